@@ -6,6 +6,9 @@
 //#define ALLOC_IMPL          LowFragHeap
 //#define ALLOC_IMPL_INCLUDE  <kcore/mem/impl/LowFragHeap/LowFragHeap.h>
 
+//#define ALLOC_IMPL          SlabAllocator
+//#define ALLOC_IMPL_INCLUDE  <kcore/mem/impl/SlabAllocator/SlabAllocator.h>
+
 #define ALLOC_IMPL          nedmallocWrapper
 #define ALLOC_IMPL_INCLUDE  <kcore/mem/impl/nedmalloc/nedmallocWrapper.h>
 
@@ -27,6 +30,12 @@ namespace gk
 template<class AllocImpl>
 class Allocator
 {
+public:
+    /**
+     * Called with the size of each Alloc when set.
+     */
+    typedef void (*AllocHook)(size_t size);
+
 public:
     /** 
 	 * Default ctor. 
@@ -55,14 +64,26 @@ public:
      */
     void Free(void* p, size_t size);
 
+    /**
+     * Sets a hook called on every Alloc of this allocator type. 
+     * Benchmarks count allocations with it. 0 to clear. 
+     * Set it before other threads allocate.
+     */
+    static void SetAllocHook(AllocHook hook);
+
 private:
     AllocImpl impl_;
+
+    static AllocHook hook_;
     
     // Copy protection
     Allocator(const Allocator&);
     Allocator& operator=(const Allocator&);
 };
 
+template<class C>
+typename Allocator<C>::AllocHook Allocator<C>::hook_ = 0;
+
 template<class C>
 inline
 Allocator<C>::Allocator()
@@ -80,6 +101,11 @@ inline
 void*
 Allocator<C>::Alloc(size_t size)
 {
+    if (hook_ != 0)
+    {
+        hook_(size);
+    }
+
     void* p = impl_.Alloc(size);
     return p;
 }
@@ -100,6 +126,14 @@ Allocator<C>::Free(void* p, size_t size)
     impl_.Free(p, size);
 }
 
+template<class C>
+inline
+void
+Allocator<C>::SetAllocHook(AllocHook hook)
+{
+    hook_ = hook;
+}
+
 typedef Allocator<ALLOC_IMPL> DefaultAllocator; ///< By redefining ALLOC_IMPL, default allocator can be changed. 
 
 extern DefaultAllocator g_allocator;
@@ -0,0 +1,590 @@
+#include "stdafx.h"
+
+#include <kcore/mem/impl/SlabAllocator/SlabAllocator.h>
+
+namespace gk
+{
+
+namespace
+{
+
+enum
+{
+    NUM_CLASSES     = 16,
+    MAX_SMALL       = 2048,
+    HEADER_SIZE     = 16,
+    CHUNK_SIZE      = 64 * 1024,
+    BATCH_BYTES     = 8 * 1024,
+    REMOTE_BATCH    = 32,
+    REMOTE_SLOTS    = 8,
+    LARGE_CLASS     = 0xFFFF
+};
+
+const unsigned int s_classSizes[NUM_CLASSES] =
+{
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1280, 1536, 1792, 2048
+};
+
+/**
+ * Block header. Kept while the block is free so that remote frees
+ * can be sorted into classes by the owner.
+ */
+union Header
+{
+    struct
+    {
+        SlabAllocator::ThreadCache* owner;
+        unsigned int                cls;
+        unsigned int                count;  ///< batch length when in depot
+    } h;
+
+    char pad[HEADER_SIZE];
+};
+
+} // anonymous
+
+struct SlabAllocator::Block
+{
+    Block* next;
+    Block* nextBatch;
+};
+
+namespace
+{
+
+struct FreeList
+{
+    SlabAllocator::Block*   head;
+    unsigned int            count;
+};
+
+struct RemoteBatch
+{
+    SlabAllocator::ThreadCache* owner;
+    SlabAllocator::Block*       head;
+    SlabAllocator::Block*       tail;
+    unsigned int                count;
+};
+
+struct Depot
+{
+    SlabAllocator::Block*   batches;
+    volatile long           lock;
+};
+
+typedef void (__stdcall *FlsCallbackFn)(void*);
+typedef DWORD (WINAPI *FlsAllocFn)(FlsCallbackFn);
+typedef BOOL (WINAPI *FlsSetValueFn)(DWORD, PVOID);
+
+unsigned char   s_classIndex[MAX_SMALL / 16 + 1];
+volatile long   s_classIndexReady;
+
+Depot           s_depots[NUM_CLASSES];
+
+SlabAllocator::ThreadCache* s_freeCaches;
+volatile long   s_cacheLock;
+volatile long   s_cacheCount;
+
+volatile long   s_flsState;     // 0: not tried, 1: in progress, 2: done
+DWORD           s_flsIndex;
+FlsSetValueFn   s_flsSetValue;
+
+__declspec(thread) SlabAllocator::ThreadCache* t_cache;
+
+inline
+void
+spinLock(volatile long& l)
+{
+    while (::InterlockedExchange(&l, 1) != 0) {
+        ::SwitchToThread();
+    }
+}
+
+inline
+void
+spinUnlock(volatile long& l)
+{
+    ::InterlockedExchange(&l, 0);
+}
+
+inline
+Header*
+headerOf(void* p)
+{
+    return (Header*)p - 1;
+}
+
+inline
+unsigned int
+batchCount(unsigned int cls)
+{
+    unsigned int n = BATCH_BYTES / (s_classSizes[cls] + HEADER_SIZE);
+
+    if (n < 4) {
+        return 4;
+    }
+
+    return n > 64 ? 64 : n;
+}
+
+inline
+unsigned int
+localLimit(unsigned int cls)
+{
+    return batchCount(cls) * 4;
+}
+
+void
+buildClassIndex()
+{
+    unsigned int cls = 0;
+
+    for (unsigned int i = 0; i <= MAX_SMALL / 16; ++i) {
+        while (s_classSizes[cls] < i * 16) {
+            ++cls;
+        }
+        s_classIndex[i] = (unsigned char)cls;
+    }
+
+    ::InterlockedExchange(&s_classIndexReady, 1);
+}
+
+} // anonymous
+
+struct SlabAllocator::ThreadCache
+{
+    FreeList        lists[NUM_CLASSES];
+    Block* volatile remote;                 ///< blocks freed by other threads
+    RemoteBatch     batches[REMOTE_SLOTS];  ///< pending frees to other caches
+    unsigned int    index;
+    ThreadCache*    nextFree;
+};
+
+void*
+SlabAllocator::Alloc(size_t size)
+{
+    if (size > MAX_SMALL) {
+        return allocLarge(size);
+    }
+
+    unsigned int cls = classOf(size);
+
+    ThreadCache* c = getCache();
+
+    FreeList& l = c->lists[cls];
+
+    if (l.head == 0) {
+        refill(c, cls);
+    }
+
+    Block* b = l.head;
+
+    l.head = b->next;
+    --l.count;
+
+    Header* h = headerOf(b);
+
+    h->h.owner  = c;
+    h->h.cls    = cls;
+
+    return b;
+}
+
+void
+SlabAllocator::Free(void* p)
+{
+    if (!p) { return; }
+
+    Header* h = headerOf(p);
+
+    if (h->h.cls == LARGE_CLASS) {
+        ::HeapFree(::GetProcessHeap(), 0, h);
+        return;
+    }
+
+    ThreadCache* c = getCache();
+
+    Block* b = (Block*)p;
+
+    if (h->h.owner != c) {
+        freeRemote(c, h->h.owner, b);
+        return;
+    }
+
+    unsigned int cls = h->h.cls;
+
+    FreeList& l = c->lists[cls];
+
+    b->next = l.head;
+    l.head  = b;
+    ++l.count;
+
+    if (l.count > localLimit(cls)) {
+        spill(c, cls, batchCount(cls));
+    }
+}
+
+void
+SlabAllocator::ReleaseThreadCache()
+{
+    ThreadCache* c = t_cache;
+
+    if (!c) { return; }
+
+    t_cache = 0;
+
+    if (s_flsSetValue) {
+        s_flsSetValue(s_flsIndex, 0);
+    }
+
+    releaseCache(c);
+}
+
+void __stdcall
+SlabAllocator::onThreadExit(void* p)
+{
+    if (!p) { return; }
+
+    t_cache = 0;
+
+    releaseCache((ThreadCache*)p);
+}
+
+void
+SlabAllocator::releaseCache(ThreadCache* c)
+{
+    // return everything so that the cache can be adopted by a new thread
+
+    for (unsigned int i = 0; i < REMOTE_SLOTS; ++i) {
+        flushRemote(c, i);
+    }
+
+    drainRemote(c);
+
+    for (unsigned int cls = 0; cls < NUM_CLASSES; ++cls) {
+        while (c->lists[cls].count > 0) {
+            unsigned int n = c->lists[cls].count;
+
+            if (n > batchCount(cls)) {
+                n = batchCount(cls);
+            }
+
+            spill(c, cls, n);
+        }
+    }
+
+    spinLock(s_cacheLock);
+
+    c->nextFree     = s_freeCaches;
+    s_freeCaches    = c;
+
+    spinUnlock(s_cacheLock);
+}
+
+void*
+SlabAllocator::allocLarge(size_t size)
+{
+    Header* h = (Header*)::HeapAlloc(::GetProcessHeap(), 0, size + HEADER_SIZE);
+
+    if (!h) {
+        throw std::bad_alloc(); // ANSI/ISO compliant behavior
+    }
+
+    h->h.owner  = 0;
+    h->h.cls    = LARGE_CLASS;
+
+    return h + 1;
+}
+
+SlabAllocator::ThreadCache*
+SlabAllocator::getCache()
+{
+    ThreadCache* c = t_cache;
+
+    if (c) {
+        return c;
+    }
+
+    // [1] adopt a released cache or make a new one
+
+    spinLock(s_cacheLock);
+
+    c = s_freeCaches;
+
+    if (c) {
+        s_freeCaches = c->nextFree;
+        c->nextFree  = 0;
+    }
+
+    spinUnlock(s_cacheLock);
+
+    if (!c) {
+        c = (ThreadCache*)::HeapAlloc(::GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(ThreadCache));
+
+        if (!c) {
+            throw std::bad_alloc();
+        }
+
+        c->index = (unsigned int)::InterlockedIncrement(&s_cacheCount);
+    }
+
+    t_cache = c;
+
+    // [2] get notified on thread exit. FLS is not available on XP.
+
+    if (s_flsState != 2) {
+        if (::InterlockedCompareExchange(&s_flsState, 1, 0) == 0) {
+            HMODULE k = ::GetModuleHandleA("kernel32.dll");
+
+            FlsAllocFn flsAlloc = (FlsAllocFn)::GetProcAddress(k, "FlsAlloc");
+            FlsSetValueFn flsSetValue = (FlsSetValueFn)::GetProcAddress(k, "FlsSetValue");
+
+            if (flsAlloc && flsSetValue) {
+                s_flsIndex = flsAlloc(&SlabAllocator::onThreadExit);
+
+                if (s_flsIndex != FLS_OUT_OF_INDEXES) {
+                    s_flsSetValue = flsSetValue;
+                }
+            }
+
+            ::InterlockedExchange(&s_flsState, 2);
+        }
+        else {
+            while (s_flsState != 2) {
+                ::SwitchToThread();
+            }
+        }
+    }
+
+    if (s_flsSetValue) {
+        s_flsSetValue(s_flsIndex, c);
+    }
+
+    return c;
+}
+
+void
+SlabAllocator::refill(ThreadCache* c, unsigned int cls)
+{
+    // hand over pending remote frees while we are on the slow path
+
+    for (unsigned int i = 0; i < REMOTE_SLOTS; ++i) {
+        flushRemote(c, i);
+    }
+
+    if (c->remote) {
+        drainRemote(c);
+
+        if (c->lists[cls].head) { return; }
+    }
+
+    if (popDepot(c, cls)) {
+        return;
+    }
+
+    carve(c, cls);
+}
+
+void
+SlabAllocator::drainRemote(ThreadCache* c)
+{
+    Block* b = (Block*)::InterlockedExchangePointer((PVOID volatile*)&c->remote, 0);
+
+    while (b) {
+        Block* next = b->next;
+
+        FreeList& l = c->lists[headerOf(b)->h.cls];
+
+        b->next = l.head;
+        l.head  = b;
+        ++l.count;
+
+        b = next;
+    }
+}
+
+void
+SlabAllocator::freeRemote(ThreadCache* c, ThreadCache* owner, Block* b)
+{
+    unsigned int slot = owner->index % REMOTE_SLOTS;
+
+    RemoteBatch& r = c->batches[slot];
+
+    if (r.owner != owner) {
+        flushRemote(c, slot);
+
+        r.owner = owner;
+    }
+
+    b->next = r.head;
+
+    if (!r.head) {
+        r.tail = b;
+    }
+
+    r.head = b;
+    ++r.count;
+
+    if (r.count >= REMOTE_BATCH) {
+        flushRemote(c, slot);
+    }
+}
+
+void
+SlabAllocator::flushRemote(ThreadCache* c, unsigned int slot)
+{
+    RemoteBatch& r = c->batches[slot];
+
+    if (!r.head) { return; }
+
+    // single consumer takes the whole list with an exchange. so no ABA here.
+
+    for (;;) {
+        Block* top = r.owner->remote;
+
+        r.tail->next = top;
+
+        if (::InterlockedCompareExchangePointer(
+                (PVOID volatile*)&r.owner->remote, r.head, top) == top) {
+            break;
+        }
+    }
+
+    r.head  = 0;
+    r.tail  = 0;
+    r.count = 0;
+}
+
+void
+SlabAllocator::spill(ThreadCache* c, unsigned int cls, unsigned int n)
+{
+    FreeList& l = c->lists[cls];
+
+    Block* head = l.head;
+    Block* tail = head;
+
+    for (unsigned int i = 1; i < n; ++i) {
+        tail = tail->next;
+    }
+
+    l.head      = tail->next;
+    l.count    -= n;
+    tail->next  = 0;
+
+    headerOf(head)->h.count = n;
+
+    Depot& d = s_depots[cls];
+
+    spinLock(d.lock);
+
+    head->nextBatch = d.batches;
+    d.batches       = head;
+
+    spinUnlock(d.lock);
+}
+
+bool
+SlabAllocator::popDepot(ThreadCache* c, unsigned int cls)
+{
+    Depot& d = s_depots[cls];
+
+    spinLock(d.lock);
+
+    Block* batch = d.batches;
+
+    if (batch) {
+        d.batches = batch->nextBatch;
+    }
+
+    spinUnlock(d.lock);
+
+    if (!batch) {
+        return false;
+    }
+
+    FreeList& l = c->lists[cls];
+
+    l.head  = batch;
+    l.count = headerOf(batch)->h.count;
+
+    return true;
+}
+
+void
+SlabAllocator::carve(ThreadCache* c, unsigned int cls)
+{
+    char* chunk = (char*)::VirtualAlloc(0, CHUNK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+    if (!chunk) {
+        throw std::bad_alloc();
+    }
+
+    unsigned int stride = s_classSizes[cls] + HEADER_SIZE;
+    unsigned int n      = CHUNK_SIZE / stride;
+
+    Block* head = 0;
+
+    for (unsigned int i = n; i > 0; --i) {
+        Header* h = (Header*)(chunk + (i - 1) * stride);
+
+        h->h.owner  = c;
+        h->h.cls    = cls;
+
+        Block* b = (Block*)(h + 1);
+
+        b->next = head;
+        head    = b;
+    }
+
+    FreeList& l = c->lists[cls];
+
+    l.head  = head;
+    l.count = n;
+}
+
+unsigned int
+SlabAllocator::classOf(size_t size)
+{
+    if (!s_classIndexReady) {
+        buildClassIndex();
+    }
+
+    return s_classIndex[(size + 15) >> 4];
+}
+
+} // gk
+
+/**
+ * Thread exit hook through the TLS callback of the image.
+ *
+ * FLS callbacks are not available on XP, and then a dead thread's cache
+ * and its remote list would be lost. The loader calls TLS callbacks on
+ * every thread exit on all versions, so the cache is released here.
+ * Where the FLS callback already did it, t_cache is 0 and this does nothing.
+ */
+namespace
+{
+
+void NTAPI
+slabTlsCallback(PVOID /* module */, DWORD reason, PVOID /* reserved */)
+{
+    if (reason == DLL_THREAD_DETACH) {
+        gk::SlabAllocator::ReleaseThreadCache();
+    }
+}
+
+} // anonymous
+
+// x86 decorates C names with a leading underscore, x64 does not
+#ifdef _WIN64
+ #pragma comment(linker, "/INCLUDE:_tls_used")
+ #pragma comment(linker, "/INCLUDE:p_slabTlsCallback")
+#else
+ #pragma comment(linker, "/INCLUDE:__tls_used")
+ #pragma comment(linker, "/INCLUDE:_p_slabTlsCallback")
+#endif
+
+#pragma section(".CRT$XLS", read)
+
+extern "C" __declspec(allocate(".CRT$XLS"))
+const PIMAGE_TLS_CALLBACK p_slabTlsCallback = slabTlsCallback;
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <new>
+
+namespace gk
+{
+/**
+ * @class   SlabAllocator
+ *
+ * @brief   Allocator implementation with per-thread caches of fixed size classes.
+ *
+ * Blocks up to MAX_SMALL bytes are served from the calling thread's cache
+ * without any lock. Each block carries a small header with its size class
+ * and owning cache.
+ *
+ * A block freed on a foreign thread is batched per owner and pushed to the
+ * owner's remote list with a single interlocked operation. The owner takes
+ * the whole remote list with one exchange when its local list runs dry.
+ * This is the IO thread alloc / Node thread free pattern of messages.
+ *
+ * Local lists over their limit spill batches to a global depot per class,
+ * which other threads refill from before carving new chunks.
+ * Larger blocks go to the process heap.
+ *
+ * All state is zero-initialized static storage, so it works before
+ * g_allocator is constructed when global new/delete are overridden.
+ */
+class SlabAllocator
+{
+public:
+    void* Alloc(size_t size);
+    void Free(void* p);
+
+    /**
+     * Return the calling thread's cache. Called automatically on thread
+     * exit by the FLS callback (Vista and later) or the TLS callback.
+     */
+    static void ReleaseThreadCache();
+
+    struct Block;
+    struct ThreadCache;
+
+private:
+    static void __stdcall onThreadExit(void* p);
+    static void releaseCache(ThreadCache* c);
+    static void* allocLarge(size_t size);
+    static ThreadCache* getCache();
+    static void refill(ThreadCache* c, unsigned int cls);
+    static void drainRemote(ThreadCache* c);
+    static void freeRemote(ThreadCache* c, ThreadCache* owner, Block* b);
+    static void flushRemote(ThreadCache* c, unsigned int slot);
+    static void spill(ThreadCache* c, unsigned int cls, unsigned int n);
+    static bool popDepot(ThreadCache* c, unsigned int cls);
+    static void carve(ThreadCache* c, unsigned int cls);
+    static unsigned int classOf(size_t size);
+};
+
+} // gk
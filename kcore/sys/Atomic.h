@@ -1,17 +1,116 @@
 #pragma once
 
-namespace gk 
+namespace gk
 {
+
+/**
+ * Memory ordering of an atomic access.
+ *
+ * With msvc, volatile reads have acquire and volatile writes have release
+ * semantics, and aligned loads / stores up to the word size are atomic.
+ * So only sequentially consistent stores need an interlocked instruction.
+ */
+enum MemoryOrder
+{
+	  MO_RELAXED
+	, MO_ACQUIRE
+	, MO_RELEASE
+	, MO_SEQ_CST
+};
+
+/**
+ * @struct AtomicOps
+ *
+ * Interlocked primitives by operand size.
+ */
+template <int SIZE>
+struct AtomicOps;
+
+template <>
+struct AtomicOps<4>
+{
+	typedef long Type;
+
+	static Type Load( const volatile Type* p )
+	{
+		return *p;
+	}
+
+	static void Store( volatile Type* p, Type v )
+	{
+		*p = v;
+	}
+
+	static Type Exchange( volatile Type* p, Type v )
+	{
+		return ::InterlockedExchange( p, v );
+	}
+
+	static Type FetchAdd( volatile Type* p, Type v )
+	{
+		return ::InterlockedExchangeAdd( p, v );
+	}
+
+	static Type CompareExchange( volatile Type* p, Type desired, Type expected )
+	{
+		return ::InterlockedCompareExchange( p, desired, expected );
+	}
+};
+
+template <>
+struct AtomicOps<8>
+{
+	typedef LONGLONG Type;
+
+	static Type Load( const volatile Type* p )
+	{
+#if defined( _M_X64 )
+		return *p;
+#else
+		// 64 bit loads are not atomic on x86
+		return ::InterlockedCompareExchange64( (volatile Type*)p, 0, 0 );
+#endif
+	}
+
+	static void Store( volatile Type* p, Type v )
+	{
+#if defined( _M_X64 )
+		*p = v;
+#else
+		::InterlockedExchange64( p, v );
+#endif
+	}
+
+	static Type Exchange( volatile Type* p, Type v )
+	{
+		return ::InterlockedExchange64( p, v );
+	}
+
+	static Type FetchAdd( volatile Type* p, Type v )
+	{
+		return ::InterlockedExchangeAdd64( p, v );
+	}
+
+	static Type CompareExchange( volatile Type* p, Type desired, Type expected )
+	{
+		return ::InterlockedCompareExchange64( p, desired, expected );
+	}
+};
+
 /**
  * @class Atomic
  *
- * @brief locked access to a flag data.
- * 
- * NOTE: T must be compatible with long type.
+ * @brief Atomic access to a 32 or 64 bit integral value.
+ *
+ * Reads are plain loads. Counters read on hot paths do not pay
+ * for a locked instruction. Assignment stays sequentially consistent.
  */
 template <typename T>
-class Atomic 
+class Atomic
 {
+	typedef AtomicOps<sizeof( T )> Ops;
+	typedef typename Ops::Type Raw;
+
 public:
     Atomic()
 	: v_()
@@ -19,13 +118,13 @@ public:
 	}
 
 	/**
-	 * Constructs with a default value 
+	 * Constructs with a default value
 	 *
 	 * @param v Initial value
 	 */
     explicit Atomic( const T& v )
+	: v_( (Raw)v )
 	{
-		::InterlockedExchange( (volatile long*)&v_, v );
 	}
 
     ~Atomic()
@@ -33,13 +132,85 @@ public:
 	}
 
     /**
-     * Copy construction 
+     * Copy construction
      */
     Atomic( const Atomic<T>& rhs )
+	: v_( (Raw)rhs.Load() )
 	{
-		T v = (T)rhs;
+	}
 
-		::InterlockedExchange( (volatile long*)&v_, v );
+	/**
+	 * Load the value
+	 *
+	 * @param mo Memory order. Relaxed and acquire are a plain load.
+	 * @return Current value
+	 */
+	T Load( MemoryOrder mo = MO_ACQUIRE ) const
+	{
+		mo;
+
+		return (T)Ops::Load( &v_ );
+	}
+
+	/**
+	 * Store a value
+	 *
+	 * @param v Value to store
+	 * @param mo Memory order. Only MO_SEQ_CST uses an interlocked exchange.
+	 */
+	void Store( const T& v, MemoryOrder mo = MO_SEQ_CST )
+	{
+		if ( mo == MO_SEQ_CST )
+		{
+			Ops::Exchange( &v_, (Raw)v );
+		}
+		else
+		{
+			Ops::Store( &v_, (Raw)v );
+		}
+	}
+
+	/**
+	 * Atomic exchange
+	 *
+	 * @param v Value to store
+	 * @return Previous value
+	 */
+	T Exchange( const T& v )
+	{
+		return (T)Ops::Exchange( &v_, (Raw)v );
+	}
+
+	/**
+	 * Atomic add
+	 *
+	 * @param v Value to add
+	 * @return Previous value
+	 */
+	T FetchAdd( const T& v )
+	{
+		return (T)Ops::FetchAdd( &v_, (Raw)v );
+	}
+
+	/**
+	 * Atomic compare and exchange
+	 *
+	 * @param expected Value expected. Updated to the current value on failure.
+	 * @param desired Value to store when current value is expected
+	 * @return true if desired is stored
+	 */
+	bool CompareExchange( T& expected, const T& desired )
+	{
+		Raw prev = Ops::CompareExchange( &v_, (Raw)desired, (Raw)expected );
+
+		if ( prev == (Raw)expected )
+		{
+			return true;
+		}
+
+		expected = (T)prev;
+
+		return false;
 	}
 
 	/**
@@ -50,7 +221,7 @@ public:
 	 */
 	const Atomic& Add( const T& v )
 	{
-		::InterlockedExchangeAdd( (volatile long*)&v_, v );
+		Ops::FetchAdd( &v_, (Raw)v );
 
 		return *this;
 	}
@@ -62,7 +233,7 @@ public:
 	 */
 	const Atomic& Inc()
 	{
-		::InterlockedIncrement( (volatile long*)&v_ );
+		Ops::FetchAdd( &v_, 1 );
 
 		return *this;
 	}
@@ -74,31 +245,31 @@ public:
 	 */
 	const Atomic& Dec()
 	{
-		::InterlockedDecrement( (volatile long*)&v_ );
+		Ops::FetchAdd( &v_, -1 );
 
 		return *this;
 	}
-	
+
     /**
-     * Assignment with a raw value 
+     * Assignment with a raw value
 	 *
 	 * @param v Value to assign
 	 * @return Reference to this object
      */
     const Atomic& operator=( const T& v )
 	{
-		::InterlockedExchange( (volatile long*)&v_, v );
+		Store( v );
 
 		return *this;
 	}
 
     /**
-     * Type conversion to T. Because of Locking, this cannot be const
+     * Type conversion to T. Acquire load.
      */
     operator T () const
 	{
-		return (T)::InterlockedCompareExchange( (volatile long*)&v_, v_, v_ );
-	}	
+		return Load();
+	}
 
     /**
      * Comparison of raw values
@@ -106,35 +277,36 @@ public:
 	 * @param v Value to compare
 	 * @return true if the values are same
      */
-    bool operator==( const T& v)
+    bool operator==( const T& v ) const
 	{
-		T ev = ::InterlockedCompareExchange( (volatile long*)&v_, v_, v_ );
-
-		return ( ev == v );
+		return ( Load() == v );
 	}
 
 private:
-    volatile T v_;
+    volatile Raw v_;
 };
 
 /**
  * @class Atomic<bool>
  *
- * Specialization of Atomic for bool type. 
+ * Specialization of Atomic for bool type.
  * Reason: Warning can ocurr during type casting.
+ * Kept in a long since interlocked functions write 4 bytes.
  */
 template <>
-class Atomic<bool> 
+class Atomic<bool>
 {
+	typedef AtomicOps<sizeof( long )> Ops;
+
 public:
 	Atomic()
-		: v_( false )
+		: v_( 0 )
 	{
 	}
 
 	explicit Atomic( const bool& v )
+		: v_( v ? 1 : 0 )
 	{
-		::InterlockedExchange( (volatile long*)&v_, v );
 	}
 
 	~Atomic()
@@ -142,42 +314,106 @@ public:
 	}
 
 	/**
-	 * Copy construction 
+	 * Copy construction
 	 */
 	Atomic( const Atomic<bool>& rhs )
+		: v_( rhs.Load() ? 1 : 0 )
+	{
+	}
+
+	bool Load( MemoryOrder mo = MO_ACQUIRE ) const
+	{
+		mo;
+
+		return Ops::Load( &v_ ) != 0;
+	}
+
+	void Store( const bool& v, MemoryOrder mo = MO_SEQ_CST )
+	{
+		if ( mo == MO_SEQ_CST )
+		{
+			Ops::Exchange( &v_, v ? 1 : 0 );
+		}
+		else
+		{
+			Ops::Store( &v_, v ? 1 : 0 );
+		}
+	}
+
+	bool Exchange( const bool& v )
+	{
+		return Ops::Exchange( &v_, v ? 1 : 0 ) != 0;
+	}
+
+	bool CompareExchange( bool& expected, const bool& desired )
 	{
-		bool v = (bool)rhs;
+		long prev = Ops::CompareExchange( &v_, desired ? 1 : 0, expected ? 1 : 0 );
+
+		if ( ( prev != 0 ) == expected )
+		{
+			return true;
+		}
 
-		::InterlockedExchange( (volatile long*)&v_, (long)v );
+		expected = ( prev != 0 );
+
+		return false;
 	}
 
 	/**
-	 * Assignment with a raw value 
+	 * Assignment with a raw value
 	 */
 	const Atomic& operator=( const bool& v )
 	{
-		::InterlockedExchange( (volatile long*)&v_, (long)v );
+		Store( v );
 
 		return *this;
 	}
 
 	operator bool () const
 	{
-		return ( ::InterlockedCompareExchange( (volatile long*)&v_, v_, v_ ) != 0 );
+		return Load();
 	}
 
 	/**
 	 * Comparison of raw values
 	 */
-	bool operator==( const bool& v)
+	bool operator==( const bool& v ) const
 	{
-		bool ev = ( ::InterlockedCompareExchange( (volatile long*)&v_, v_, v_ ) != 0 );
-
-		return ( ev == v );
+		return ( Load() == v );
 	}
 
 private:
-	volatile bool v_;	
+	volatile long v_;
+};
+
+/**
+ * @class PaddedAtomic
+ *
+ * Atomic on its own cache line. Use for counters written by
+ * one thread and read by others to avoid false sharing.
+ *
+ * NOTE: Heap objects are aligned only to the allocator alignment.
+ */
+template <typename T>
+class __declspec( align( 64 ) ) PaddedAtomic : public Atomic<T>
+{
+public:
+	PaddedAtomic()
+		: Atomic<T>()
+	{
+	}
+
+	explicit PaddedAtomic( const T& v )
+		: Atomic<T>( v )
+	{
+	}
+
+	const PaddedAtomic& operator=( const T& v )
+	{
+		Atomic<T>::Store( v );
+
+		return *this;
+	}
 };
 
-} // gk 
+} // gk
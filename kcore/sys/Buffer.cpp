@@ -10,8 +10,9 @@ Buffer::Buffer( byte *data, uint len )
 	K_ASSERT( data != 0 );
 	K_ASSERT( len > 0 );
 
-	m_data 	= data;
-	m_size 	= len;
+	m_data 		= data;
+	m_size 		= len;
+	m_capacity 	= len;
 	m_owner 	= false;
 }
 
@@ -19,9 +20,7 @@ Buffer::Buffer( uint len )
 {
 	K_ASSERT( len > 0 );
 
-	m_size   = len;
-	m_data 	 = (byte*)g_allocator.Alloc( m_size );
-	m_owner	 = true;
+	allocate( len );
 }
 
 
@@ -2,12 +2,30 @@
 
 #include <kcore/mem/Allocator.h>
 
+/**
+ * Bytes of a Buffer kept inside the object. 
+ * 
+ * 256 holds the default 128 byte BitStream used as a temporary on send 
+ * paths with room for one growth, so those never allocate. 
+ * It adds the same to every Buffer and BitStream including long lived 
+ * members. When object size matters more, define it smaller, or 0 to 
+ * always allocate, in the preprocessor definitions of every project.
+ */
+#ifndef BUFFER_INLINE_SIZE
+#define BUFFER_INLINE_SIZE 256
+#endif
+
 namespace gk {
 
 /**
  * @class Buffer 
  *
  * @brief Byte buffer allocated dynamically. 
+ *
+ * Size is the usable length. Capacity is what is allocated. 
+ * Growth is geometric, so repeated appends are amortized O(1). 
+ * Buffers up to INLINE_BUFFER_SIZE live inside the object and 
+ * do not touch the heap.
  */
 class Buffer 
 {
@@ -15,6 +33,7 @@ public:
    	enum 
 	{
    	   DEFAULT_BUFFER_SIZE = 128,  // initial buffer size
+   	   INLINE_BUFFER_SIZE  = BUFFER_INLINE_SIZE,  // small buffer kept in the object
    	};
 	
    	/**
@@ -33,10 +52,15 @@ public:
    	Buffer( uint len = DEFAULT_BUFFER_SIZE );
 
 	/**
-	 * Copy constructor. Copies buffer.
+	 * Copy constructor. Copies content into memory owned by this.
 	 */
 	Buffer( const Buffer& rhs );
 
+	/**
+	 * Assignment. Copies content into memory owned by this.
+	 */
+	Buffer& operator=( const Buffer& rhs );
+
 	/**
 	 * Destroys buffer 
 	 */
@@ -60,13 +84,21 @@ public:
 	void SetBuffer( byte* data, uint len, bool owner );
 
 	/** 
-	 * Attempts to resize the buffer.
+	 * Attempts to resize the buffer. Capacity grows at least twice.
 	 * 
 	 * @param newSize The new required buffer size
 	 * @return true if it owns its own memory, false otherwise.
 	 */
 	bool Resize( uint newSize );
 
+	/**
+	 * Make sure capacity is at least the given size. Size is not changed.
+	 *
+	 * @param capacity The capacity required
+	 * @return false if it does not own its own memory and it is too small
+	 */
+	bool Reserve( uint capacity );
+
 	/**
 	 * Appends the specified buffer to the end of the byte buffer.
 	 *
@@ -112,37 +144,66 @@ public:
 	 */
 	uint GetSize() const;
 
+	/**
+	 * @return allocated size
+	 */
+	uint GetCapacity() const;
+
 	/**
 	 * @return buffer
 	 */
 	byte* GetBuffer() const;
 
+protected:
+	void allocate( uint len );
+	bool grow( uint capacity );
+	void release();
+
 protected:
 	byte* 		m_data; 		// buffer
 	uint 		m_size;			// buffer length 
+	uint 		m_capacity;		// allocated length
 	bool 		m_owner; 		// is owner?
+	byte 		m_inline[INLINE_BUFFER_SIZE > 0 ? INLINE_BUFFER_SIZE : 1]; // small buffer storage
 };
 
 inline
 Buffer::Buffer( const Buffer& rhs )
+: m_data( 0 )
+, m_size( 0 )
+, m_capacity( 0 )
+, m_owner( false )
 {
-	m_size   = rhs.m_size;
-	m_data 	= rhs.m_data;
-	m_owner 	= false;
+	allocate( rhs.m_size );
+
+	if ( m_size > 0 )
+	{
+		::memcpy( m_data, rhs.m_data, m_size );
+	}
 }
 
 inline
-Buffer::~Buffer()
+Buffer& 
+Buffer::operator=( const Buffer& rhs )
 {
-	if ( m_owner )
+	K_RETURN_V_IF( this == &rhs, *this );
+
+	release();
+
+	allocate( rhs.m_size );
+
+	if ( m_size > 0 )
 	{
-		if ( m_data != 0 )
-		{
-			g_allocator.Free( m_data );
-			m_data = 0;
-			m_size = 0;
-		}
+		::memcpy( m_data, rhs.m_data, m_size );
 	}
+
+	return *this;
+}
+
+inline
+Buffer::~Buffer()
+{
+	release();
 }
 
 inline
@@ -152,20 +213,11 @@ Buffer::SetBuffer( byte* data, uint len )
 	K_ASSERT( data != 0 );
 	K_ASSERT( len > 0 );
 
-	if ( m_owner )
-	{
-		m_owner = false;
-
-		if ( m_data != 0 )
-		{
-			g_allocator.Free( m_data );
-			m_data = 0;
-			m_size = 0;
-		}
-	}
+	release();
 
-	m_data = data;
-	m_size = len;
+	m_data 		= data;
+	m_size 		= len;
+	m_capacity 	= len;
 }
 
 inline
@@ -182,32 +234,107 @@ Buffer::Resize( uint newSize )
 {
 	K_ASSERT( newSize > 0 );
 
-	if ( m_size >= newSize )
+	if ( m_capacity >= newSize )
 	{
 		m_size = newSize;
+
+		return true;
 	}
-	else if( m_owner )
- 	{
- 		byte* p = (byte*)g_allocator.Alloc( newSize );
 
-		if ( m_data != 0 )
-		{
-			K_ASSERT( m_size > 0 );
+	uint capacity = m_capacity * 2;
 
-			// memcpy is faster than realloc call
-			::memcpy( p, (void*)m_data, m_size );
+	if ( capacity < newSize )
+	{
+		capacity = newSize;
+	}
 
-			m_size = newSize;
+	if ( !grow( capacity ) )
+	{
+		return false;
+	}
 
-			g_allocator.Free( m_data );
-		}
+	m_size = newSize;
 
-		m_data = p;
+	return true;
+}
 
+inline
+bool 
+Buffer::Reserve( uint capacity )
+{
+	if ( m_capacity >= capacity )
+	{
 		return true;
 	}
 
-	return false;
+	return grow( capacity );
+}
+
+inline
+void 
+Buffer::allocate( uint len )
+{
+	// called on a released buffer
+
+	m_size 	= len;
+	m_owner = true;
+
+	if ( len <= INLINE_BUFFER_SIZE )
+	{
+		m_data 		= m_inline;
+		m_capacity 	= INLINE_BUFFER_SIZE;
+	}
+	else
+	{
+		m_data 		= (byte*)g_allocator.Alloc( len );
+		m_capacity 	= len;
+	}
+}
+
+inline
+bool 
+Buffer::grow( uint capacity )
+{
+	K_ASSERT( capacity > m_capacity );
+
+	if ( !m_owner )
+	{
+		return false;
+	}
+
+	byte* p = (byte*)g_allocator.Alloc( capacity );
+
+	if ( m_data != 0 && m_size > 0 )
+	{
+		// memcpy is faster than realloc call
+		::memcpy( p, (void*)m_data, m_size );
+	}
+
+	release();
+
+	m_data 		= p;
+	m_capacity 	= capacity;
+	m_owner 	= true;
+
+	return true;
+}
+
+inline
+void 
+Buffer::release()
+{
+	if ( m_owner )
+	{
+		m_owner = false;
+
+		if ( m_data != 0 && m_data != m_inline )
+		{
+			g_allocator.Free( m_data );
+		}
+	}
+
+	m_data 		= 0;
+	m_capacity 	= 0;
 }
 
 inline
@@ -260,12 +387,21 @@ Buffer::TakeOwnership()
 {
 	if ( !m_owner )
 	{
-		byte* p = (byte*)g_allocator.Alloc( m_size );
+		byte* p = m_inline;
 
-		::memcpy( (void*)p, (void*)m_data, m_size );
+		if ( m_size > INLINE_BUFFER_SIZE )
+		{
+			p = (byte*)g_allocator.Alloc( m_size );
+		}
 
-		m_data 	= p;
-		m_owner = true;
+		if ( m_size > 0 )
+		{
+			::memcpy( (void*)p, (void*)m_data, m_size );
+		}
+
+		m_data 		= p;
+		m_capacity 	= ( p == m_inline ) ? INLINE_BUFFER_SIZE : m_size;
+		m_owner 	= true;
 	}
 }
 
@@ -293,6 +429,13 @@ Buffer::GetSize() const
 	return m_size;
 }
 
+inline
+uint 
+Buffer::GetCapacity() const
+{
+	return m_capacity;
+}
+
 inline
 byte* 
 Buffer::GetBuffer() const
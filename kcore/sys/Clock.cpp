@@ -0,0 +1,172 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <kcore/sys/Clock.h>
+
+#if defined( __linux__ )
+#include <time.h>
+#else
+#include <intrin.h>
+#endif
+
+namespace gk {
+
+namespace
+{
+
+const uint8 NS_PER_SEC	= 1000000000;
+const uint8 NS_PER_MS	= 1000000;
+
+volatile long	s_calibrate;	// 0: not tried, 1: in progress, 2: done
+volatile bool	s_useTsc;
+double			s_nsPerTsc;
+uint8			s_tscBase;
+uint8			s_nsBase;
+
+#if !defined( __linux__ )
+uint8 
+queryFrequency()
+{
+	uint8 freq = 0;
+
+	::QueryPerformanceFrequency( (LARGE_INTEGER*)&freq );
+
+	return freq;
+}
+
+// read once at startup before other threads run. never written after.
+// 64 bit writes are not atomic on x86, so it is not set lazily.
+
+const uint8		s_freq = queryFrequency();
+#endif
+
+#if defined( __linux__ )
+__thread uint8 t_nowMs;				// 0 when the thread never called Update()
+#else
+__declspec(thread) uint8 t_nowMs;	// 0 when the thread never called Update()
+#endif
+
+} // anonymous
+
+uint8
+Clock::NowNs()
+{
+#if defined( __linux__ )
+	timespec ts;
+
+	::clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return (uint8)ts.tv_sec * NS_PER_SEC + ts.tv_nsec;
+#else
+	// 0 only when called by a static initializer before s_freq is set
+
+	uint8 freq = s_freq != 0 ? s_freq : queryFrequency();
+
+	uint8 counter = 0;
+
+	::QueryPerformanceCounter( (LARGE_INTEGER*)&counter );
+
+	// split to avoid overflow of counter * NS_PER_SEC
+
+	return ( counter / freq ) * NS_PER_SEC +
+		   ( counter % freq ) * NS_PER_SEC / freq;
+#endif
+}
+
+uint8
+Clock::FastNowNs()
+{
+#if !defined( __linux__ )
+	if ( s_useTsc )
+	{
+		uint8 tsc = __rdtsc();
+
+		return s_nsBase + (uint8)( (double)( tsc - s_tscBase ) * s_nsPerTsc );
+	}
+#endif
+
+	return NowNs();
+}
+
+bool
+Clock::Calibrate()
+{
+#if defined( __linux__ )
+	return false;
+#else
+	if ( ::InterlockedCompareExchange( &s_calibrate, 1, 0 ) != 0 )
+	{
+		while ( s_calibrate != 2 )
+		{
+			::Sleep( 1 );
+		}
+
+		return s_useTsc;
+	}
+
+	// [1] invariant TSC runs at a constant rate over all cores and power states
+
+	int regs[4];
+
+	__cpuid( regs, 0x80000000 );
+
+	bool invariant = false;
+
+	if ( (uint)regs[0] >= 0x80000007 )
+	{
+		__cpuid( regs, 0x80000007 );
+
+		invariant = ( regs[3] & ( 1 << 8 ) ) != 0;
+	}
+
+	// [2] measure TSC rate against the performance counter
+
+	if ( invariant )
+	{
+		uint8 ns0	= NowNs();
+		uint8 tsc0	= __rdtsc();
+
+		::Sleep( 20 );
+
+		uint8 ns1	= NowNs();
+		uint8 tsc1	= __rdtsc();
+
+		if ( ns1 > ns0 && tsc1 > tsc0 )
+		{
+			s_nsPerTsc	= (double)( ns1 - ns0 ) / (double)( tsc1 - tsc0 );
+			s_tscBase	= tsc1;
+			s_nsBase	= ns1;
+
+			s_useTsc	= true; // volatile write is release on msvc
+		}
+	}
+
+	::InterlockedExchange( &s_calibrate, 2 );
+
+	return s_useTsc;
+#endif
+}
+
+void
+Clock::Update()
+{
+	t_nowMs = FastNowNs() / NS_PER_MS;
+
+	if ( t_nowMs == 0 )
+	{
+		t_nowMs = 1;
+	}
+}
+
+uint8
+Clock::Now()
+{
+	if ( t_nowMs != 0 )
+	{
+		return t_nowMs;
+	}
+
+	return FastNowNs() / NS_PER_MS;
+}
+
+} // gk
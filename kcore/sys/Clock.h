@@ -0,0 +1,60 @@
+#pragma once
+
+namespace gk
+{
+
+/**
+ * @class Clock
+ *
+ * Monotonic clock service.
+ *
+ * NowNs() is the portable source. QueryPerformanceCounter on Windows
+ * with the frequency read once at startup. CLOCK_MONOTONIC on Linux.
+ *
+ * FastNowNs() reads the TSC and scales it when Calibrate() found an
+ * invariant TSC. Otherwise it is same as NowNs().
+ *
+ * Loops call Update() once per iteration. Now() then returns the
+ * cached value on that thread, so timers checked many times in an
+ * iteration share one clock read. Threads which never call Update()
+ * get the current time from Now().
+ */
+class Clock
+{
+public:
+	/**
+	 * Current monotonic time
+	 *
+	 * @return Nanoseconds from an unspecified start
+	 */
+	static uint8 NowNs();
+
+	/**
+	 * Current monotonic time using TSC when calibrated
+	 *
+	 * @return Nanoseconds on the same base as NowNs()
+	 */
+	static uint8 FastNowNs();
+
+	/**
+	 * Enable the TSC path of FastNowNs(). Blocks about 20 ms once.
+	 *
+	 * @return true if TSC is invariant and calibrated
+	 */
+	static bool Calibrate();
+
+	/**
+	 * Cache the current time for the calling thread.
+	 * Called once per loop iteration.
+	 */
+	static void Update();
+
+	/**
+	 * Time cached by the last Update() on this thread
+	 *
+	 * @return Milliseconds on the same base as NowNs()
+	 */
+	static uint8 Now();
+};
+
+} // gk
@@ -0,0 +1,96 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <kcore/sys/Event.h>
+
+#if defined( __linux__ )
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace gk {
+
+Event::Event()
+: m_signalled( false )
+{
+#if defined( __linux__ )
+	m_fd = ::eventfd( 0, EFD_NONBLOCK );
+
+	K_ASSERT( m_fd >= 0 );
+#else
+	m_handle = ::CreateEvent( NULL, FALSE, FALSE, NULL );
+
+	K_ASSERT( m_handle != NULL );
+#endif
+}
+
+Event::~Event()
+{
+#if defined( __linux__ )
+	if ( m_fd >= 0 )
+	{
+		::close( m_fd );
+	}
+#else
+	if ( m_handle != NULL )
+	{
+		::CloseHandle( m_handle );
+	}
+#endif
+}
+
+void
+Event::Signal()
+{
+	// plain read first. no bus lock while the loop is awake and busy.
+
+	K_RETURN_IF( m_signalled.Load() );
+	K_RETURN_IF( m_signalled.Exchange( true ) );
+
+#if defined( __linux__ )
+	uint8 one = 1;
+
+	ssize_t rc = ::write( m_fd, &one, sizeof( one ) );
+
+	(void)rc;
+#else
+	::SetEvent( m_handle );
+#endif
+}
+
+bool
+Event::Wait( uint ms )
+{
+	bool signalled = false;
+
+#if defined( __linux__ )
+	pollfd pfd;
+
+	pfd.fd		= m_fd;
+	pfd.events	= POLLIN;
+	pfd.revents	= 0;
+
+	int timeout = ( ms == INFINITE_WAIT ) ? -1 : (int)ms;
+
+	if ( ::poll( &pfd, 1, timeout ) > 0 )
+	{
+		uint8 count = 0;
+
+		signalled = ( ::read( m_fd, &count, sizeof( count ) ) == sizeof( count ) );
+	}
+#else
+	DWORD timeout = ( ms == INFINITE_WAIT ) ? INFINITE : ms;
+
+	signalled = ( ::WaitForSingleObject( m_handle, timeout ) == WAIT_OBJECT_0 );
+#endif
+
+	// cleared after wakeup. a put after this signals again.
+	// full barrier store. the loop reads its queues after this.
+
+	m_signalled.Store( false );
+
+	return signalled;
+}
+
+} // gk
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <kcore/base/Noncopyable.h>
+#include <kcore/sys/Atomic.h>
+
+namespace gk 
+{
+
+/**
+ * @class Event
+ *
+ * Auto reset event to wake a loop when work arrives.
+ *
+ * Producers call Signal() after putting work to a queue. The loop calls
+ * Wait() when it found nothing to do. Signal() makes a system call only
+ * when the event is not signalled yet. So a busy producer does not pay
+ * a kernel transition for each put.
+ *
+ * A wakeup can be spurious. The loop checks its queues after Wait().
+ */
+class Event : private Noncopyable
+{
+public:
+	enum
+	{
+		INFINITE_WAIT = 0xFFFFFFFF
+	};
+
+public:
+	Event();
+	~Event();
+
+	/**
+	 * Wake the waiting thread. Cheap when already signalled.
+	 */
+	void Signal();
+
+	/**
+	 * Wait for a signal or timeout
+	 *
+	 * @param ms Timeout in milliseconds. INFINITE_WAIT to wait forever.
+	 * @return true if signalled
+	 */
+	bool Wait( uint ms );
+
+private:
+	Atomic<bool>	m_signalled;
+
+#if defined( __linux__ )
+	int				m_fd;			///< eventfd
+#else
+	HANDLE			m_handle;
+#endif
+};
+
+} // gk
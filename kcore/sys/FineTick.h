@@ -1,11 +1,13 @@
 #pragma once
 
+#include <kcore/sys/Clock.h>
+
 namespace gk 
 {
 /**
  * @class FineTick
  * 
- * Tick count using QueryPerformanceCounter/QueryPerformanceFrequency
+ * Tick count using Clock::NowNs(). Not cached.
  */
 class FineTick 
 {
@@ -26,7 +28,7 @@ public:
     void Reset() const;
 
 private:
-    mutable longlong start_;
+    mutable uint8 start_;
 };
 
 inline
@@ -44,22 +46,14 @@ inline
 double
 FineTick::Elapsed() const
 {
-    longlong end = 0;
-    ::QueryPerformanceCounter( (LARGE_INTEGER*)&end );
-
-    longlong freq = 0;
-    ::QueryPerformanceFrequency( (LARGE_INTEGER*)&freq );
-
-    K_ASSERT( freq > 0 );
-
-    return (double( (end - start_) ) / freq);
+    return double( Clock::NowNs() - start_ ) / 1000000000.0;
 }
 
 inline
 void
 FineTick::Reset() const
 {
-     ::QueryPerformanceCounter( (LARGE_INTEGER*)&start_ );
+     start_ = Clock::NowNs();
 }
 
 } // gk 
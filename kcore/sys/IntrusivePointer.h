@@ -0,0 +1,129 @@
+#pragma once
+
+namespace gk 
+{
+/**
+ * @class IntrusivePointer
+ *
+ * @brief A thread-safe shared pointer for RefCounted objects
+ *
+ * Same interface as SharedPointer, but the count is kept in the object.
+ * A new object costs one allocation and copies touch only the object. 
+ * Swap exchanges pointers without touching counts, and Queue uses it 
+ * to hand out entries.
+ *
+ * Wrapping a raw pointer which is already shared is safe.
+ */
+template <class X> 
+class IntrusivePointer
+{
+public:
+    typedef X element_type;
+
+    explicit IntrusivePointer( X* p = 0 )
+        : ptr_( p ) 
+    {
+        if ( ptr_ ) 
+        {
+            ptr_->AddRef();
+        }
+    }
+
+    ~IntrusivePointer()
+    {
+        release();
+    }
+
+    IntrusivePointer( const IntrusivePointer& r ) throw()
+        : ptr_( r.ptr_ )
+    {
+        if ( ptr_ ) 
+        {
+            ptr_->AddRef();
+        }
+    }
+
+    IntrusivePointer& operator=( const IntrusivePointer& r )
+    {
+        if ( ptr_ != r.ptr_ ) 
+        {
+            IntrusivePointer tmp( r );
+
+            Swap( tmp );
+        }
+
+        return *this;
+    }
+
+    X& operator*()  const throw()   
+    {
+        return *ptr_;
+    }
+
+    X* operator->() const throw()   
+    {
+        return ptr_;
+    }
+
+    X* Get()        const throw()   
+    {
+        return ptr_;
+    }
+
+    bool IsUnique() const
+    {
+        return ( ptr_ ? ptr_->GetRefCount() == 1 : true );
+    }
+
+    /**
+     * Exchange pointers without touching reference counts
+     */
+    void Swap( IntrusivePointer& r ) throw()
+    {
+        X* p = ptr_;
+
+        ptr_    = r.ptr_;
+        r.ptr_  = p;
+    }
+
+	template <class T>
+	bool Cast( T*& ptr )
+	{
+		K_ASSERT( ptr_ != 0 );
+
+#ifdef _DEBUG
+		ptr = dynamic_cast<T*>( ptr_ );	// Debug version
+#else
+		ptr = static_cast<T*>( ptr_ );	// Release version without checking
+#endif
+
+		return true;
+	}
+
+private:
+    void release()
+    {
+        if ( ptr_ && ptr_->Release() == 0 ) 
+        {
+            delete ptr_;
+        }
+
+        ptr_ = 0;
+    }
+
+private:
+    X* ptr_;
+};
+
+/**
+ * Swap without reference counting. Found by Queue::Get through ADL.
+ */
+template <class X>
+inline
+void 
+swap( IntrusivePointer<X>& a, IntrusivePointer<X>& b )
+{
+	a.Swap( b );
+}
+
+} // gk 
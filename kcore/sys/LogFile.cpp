@@ -17,9 +17,10 @@ LogFile::~LogFile()
 }
 
 bool 
-LogFile::Open( const tstring& prefix )
+LogFile::Open( const tstring& prefix, const tstring& ext )
 {
     m_prefix = prefix;
+    m_ext    = ext;
 
     makeFileName();
 
@@ -33,6 +34,8 @@ LogFile::Open( const tstring& prefix )
 
     if ( m_handle == INVALID_HANDLE_VALUE )
 	{
+		m_handle = 0;
+
 		return false;
 	}
 
@@ -51,7 +54,9 @@ LogFile::Write( const std::string& out )
 
 	DWORD len = 0;
 
-	::WriteFile( m_handle, out.c_str(), out.length(), &len, NULL );
+	// callers write a batch at once. so no buffering here.
+
+	::WriteFile( m_handle, out.c_str(), (DWORD)out.length(), &len, NULL );
 
 }
 
@@ -64,7 +69,7 @@ LogFile::Flush()
 void 
 LogFile::Close()
 {
-    if ( m_handle != INVALID_HANDLE_VALUE )
+    if ( m_handle != 0 && m_handle != INVALID_HANDLE_VALUE )
 	{
 		::CloseHandle( m_handle );
 
@@ -95,8 +100,8 @@ LogFile::makeFileName()
 	CreateDirectory(path, NULL);
 
     _sntprintf_s( tmp, _ARRAYSIZE(tmp)-1, 
-                 _T("%s\\%s-%s.log"),                       // system-20080903.log
-                 path, m_prefix.c_str(), date.c_str() );
+                 _T("%s\\%s-%s.%s"),                       // system-20080903.log
+                 path, m_prefix.c_str(), date.c_str(), m_ext.c_str() );
 
 	m_filename = tmp;
 }
@@ -112,7 +117,7 @@ LogFile::checkRotate()
 
 		m_handle = 0;
 
-        Open( m_prefix ); //   ȴ
+        Open( m_prefix, m_ext ); //   ȴ
     }
 }
 
@@ -18,9 +18,10 @@ public:
 	 * Open log file with prefix. Appends date and time. 
 	 *
 	 * @param prefix for log file
+	 * @param ext extension of log file
 	 * @return true when succeeds
 	 */
-    bool Open( const tstring& prefix );
+    bool Open( const tstring& prefix, const tstring& ext = _T("log") );
 
 	/**
 	 * Write log to the file
@@ -50,6 +51,7 @@ private:
 
 private:
     tstring     m_prefix;
+    tstring     m_ext;
     tstring     m_filename;
 	HANDLE		m_handle;
     DateTime    m_date;
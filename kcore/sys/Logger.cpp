@@ -3,11 +3,98 @@
 #include <kcore/corebase.h>
 #include <kcore/sys/Logger.h>
 
-#include <kcore/util/StringUtil.h>
-
 namespace gk {
 
-Logger* 
+namespace
+{
+
+/**
+ * Header of a record in a binary log file. Text of length bytes follows.
+ */
+struct BinaryRecord
+{
+	uint		magic;		///< BINARY_MAGIC
+	uint		threadId;
+	ushort		feature;
+	ushort		charSize;	///< sizeof( TCHAR ) of the writer
+	uint		length;		///< bytes of text
+	uint8		time;		///< local time as FILETIME
+};
+
+const uint BINARY_MAGIC = 0x4c4b4721; // "!GKL"
+
+const uint8 TICKS_PER_MS = 10000;	// FILETIME is in 100 ns
+const uint8 TICKS_PER_SEC = 10000000;
+
+void
+appendMBCS( const TCHAR* s, int len, std::string& out )
+{
+#if defined(_UNICODE) || defined(UNICODE)
+	K_RETURN_IF( len <= 0 );
+
+	int mlen = ::WideCharToMultiByte( CP_ACP, 0, s, len, NULL, 0, NULL, NULL );
+
+	size_t pos = out.size();
+
+	out.resize( pos + mlen );
+
+	::WideCharToMultiByte( CP_ACP, 0, s, len, &out[pos], mlen, NULL, NULL );
+#else
+	out.append( s, len );
+#endif
+}
+
+/**
+ * Append "[tid][HH:MM:SS][feature] line\r\n" to out.
+ * date is formatted again only when the second changes.
+ */
+void
+appendText( uint threadId,
+			int feature,
+			uint8 time,
+			const TCHAR* s,
+			int len,
+			uint8& lastSecond,
+			TCHAR* date,
+			std::string& out )
+{
+	uint8 second = time / TICKS_PER_SEC;
+
+	if ( second != lastSecond )
+	{
+		FILETIME ft;
+
+		ft.dwLowDateTime	= (DWORD)( time & 0xFFFFFFFF );
+		ft.dwHighDateTime	= (DWORD)( time >> 32 );
+
+		SYSTEMTIME t;
+
+		::FileTimeToSystemTime( &ft, &t );
+
+		_sntprintf_s( date, 16, _TRUNCATE,
+					  _T("%02d:%02d:%02d"),
+					  t.wHour, t.wMinute, t.wSecond );
+
+		lastSecond = second;
+	}
+
+	TCHAR head[128];
+
+	int hlen = _sntprintf_s( head, _ARRAYSIZE(head), _TRUNCATE,
+							 _T("[%6x][%s][%d] "),
+							 threadId,
+							 date,
+							 feature );
+
+	appendMBCS( head, hlen, out );
+	appendMBCS( s, len, out );
+
+	out.append( "\r\n" );
+}
+
+} // anonymous
+
+Logger*
 Logger::Instance()
 {
     static Logger instance;
@@ -17,6 +104,8 @@ Logger::Instance()
 
 Logger::Logger()
 : m_isConsolePrint( false )
+, m_isBinary( false )
+, m_isFileBinary( false )
 {
 #ifdef _DEBUG
     Enable( FT_DEBUG );
@@ -26,7 +115,7 @@ Logger::Logger()
     Enable( FT_ERROR );
     Enable( FT_SERVICE );
 
-	m_logFile.Open( _T("system") );
+	open();
 
     Start();
 }
@@ -36,96 +125,102 @@ Logger::~Logger()
 	Fini();
 }
 
-void 
+void
 Logger::Enable( int feature )
 {
-    ScopedLock sl( m_memberLock );
+    K_ASSERT( feature < FEATURE_LIMIT );
+	K_RETURN_IF( feature < 0 || feature >= FEATURE_LIMIT );
 
-    K_ASSERT( feature < FEATURE_LIMIT ); // max 128
+	Atomic<uint>& word = m_features[feature >> 5];
 
-    m_features.set( feature );
+	uint bits = word.Load();
+
+	while ( !word.CompareExchange( bits, bits | ( 1u << ( feature & 31 ) ) ) ) {}
 }
 
-void 
+void
 Logger::Disable( int feature )
 {
-    ScopedLock sl( m_memberLock );
-
-    K_ASSERT( feature < FEATURE_LIMIT ); // max 128
+    K_ASSERT( feature < FEATURE_LIMIT );
+	K_RETURN_IF( feature < 0 || feature >= FEATURE_LIMIT );
 
-    m_features.set( feature, false );
-}
+	Atomic<uint>& word = m_features[feature >> 5];
 
-bool 
-Logger::IsEnabled( int feature )
-{
-    ScopedLock sl( m_memberLock );
+	uint bits = word.Load();
 
-    return m_features[feature];
+	while ( !word.CompareExchange( bits, bits & ~( 1u << ( feature & 31 ) ) ) ) {}
 }
 
-void 
+void
 Logger::EnableConsole()
 {
-	ScopedLock sl( m_memberLock );
-
 	m_isConsolePrint = true;
 }
 
-void 
+void
 Logger::DisableConsole()
 {
-	ScopedLock sl( m_memberLock );
-
 	m_isConsolePrint = false;
 }
 
-void 
-Logger::Put( const tstring& line )
+void
+Logger::EnableBinary()
 {
-    m_q.Put( line );
+	m_isBinary = true;
 }
 
-int 
-Logger::Run()
+void
+Logger::DisableBinary()
 {
-    while ( IsRunning() )
-    {
-        tstring line;
+	m_isBinary = false;
+}
 
-        if ( !m_logFile.IsOpen() )
-        {
-            m_logFile.Open( _T("system") );
-        }
+void
+Logger::Put( const tstring& line )
+{
+	Record r;
 
-        line.clear();
+	r.tick		= ::GetTickCount();
+	r.threadId	= ::GetCurrentThreadId();
+	r.line		= line;
 
-        if ( m_q.Get( line ) )
-        {
-			line.append( _T("\r\n") );
+    m_q.Put( r );
 
-			std::string out;
+	m_wakeup.Signal();
+}
 
-			StringUtil::ConvertToMBCS( line, out );	
+void
+Logger::Put( const Record& record )
+{
+	m_q.Put( record );
 
-			m_logFile.Write( out );
+	m_wakeup.Signal();
+}
 
-			ScopedLock sl( m_memberLock );
+int
+Logger::Run()
+{
+	RecordQ::List records;
 
-			if ( m_isConsolePrint )
-			{
-				printf( "%s", out.c_str() );
-			}
+    while ( IsRunning() )
+    {
+		if ( !m_logFile.IsOpen() || m_isFileBinary != m_isBinary.Load() )
+        {
+			open();
+        }
+
+        if ( m_q.GetAll( records ) )
+        {
+			write( records );
 
-			out.clear();
-			line.clear();
+			records.clear();
         }
         else
         {
-            ::Sleep( 1 ); 
+			m_wakeup.Wait( WAIT_MS );
         }
 
-		if ( m_flushTick.Elapsed() > 5000 )
+		if ( m_flushTick.Elapsed() > FLUSH_MS )
 		{
 			m_logFile.Flush();
 
@@ -136,92 +231,238 @@ Logger::Run()
     return 0;
 }
 
-void 
+void
+Logger::helpStop()
+{
+	m_wakeup.Signal();
+}
+
+void
 Logger::Fini()
 {
 	Stop();
 
 	flush();
-    
+
     cleanup();
 }
 
-void 
-Logger::flush()
+bool
+Logger::Decode( const tstring& binaryFile, const tstring& textFile )
 {
-	// flush remaining lines
+	HANDLE in = ::CreateFile( binaryFile.c_str(),
+							  GENERIC_READ,
+							  FILE_SHARE_READ | FILE_SHARE_WRITE,
+							  NULL,
+							  OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL,
+							  NULL );
 
-	tstring line;
+	K_RETURN_V_IF( in == INVALID_HANDLE_VALUE, false );
 
-    while ( m_q.Get( line ) )
-    {
-		line.append( _T("\r\n") );
+	std::string data;
+
+	char chunk[64 * 1024];
+	DWORD len = 0;
+
+	while ( ::ReadFile( in, chunk, sizeof( chunk ), &len, NULL ) && len > 0 )
+	{
+		data.append( chunk, len );
+	}
+
+	::CloseHandle( in );
+
+	HANDLE out = ::CreateFile( textFile.c_str(),
+							   GENERIC_WRITE,
+							   FILE_SHARE_READ,
+							   NULL,
+							   CREATE_ALWAYS,
+							   FILE_ATTRIBUTE_NORMAL,
+							   NULL );
 
-		std::string out;
+	K_RETURN_V_IF( out == INVALID_HANDLE_VALUE, false );
 
-		StringUtil::ConvertToMBCS( line, out );	
+	std::string text;
 
-		m_logFile.Write( out );
+	uint8 lastSecond = 0;
+	TCHAR date[16] = { 0, };
 
-		line.clear();
+	bool complete = true;
+	size_t pos = 0;
+
+	while ( pos + sizeof( BinaryRecord ) <= data.size() )
+	{
+		BinaryRecord h;
+
+		::memcpy( &h, &data[pos], sizeof( h ) );
+
+		if ( h.magic != BINARY_MAGIC ||
+			 h.charSize != sizeof( TCHAR ) ||
+			 pos + sizeof( h ) + h.length > data.size() )
+		{
+			// skip to the next record. a torn write or a different build.
+
+			complete = false;
+
+			++pos;
+
+			continue;
+		}
+
+		const TCHAR* s = (const TCHAR*)&data[pos + sizeof( h )];
+
+		appendText( h.threadId, h.feature, h.time, s, (int)( h.length / sizeof( TCHAR ) ), lastSecond, date, text );
+
+		pos += sizeof( h ) + h.length;
+	}
+
+	DWORD written = 0;
+
+	::WriteFile( out, text.c_str(), (DWORD)text.length(), &written, NULL );
+	::CloseHandle( out );
+
+	return complete && pos == data.size();
+}
+
+void
+Logger::open()
+{
+	m_logFile.Close();
+
+	m_isFileBinary = m_isBinary.Load();
+
+	m_logFile.Open( _T("system"), m_isFileBinary ? _T("blog") : _T("log") );
+}
+
+void
+Logger::write( RecordQ::List& records )
+{
+	// [1] one local time for the batch. records are placed by tick offset.
+
+	SYSTEMTIME st;
+	::GetLocalTime( &st );
+
+	uint baseTick = ::GetTickCount();
+
+	FILETIME ft;
+	::SystemTimeToFileTime( &st, &ft );
+
+	uint8 base = ( (uint8)ft.dwHighDateTime << 32 ) | ft.dwLowDateTime;
+
+	// [2] build the batch
+
+	bool console = m_isConsolePrint.Load();
+
+	uint8 lastSecond = 0;
+	TCHAR date[16] = { 0, };
+
+	m_out.clear();
+	m_console.clear();
+
+	RecordQ::List::iterator i( records.begin() );
+	RecordQ::List::iterator iEnd( records.end() );
+
+	for ( ; i != iEnd; ++i )
+	{
+		const Record& r = *i;
+
+		uint8 time = base - (uint8)( baseTick - r.tick ) * TICKS_PER_MS;
+
+		if ( m_isFileBinary )
+		{
+			BinaryRecord h;
+
+			h.magic		= BINARY_MAGIC;
+			h.threadId	= r.threadId;
+			h.feature	= (ushort)r.feature;
+			h.charSize	= (ushort)sizeof( TCHAR );
+			h.length	= (uint)( r.line.length() * sizeof( TCHAR ) );
+			h.time		= time;
+
+			m_out.append( (const char*)&h, sizeof( h ) );
+			m_out.append( (const char*)r.line.c_str(), h.length );
+
+			if ( console )
+			{
+				appendText( r.threadId, r.feature, time, r.line.c_str(), (int)r.line.length(), lastSecond, date, m_console );
+			}
+		}
+		else
+		{
+			appendText( r.threadId, r.feature, time, r.line.c_str(), (int)r.line.length(), lastSecond, date, m_out );
+		}
+	}
+
+	// [3] single write
+
+	m_logFile.Write( m_out );
+
+	if ( console )
+	{
+		const std::string& s = m_isFileBinary ? m_console : m_out;
+
+		fwrite( s.c_str(), 1, s.length(), stdout );
 	}
 }
 
-void 
+void
+Logger::flush()
+{
+	// flush remaining lines
+
+	RecordQ::List records;
+
+	if ( m_q.GetAll( records ) )
+	{
+		write( records );
+	}
+}
+
+void
 Logger::cleanup()
 {
     m_logFile.Close();
 }
 
-void 
+void
 LOG( int feature, const TCHAR* fmt, ... )
 {
     K_ASSERT( feature > 0 );
     K_ASSERT( feature < FEATURE_LIMIT );
 
-    if ( !Logger::Instance()->IsEnabled( feature ) )
+	Logger* logger = Logger::Instance();
+
+    if ( !logger->IsEnabled( feature ) )
 	{
 		return;
 	}
 
-    va_list args;
+	// header and time are added on the logger thread
 
     TCHAR buf[4096];
-    TCHAR head[128];
-
-    ::memset( buf, 0, sizeof( TCHAR ) * 4096 );
-    ::memset( head, 0, sizeof( TCHAR ) * 128 );
-
-    SYSTEMTIME t;
-    ::GetLocalTime( &t );
 
-    TCHAR date[64];
-
-    _sntprintf_s( date, _ARRAYSIZE(date)-1, 
-                  _T("%02d:%02d:%02d"),
-                  t.wHour, t.wMinute, t.wSecond );
-
-    _sntprintf_s( head, _ARRAYSIZE(head)-1, 
-                 _T("[%6x][%s][%d] "), 
-                 ::GetCurrentThreadId(), 
-                 date, 
-				 feature );
-
-    tstring s;
-
-    s.append( head );
+    va_list args;
 
     va_start( args, fmt );
 
-    _vsntprintf_s( buf, 4096, 4096, fmt, args );
+    int len = _vsntprintf_s( buf, _ARRAYSIZE(buf), _TRUNCATE, fmt, args );
 
     va_end( args );
 
-    s.append( buf );
+	if ( len < 0 ) // truncated
+	{
+		len = (int)_tcslen( buf );
+	}
+
+	Logger::Record r;
+
+	r.tick		= ::GetTickCount();
+	r.threadId	= ::GetCurrentThreadId();
+	r.feature	= feature;
 
-    Logger::Instance()->Put( s );
+	r.line.assign( buf, len );
 
-	s.clear(); 
+    logger->Put( r );
 }
 
 } // gk
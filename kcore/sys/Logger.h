@@ -1,16 +1,16 @@
-#pragma once 
+#pragma once
 
 #include <kcore/sys/Thread.h>
 #include <kcore/sys/Queue.h>
 #include <kcore/sys/LogFile.h>
+#include <kcore/sys/Atomic.h>
+#include <kcore/sys/Event.h>
 #include <kcore/sys/Tick.h>
 
-#include <bitset>
-
-namespace gk 
+namespace gk
 {
 
-enum FEATURE 
+enum FEATURE
 {
       FT_DEBUG     = 1
 	, FT_DEBUG_FLOW
@@ -25,9 +25,40 @@ enum FEATURE
  * @class Logger
  *
  * Logs to a sys log file.
+ *
+ * LOG() checks features with a plain load and formats only the message
+ * on the calling thread. Records are passed to the logger thread through
+ * a lock free queue. The logger thread takes all pending records at once,
+ * gets the local time once per batch, adds line headers and writes
+ * the batch to the file with a single write.
+ *
+ * In binary mode records are written as they are without text conversion.
+ * Use Logger::Decode to convert a binary log to text offline.
  */
 class Logger : public Thread
 {
+public:
+	/**
+	 * @struct Record
+	 *
+	 * A log line queued to the logger thread
+	 */
+	struct Record
+	{
+		uint		tick;		///< ::GetTickCount() when logged
+		uint		threadId;	///< thread logged
+		int			feature;	///< feature logged. 0 for Put()
+		tstring		line;		///< formatted message without header
+
+		Record()
+			: tick( 0 )
+			, threadId( 0 )
+			, feature( 0 )
+			, line()
+		{
+		}
+	};
+
 public:
     static Logger* Instance();
 
@@ -48,12 +79,12 @@ public:
     void Disable( int feature );
 
 	/**
-	 * Check whether the feature is enabled
+	 * Check whether the feature is enabled. No lock.
 	 *
 	 * @param feature Index value of feature
 	 * @return true if the feature is enabled
 	 */
-    bool IsEnabled( int feature );
+    bool IsEnabled( int feature ) const;
 
 	/**
 	 * Enable log to console
@@ -65,6 +96,17 @@ public:
 	 */
 	void DisableConsole();
 
+	/**
+	 * Write records in binary from the next batch.
+	 * Starts a new log file with .blog extension.
+	 */
+	void EnableBinary();
+
+	/**
+	 * Write records in text from the next batch
+	 */
+	void DisableBinary();
+
 	/**
 	 * Put a line to log
 	 *
@@ -72,36 +114,101 @@ public:
 	 */
     void Put( const tstring& line );
 
+	/**
+	 * Put a record to log
+	 *
+	 * @param record A record filled by caller
+	 */
+	void Put( const Record& record );
+
 	/**
 	 * Thread::Run
 	 */
-    int Run(); 
+    int Run();
 
 	/**
-	 * Explicit finish 
+	 * Explicit finish
 	 */
 	void Fini();
 
+	/**
+	 * Convert a binary log file to a text log file
+	 *
+	 * @param binaryFile Path of a .blog file
+	 * @param textFile Path of the text file to create
+	 * @return true if the whole file is converted
+	 */
+	static bool Decode( const tstring& binaryFile, const tstring& textFile );
+
+protected:
+	/**
+	 * Wake Run to exit
+	 */
+	void helpStop();
+
 private:
+	typedef Queue<Record, LockFree> RecordQ;
+
     Logger();
 
+	void open();
+	void write( RecordQ::List& records );
 	void flush();
     void cleanup();
 
 private:
-    Queue<tstring, Mutex>       m_q;
-    LogFile                     m_logFile;
-
-    std::bitset<FEATURE_LIMIT>  m_features;
-    Mutex                       m_memberLock;
-
-	bool						m_isConsolePrint; // ֿܼ ϴ°?
+	enum
+	{
+		  FEATURE_WORDS	= FEATURE_LIMIT / 32
+		, FLUSH_MS		= 5000
+		, WAIT_MS		= 1000		///< idle wait. bounds the flush delay
+	};
+
+    RecordQ						m_q;
+	Event						m_wakeup;			///< signalled on put
+    LogFile						m_logFile;
+
+	Atomic<uint>				m_features[FEATURE_WORDS];
+	Atomic<bool>				m_isConsolePrint;
+	Atomic<bool>				m_isBinary;
+	bool						m_isFileBinary;		///< mode of the open file. logger thread only
+
+	std::string					m_out;				///< batch write buffer
+	std::string					m_console;			///< batch console buffer
 	Tick						m_flushTick;
 };
 
+inline
+bool
+Logger::IsEnabled( int feature ) const
+{
+	if ( feature < 0 || feature >= FEATURE_LIMIT )
+	{
+		return false;
+	}
+
+	uint word = m_features[feature >> 5].Load( MO_RELAXED );
+
+	return ( word & ( 1u << ( feature & 31 ) ) ) != 0;
+}
+
+/**
+ * Swap records without copying lines. Used by queues.
+ */
+inline
+void
+swap( Logger::Record& lhs, Logger::Record& rhs )
+{
+	std::swap( lhs.tick, rhs.tick );
+	std::swap( lhs.threadId, rhs.threadId );
+	std::swap( lhs.feature, rhs.feature );
+
+	lhs.line.swap( rhs.line );
+}
+
 extern void LOG( int feature, const TCHAR* fmt, ... );
 
-} // gk 
+} // gk
 
 #define NS_LOG_RETURN_IF( cond, msg ) \
 	if ( (cond) ) { kcore::LOG( kcore::FT_INFO, msg ); return; }
@@ -115,4 +222,3 @@ extern void LOG( int feature, const TCHAR* fmt, ... );
 #define NS_LOG_RETURN_VAL_IF_NOT( cond, v, msg ) \
 	if ( !(cond) ) { kcore::LOG( kcore::FT_INFO, msg ); return v; }
 
-
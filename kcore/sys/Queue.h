@@ -1,8 +1,11 @@
 #pragma once 
 
 #include <kcore/sys/ScopedLock.h>
+#include <kcore/mem/Allocator.h>
 
+#include <algorithm>
 #include <deque>
+#include <new>
 
 namespace gk {
 /** 
@@ -14,6 +17,9 @@ namespace gk {
 template <typename V, class LOCK = NullLock>
 class Queue : public Noncopyable
 {
+public:
+    typedef std::deque<V> List;
+
 public:
     Queue();
     ~Queue();
@@ -40,6 +46,14 @@ public:
 	 */
     bool Get( V& v);
 
+	/**
+	 * Get all entries from a queue with one lock
+	 *
+	 * @param l The list to append entries to
+	 * @return true if any entry is taken
+	 */
+	bool GetAll( List& l );
+
 private:
     typedef std::deque<V> Q;
 
@@ -92,11 +106,240 @@ Queue<V, LOCK>::Get( V& v )
 		return false;
 	}
 
-    v = q_.front(); // NOTE: Copy is inevitable
+    using std::swap;
+
+    swap( v, q_.front() ); // no copy for types with a cheap swap
 
     q_.pop_front();
 
     return true;
 }
 
+template <typename V, class LOCK>
+inline
+bool
+Queue<V, LOCK>::GetAll( List& l ) 
+{ 
+    ScopedLock sl( lock_ );
+
+	if ( q_.empty() )
+	{
+		return false;
+	}
+
+	if ( l.empty() )
+	{
+		l.swap( q_ );
+	}
+	else
+	{
+		l.insert( l.end(), q_.begin(), q_.end() );
+
+		q_.clear();
+	}
+
+    return true;
+}
+
+/**
+ * @class LockFree
+ *
+ * Queue policy for a lock free multi-producer / single-consumer queue.
+ * Put can be called from any thread. Get, GetAll and IsEmpty must be
+ * called only from the consumer thread.
+ */
+class LockFree
+{
+};
+
+/**
+ * @class Queue<V, LockFree>
+ *
+ * Intrusive MPSC queue. Put is one interlocked exchange. 
+ * The consumer follows next links without any interlocked operation.
+ *
+ * A Put can be seen a little late by the consumer while the producer 
+ * is between the exchange and the link. It is picked up on the next Get. 
+ */
+template <typename V>
+class Queue<V, LockFree> : public Noncopyable
+{
+public:
+    typedef std::deque<V> List;
+
+public:
+    Queue();
+    ~Queue();
+
+	/**
+	 * Add an entry into a queue. Any thread.
+	 *
+	 * @param v A value to add
+	 */
+    void Put( const V& v );
+
+	/**
+	 * Check whether queue is empty. Consumer thread only.
+	 *
+	 * @return true if the queue is empty
+	 */
+	bool IsEmpty() const;
+
+	/**
+	 * Get an entry from a queue. Consumer thread only.
+	 *
+	 * @param v The reference to hold result
+	 * @return true if queue is not empty 
+	 */
+    bool Get( V& v );
+
+	/**
+	 * Get all entries from a queue. Consumer thread only.
+	 *
+	 * @param l The list to append entries to
+	 * @return true if any entry is taken
+	 */
+	bool GetAll( List& l );
+
+private:
+	struct Node
+	{
+		Node* volatile	next;
+		V				v;
+
+		Node( const V& iv ) 
+			: next( 0 )
+			, v( iv )
+		{
+		}
+	};
+
+	Node* newNode( const V& v );
+	void deleteNode( Node* n );
+
+private:
+	Node* volatile	head_;	// producers
+	Node*			tail_;	// consumer. stub node
+};
+
+template <typename V>
+inline
+Queue<V, LockFree>::Queue()
+: head_( 0 )
+, tail_( 0 )
+{
+	tail_ = newNode( V() );
+	head_ = tail_;
+}
+
+template <typename V>
+inline
+Queue<V, LockFree>::~Queue()
+{
+	V v;
+
+	while ( Get( v ) ) {}
+
+	deleteNode( tail_ );
+}
+
+template <typename V>
+inline
+void
+Queue<V, LockFree>::Put( const V& v )
+{
+	Node* n = newNode( v );
+
+	Node* prev = (Node*)::InterlockedExchangePointer( (PVOID volatile*)&head_, n );
+
+	prev->next = n; // volatile write is release on msvc
+}
+
+template <typename V>
+inline
+bool 
+Queue<V, LockFree>::IsEmpty() const
+{
+	return tail_->next == 0;
+}
+
+template <typename V>
+inline
+bool
+Queue<V, LockFree>::Get( V& v ) 
+{ 
+	Node* tail = tail_;
+	Node* next = tail->next; // volatile read is acquire on msvc
+
+	if ( next == 0 )
+	{
+		return false;
+	}
+
+	using std::swap;
+
+	swap( v, next->v );
+
+	next->v = V(); // next is the new stub. release value now.
+
+	tail_ = next;
+
+	deleteNode( tail );
+
+	return true;
+}
+
+template <typename V>
+inline
+bool
+Queue<V, LockFree>::GetAll( List& l ) 
+{ 
+	using std::swap;
+
+	bool taken = false;
+
+	for ( ;; )
+	{
+		Node* tail = tail_;
+		Node* next = tail->next;
+
+		if ( next == 0 )
+		{
+			break;
+		}
+
+		l.push_back( V() );
+
+		swap( l.back(), next->v );
+
+		next->v = V();
+
+		tail_ = next;
+
+		deleteNode( tail );
+
+		taken = true;
+	}
+
+	return taken;
+}
+
+template <typename V>
+inline
+typename Queue<V, LockFree>::Node*
+Queue<V, LockFree>::newNode( const V& v )
+{
+	return new ( g_allocator.Alloc( sizeof( Node ) ) ) Node( v );
+}
+
+template <typename V>
+inline
+void
+Queue<V, LockFree>::deleteNode( Node* n )
+{
+	n->~Node();
+
+	g_allocator.Free( n );
+}
+
 } // gk 
@@ -0,0 +1,67 @@
+#pragma once
+
+namespace gk 
+{
+/**
+ * @class RefCounted
+ *
+ * @brief Base for objects carrying their own reference count
+ *
+ * Used with IntrusivePointer. The count lives in the object, 
+ * so sharing an object needs no extra allocation.
+ * Copying an object does not copy the count.
+ */
+class RefCounted
+{
+public:
+	RefCounted()
+		: refs_( 0 )
+	{
+	}
+
+	RefCounted( const RefCounted& )
+		: refs_( 0 )
+	{
+	}
+
+	RefCounted& operator=( const RefCounted& )
+	{
+		return *this;
+	}
+
+	/**
+	 * Increment reference count
+	 */
+	void AddRef() const
+	{
+		::InterlockedIncrement( &refs_ );
+	}
+
+	/**
+	 * Decrement reference count
+	 *
+	 * @return Remaining count. Owner deletes the object on 0.
+	 */
+	long Release() const
+	{
+		return ::InterlockedDecrement( &refs_ );
+	}
+
+	/**
+	 * Get current reference count
+	 */
+	long GetRefCount() const
+	{
+		return refs_;
+	}
+
+protected:
+	~RefCounted()
+	{
+	}
+
+private:
+	mutable volatile long refs_;
+};
+
+} // gk 
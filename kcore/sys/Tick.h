@@ -1,6 +1,6 @@
 #pragma once
 
-#include <kcore/sys/Atomic.h>
+#include <kcore/sys/Clock.h>
 
 namespace gk 
 {
@@ -8,7 +8,9 @@ namespace gk
 /**
  * @class Tick
  * 
- * Tick count using GetTickCount()
+ * Millisecond tick using Clock::Now(). 
+ * Uses the time cached once per loop on threads calling Clock::Update().
+ * 64 bit. So it does not wrap like GetTickCount().
  */
 class Tick 
 {
@@ -17,7 +19,8 @@ public:
     ~Tick();
 
     /**
-     * @return Elapsed time in seconds
+     * @return Elapsed time in milliseconds. 0 when reset later than now,
+     *         which happens with a time cached by Clock::Update().
      */
     unsigned long Elapsed() const;
 
@@ -27,7 +30,7 @@ public:
     void Reset() const;
 
 private:
-    mutable long start_;
+    mutable uint8 start_;
 };
 
 inline
@@ -45,14 +48,21 @@ inline
 unsigned long
 Tick::Elapsed() const
 {
-	return (::GetTickCount() - start_ );
+	uint8 now = Clock::Now();
+
+	if ( now < start_ )
+	{
+		return 0;
+	}
+
+	return (unsigned long)( now - start_ );
 }
 
 inline
 void
 Tick::Reset() const
 {
-	start_ = ::GetTickCount();
+	start_ = Clock::Now();
 }
 
 } // gk 
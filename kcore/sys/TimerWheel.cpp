@@ -0,0 +1,268 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <kcore/sys/TimerWheel.h>
+
+#include <kcore/sys/Clock.h>
+
+namespace gk {
+
+Timer::Timer()
+: m_prev( 0 )
+, m_next( 0 )
+, m_wheel( 0 )
+, m_expire( 0 )
+{
+}
+
+Timer::~Timer()
+{
+	Cancel();
+}
+
+void
+Timer::Cancel()
+{
+	if ( m_wheel != 0 )
+	{
+		m_wheel->Cancel( this );
+	}
+}
+
+TimerWheel::TimerWheel()
+: m_current( 0 )
+, m_now( 0 )
+, m_count( 0 )
+{
+	for ( int level = 0; level < LEVELS; ++level )
+	{
+		for ( int i = 0; i < SLOTS; ++i )
+		{
+			Head& h = m_slots[level][i];
+
+			h.m_prev = &h;
+			h.m_next = &h;
+		}
+	}
+
+	m_now		= Clock::Now();
+	m_current	= m_now / RESOLUTION;
+}
+
+TimerWheel::~TimerWheel()
+{
+	// timers can outlive the wheel. just forget them.
+
+	for ( int level = 0; level < LEVELS; ++level )
+	{
+		for ( int i = 0; i < SLOTS; ++i )
+		{
+			Head& h = m_slots[level][i];
+
+			while ( h.m_next != &h )
+			{
+				Timer* t = h.m_next;
+
+				unlink( t );
+
+				t->m_wheel = 0;
+			}
+		}
+	}
+
+	m_count = 0;
+}
+
+void
+TimerWheel::Schedule( Timer* t, uint8 expire )
+{
+	K_ASSERT( t != 0 );
+
+	if ( t->m_wheel != 0 )
+	{
+		t->m_wheel->Cancel( t );
+	}
+
+	t->m_expire = expire;
+	t->m_wheel	= this;
+
+	// slots up to m_current are already processed
+
+	link( t, m_current + 1 );
+
+	++m_count;
+}
+
+void
+TimerWheel::ScheduleAfter( Timer* t, uint ms )
+{
+	Schedule( t, m_now + ms );
+}
+
+void
+TimerWheel::Cancel( Timer* t )
+{
+	K_ASSERT( t != 0 );
+	K_ASSERT( t->m_wheel == this );
+
+	K_RETURN_IF( t->m_wheel != this );
+
+	unlink( t );
+
+	t->m_wheel = 0;
+
+	--m_count;
+}
+
+uint
+TimerWheel::Advance( uint8 now )
+{
+	K_RETURN_V_IF( now < m_now, 0 );
+
+	m_now = now;
+
+	uint8 target = now / RESOLUTION;
+	uint expired = 0;
+
+	while ( m_current < target )
+	{
+		++m_current;
+
+		uint idx = (uint)( m_current & ( SLOTS - 1 ) );
+
+		if ( idx == 0 )
+		{
+			cascade( 1 );
+		}
+
+		Head& h = m_slots[0][idx];
+
+		if ( h.m_next == &h )
+		{
+			continue;
+		}
+
+		// detach the slot. callbacks can schedule or cancel any timer.
+
+		Head due;
+
+		due.m_next			= h.m_next;
+		due.m_prev			= h.m_prev;
+		due.m_next->m_prev	= &due;
+		due.m_prev->m_next	= &due;
+
+		h.m_next = &h;
+		h.m_prev = &h;
+
+		while ( due.m_next != &due )
+		{
+			Timer* t = due.m_next;
+
+			unlink( t );
+
+			t->m_wheel = 0;
+
+			--m_count;
+			++expired;
+
+			t->onExpire( m_now );
+		}
+	}
+
+	return expired;
+}
+
+void
+TimerWheel::link( Timer* t, uint8 base )
+{
+	// round up so that a timer does not expire before its time
+
+	uint8 slot = ( t->m_expire + RESOLUTION - 1 ) / RESOLUTION;
+
+	if ( slot < base )
+	{
+		slot = base;
+	}
+
+	uint8 delta = slot - m_current;
+
+	int level = 0;
+
+	while ( level < LEVELS - 1 &&
+			delta >= ( (uint8)1 << ( SLOT_BITS * ( level + 1 ) ) ) )
+	{
+		++level;
+	}
+
+	const uint8 range = ( (uint8)1 << ( SLOT_BITS * LEVELS ) ) - 1;
+
+	if ( delta > range )
+	{
+		// linked again with the real expire when cascaded
+
+		slot = m_current + range;
+	}
+
+	uint idx = (uint)( ( slot >> ( SLOT_BITS * level ) ) & ( SLOTS - 1 ) );
+
+	pushBack( &m_slots[level][idx], t );
+}
+
+void
+TimerWheel::cascade( int level )
+{
+	K_RETURN_IF( level >= LEVELS );
+
+	uint idx = (uint)( ( m_current >> ( SLOT_BITS * level ) ) & ( SLOTS - 1 ) );
+
+	if ( idx == 0 )
+	{
+		cascade( level + 1 );
+	}
+
+	Head& h = m_slots[level][idx];
+
+	K_RETURN_IF( h.m_next == &h );
+
+	Head moving;
+
+	moving.m_next			= h.m_next;
+	moving.m_prev			= h.m_prev;
+	moving.m_next->m_prev	= &moving;
+	moving.m_prev->m_next	= &moving;
+
+	h.m_next = &h;
+	h.m_prev = &h;
+
+	while ( moving.m_next != &moving )
+	{
+		Timer* t = moving.m_next;
+
+		unlink( t );
+
+		// m_current slot is processed right after cascade
+
+		link( t, m_current );
+	}
+}
+
+void
+TimerWheel::unlink( Timer* t )
+{
+	t->m_prev->m_next = t->m_next;
+	t->m_next->m_prev = t->m_prev;
+
+	t->m_prev = 0;
+	t->m_next = 0;
+}
+
+void
+TimerWheel::pushBack( Timer* head, Timer* t )
+{
+	t->m_prev				= head->m_prev;
+	t->m_next				= head;
+	head->m_prev->m_next	= t;
+	head->m_prev			= t;
+}
+
+} // gk
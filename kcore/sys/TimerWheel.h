@@ -0,0 +1,180 @@
+#pragma once
+
+#include <kcore/base/Noncopyable.h>
+
+namespace gk
+{
+
+class TimerWheel;
+
+/**
+ * @class Timer
+ *
+ * An entry of TimerWheel. Derive and implement onExpire.
+ *
+ * Timers are linked into wheel slots by themselves. So schedule
+ * and cancel do not allocate and cancel is O(1).
+ */
+class Timer : private Noncopyable
+{
+public:
+	Timer();
+	virtual ~Timer();
+
+	/**
+	 * Remove from the wheel if scheduled
+	 */
+	void Cancel();
+
+	/**
+	 * Check whether scheduled
+	 */
+	bool IsScheduled() const;
+
+	/**
+	 * Get expire time
+	 *
+	 * @return Milliseconds in Clock::Now() base
+	 */
+	uint8 GetExpire() const;
+
+protected:
+	/**
+	 * Called from TimerWheel::Advance when expired.
+	 * Timer is not scheduled during the call. Can schedule itself again.
+	 *
+	 * @param now Current time of the wheel
+	 */
+	virtual void onExpire( uint8 now ) = 0;
+
+private:
+	friend class TimerWheel;
+
+	Timer*		m_prev;
+	Timer*		m_next;
+	TimerWheel*	m_wheel;
+	uint8		m_expire;
+};
+
+/**
+ * @class TimerWheel
+ *
+ * @brief Hierarchical timing wheel.
+ *
+ * LEVELS wheels of SLOTS slots each. Level 0 slot is RESOLUTION ms.
+ * Each upper level slot covers a whole lower wheel. Timers in an upper
+ * slot are moved down when the lower wheel wraps around.
+ *
+ * Advance visits only the slots passed and the timers in them.
+ * Not thread safe. Used from the thread running the owner.
+ */
+class TimerWheel : private Noncopyable
+{
+public:
+	enum
+	{
+		  SLOT_BITS		= 8
+		, SLOTS			= 1 << SLOT_BITS
+		, LEVELS		= 4
+		, RESOLUTION	= 10	///< ms per level 0 slot
+	};
+
+public:
+	TimerWheel();
+	~TimerWheel();
+
+	/**
+	 * Schedule a timer. Reschedules if already scheduled.
+	 *
+	 * @param t Timer to schedule
+	 * @param expire Expire time in Clock::Now() base
+	 */
+	void Schedule( Timer* t, uint8 expire );
+
+	/**
+	 * Schedule a timer after ms from the wheel time
+	 *
+	 * @param t Timer to schedule
+	 * @param ms Milliseconds from now
+	 */
+	void ScheduleAfter( Timer* t, uint ms );
+
+	/**
+	 * Remove a timer. O(1).
+	 *
+	 * @param t Timer to remove
+	 */
+	void Cancel( Timer* t );
+
+	/**
+	 * Expire timers due until now
+	 *
+	 * @param now Current time in Clock::Now() base
+	 * @return The number of timers expired
+	 */
+	uint Advance( uint8 now );
+
+	/**
+	 * Get wheel time
+	 *
+	 * @return Time of the last Advance
+	 */
+	uint8 GetNow() const;
+
+	/**
+	 * Get the number of scheduled timers
+	 */
+	uint GetCount() const;
+
+private:
+	void link( Timer* t, uint8 base );
+	void cascade( int level );
+
+	static void unlink( Timer* t );
+	static void pushBack( Timer* head, Timer* t );
+
+private:
+	/**
+	 * Sentinel of a slot list
+	 */
+	class Head : public Timer
+	{
+	protected:
+		void onExpire( uint8 ) {}
+	};
+
+	Head	m_slots[LEVELS][SLOTS];
+	uint8	m_current;		///< current level 0 slot count
+	uint8	m_now;
+	uint	m_count;
+};
+
+inline
+bool
+Timer::IsScheduled() const
+{
+	return m_wheel != 0;
+}
+
+inline
+uint8
+Timer::GetExpire() const
+{
+	return m_expire;
+}
+
+inline
+uint8
+TimerWheel::GetNow() const
+{
+	return m_now;
+}
+
+inline
+uint
+TimerWheel::GetCount() const
+{
+	return m_count;
+}
+
+} // gk
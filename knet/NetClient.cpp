@@ -3,6 +3,7 @@
 #include <kcore/corebase.h>
 #include <knet/NetClient.h>
 
+#include <kcore/sys/Clock.h>
 #include <kcore/sys/Logger.h>
 #include <knet/group/NmGroupPrepare.h>
 #include <knet/group/NmGroupPrepared.h>
@@ -12,6 +13,7 @@
 #include <knet/group/NmGroupDestroy.h>
 #include <knet/message/MessageFactory.h>
 #include <knet/message/net/NetControlMessage.h>
+#include <knet/message/net/NetStateMessage.h>
 #include <knet/socket/Socket.h>
 
 namespace gk {
@@ -26,6 +28,7 @@ NetClient::NetClient()
 , m_groupId( 0 )
 , m_selfTag( 0 )
 , m_processedCount( 0 )
+, m_wakeup()
 {
 }
 
@@ -40,6 +43,8 @@ NetClient::Init( MessageListener* listener )
 
 	Socket::Startup();
 
+	(void)Clock::Calibrate(); // for cached loop time
+
 	m_listener = listener;
 
 	bool rc = m_ios.Init();
@@ -60,6 +65,8 @@ NetClient::Init( MessageListener* listener )
 		return false;
 	}
 
+	m_tcp.SetWakeup( &m_wakeup );
+
 	m_groupId = 0;
 	m_selfTag = 0;
 
@@ -73,6 +80,18 @@ NetClient::Init( MessageListener* listener )
 	return true;
 }
 
+void 
+NetClient::SetRecvMode( TcpConnection::RecvMode mode )
+{
+	m_tcp.SetRecvMode( mode );
+}
+
+void 
+NetClient::SetCompression( uint mode )
+{
+	m_tcp.SetCompression( mode );
+}
+
 void 
 NetClient::Connect( const IpAddress& addr )
 {
@@ -101,16 +120,21 @@ NetClient::Send( MessagePtr m )
 	K_ASSERT( m.Get() != 0 );
 
 	m_sendQ.Put( m );
+
+	m_wakeup.Signal();
 }
 
 void 
-NetClient::SendUdp( MessagePtr m, int qos )
+NetClient::SendUdp( MessagePtr m, int qos, uint cookie )
 {
 	UdpSend s;
-	s.m 	= m;
-	s.qos 	= qos;
+	s.m 		= m;
+	s.qos 		= qos;
+	s.cookie 	= cookie;
 
 	m_udpSendQ.Put( s );
+
+	m_wakeup.Signal();
 }
 
 void 
@@ -123,6 +147,8 @@ NetClient::BroadcastUdp( MessagePtr m, int qos )
 	s.broadcast = true;
 
 	m_udpSendQ.Put( s );
+
+	m_wakeup.Signal();
 }
 
 void 
@@ -131,6 +157,8 @@ NetClient::Notify( MessagePtr m )
 	K_ASSERT( m.Get() != 0 );
 
 	m_recvQ.Put( m );
+
+	m_wakeup.Signal();
 }
 
 int 
@@ -140,6 +168,8 @@ NetClient::Run()
 
 	while ( IsRunning() )
 	{
+		Clock::Update();
+
 		m_processedCount = 0;
 
 		m_tcp.Run(); 
@@ -151,7 +181,7 @@ NetClient::Run()
 
 		if ( m_processedCount == 0 )
 		{
-			::Sleep( 1 );
+			m_wakeup.Wait( m_tcp.GetWaitMs( WAIT_MS ) );
 		}
 	}
 
@@ -161,6 +191,12 @@ NetClient::Run()
 
 }
 
+void 
+NetClient::helpStop()
+{
+	m_wakeup.Signal();
+}
+
 void 
 NetClient::Fini()
 {
@@ -245,13 +281,38 @@ NetClient::processUdpSendQ()
 		}
 		else
 		{
-			m_udp.SendByTag( s.m, s.qos );
+			uint seq = 0;
+
+			m_udp.SendByTag( s.m, s.qos, &seq );
+
+			if ( s.cookie != 0 && seq != 0 )
+			{
+				notifyUdpSent( s, seq );
+			}
 		}	
 
 		++m_processedCount;
 	}
 }
 
+void 
+NetClient::notifyUdpSent( const UdpSend& s, uint seq )
+{
+	// the seq is known only here after the send. see SendUdp.
+
+	NetStateMessage* nsm = new NetStateMessage;
+
+	nsm->state 			= NetStateMessage::UDP_SENT;
+	nsm->connectionId 	= s.m->remote;
+	nsm->groupId 		= m_groupId;
+	nsm->cookie 		= s.cookie;
+	nsm->seq 			= seq;
+
+	(void)m_udp.GetAckState( s.m->remote, nsm->cumAck );
+
+	m_listener->Notify( MessagePtr( nsm ) );
+}
+
 void 
 NetClient::onControl( MessagePtr m )
 {
@@ -13,10 +13,12 @@ struct UdpSend
 	MessagePtr 	m;
 	int 		qos;
 	bool 		broadcast;
+	uint 		cookie;
 
 	UdpSend()
 		: qos( Message::RELIABLE )
 		, broadcast( false )
+		, cookie( 0 )
 	{
 	}
 };
@@ -39,11 +41,33 @@ public:
 	/**
 	 * Init with a MessageListener
 	 *
+	 * Registers the group messages. Register application messages and 
+	 * call MessageFactory::Freeze after Init and before Connect.
+	 *
 	 * @param listener The MessageListener to notify
 	 * @return true if successful
 	 */
 	bool Init( MessageListener* listener );
 
+	/**
+	 * Set recv mode of TCP connections. 
+	 *
+	 * RECV_ZERO_BYTE saves memory when most connections are idle.
+	 *
+	 * @param mode The recv mode
+	 */
+	void SetRecvMode( TcpConnection::RecvMode mode );
+
+	/**
+	 * Set compression of TCP connections. Call before Init. 
+	 *
+	 * Used only when both sides set it. MODE_DICT falls back to MODE_FAST 
+	 * unless both set the same Compressor::SetDictionary.
+	 *
+	 * @param mode Compressor::Mode
+	 */
+	void SetCompression( uint mode );
+
 	/**
 	 * Connect to NetServer
 	 *
@@ -68,10 +92,16 @@ public:
 	/**
 	 * Send message over udp. There can be only one Udp group
 	 *
+	 * With a cookie, a reliable or ordered send to m->remote is notified 
+	 * as NetStateMessage UDP_SENT after it is sent. It has the cookie, 
+	 * the reliable sequence of the send and the cumulative ack of the 
+	 * connection. Not notified when relayed over TCP.
+	 *
 	 * @param m Message to send
 	 * @param qos The quality of service level
+	 * @param cookie Application value to notify with. 0 for none.
 	 */
-	void SendUdp( MessagePtr m, int qos = Message::RELIABLE );
+	void SendUdp( MessagePtr m, int qos = Message::RELIABLE, uint cookie = 0 );
 	void BroadcastUdp( MessagePtr m, int qos = Message::RELIABLE );
 
 	/**
@@ -89,12 +119,24 @@ public:
 	 */
 	void Fini();
 
+protected:
+	/**
+	 * Wake Run to exit
+	 */
+	void helpStop();
+
 private:
 	typedef Queue<UdpSend, Mutex> UdpSendQ;
 
+	enum
+	{
+		WAIT_MS = 10 		// idle wait. UDP resend checks run from Run
+	};
+
 	void processRecvQ();
 	void processSendQ();
 	void processUdpSendQ();
+	void notifyUdpSent( const UdpSend& s, uint seq );
 
 	void onControl( MessagePtr m );
 	void onGroupPrepare( MessagePtr m );
@@ -115,6 +157,7 @@ private:
 	uint 				m_groupId; 		// current udp group
 	uint 				m_selfTag; 		// my tag when joined
 	uint 				m_processedCount;
+	Event 				m_wakeup; 		// signalled on queue put
 };
 
 } // gk 
@@ -3,6 +3,7 @@
 #include <kcore/corebase.h>
 #include <knet/NetServer.h>
 
+#include <kcore/sys/Clock.h>
 #include <kcore/sys/Logger.h>
 #include <knet/group/NmGroupPrepare.h>
 #include <knet/group/NmGroupPrepared.h>
@@ -27,6 +28,8 @@ NetServer::NetServer()
 , m_groups()
 , m_nextGroupId( 1 )
 , m_processedCount( 0 )
+, m_corking( false )
+, m_wakeup()
 {
 }
 
@@ -41,6 +44,8 @@ NetServer::Init( MessageListener* listener )
 
 	Socket::Startup();
 
+	(void)Clock::Calibrate(); // for cached loop time
+
 	m_listener = listener;
 
 	bool rc = m_ios.Init();
@@ -61,14 +66,65 @@ NetServer::Init( MessageListener* listener )
 		return false;
 	}
 
+	m_tcp.SetWakeup( &m_wakeup );
+
 	MessageFactory::Instance()->Register( new NmGroupPrepared );
 	MessageFactory::Instance()->Register( new NmGroupRelay );
+	MessageFactory::Instance()->SetPool( NET_GROUP_RELAY ); // every relayed packet
 
 	Start();
 
 	return true;
 }
 
+void 
+NetServer::SetRecvMode( TcpConnection::RecvMode mode )
+{
+	m_tcp.SetRecvMode( mode );
+}
+
+void 
+NetServer::SetCompression( uint mode )
+{
+	m_tcp.SetCompression( mode );
+}
+
+void 
+NetServer::SetSendLimits( uint highWater, uint lowWater, uint policy )
+{
+	m_tcp.SetSendLimits( highWater, lowWater, policy );
+}
+
+void 
+NetServer::SetCorking( bool corking )
+{
+	m_corking = corking;
+}
+
+void 
+NetServer::SetCorkLimits( uint bytes, uint ms )
+{
+	m_tcp.SetCorkLimits( bytes, ms );
+}
+
+void 
+NetServer::SetLowLatency( uint connectionId, bool lowLatency )
+{
+	NetControlMessage* ncm = new NetControlMessage;
+
+	ncm->control 		= NetControlMessage::TCP_LOW_LATENCY;
+	ncm->connectionId 	= connectionId;
+	ncm->param 			= lowLatency ? 1 : 0;
+
+	this->Notify( MessagePtr( ncm ) );
+}
+
+TcpCommunicator::FlushStats 
+NetServer::GetFlushStats() const
+{
+	return m_tcp.GetFlushStats();
+}
+
 void 
 NetServer::Listen( const IpAddress& addr, SecurityLevel sl )
 {
@@ -109,6 +165,8 @@ NetServer::Send( MessagePtr m )
 	K_ASSERT( m.Get() != 0 );
 
 	m_sendQ.Put( m );
+
+	m_wakeup.Signal();
 }
 
 void 
@@ -122,6 +180,8 @@ NetServer::Notify( MessagePtr m )
 	case NET_GROUP_PREPARED:
 	case NET_STATE_MESSAGE:
 		m_recvQ.Put( m );
+
+		m_wakeup.Signal();
 		break;
 	default:
 		m_listener->Notify( m );
@@ -140,6 +200,8 @@ NetServer::CreateUdpGroup( SecurityLevel sl )
 
 	m_groupQ.Put( op );
 
+	m_wakeup.Signal();
+
 	return op.groupId;
 }
 
@@ -154,6 +216,8 @@ NetServer::JoinUdpGroup( uint groupId, uint connectionId, const tstring& extra )
 	op.extra		= extra;
 	
 	m_groupQ.Put( op );
+
+	m_wakeup.Signal();
 }
 
 void 
@@ -166,6 +230,8 @@ NetServer::LeaveUdpGroup( uint groupId, uint connectionId )
 	op.op 			= NetGroupOp::LEAVE;
 	
 	m_groupQ.Put( op );
+
+	m_wakeup.Signal();
 }
 
 void 
@@ -177,6 +243,8 @@ NetServer::DestroyUdpGroup( uint groupId )
 	op.op 			= NetGroupOp::DESTROY;
 	
 	m_groupQ.Put( op );
+
+	m_wakeup.Signal();
 }
 
 int 
@@ -186,17 +254,32 @@ NetServer::Run()
 
 	while ( IsRunning() )
 	{
+		Clock::Update();
+
 		m_processedCount = 0;
 
 		m_tcp.Run();				// tick 
 
 		processRecvQ();				
+
+		bool corking = m_corking;
+
+		if ( corking )
+		{
+			m_tcp.Cork();
+		}
+
 		processSendQ();
 		processOpQ();
 
+		if ( corking )
+		{
+			m_tcp.Flush();
+		}
+
 		if ( m_processedCount == 0 )
 		{
-			::Sleep( 1 );
+			m_wakeup.Wait( m_tcp.GetWaitMs( WAIT_MS ) );
 		}
 	}
 
@@ -205,6 +288,12 @@ NetServer::Run()
 	return 0;
 }
 
+void 
+NetServer::helpStop()
+{
+	m_wakeup.Signal();
+}
+
 void 
 NetServer::Fini()
 {	
@@ -320,6 +409,11 @@ NetServer::onControl( MessagePtr m )
 			m_tcp.Close( cm->connectionId );
 		}
 		break;
+	case NetControlMessage::TCP_LOW_LATENCY:
+		{
+			m_tcp.SetLowLatency( cm->connectionId, cm->param != 0 );
+		}
+		break;
 	}
 }
 
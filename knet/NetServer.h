@@ -29,11 +29,73 @@ public:
 	/**
 	 * Initialize NetServer 
 	 *
+	 * Registers the group messages and pools NET_GROUP_RELAY. Register 
+	 * application messages and call MessageFactory::Freeze after Init 
+	 * and before Listen. Node does it in Node::Init.
+	 *
 	 * @param listener The listener to notify 
 	 * @return true if successful
 	 */
 	bool Init( MessageListener* listener );
 
+	/**
+	 * Set recv mode of TCP connections. 
+	 *
+	 * RECV_ZERO_BYTE saves memory when most connections are idle.
+	 *
+	 * @param mode The recv mode
+	 */
+	void SetRecvMode( TcpConnection::RecvMode mode );
+
+	/**
+	 * Set compression of TCP connections. Call before Init. 
+	 *
+	 * Used only when both sides set it. MODE_DICT falls back to MODE_FAST 
+	 * unless both set the same Compressor::SetDictionary.
+	 *
+	 * @param mode Compressor::Mode
+	 */
+	void SetCompression( uint mode );
+
+	/**
+	 * Set send queue limits of TCP connections created later. 
+	 * TCP_SEND_HIGH_WATER and TCP_SEND_LOW_WATER are notified on crossing.
+	 *
+	 * @param highWater Queued bytes to notify and apply policy over. 0 for no limit.
+	 * @param lowWater Queued bytes to notify at after going over high water
+	 * @param policy TcpConnection::SendPolicy bits
+	 */
+	void SetSendLimits( uint highWater, uint lowWater, uint policy );
+
+	/**
+	 * Cork TCP sends in each loop and flush at the end. 
+	 * Messages sent in a loop go out with fewer send calls.
+	 *
+	 * @param corking true to cork. false by default.
+	 */
+	void SetCorking( bool corking );
+
+	/**
+	 * Set limits to flush corked frames early. Call before Init.
+	 *
+	 * @param bytes Corked bytes to flush at
+	 * @param ms Age of the first corked frame to flush at
+	 */
+	void SetCorkLimits( uint bytes, uint ms );
+
+	/**
+	 * Set a connection low latency. A low latency connection is not corked.
+	 *
+	 * @param connectionId The TCP connection id
+	 * @param lowLatency true to send right away always
+	 */
+	void SetLowLatency( uint connectionId, bool lowLatency );
+
+	/**
+	 * Get counters for corked sends. Read without lock.
+	 */
+	TcpCommunicator::FlushStats GetFlushStats() const;
+
 	/**
 	 * Start listen on addr 
 	 *
@@ -100,7 +162,18 @@ public:
 	 */
 	void Fini();
 
+protected:
+	/**
+	 * Wake Run to exit
+	 */
+	void helpStop();
+
 private:
+	enum
+	{
+		WAIT_MS = 100 		// idle wait. queues and IO completions signal earlier
+	};
+
 	typedef stdext::hash_map<uint, NetGroup*> NetGroupMap;
 	typedef Queue<NetGroupOp, Mutex> GroupOpQueue;
 
@@ -134,6 +207,8 @@ private:
 	GroupOpQueue 		m_groupQ;
 
 	uint 				m_processedCount;
+	Atomic<bool> 		m_corking;
+	Event 				m_wakeup; 		// signalled on queue put
 };
 
 } // gk 
@@ -1,14 +1,25 @@
 #pragma once 
 
+#include <knet/aio/IoPort.h>
+
+#if defined( GK_IO_EPOLL )
+#include <netinet/in.h>
+#endif
+
 namespace gk 
 {
 
 /**
  * @struct IoBlock 
  *
- * IOCP overlapped block for asynchronous io
+ * IOCP overlapped block for asynchronous io.
+ * On Linux, a plain block submitted to IoPort.
  */
+#if defined( GK_IO_EPOLL )
+struct IoBlock
+#else
 struct IoBlock : public OVERLAPPED
+#endif
 {
     enum OpCode
     {
@@ -16,13 +27,20 @@ struct IoBlock : public OVERLAPPED
         OP_WRITE
     };
 
-    WSABUF      buf;            ///< Async buffer. Must come first
+    IoBuf       buf;            ///< Async buffer. Must come first
     OpCode      op;             ///< operation
     ulong       transferred;    ///< transferred length 
     ulong       totalLen;       ///< total length of bytes
     sockaddr_in remote;         ///< address for UDP
     uint        remoteLen;      ///< remote address length
     void*       extra;          ///< save extra data to process. IoBlock at current impl.
+    IoBuf*      bufs;           ///< gather buffers for send. buf is used when 0
+    ulong       bufCount;       ///< number of bufs
+#if defined( GK_IO_EPOLL )
+    int         handle;         ///< handle submitted on. set by IoPort::Submit
+    bool        withAddr;       ///< use remote for recvfrom / sendto
+    uint        bindSeq;        ///< bind sequence of the handle at Submit
+#endif
 
     IoBlock()
         : op(), 
@@ -30,7 +48,14 @@ struct IoBlock : public OVERLAPPED
           totalLen( 0 ), 
 		  remote(), 
 		  remoteLen( 0 ), 
-		  extra( 0 )
+		  extra( 0 ), 
+          bufs( 0 ), 
+          bufCount( 0 )
+#if defined( GK_IO_EPOLL )
+        , handle( -1 )
+        , withAddr( false )
+        , bindSeq( 0 )
+#endif
     {
         buf.buf = 0;
         buf.len = 0;
@@ -0,0 +1,671 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <knet/aio/IoPort.h>
+
+#include <knet/aio/IoAgent.h>
+#include <knet/aio/IoBlock.h>
+#include <kcore/sys/Logger.h>
+#include <kcore/sys/ScopedLock.h>
+
+#if defined( GK_IO_EPOLL )
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+namespace gk {
+
+#if defined( GK_IO_EPOLL )
+
+/**
+ * @struct IoPort::Entry
+ *
+ * Per handle state. Entries are indexed by handle and never freed
+ * since epoll can report a stale event after a handle is unbound.
+ *
+ * bindSeq changes on each Bind and unbind. An io submitted before 
+ * that is not performed, since the handle number can be reused 
+ * by another socket.
+ */
+struct IoPort::Entry
+{
+	IoPort*		port;
+	IoAgent*	agent;
+	int			handle;
+	uint		bindSeq;
+	IoBlock*	read;		///< parked read waiting for readiness
+	IoBlock*	write;		///< parked write waiting for readiness
+	Mutex		lock;
+
+	Entry()
+		: port( 0 )
+		, agent( 0 )
+		, handle( -1 )
+		, bindSeq( 0 )
+		, read( 0 )
+		, write( 0 )
+		, lock()
+	{
+	}
+};
+
+IoPort::Entry*	IoPort::s_entries[IoPort::MAX_HANDLES];
+Mutex			IoPort::s_entryLock;
+
+IoPort::IoPort()
+: m_port( -1 )
+, m_wake( -1 )
+, m_kick( -1 )
+, m_ready()
+{
+}
+
+IoPort::~IoPort()
+{
+	Fini();
+}
+
+bool
+IoPort::Init()
+{
+	m_port = ::epoll_create1( EPOLL_CLOEXEC );
+
+	if ( m_port < 0 )
+	{
+		LOG( FT_ERROR, _T("IoPort::Init> epoll_create1 failed %d"), errno );
+
+		return false;
+	}
+
+	m_wake = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+	if ( m_wake < 0 )
+	{
+		LOG( FT_ERROR, _T("IoPort::Init> eventfd failed %d"), errno );
+
+		Fini();
+
+		return false;
+	}
+
+	m_kick = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+	if ( m_kick < 0 )
+	{
+		LOG( FT_ERROR, _T("IoPort::Init> eventfd failed %d"), errno );
+
+		Fini();
+
+		return false;
+	}
+
+	// level triggered and never read, so every worker sees a wake up
+
+	epoll_event ev;
+
+	ev.events	= EPOLLIN;
+	ev.data.ptr = 0;
+
+	K_RETURN_V_IF( ::epoll_ctl( m_port, EPOLL_CTL_ADD, m_wake, &ev ) != 0, false );
+
+	// read by the worker woken up to run cancelled ios in m_ready
+
+	ev.events	= EPOLLIN;
+	ev.data.ptr = &m_kick;
+
+	return ::epoll_ctl( m_port, EPOLL_CTL_ADD, m_kick, &ev ) == 0;
+}
+
+bool
+IoPort::Bind( IoAgent* agent )
+{
+	K_ASSERT( agent != 0 );
+	K_ASSERT( m_port >= 0 );
+
+	int handle = (int)(intptr_t)agent->RequestHandle();
+
+	K_RETURN_V_IF( handle < 0 || handle >= MAX_HANDLES, false );
+
+	Entry* e = getEntry( handle );
+
+	{
+		ScopedLock sl( e->lock );
+
+		// a handle closed without Cancel leaves its entry bound
+
+		if ( e->agent != 0 )
+		{
+			unbind( e );
+		}
+
+		++e->bindSeq;
+
+		e->port		= this;
+		e->agent	= agent;
+		e->handle	= handle;
+	}
+
+	// oneshot. armed again for each submitted io
+
+	epoll_event ev;
+
+	ev.events	= EPOLLONESHOT;
+	ev.data.ptr = e;
+
+	return ::epoll_ctl( m_port, EPOLL_CTL_ADD, handle, &ev ) == 0;
+}
+
+void
+IoPort::Unbind( IoAgent* agent )
+{
+	K_ASSERT( agent != 0 );
+
+	int handle = (int)(intptr_t)agent->RequestHandle();
+
+	K_RETURN_IF( handle < 0 || handle >= MAX_HANDLES );
+
+	Entry* e = getEntry( handle );
+
+	ScopedLock sl( e->lock );
+
+	K_RETURN_IF( e->agent != agent );
+
+	unbind( e );
+}
+
+void
+IoPort::Cancel( int handle )
+{
+	K_RETURN_IF( handle < 0 || handle >= MAX_HANDLES );
+
+	Entry* e = getEntry( handle );
+
+	ScopedLock sl( e->lock );
+
+	K_RETURN_IF( e->agent == 0 );
+
+	unbind( e );
+}
+
+bool
+IoPort::Wait( Completion& c )
+{
+	for ( ;; )
+	{
+		// [1] ios already known to be ready
+
+		IoBlock* io = 0;
+
+		if ( m_ready.Get( io ) )
+		{
+			if ( perform( io, c ) )
+			{
+				return c.error == 0;
+			}
+
+			continue;
+		}
+
+		// [2] wait for readiness
+
+		epoll_event evs[MAX_EVENTS];
+
+		int n = ::epoll_wait( m_port, evs, MAX_EVENTS, -1 );
+
+		if ( n < 0 )
+		{
+			if ( errno == EINTR )
+			{
+				continue;
+			}
+
+			c.agent = 0;
+			c.error = errno;
+
+			return false;
+		}
+
+		// finish the batch before shutdown. oneshot events not
+		// handled here are never reported again.
+
+		bool shutdown = false;
+
+		for ( int i = 0; i < n; ++i )
+		{
+			if ( evs[i].data.ptr == 0 )
+			{
+				shutdown = true;
+
+				continue;
+			}
+
+			if ( evs[i].data.ptr == &m_kick )
+			{
+				uint8 v = 0;
+
+				(void)::read( m_kick, &v, sizeof( v ) );
+
+				continue;
+			}
+
+			Entry* e = (Entry*)evs[i].data.ptr;
+
+			ScopedLock sl( e->lock );
+
+			if ( e->agent == 0 )
+			{
+				continue;
+			}
+
+			uint events = evs[i].events;
+
+			if ( events & ( EPOLLIN | EPOLLERR | EPOLLHUP ) )
+			{
+				if ( e->read != 0 )
+				{
+					m_ready.Put( e->read );
+
+					e->read = 0;
+				}
+			}
+
+			if ( events & ( EPOLLOUT | EPOLLERR | EPOLLHUP ) )
+			{
+				if ( e->write != 0 )
+				{
+					m_ready.Put( e->write );
+
+					e->write = 0;
+				}
+			}
+
+			arm( e );
+		}
+
+		if ( shutdown )
+		{
+			c.agent = 0;
+			c.io	= 0;
+
+			return true;
+		}
+	}
+}
+
+void
+IoPort::Wake( int count )
+{
+	count; // one write wakes all workers. level triggered.
+
+	K_RETURN_IF( m_wake < 0 );
+
+	uint8 v = 1;
+
+	::write( m_wake, &v, sizeof( v ) );
+}
+
+void
+IoPort::Fini()
+{
+	if ( m_wake >= 0 )
+	{
+		::close( m_wake );
+
+		m_wake = -1;
+	}
+
+	if ( m_kick >= 0 )
+	{
+		::close( m_kick );
+
+		m_kick = -1;
+	}
+
+	if ( m_port >= 0 )
+	{
+		::close( m_port );
+
+		m_port = -1;
+	}
+}
+
+int
+IoPort::Submit( int handle, IoBlock* io, bool withAddr )
+{
+	K_ASSERT( io != 0 );
+	K_ASSERT( handle >= 0 && handle < MAX_HANDLES );
+
+	Entry* e = getEntry( handle );
+
+	ScopedLock sl( e->lock );
+
+	if ( e->agent == 0 )
+	{
+		return EBADF;
+	}
+
+	io->handle		= handle;
+	io->withAddr	= withAddr;
+	io->transferred	= 0;
+	io->bindSeq		= e->bindSeq;
+
+	if ( io->op == IoBlock::OP_READ )
+	{
+		K_ASSERT( e->read == 0 ); // one outstanding read
+
+		e->read = io;
+	}
+	else
+	{
+		K_ASSERT( e->write == 0 ); // one outstanding write
+
+		e->write = io;
+	}
+
+	e->port->arm( e );
+
+	return 0;
+}
+
+bool
+IoPort::perform( IoBlock* io, Completion& c )
+{
+	// io is owned by its agent, which holds a request count until
+	// the completion is delivered. only the handle can be gone.
+
+	Entry* e = getEntry( io->handle );
+
+	c.agent = (IoAgent*)io->extra;
+	c.io	= io;
+	c.bytes = 0;
+	c.error = 0;
+
+	// held over the non-blocking call, so Cancel waits for it 
+	// before the handle is closed and its number reused
+
+	ScopedLock sl( e->lock );
+
+	if ( io->bindSeq != e->bindSeq )
+	{
+		c.error = ECANCELED;
+
+		return true;
+	}
+
+	// zero byte recv completes on readiness only. agent reads by itself.
+
+	if ( io->op == IoBlock::OP_READ && io->buf.len == 0 )
+	{
+		return true;
+	}
+
+	iovec iov[MAX_IOV];
+
+	size_t iovCount = 1;
+
+	if ( io->bufs != 0 ) // gather send
+	{
+		iovCount = io->bufCount < MAX_IOV ? io->bufCount : MAX_IOV;
+
+		for ( size_t i = 0; i < iovCount; ++i )
+		{
+			iov[i].iov_base	= io->bufs[i].buf;
+			iov[i].iov_len	= io->bufs[i].len;
+		}
+	}
+	else
+	{
+		iov[0].iov_base	= io->buf.buf;
+		iov[0].iov_len	= io->buf.len;
+	}
+
+	msghdr msg;
+
+	::memset( &msg, 0, sizeof( msg ) );
+
+	msg.msg_iov		= iov;
+	msg.msg_iovlen	= iovCount;
+
+	if ( io->withAddr )
+	{
+		msg.msg_name	= &io->remote;
+		msg.msg_namelen	= sizeof( sockaddr_in );
+	}
+
+	ssize_t rc = 0;
+
+	if ( io->op == IoBlock::OP_READ )
+	{
+		rc = ::recvmsg( io->handle, &msg, 0 );
+
+		io->remoteLen = msg.msg_namelen;
+	}
+	else
+	{
+		rc = ::sendmsg( io->handle, &msg, MSG_NOSIGNAL );
+	}
+
+	if ( rc >= 0 )
+	{
+		c.bytes = (ulong)rc;
+
+		return true;
+	}
+
+	if ( errno == EAGAIN || errno == EWOULDBLOCK )
+	{
+		// spurious readiness. park again
+
+		if ( io->op == IoBlock::OP_READ )
+		{
+			e->read = io;
+		}
+		else
+		{
+			e->write = io;
+		}
+
+		arm( e );
+
+		return false;
+	}
+
+	c.error = errno;
+
+	return true;
+}
+
+void
+IoPort::arm( Entry* e )
+{
+	// called with e->lock held
+
+	uint events = EPOLLONESHOT;
+
+	if ( e->read != 0 )
+	{
+		events |= EPOLLIN | EPOLLRDHUP;
+	}
+
+	if ( e->write != 0 )
+	{
+		events |= EPOLLOUT;
+	}
+
+	K_RETURN_IF( events == EPOLLONESHOT );
+
+	epoll_event ev;
+
+	ev.events	= events;
+	ev.data.ptr = e;
+
+	::epoll_ctl( m_port, EPOLL_CTL_MOD, e->handle, &ev );
+}
+
+void
+IoPort::kick()
+{
+	uint8 v = 1;
+
+	(void)::write( m_kick, &v, sizeof( v ) );
+}
+
+void
+IoPort::unbind( Entry* e )
+{
+	// called with e->lock held. 
+	// the same order as Wait. e->lock then m_ready.
+
+	IoPort* port = e->port;
+
+	::epoll_ctl( port->m_port, EPOLL_CTL_DEL, e->handle, 0 );
+
+	++e->bindSeq;
+
+	bool parked = ( e->read != 0 || e->write != 0 );
+
+	if ( e->read != 0 )
+	{
+		port->m_ready.Put( e->read );
+	}
+
+	if ( e->write != 0 )
+	{
+		port->m_ready.Put( e->write );
+	}
+
+	e->port		= 0;
+	e->agent	= 0;
+	e->read		= 0;
+	e->write	= 0;
+
+	// ios already in m_ready and these complete with ECANCELED in perform
+
+	if ( parked )
+	{
+		port->kick();
+	}
+}
+
+IoPort::Entry*
+IoPort::getEntry( int handle )
+{
+	Entry* e = s_entries[handle];
+
+	if ( e != 0 )
+	{
+		return e;
+	}
+
+	ScopedLock sl( s_entryLock );
+
+	if ( s_entries[handle] == 0 )
+	{
+		s_entries[handle] = new Entry;
+	}
+
+	return s_entries[handle];
+}
+
+#else // IOCP
+
+IoPort::IoPort()
+: m_port( INVALID_HANDLE_VALUE )
+{
+}
+
+IoPort::~IoPort()
+{
+	Fini();
+}
+
+bool
+IoPort::Init()
+{
+	m_port = ::CreateIoCompletionPort( INVALID_HANDLE_VALUE, 0, 0, 0 );
+
+	return ( m_port != 0 && m_port != INVALID_HANDLE_VALUE );
+}
+
+bool
+IoPort::Bind( IoAgent* agent )
+{
+	K_ASSERT( agent != 0 );
+	K_ASSERT( agent->RequestHandle() != INVALID_HANDLE_VALUE );
+
+	HANDLE v = ::CreateIoCompletionPort(
+						agent->RequestHandle(),
+						m_port,
+						(ULONG_PTR)agent,
+						0 );
+
+	return ( v != 0 && v == m_port );
+}
+
+void
+IoPort::Unbind( IoAgent* agent )
+{
+	K_ASSERT( agent != 0 );
+
+	// IOCP association ends when the handle is closed
+}
+
+bool
+IoPort::Wait( Completion& c )
+{
+	ulong           bytes       = 0;
+	ULONG_PTR       perIoKey    = 0;
+	LPOVERLAPPED    ov          = 0;
+
+	int rc = ::GetQueuedCompletionStatus(
+					m_port,
+					(LPDWORD)&bytes,
+					&perIoKey,
+					&ov,
+					INFINITE );
+
+	c.agent = (IoAgent*)perIoKey;
+	c.io	= (IoBlock*)ov;
+	c.bytes = bytes;
+	c.error = 0;
+
+	if ( rc == 0 )
+	{
+		c.error = ::GetLastError();
+
+		if ( c.error == 0 )
+		{
+			c.error = WSAESHUTDOWN;
+		}
+	}
+
+	return rc != 0;
+}
+
+void
+IoPort::Wake( int count )
+{
+	for ( int i = 0; i < count; ++i )
+	{
+		::PostQueuedCompletionStatus( m_port, 0, 0, 0 );
+	}
+}
+
+void
+IoPort::Fini()
+{
+	if ( m_port != INVALID_HANDLE_VALUE )
+	{
+		::CloseHandle( m_port );
+
+		m_port = INVALID_HANDLE_VALUE;
+	}
+}
+
+#endif
+
+} // gk
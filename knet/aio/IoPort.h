@@ -0,0 +1,181 @@
+#pragma once
+
+#include <kcore/base/Noncopyable.h>
+
+#if defined( __linux__ )
+#define GK_IO_EPOLL
+#endif
+
+#if defined( GK_IO_EPOLL )
+#include <kcore/sys/Lock.h>
+#include <kcore/sys/Queue.h>
+#include <errno.h>
+#endif
+
+namespace gk {
+
+#if defined( GK_IO_EPOLL )
+/**
+ * @struct IoBuf
+ *
+ * Same layout as WSABUF so that IoBlock is shared by both platforms
+ */
+struct IoBuf
+{
+	ulong	len;
+	char*	buf;
+};
+#else
+typedef WSABUF IoBuf;
+#endif
+
+class IoAgent;
+struct IoBlock;
+
+/**
+ * @class IoPort
+ *
+ * Completion port used by IoService and IoWorkers.
+ *
+ * On Windows, this is a thin wrapper of an IOCP port.
+ * On Linux, completions are emulated on top of epoll.
+ * A submitted IoBlock is parked on its handle until epoll reports
+ * readiness, then the operation is performed on a worker thread and
+ * delivered as a completion. So IoAgents see the same completion
+ * driven flow on both platforms.
+ */
+class IoPort : private Noncopyable
+{
+public:
+	/**
+	 * @struct Completion
+	 *
+	 * Result of a finished io. agent is 0 when the port is shutdown.
+	 */
+	struct Completion
+	{
+		IoAgent*	agent;		///< agent bound to the handle
+		IoBlock*	io;			///< IoBlock completed. 0 if the wait itself failed
+		ulong		bytes;		///< transferred bytes
+		int			error;		///< system error code when the io failed
+
+		Completion()
+			: agent( 0 )
+			, io( 0 )
+			, bytes( 0 )
+			, error( 0 )
+		{
+		}
+	};
+
+	/**
+	 * System error codes reported to IoAgents
+	 */
+	enum
+	{
+#if defined( GK_IO_EPOLL )
+		  ERROR_CONNRESET	= ECONNRESET
+#else
+		  ERROR_CONNRESET	= WSAECONNRESET
+#endif
+	};
+
+public:
+	IoPort();
+	~IoPort();
+
+	/**
+	 * Create the port
+	 *
+	 * @return true if successful
+	 */
+	bool Init();
+
+	/**
+	 * Associate agent handle with this port
+	 *
+	 * @param agent IoAgent to bind
+	 * @return true if successful
+	 */
+	bool Bind( IoAgent* agent );
+
+	/**
+	 * Dissociate agent handle from this port
+	 *
+	 * @param agent IoAgent to unbind
+	 */
+	void Unbind( IoAgent* agent );
+
+	/**
+	 * Wait for a completion. Blocks until an io is finished or port is woken up.
+	 *
+	 * @param c Completion filled on return
+	 * @return false if the io failed. c.error has the error code.
+	 */
+	bool Wait( Completion& c );
+
+	/**
+	 * Wake up workers waiting on this port to shutdown
+	 *
+	 * @param count The number of wake ups to post
+	 */
+	void Wake( int count );
+
+	/**
+	 * Close the port
+	 */
+	void Fini();
+
+#if defined( GK_IO_EPOLL )
+	/**
+	 * Submit an io on a bound handle. Called from Socket async functions.
+	 *
+	 * @param handle Socket handle bound with Bind()
+	 * @param io IoBlock to process. op decides direction
+	 * @param withAddr true to use io->remote for UDP recvfrom/sendto
+	 * @return 0 if successful. Otherwise system error code
+	 */
+	static int Submit( int handle, IoBlock* io, bool withAddr );
+
+	/**
+	 * Remove a handle from its port before it is closed. 
+	 * Parked and ready ios of the handle complete with ECANCELED, 
+	 * so their agents see OnIoError as with IOCP on close.
+	 *
+	 * @param handle Socket handle bound with Bind()
+	 */
+	static void Cancel( int handle );
+#endif
+
+private:
+#if defined( GK_IO_EPOLL )
+	struct Entry;
+
+	enum
+	{
+		  MAX_HANDLES	= 65536
+		, MAX_EVENTS	= 16
+		, MAX_IOV		= 64
+	};
+
+	bool perform( IoBlock* io, Completion& c );
+	void arm( Entry* e );
+	void kick();
+
+	static void unbind( Entry* e );
+	static Entry* getEntry( int handle );
+
+private:
+	int						m_port;
+	int						m_wake;
+	int						m_kick;
+	Queue<IoBlock*, Mutex>	m_ready;
+
+	static Entry*			s_entries[MAX_HANDLES];
+	static Mutex			s_entryLock;
+#else
+	HANDLE					m_port;
+#endif
+};
+
+} // gk
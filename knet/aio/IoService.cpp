@@ -4,10 +4,14 @@
 #include <knet/aio/IoService.h>
 #include <kcore/sys/Logger.h>
 
+#if defined( GK_IO_EPOLL )
+#include <unistd.h>
+#endif
+
 namespace gk {
 
 IoService::IoService()
-: m_port( INVALID_HANDLE_VALUE ), 
+: m_port(), 
   m_workerCount( 0 )
 {
 }
@@ -20,9 +24,7 @@ IoService::~IoService()
 bool 
 IoService::Init()
 {
-    m_port = ::CreateIoCompletionPort( INVALID_HANDLE_VALUE, 0, 0, 0 );
-
-    if ( m_port == INVALID_HANDLE_VALUE )
+    if ( !m_port.Init() )
     {
         return false;
     }
@@ -38,33 +40,29 @@ IoService::Init()
 
     for ( int i = 0; i < properWorkerCount; ++i )
     {
-        if ( m_workers[i].Init( m_port ) )
+        if ( m_workers[i].Init( &m_port ) )
         {
             ++m_workerCount;
         }
     }
 
-    return ( m_port != 0 && m_workerCount > 0 );
+    return ( m_workerCount > 0 );
 }
 
 bool 
 IoService::BindIo( IoAgent* agent )
 {
     K_ASSERT( agent != 0 );
-    K_ASSERT( agent->RequestHandle() != INVALID_HANDLE_VALUE );
 
-    HANDLE v = ::CreateIoCompletionPort( 
-                        agent->RequestHandle(), 
-                        m_port, 
-                        (ULONG_PTR)agent, 
-                        0 );        
+    // handle is checked by IoPort for each platform
+
+    bool rc = m_port.Bind( agent );
 
     LOG( FT_DEBUG, 
-         _T("[IoService] Bound 0x%x to handle %d"), 
-         m_port, 
+         _T("[IoService] Bound handle %d"), 
          agent->RequestHandle() );
 
-    return ( v != 0 && v == m_port ); 
+    return rc; 
 }
 
 void 
@@ -72,7 +70,7 @@ IoService::UnbindIo( IoAgent* agent )
 {
     K_ASSERT( agent != 0 );
 	
-	// hmm... UnbindIo
+	m_port.Unbind( agent );
 }
 
 bool 
@@ -99,12 +97,7 @@ IoService::Fini()
         m_workers[i].Fini();
     }
 
-    if ( m_port != INVALID_HANDLE_VALUE )
-    {
-        CloseHandle( m_port );
-
-        m_port = INVALID_HANDLE_VALUE;
-    }
+    m_port.Fini();
 
 	LOG( FT_INFO, _T("IoService::Fini> Finished") );
 }
@@ -112,11 +105,17 @@ IoService::Fini()
 uint 
 IoService::getProperWorkerCount() const
 {
+#if defined( GK_IO_EPOLL )
+    long n = ::sysconf( _SC_NPROCESSORS_ONLN );
+
+    return n > 0 ? (uint)n : 1;
+#else
     SYSTEM_INFO si;
 
     GetSystemInfo( &si );
 
     return si.dwNumberOfProcessors;
+#endif
 }
 
 } // gk
@@ -3,12 +3,15 @@
 #include <kcore/base/Noncopyable.h>
 #include <knet/aio/IoAgent.h>
 #include <knet/aio/IoBlock.h>
+#include <knet/aio/IoPort.h>
 #include <knet/aio/IoWorker.h>
 
 namespace gk {
 
 /** 
  * @class IoService
+ *
+ * Runs IoWorkers on an IoPort. IOCP on Windows, epoll on Linux.
  */
 class IoService : private Noncopyable
 {
@@ -66,7 +69,7 @@ private:
     uint getProperWorkerCount() const;
 
 private:
-    HANDLE 		m_port;
+    IoPort 		m_port;
     IoWorker 	m_workers[MAX_WORKERS];
     int 		m_workerCount;
 };
@@ -19,7 +19,7 @@ IoWorker::~IoWorker()
 }
 
 bool 
-IoWorker::Init( HANDLE port )
+IoWorker::Init( IoPort* port )
 {
     K_ASSERT( port != 0 );
 
@@ -39,36 +39,29 @@ IoWorker::Run()
     {
         // [1] Get completion status
 
-        ulong           bytes       = 0;
-        ulong           perIoKey    = 0;
-        LPOVERLAPPED    ov          = 0;
+        IoPort::Completion c;
 
-        int rc = ::GetQueuedCompletionStatus( 
-                        port_, 
-                        (LPDWORD)&bytes, 
-                        (PULONG_PTR)&perIoKey, 
-                        &ov, 
-                        INFINITE );
+        bool rc = port_->Wait( c );
 
 		if ( !IsRunning() )
 		{
 			break;
 		}
 
-        if ( perIoKey == NULL ) // shutdown
+        if ( c.agent == 0 ) // shutdown
         {
             break;
         }
 
         // [2] Branch on rc 
 
-        if ( rc == 0 )  
+        if ( !rc )  
         {
-            handleRcZero( bytes, perIoKey, ov );
+            handleRcZero( c );
         }
         else
         {
-            handleRcNonZero( bytes, perIoKey, ov );
+            handleRcNonZero( c );
         }
     }
 
@@ -78,99 +71,85 @@ IoWorker::Run()
 }
 
 void
-IoWorker::handleRcZero( ulong bytes, 
-                             ulong perIoKey, 
-                             LPOVERLAPPED ov )
+IoWorker::handleRcZero( const IoPort::Completion& c )
 {
     // when rc == 0, there are two cases
 
-    bytes;
-    perIoKey;
-
-    if ( ov == NULL )  // This seems not happen for INFINITE wait
+    if ( c.io == 0 )  // This seems not happen for INFINITE wait
     {
         // GetQueuedCompletionStatus failed
 
         return;
     }
 
-    // ov != NULL && perIoKey && bytes saved
-
-    K_ASSERT( ov != NULL );
+    // io != 0 && agent && bytes saved
 
-    // This is when error occurs on perIoKey
+    K_ASSERT( c.io != 0 );
 
-    IoBlock* ab = (IoBlock*)(ov);
+    // This is when error occurs on agent
 
-    IoAgent* c = (IoAgent*)ab->extra;
-    K_ASSERT( c != 0 );
+    IoBlock* ab = c.io;
 
-    int errorCode = GetLastError();
+    IoAgent* agent = (IoAgent*)ab->extra;
+    K_ASSERT( agent != 0 );
 
-    if ( errorCode == 0 )
-    {
-        errorCode = WSAESHUTDOWN;
-    }
-
-    c->OnIoError( errorCode, ab );
+    agent->OnIoError( c.error, ab );
 }
 
 void
-IoWorker::handleRcNonZero( ulong bytes, 
-                                ulong perIoKey, 
-                                LPOVERLAPPED ov )
+IoWorker::handleRcNonZero( const IoPort::Completion& c )
 {
-    K_ASSERT( ov != 0 );  // Is this guaranteed? 
-
-    perIoKey;
+    K_ASSERT( c.io != 0 );  // Is this guaranteed? 
 
-    IoBlock* ab = (IoBlock*)ov;
+    IoBlock* ab = c.io;
     K_ASSERT( ab != 0 );
 
+    ulong bytes = c.bytes;
+
     ab->transferred = bytes;
 
     switch ( ab->op )
     {
     case IoBlock::OP_READ:
         {
-            IoAgent* c = (IoAgent*)ab->extra;
-            K_ASSERT( c != 0 );
+            IoAgent* agent = (IoAgent*)ab->extra;
+            K_ASSERT( agent != 0 );
 
             if ( bytes == 0 )
             {
                 if ( ab->buf.len != 0 ) // if not 0-recv
                 {
-                    c->OnIoError( WSAECONNRESET, ab );
+                    agent->OnIoError( IoPort::ERROR_CONNRESET, ab );
 
                     return;
                 }
             }
 
-            c->OnRecvCompleted( ab ); // ask for recv again 
+            agent->OnRecvCompleted( ab ); // ask for recv again 
         }
         break;
     case IoBlock::OP_WRITE:
         {
-            IoAgent* c = (IoAgent*)ab->extra;
-            K_ASSERT( c != 0 );
+            IoAgent* agent = (IoAgent*)ab->extra;
+            K_ASSERT( agent != 0 );
 
             if ( bytes == 0 ) 
             {
-                K_ASSERT( ab->buf.len > 0 );
+                K_ASSERT( ab->bufs != 0 || ab->buf.len > 0 );
                 K_ASSERT( ab->totalLen > 0 );
 
-                c->OnIoError( WSAECONNRESET, ab ); 
+                agent->OnIoError( IoPort::ERROR_CONNRESET, ab ); 
 
                 return;
             }
 
             if ( ab->totalLen > bytes )
             {
-                c->OnSendCompleted( ab, bytes );
+                agent->OnSendCompleted( ab, bytes );
             }
             else
             {
-                c->OnSendCompleted( ab ); // ask for send again if required
+                agent->OnSendCompleted( ab ); // ask for send again if required
             }
         }
         break;
@@ -203,9 +182,7 @@ IoWorker::helpStop()
     //
     // This is strange, but it is identified during unit test once. 
 
-    ::PostQueuedCompletionStatus( port_, 0, 0, 0 );
-    ::PostQueuedCompletionStatus( port_, 0, 0, 0 );
-    ::PostQueuedCompletionStatus( port_, 0, 0, 0 );
+    port_->Wake( 3 );
 }
 
 } // gk 
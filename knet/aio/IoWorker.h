@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <kcore/sys/Thread.h>
+#include <knet/aio/IoPort.h>
 
 namespace gk {
 /** 
@@ -16,9 +17,9 @@ public:
     /** 
      * Prepare for io and start thread
 	 *
-	 * @param port HANDLE to iocp port
+	 * @param port IoPort to wait completions on
      */
-    bool Init( HANDLE port );
+    bool Init( IoPort* port );
 
     /**
      * Thread function 
@@ -31,12 +32,12 @@ public:
     void Fini(); 
 
 private:
-    void handleRcZero( ulong bytes, ulong perIoKey, LPOVERLAPPED ov );
-    void handleRcNonZero( ulong bytes, ulong perIoKey, LPOVERLAPPED ov );
+    void handleRcZero( const IoPort::Completion& c );
+    void handleRcNonZero( const IoPort::Completion& c );
     void helpStop();
 
 private:
-    HANDLE port_;
+    IoPort* port_;
 };
 
 } // gk 
@@ -164,6 +164,12 @@ Cipher::Fini()
 
 bool 
 Cipher::Encrypt( BitStream& bs )
+{
+	return Encrypt( bs, 0 );
+}
+
+bool 
+Cipher::Encrypt( BitStream& bs, uint skip )
 {
 	K_ASSERT( IsEstablished() );
 
@@ -173,7 +179,9 @@ Cipher::Encrypt( BitStream& bs )
 	}
 
 	// ECB mode requires that the input buffer length is aligned to the block size
-    uint x = bs.GetBytePosition() % m_codec->GetBlockSize();
+	K_ASSERT( skip <= bs.GetBytePosition() );
+
+    uint x = ( bs.GetBytePosition() - skip ) % m_codec->GetBlockSize();
 
     if ( x )
     {
@@ -181,9 +189,9 @@ Cipher::Encrypt( BitStream& bs )
         bs.Write( (ushort)(m_codec->GetBlockSize() - x), padding );
     }
     
-    const byte* in      = bs.GetBuffer();
-    uint        inLen   = bs.GetBytePosition();
-    byte*       out     = bs.GetBuffer();
+    const byte* in      = bs.GetBuffer() + skip;
+    uint        inLen   = bs.GetBytePosition() - skip;
+    byte*       out     = bs.GetBuffer() + skip;
     uint        outLen  = inLen;
 
     try
@@ -246,7 +254,7 @@ Cipher::Decrypt( BitStream& bs, uint skip, uint len )
         return false;
 	}
 
-	K_ASSERT( skip <= len );
+	K_ASSERT( skip + len <= bs.GetSize() );
 
 	const byte* in      = (const byte*)( bs.GetBuffer() + skip );
     uint        inLen   = len;
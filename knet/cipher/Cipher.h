@@ -61,6 +61,7 @@ public:
 	 * @returns true if the decryption has been completed successful, false otherwise
 	 */
 	bool Encrypt( BitStream& bitStream );
+	bool Encrypt( BitStream& bitStream, uint skip ); ///< encrypt from skip offset to write position
 
 	/**
 	 * Decrypt a bit stream according to the given cipher context.
@@ -74,7 +75,7 @@ public:
 	 * @returns true if the decryption has been completed successful, false otherwise
 	 */
 	bool Decrypt( BitStream& bitStream );
-	bool Decrypt( BitStream& bitStream, uint skip, uint len );
+	bool Decrypt( BitStream& bitStream, uint skip, uint len ); ///< decrypt len bytes from skip offset
 
 	/**
 	 * Clean up
@@ -0,0 +1,321 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <knet/compress/Compressor.h>
+
+namespace gk {
+
+namespace
+{
+
+const uint HASH_BITS 	= 12;
+const uint HASH_SIZE 	= 1 << HASH_BITS;
+const uint SKIP_SHIFT 	= 6; 			// step up on misses in incompressible data
+const uint MAX_LENGTH 	= 1 << 24; 		// sanity limit of a decoded length
+
+byte 	s_dict[Compressor::MAX_DICT_LEN];
+uint 	s_dictLen;
+uint 	s_dictId;
+ushort 	s_dictTable[HASH_SIZE]; 		// dictionary positions by hash
+
+inline
+uint 
+read32( const byte* p )
+{
+	uint v;
+
+	::memcpy( &v, p, sizeof( v ) );
+
+	return v;
+}
+
+inline
+uint 
+hash( uint v )
+{
+	return ( v * 2654435761U ) >> ( 32 - HASH_BITS );
+}
+
+inline
+void 
+writeLength( byte*& op, uint len )
+{
+	while ( len >= 255 )
+	{
+		*op++ = 255;
+
+		len -= 255;
+	}
+
+	*op++ = (byte)len;
+}
+
+inline
+bool 
+readLength( const byte*& ip, const byte* iend, uint& len )
+{
+	uint b = 255;
+
+	while ( b == 255 )
+	{
+		K_RETURN_V_IF( ip >= iend || len > MAX_LENGTH, false );
+
+		b = *ip++;
+
+		len += b;
+	}
+
+	return true;
+}
+
+/**
+ * Space for a sequence with litLen literals and a match of mlen
+ */
+inline
+uint 
+sequenceBound( uint litLen, uint mlen )
+{
+	return 1 + litLen / 255 + 1 + litLen + 2 + mlen / 255 + 1;
+}
+
+} // anonymous
+
+void 
+Compressor::SetDictionary( const void* data, uint len )
+{
+	const byte* p = (const byte*)data;
+
+	if ( len > MAX_DICT_LEN )
+	{
+		p  += len - MAX_DICT_LEN;
+		len = MAX_DICT_LEN;
+	}
+
+	s_dictLen = ( p != 0 ) ? len : 0;
+	s_dictId  = 0;
+
+	::memset( s_dictTable, 0, sizeof( s_dictTable ) );
+
+	K_RETURN_IF( s_dictLen == 0 );
+
+	::memcpy( s_dict, p, s_dictLen );
+
+	// FNV-1a. 0 is kept for no dictionary.
+
+	uint h = 2166136261U;
+
+	for ( uint i = 0; i < s_dictLen; ++i )
+	{
+		h = ( h ^ s_dict[i] ) * 16777619U;
+	}
+
+	s_dictId = ( h != 0 ) ? h : 1;
+
+	for ( uint i = 0; i + MIN_MATCH <= s_dictLen; ++i )
+	{
+		s_dictTable[ hash( read32( s_dict + i ) ) ] = (ushort)i;
+	}
+}
+
+uint 
+Compressor::GetDictionaryId()
+{
+	return s_dictId;
+}
+
+uint 
+Compressor::GetBound( uint len )
+{
+	return len + len / 255 + 16;
+}
+
+uint 
+Compressor::Compress( const byte* src, uint len, byte* dst, uint cap, Mode mode )
+{
+	K_ASSERT( src != 0 );
+	K_ASSERT( dst != 0 );
+	K_ASSERT( mode != MODE_NONE );
+
+	// positions are in one space of the dictionary followed by src
+
+	const uint dictLen = ( mode == MODE_DICT ) ? s_dictLen : 0;
+
+	K_RETURN_V_IF( len > MAX_OFFSET - dictLen, 0 );
+
+	ushort table[HASH_SIZE];
+
+	if ( dictLen > 0 )
+	{
+		::memcpy( table, s_dictTable, sizeof( table ) );
+	}
+	else
+	{
+		::memset( table, 0, sizeof( table ) );
+	}
+
+	const byte* ip 		= src;
+	const byte* anchor 	= src;
+	const byte* iend 	= src + len;
+	byte* 		op 		= dst;
+	byte* 		oend 	= dst + cap;
+
+	while ( len >= MIN_MATCH && ip <= iend - MIN_MATCH )
+	{
+		uint seq  = read32( ip );
+		uint h 	  = hash( seq );
+		uint cur  = dictLen + (uint)( ip - src );
+		uint cand = table[h];
+
+		table[h] = (ushort)cur;
+
+		const byte* cp 	   = 0;
+		const byte* climit = 0;
+
+		if ( cand < dictLen )
+		{
+			cp 	   = s_dict + cand;
+			climit = s_dict + dictLen; 		// matches do not cross into src
+		}
+		else if ( cand < cur )
+		{
+			cp 	   = src + ( cand - dictLen );
+			climit = iend;
+		}
+
+		if ( cp == 0 || cp + MIN_MATCH > climit || read32( cp ) != seq )
+		{
+			ip += 1 + ( ( ip - anchor ) >> SKIP_SHIFT );
+
+			continue;
+		}
+
+		uint mlen = MIN_MATCH;
+
+		while ( ip + mlen < iend && cp + mlen < climit && ip[mlen] == cp[mlen] )
+		{
+			++mlen;
+		}
+
+		uint litLen = (uint)( ip - anchor );
+
+		K_RETURN_V_IF( (uint)( oend - op ) < sequenceBound( litLen, mlen ), 0 );
+
+		uint offset = cur - cand;
+		uint ml 	= mlen - MIN_MATCH;
+		byte* token = op++;
+
+		*token = (byte)( ( ( litLen < 15 ? litLen : 15 ) << 4 ) | ( ml < 15 ? ml : 15 ) );
+
+		if ( litLen >= 15 )
+		{
+			writeLength( op, litLen - 15 );
+		}
+
+		::memcpy( op, anchor, litLen );
+
+		op += litLen;
+
+		*op++ = (byte)( offset & 0xFF );
+		*op++ = (byte)( offset >> 8 );
+
+		if ( ml >= 15 )
+		{
+			writeLength( op, ml - 15 );
+		}
+
+		ip 	  += mlen;
+		anchor = ip;
+	}
+
+	uint litLen = (uint)( iend - anchor );
+
+	if ( litLen > 0 )
+	{
+		K_RETURN_V_IF( (uint)( oend - op ) < sequenceBound( litLen, 0 ), 0 );
+
+		*op++ = (byte)( ( litLen < 15 ? litLen : 15 ) << 4 );
+
+		if ( litLen >= 15 )
+		{
+			writeLength( op, litLen - 15 );
+		}
+
+		::memcpy( op, anchor, litLen );
+
+		op += litLen;
+	}
+
+	return (uint)( op - dst );
+}
+
+int 
+Compressor::Decompress( const byte* src, uint len, byte* dst, uint cap, Mode mode )
+{
+	K_ASSERT( src != 0 );
+	K_ASSERT( dst != 0 );
+	K_ASSERT( mode != MODE_NONE );
+
+	const uint dictLen = ( mode == MODE_DICT ) ? s_dictLen : 0;
+
+	const byte* ip 	 = src;
+	const byte* iend = src + len;
+	byte* 		op 	 = dst;
+	byte* 		oend = dst + cap;
+
+	while ( ip < iend && op < oend )
+	{
+		uint token 	= *ip++;
+		uint litLen = token >> 4;
+
+		if ( litLen == 15 )
+		{
+			K_RETURN_V_IF( !readLength( ip, iend, litLen ), -1 );
+		}
+
+		K_RETURN_V_IF( (uint)( iend - ip ) < litLen, -1 );
+		K_RETURN_V_IF( (uint)( oend - op ) < litLen, -1 );
+
+		::memcpy( op, ip, litLen );
+
+		op += litLen;
+		ip += litLen;
+
+		if ( ip >= iend || op >= oend )
+		{
+			break; // the last sequence or padding after it
+		}
+
+		K_RETURN_V_IF( iend - ip < 2, -1 );
+
+		uint offset = ip[0] | ( ip[1] << 8 );
+
+		ip += 2;
+
+		uint mlen = token & 0x0F;
+
+		if ( mlen == 15 )
+		{
+			K_RETURN_V_IF( !readLength( ip, iend, mlen ), -1 );
+		}
+
+		mlen += MIN_MATCH;
+
+		uint pos = (uint)( op - dst );
+
+		K_RETURN_V_IF( offset == 0 || offset > dictLen + pos, -1 );
+		K_RETURN_V_IF( (uint)( oend - op ) < mlen, -1 );
+
+		// byte by byte. a match can overlap itself or start in the dictionary.
+
+		uint u = dictLen + pos - offset;
+
+		for ( uint i = 0; i < mlen; ++i, ++u )
+		{
+			*op++ = ( u < dictLen ) ? s_dict[u] : dst[u - dictLen];
+		}
+	}
+
+	return (int)( op - dst );
+}
+
+} // gk
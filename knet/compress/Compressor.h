@@ -0,0 +1,90 @@
+#pragma once 
+
+namespace gk 
+{
+
+/**
+ * @class Compressor
+ *
+ * @brief Fast LZ77 block compression for TCP frames.
+ *
+ * Block format is a list of sequences in the style of LZ4. 
+ *   TOKEN{8} [LITLEN] LITERALS [OFFSET{16} [MATCHLEN]]
+ * High nibble of the token is the literal length and low nibble is the 
+ * match length minus MIN_MATCH. 15 continues with bytes of 255 until a 
+ * smaller byte. The last sequence has literals only.
+ *
+ * Matches are found with a single hash probe and no entropy coding. 
+ * So compression runs at memory speed and decompression is a copy loop.
+ *
+ * MODE_DICT uses a dictionary shared by both sides as the window before 
+ * the input. Small repetitive messages compress well with a dictionary 
+ * built from typical messages. Peers agree on it by GetDictionaryId().
+ */
+class Compressor
+{
+public:
+	enum Mode
+	{
+		  MODE_NONE = 0
+		, MODE_FAST 	// no dictionary
+		, MODE_DICT 	// pre-shared dictionary
+	};
+
+	enum 
+	{
+		  MIN_MATCH 	= 4
+		, MAX_OFFSET 	= 65535
+		, MAX_DICT_LEN 	= 32768
+	};
+
+public:
+	/**
+	 * Set the dictionary for MODE_DICT. Not thread safe. 
+	 * Call before any connection is created. The last MAX_DICT_LEN bytes 
+	 * are used when longer.
+	 *
+	 * @param data Bytes of typical messages
+	 * @param len The length of data. 0 to clear.
+	 */
+	static void SetDictionary( const void* data, uint len );
+
+	/**
+	 * Get the id of the dictionary
+	 *
+	 * @return A hash of the dictionary. 0 if not set.
+	 */
+	static uint GetDictionaryId();
+
+	/**
+	 * Get the max compressed length of len bytes
+	 */
+	static uint GetBound( uint len );
+
+	/**
+	 * Compress a block
+	 *
+	 * @param src The bytes to compress
+	 * @param len The length of src
+	 * @param dst The output
+	 * @param cap The capacity of dst
+	 * @param mode MODE_FAST or MODE_DICT
+	 * @return The compressed length. 0 if dst is too small.
+	 */
+	static uint Compress( const byte* src, uint len, byte* dst, uint cap, Mode mode );
+
+	/**
+	 * Decompress a block. Input is not trusted.
+	 * Stops when cap bytes are written. So trailing padding is ignored.
+	 *
+	 * @param src The compressed bytes
+	 * @param len The length of src
+	 * @param dst The output
+	 * @param cap The capacity of dst
+	 * @param mode MODE_FAST or MODE_DICT
+	 * @return The decompressed length. -1 if src is corrupted.
+	 */
+	static int Decompress( const byte* src, uint len, byte* dst, uint cap, Mode mode );
+};
+
+} // gk
@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <knet/message/Message.h>
+#include <knet/message/MessageSchema.h>
 #include <knet/message/MessageSerialization.h>
 #include <knet/message/net/NetMessageTypes.h>
 
@@ -17,23 +18,9 @@ struct NmGroupDestroy : public Message
 {
 	uint 		groupId;
 
-	bool Pack( BitStream& bs )
-	{
-		Message::Pack( bs );
-
-		bs.Write( groupId );
-
-		return bs.IsValid();
-	}
-
-	bool Unpack( BitStream& bs )
-	{
-		Message::Unpack( bs );
-
-		bs.Read( groupId );
-
-		return bs.IsValid();
-	}
+	K_SCHEMA_BEGIN( Message )
+		K_FIELD( groupId, SchemaUInt<32> )
+	K_SCHEMA_END()
 
 	Message* Create() 
 	{
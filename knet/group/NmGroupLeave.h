@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <knet/message/Message.h>
+#include <knet/message/MessageSchema.h>
 #include <knet/message/MessageSerialization.h>
 #include <knet/message/net/NetMessageTypes.h>
 
@@ -16,25 +17,10 @@ struct NmGroupLeave : public Message
 	uint groupId;
 	uint connectionId; // UDP connection to send
 
-	bool Pack( BitStream& bs )
-	{
-		Message::Pack( bs );
-
-		bs.Write( groupId );
-		bs.Write( connectionId );
-
-		return bs.IsValid();
-	}
-
-	bool Unpack( BitStream& bs )
-	{
-		Message::Unpack( bs );
-
-		bs.Read( groupId );
-		bs.Read( connectionId );
-
-		return bs.IsValid();
-	}
+	K_SCHEMA_BEGIN( Message )
+		K_FIELD( groupId, 		SchemaUInt<32> )
+		K_FIELD( connectionId, 	SchemaUInt<32> )
+	K_SCHEMA_END()
 
 	Message* Create() 
 	{
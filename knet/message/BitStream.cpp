@@ -33,6 +33,21 @@ BitStream::Accumulate( byte* v, uint len )
 	return true;
 }
 
+bool
+BitStream::ReserveWrite( uint len )
+{
+	K_ASSERT( (m_posBit & 0x7) == 0 );
+
+	uint bitCount = len << 3;
+
+	if ( (bitCount + m_posBit) > m_maxWriteBits )
+	{
+      	return resizeBits( bitCount + m_posBit - m_maxWriteBits );
+   	}
+
+	return true;
+}
+
 bool 
 BitStream::WriteBits( uint bitCount, const void *bitPtr )
 {
@@ -49,77 +64,45 @@ BitStream::WriteBits( uint bitCount, const void *bitPtr )
 	  	}
    	}
 
-   	uint upShift  	= m_posBit & 0x7;
-   	uint downShift 	= 8 - upShift;
+	const byte* src = (const byte*)bitPtr;
+	byte* dst 		= GetBuffer() + (m_posBit >> 3);
+	uint shift 		= m_posBit & 0x7;
+	uint room 		= getRoom();
 
-   	const byte *sourcePtr = (byte *) bitPtr;
-   	byte *destPtr = GetBuffer() + (m_posBit >> 3);
-
-   	// if this write is for <= 1 byte, and it will all fit in the
-   	// first dest byte, then do some special masking.
-   	if ( downShift >= bitCount )
-   	{
-      	byte mask = (byte)( ( ((1 << bitCount) - 1) << upShift ) & 0xFF );
-      	*destPtr = (*destPtr & ~mask) | ((*sourcePtr << upShift) & mask);
-      	m_posBit += bitCount;
+	m_posBit += bitCount;
 
-      	return true;
-   	}
+	// byte aligned writes are copied in bulk
+	if ( !shift )
+	{
+		uint len = bitCount >> 3;
 
-   	// check for byte aligned writes -- this will be
-   	// much faster than the shifting writes.
-   	if ( !upShift ) 
-   	{
-      	m_posBit += bitCount;
+		::memcpy( dst, src, len );
 
-      	for( ; bitCount >= 8; bitCount -= 8 )
+		if ( bitCount & 0x7 )
 		{
-         	*destPtr++ = *sourcePtr++;
+			putWord( dst + len, room - len, src[len], 0, bitCount & 0x7 );
 		}
 
-      	if ( bitCount )
-      	{
-         	byte mask = (1 << bitCount) - 1;
-         	*destPtr = (*sourcePtr & mask) | (*destPtr & ~mask);
-      	}
-
-      	return true;
-   	}
-
-   	// the write destination is not byte aligned.
-   	byte sourceByte;
-   	byte destByte = *destPtr & (0xFF >> downShift);
-   	byte lastMask = 0xFF >> (7 - ((m_posBit + bitCount - 1) & 0x7));
-
-   	m_posBit += bitCount;
-
-   	for( ; bitCount >= 8; bitCount -= 8 )
-   	{
-      	sourceByte = *sourcePtr++;
-      	*destPtr++ = destByte | (sourceByte << upShift);
-      	destByte = sourceByte >> downShift;
-   	}
-
-   	if ( bitCount == 0 )
-   	{
-      	*destPtr = (*destPtr & ~lastMask) | (destByte & lastMask);
+		return true;
+	}
 
-      	return true;
-   	}
+	// 7 bytes a step. shift stays same and shift + 56 fits in a word.
+	while ( bitCount > 0 )
+	{
+		uint bits = bitCount < 56 ? bitCount : 56;
+		uint8 v   = 0;
 
-   	if ( bitCount <= downShift )
-   	{
-      	*destPtr = (*destPtr & ~lastMask) | ((destByte | 
-				   (*sourcePtr << upShift)) & lastMask);
+		::memcpy( &v, src, ( bits + 7 ) >> 3 );
 
-      	return true;
-   	}
+		putWord( dst, room, v, shift, bits );
 
-   	sourceByte = *sourcePtr;
-   	*destPtr++ = destByte | (sourceByte << upShift);
-   	*destPtr   = (*destPtr & ~lastMask) | ((sourceByte >> downShift) & lastMask);
+		src 		+= 7;
+		dst 		+= 7;
+		room 		 = room > 7 ? room - 7 : 0;
+		bitCount 	-= bits;
+	}
 
-   	return true;
+	return true;
 }
 
 bool 
@@ -136,44 +119,231 @@ BitStream::ReadBits( uint bitCount, void *bitPtr )
       	return false;
    	}
 
-   	byte *sourcePtr = GetBuffer() + (m_posBit >> 3);
-   	uint byteCount  = (bitCount + 7) >> 3;
+	const byte* src = GetBuffer() + (m_posBit >> 3);
+	byte* dst 		= (byte*)bitPtr;
+	uint shift 		= m_posBit & 0x7;
+	uint room 		= getRoom();
 
-   	byte *destPtr  = (byte *) bitPtr;
-   	uint downShift = m_posBit & 0x7;
-   	uint upShift   = 8 - downShift;
+	m_posBit += bitCount;
 
-   	if ( !downShift )
-   	{
-      	while ( byteCount--)
-        	*destPtr++ = *sourcePtr++;
+	if ( !shift )
+	{
+		::memcpy( dst, src, ( bitCount + 7 ) >> 3 );
 
-      	m_posBit += bitCount;
-      	return true;
-   	}
+		return true;
+	}
 
-   	byte sourceByte = *sourcePtr >> downShift;
-   	m_posBit       += bitCount;
+	while ( bitCount > 0 )
+	{
+		uint bits = bitCount < 56 ? bitCount : 56;
+		uint8 v   = getWord( src, room, shift, bits );
 
-   	for ( ; bitCount >= 8; bitCount -= 8 )
-   	{
-      	byte nextByte = *++sourcePtr;
-     	*destPtr++ = sourceByte | (nextByte << upShift);
-      	sourceByte = nextByte >> downShift;
-   	}
+		::memcpy( dst, &v, ( bits + 7 ) >> 3 );
 
-   	if ( bitCount )
-   	{
-      	if ( bitCount <= upShift )
-      	{
-         	*destPtr = sourceByte;
-         	return true;
-      	}
+		src 		+= 7;
+		dst 		+= 7;
+		room 		 = room > 7 ? room - 7 : 0;
+		bitCount 	-= bits;
+	}
 
-      	*destPtr = sourceByte | ( (*++sourcePtr) << upShift);
-  	}
+	return true;
+}
 
-   	return true;
+void 
+BitStream::WriteVarInt( uint value, byte groupBits )
+{
+	K_ASSERT( groupBits > 0 && groupBits < 32 );
+
+	uint mask = ( 1u << groupBits ) - 1;
+
+	while ( value > mask )
+	{
+		WriteInt( ( value & mask ) | ( 1u << groupBits ), groupBits + 1 );
+
+		value >>= groupBits;
+	}
+
+	WriteInt( value, groupBits + 1 );
+}
+
+void 
+BitStream::ReadVarInt( uint& value, byte groupBits )
+{
+	K_ASSERT( groupBits > 0 && groupBits < 32 );
+
+	uint mask = ( 1u << groupBits ) - 1;
+	uint v 	  = 0;
+
+	for ( uint shift = 0; shift < 32; shift += groupBits )
+	{
+		uint group = 0;
+
+		ReadInt( group, groupBits + 1 );
+
+		K_RETURN_IF( m_error );
+
+		// the last group can carry bits past 32. corrupted.
+
+		if ( shift + groupBits > 32 && ( ( group & mask ) >> ( 32 - shift ) ) != 0 )
+		{
+			m_error = true;
+
+			return;
+		}
+
+		v |= ( group & mask ) << shift;
+
+		if ( ( group >> groupBits ) == 0 )
+		{
+			value = v;
+
+			return;
+		}
+	}
+
+	// more groups than 32 bits. corrupted.
+
+	m_error = true;
+}
+
+uint 
+BitStream::GetVarIntBits( uint value, byte groupBits )
+{
+	K_ASSERT( groupBits > 0 && groupBits < 32 );
+
+	uint mask = ( 1u << groupBits ) - 1;
+	uint bits = groupBits + 1;
+
+	while ( value > mask )
+	{
+		value >>= groupBits;
+		bits  += groupBits + 1;
+	}
+
+	return bits;
+}
+
+void 
+BitStream::WriteRangedFloat( float f, float minValue, float maxValue, byte bitCount )
+{
+	K_ASSERT( maxValue > minValue );
+	K_ASSERT( bitCount > 0 && bitCount <= 32 );
+
+	double steps = (double)( ( (uint8)1 << bitCount ) - 1 );
+	double t 	 = ( (double)f - minValue ) / ( (double)maxValue - minValue );
+
+	t = t < 0.0 ? 0.0 : ( t > 1.0 ? 1.0 : t );
+
+	WriteInt( (uint)( t * steps + 0.5 ), bitCount );
+}
+
+void 
+BitStream::ReadRangedFloat( float& f, float minValue, float maxValue, byte bitCount )
+{
+	K_ASSERT( maxValue > minValue );
+	K_ASSERT( bitCount > 0 && bitCount <= 32 );
+
+	double steps = (double)( ( (uint8)1 << bitCount ) - 1 );
+	uint v 		 = 0;
+
+	ReadInt( v, bitCount );
+
+	f = (float)( minValue + ( (double)maxValue - minValue ) * ( v / steps ) );
+}
+
+void 
+BitStream::WriteNormal( const float* n, byte bitCount )
+{
+	K_ASSERT( n != 0 );
+
+	const double PI = 3.14159265358979323846;
+
+	double phi 	 = ::atan2( (double)n[0], (double)n[1] );
+	double theta = ::atan2( (double)n[2], ::sqrt( (double)n[0] * n[0] + (double)n[1] * n[1] ) );
+
+	WriteSignedFloat( (float)( phi / PI ), bitCount + 1 );
+	WriteSignedFloat( (float)( theta / ( PI / 2 ) ), bitCount );
+}
+
+void 
+BitStream::ReadNormal( float* n, byte bitCount )
+{
+	K_ASSERT( n != 0 );
+
+	const double PI = 3.14159265358979323846;
+
+	float phi 	= 0.0f;
+	float theta = 0.0f;
+
+	ReadSignedFloat( phi, bitCount + 1 );
+	ReadSignedFloat( theta, bitCount );
+
+	double p = phi * PI;
+	double t = theta * ( PI / 2 );
+
+	n[0] = (float)( ::sin( p ) * ::cos( t ) );
+	n[1] = (float)( ::cos( p ) * ::cos( t ) );
+	n[2] = (float)::sin( t );
+}
+
+void 
+BitStream::WriteQuaternion( const float* q, byte bitCount )
+{
+	K_ASSERT( q != 0 );
+
+	// the other components are within +-1/sqrt(2) of a unit quaternion
+
+	const float RANGE = 0.70710678f;
+
+	uint largest = 0;
+
+	for ( uint i = 1; i < 4; ++i )
+	{
+		if ( ::fabs( q[i] ) > ::fabs( q[largest] ) )
+		{
+			largest = i;
+		}
+	}
+
+	// q and -q are the same rotation. the largest is sent as positive.
+
+	float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+	WriteInt( largest, 2 );
+
+	for ( uint i = 0; i < 4; ++i )
+	{
+		if ( i != largest )
+		{
+			WriteRangedFloat( q[i] * sign, -RANGE, RANGE, bitCount );
+		}
+	}
+}
+
+void 
+BitStream::ReadQuaternion( float* q, byte bitCount )
+{
+	K_ASSERT( q != 0 );
+
+	const float RANGE = 0.70710678f;
+
+	uint largest = 0;
+
+	ReadInt( largest, 2 );
+
+	double sum = 0.0;
+
+	for ( uint i = 0; i < 4; ++i )
+	{
+		if ( i != largest )
+		{
+			ReadRangedFloat( q[i], -RANGE, RANGE, bitCount );
+
+			sum += (double)q[i] * q[i];
+		}
+	}
+
+	q[largest] = (float)::sqrt( sum < 1.0 ? 1.0 - sum : 0.0 );
 }
 
 bool 
@@ -8,6 +8,13 @@ namespace gk {
  * @class BitStream
  *
  * BitStream to save bandwidth without much CPU overhead
+ *
+ * Bits are moved a 64 bit word at a time. An integer is merged into the 
+ * buffer with one load and store when 8 bytes are there. Longer bit runs 
+ * go 56 bits per step and byte aligned runs are copied with memcpy. 
+ * The buffer is always up to date so GetBuffer() can be used any time.
+ * 
+ * Word access assumes a little endian CPU.
  */
 class BitStream : public Buffer
 {
@@ -125,6 +132,16 @@ public:
 	 */
 	bool Accumulate( byte* v, uint len );
 
+	/**
+	 * Make room for len bytes at the byte aligned write position. 
+	 * Use with GetBytePtr() to write into the buffer directly 
+	 * and AdvanceBitPosition() to commit.
+	 *
+	 * @param len The bytes to write
+	 * @return false if the buffer cannot grow
+	 */
+	bool ReserveWrite( uint len );
+
 	/**
 	 * Writes an unsigned integer value between 0 and 2^(bitCount - 1) into the stream.
 	 *
@@ -193,6 +210,75 @@ public:
 	void WriteSignedFloat( float f, byte bitCount );
 	void ReadSignedFloat( float& f, byte bitCount );
 
+	/**
+	 * Writes/Reads an unsigned integer in groups of groupBits bits.
+	 * Each group is followed by a flag set when more groups follow.
+	 * groupBits 7 is LEB128 when byte aligned. Small values take few bits.
+	 *
+	 * @param value The value to write
+	 * @param groupBits The number of value bits in a group
+	 */
+	void WriteVarInt( uint value, byte groupBits = 7 );
+	void ReadVarInt( uint& value, byte groupBits = 7 );
+
+	/**
+	 * Writes/Reads a signed integer as a zigzag mapped var int.
+	 * Values near 0 of both signs take few bits.
+	 *
+	 * @param value The value to write
+	 * @param groupBits The number of value bits in a group
+	 */
+	void WriteVarSignedInt( int value, byte groupBits = 7 );
+	void ReadVarSignedInt( int& value, byte groupBits = 7 );
+
+	/**
+	 * Writes/Reads a float in [minValue, maxValue] quantized to bitCount bits.
+	 * Values out of the range are clamped.
+	 *
+	 * @param f The value to write
+	 * @param minValue The minimum value
+	 * @param maxValue The maximum value
+	 * @param bitCount The number of bits to use for the value
+	 */
+	void WriteRangedFloat( float f, float minValue, float maxValue, byte bitCount );
+	void ReadRangedFloat( float& f, float minValue, float maxValue, byte bitCount );
+
+	/**
+	 * Writes/Reads a unit vector of 3 floats as two angles.
+	 * Uses bitCount * 2 + 1 bits.
+	 *
+	 * @param n The unit vector x, y, z
+	 * @param bitCount The number of bits to use for the latitude
+	 */
+	void WriteNormal( const float* n, byte bitCount );
+	void ReadNormal( float* n, byte bitCount );
+
+	/**
+	 * Writes/Reads a unit quaternion with the smallest three components.
+	 * The index of the largest one is sent in 2 bits and it is restored 
+	 * from the unit length. Uses 2 + bitCount * 3 bits.
+	 *
+	 * @param q The quaternion of 4 floats. Read in the same order.
+	 * @param bitCount The number of bits to use for each component
+	 */
+	void WriteQuaternion( const float* q, byte bitCount );
+	void ReadQuaternion( float* q, byte bitCount );
+
+	/**
+	 * Get bits of a var int
+	 *
+	 * @param value The value to write
+	 * @param groupBits The number of value bits in a group
+	 * @return The number of bits WriteVarInt uses
+	 */
+	static uint GetVarIntBits( uint value, byte groupBits = 7 );
+
+	/**
+	 * Zigzag mapping. 0, -1, 1, -2 ... to 0, 1, 2, 3 ...
+	 */
+	static uint ZigZag( int value );
+	static int UnZigZag( uint value );
+
 	/**
 	 * Writes/Reads bitCount bits into/from the stream from bitPtr.
 	 */
@@ -277,6 +363,22 @@ private:
 	 */
 	bool resizeBits( uint numBitsNeeded );
 
+	/**
+	 * Bytes from the current position to the end of the buffer
+	 */
+	uint getRoom() const;
+
+	/**
+	 * Merge bits of v into dst from shift. shift + bits <= 64.
+	 * One word load and store if room is 8 bytes or more.
+	 */
+	static void putWord( byte* dst, uint room, uint8 v, uint shift, uint bits );
+
+	/**
+	 * Get bits from src after shift. shift + bits <= 64.
+	 */
+	static uint8 getWord( const byte* src, uint room, uint shift, uint bits );
+
 private:
    	uint m_posBit;            // The current bit position for reading/writing 
    	bool m_error;             // Flag set if overflow, or underflow
@@ -418,8 +520,16 @@ void
 BitStream::WriteInt( uint value, byte bitCount )
 {
 	K_ASSERT( bitCount > 0 );
+	K_ASSERT( bitCount <= 32 );
+
+	if ( bitCount + m_posBit > m_maxWriteBits )
+	{
+		K_RETURN_IF( !resizeBits( bitCount + m_posBit - m_maxWriteBits ) );
+	}
 
-   	WriteBits( bitCount, &value );
+	putWord( GetBuffer() + ( m_posBit >> 3 ), getRoom(), value, m_posBit & 0x7, bitCount );
+
+	m_posBit += bitCount;
 }
 
 inline
@@ -427,14 +537,19 @@ void
 BitStream::ReadInt( uint& value, byte bitCount )
 {
 	K_ASSERT( bitCount > 0 );
+	K_ASSERT( bitCount <= 32 );
 
-   	ReadBits( bitCount, &value );
-
-   	if ( bitCount != 32 )
+	if ( bitCount + m_posBit > m_maxReadBits )
 	{
-		// clear the unrequired bits
-      	value &= (1 << bitCount) - 1;
+		m_error = true;
+
+		return;
 	}
+
+	value = (uint)getWord( GetBuffer() + ( m_posBit >> 3 ), getRoom(), 
+						   m_posBit & 0x7, bitCount );
+
+	m_posBit += bitCount;
 }
 
 inline
@@ -534,6 +649,38 @@ BitStream::ReadSignedFloat( float& f, byte bitCount )
 	f = v/ float( (1 << (bitCount - 1)) - 1 );
 }
 
+inline
+void 
+BitStream::WriteVarSignedInt( int value, byte groupBits )
+{
+	WriteVarInt( ZigZag( value ), groupBits );
+}
+
+inline
+void 
+BitStream::ReadVarSignedInt( int& value, byte groupBits )
+{
+	uint v = 0;
+
+	ReadVarInt( v, groupBits );
+
+	value = UnZigZag( v );
+}
+
+inline
+uint 
+BitStream::ZigZag( int value )
+{
+	return ( (uint)value << 1 ) ^ (uint)( value >> 31 );
+}
+
+inline
+int 
+BitStream::UnZigZag( uint value )
+{
+	return (int)( value >> 1 ) ^ -(int)( value & 1 );
+}
+
 inline
 bool 
 BitStream::Write( bool value ) 
@@ -666,4 +813,69 @@ BitStream::IsValid() const
 	return !m_error; 
 }
 
+inline
+uint 
+BitStream::getRoom() const
+{
+	uint pos = m_posBit >> 3;
+
+	return GetCapacity() > pos ? GetCapacity() - pos : 0;
+}
+
+inline
+void 
+BitStream::putWord( byte* dst, uint room, uint8 v, uint shift, uint bits )
+{
+	uint8 mask = ( ( (uint8)1 << bits ) - 1 ) << shift;
+
+	v = ( v << shift ) & mask;
+
+	if ( room >= 8 )
+	{
+		uint8 w;
+
+		::memcpy( &w, dst, 8 );
+
+		w = ( w & ~mask ) | v;
+
+		::memcpy( dst, &w, 8 );
+
+		return;
+	}
+
+	// near the end of buffer. just the bytes touched.
+
+	uint len = ( shift + bits + 7 ) >> 3;
+
+	for ( uint i = 0; i < len; ++i )
+	{
+		byte m = (byte)( mask >> ( i << 3 ) );
+
+		dst[i] = (byte)( ( dst[i] & ~m ) | (byte)( v >> ( i << 3 ) ) );
+	}
+}
+
+inline
+uint8 
+BitStream::getWord( const byte* src, uint room, uint shift, uint bits )
+{
+	uint8 w = 0;
+
+	if ( room >= 8 )
+	{
+		::memcpy( &w, src, 8 );
+	}
+	else
+	{
+		uint len = ( shift + bits + 7 ) >> 3;
+
+		for ( uint i = 0; i < len; ++i )
+		{
+			w |= (uint8)src[i] << ( i << 3 );
+		}
+	}
+
+	return ( w >> shift ) & ( ( (uint8)1 << bits ) - 1 );
+}
+
 } // gk 
@@ -3,12 +3,16 @@
 #include <kcore/corebase.h>
 #include <knet/message/Message.h>	
 
+#include <knet/message/MessagePool.h>
+
 namespace gk {
 
 Message::Message()
 : type( 0 ) // 0 is invalid type
 , remote( 0 )
 , remotes()
+, sendFlags( 0 )
+, collapseKey( 0 )
 {
 	contextKey.clear();
 }
@@ -48,4 +52,16 @@ Message::Create()
 	return (Message*)0; // invalid
 }
 
+void* 
+Message::operator new( size_t size )
+{
+	return MessagePool::Allocate( size );
+}
+
+void 
+Message::operator delete( void* p )
+{
+	MessagePool::Deallocate( p );
+}
+
 } // gk
@@ -1,7 +1,8 @@
 #pragma once 
 
 #include <kcore/mem/AllocatorAware.h>
-#include <kcore/sys/SharedPointer.h>
+#include <kcore/sys/IntrusivePointer.h>
+#include <kcore/sys/RefCounted.h>
 #include <kcore/sys/Queue.h>
 #include <knet/message/BitStream.h>
 #include <knet/message/ContextKey.h>
@@ -21,7 +22,7 @@ namespace gk
  * [2] Write Pack/Unpack
  * [3] Register the class to MessageFactory if it is received
  */
-struct Message : public AllocatorAware
+struct Message : public AllocatorAware, public RefCounted
 {
 	enum 
 	{
@@ -36,12 +37,19 @@ struct Message : public AllocatorAware
 		, LOSSY    = 3 			// udp lossy send option
 	};
 
+	enum SendFlag
+	{
+		  DROPPABLE = 1 		// tcp send can drop it when the send queue is full
+	};
+
 	typedef std::vector<uint> RemoteList;
 
 	ushort 		type; 			// Message type
 	uint 		remote; 		// Has different meaning, usually connection id	
 	RemoteList 	remotes; 		// Only used when sending message to several connections
 	tstring 	contextKey; 	// context key for context based dispatching.   
+	ushort 		sendFlags; 		// SendFlag bits. not packed
+	uint 		collapseKey; 	// queued tcp message of same type and key can be replaced. 0 for none
 
 	Message();
 	virtual ~Message();
@@ -66,9 +74,22 @@ struct Message : public AllocatorAware
 	 * @return heap allocated and default constructed message
 	 */
 	virtual Message* Create();
+
+	/**
+	 * Class-wide new. Takes a block from the pool of the type 
+	 * when created by MessageFactory. See MessagePool.
+	 */
+	static void* operator new( size_t size );
+
+	/**
+	 * Class-wide delete. Returns a pooled block to its pool.
+	 */
+	static void operator delete( void* p );
 };
 
-typedef SharedPointer<Message> MessagePtr;
+typedef IntrusivePointer<Message> MessagePtr; ///< count is in Message. one allocation per message.
 typedef Queue<MessagePtr, Mutex> MessageQ;
+typedef Queue<MessagePtr, LockFree> LockFreeMessageQ; ///< single consumer only
+
 
 } // gk 
@@ -3,6 +3,8 @@
 #include <kcore/corebase.h>
 #include <knet/message/MessageFactory.h>
 
+#include <kcore/sys/Logger.h>
+
 namespace gk {
 
 MessageFactory*
@@ -13,7 +15,10 @@ MessageFactory::Instance()
 }
 
 MessageFactory::MessageFactory()
+: m_retired()
+, m_frozen( false )
 {
+	::memset( m_entries, 0, sizeof( m_entries ) );
 }
 
 MessageFactory::~MessageFactory()
@@ -24,49 +29,110 @@ MessageFactory::~MessageFactory()
 void
 MessageFactory::Register( Message* prototype )
 {
+	K_ASSERT( prototype != 0 );
+	K_ASSERT( prototype->type > 0 );
+
 	ScopedLock sl( m_lock );
 
-	MessageMap::iterator itr( m_messages.find( prototype->type ) );
+	if ( m_frozen )
+	{
+		LOG( FT_ERROR, 
+			 _T("MessageFactory::Register> Frozen. Type %d refused"), 
+			 prototype->type );
+
+		delete prototype;
+
+		return;
+	}
+
+	Entry& e = m_entries[prototype->type];
+
+	K_RETURN_IF( e.prototype == prototype );
 
-	if( itr != m_messages.end() )
+	if ( e.prototype != 0 )
 	{
-		delete itr->second;
+		m_retired.push_back( e.prototype );
+	}
 
-		m_messages.erase( itr );
+	e.prototype = prototype; // volatile write is release on msvc
+}
+
+void 
+MessageFactory::SetPool( ushort type, uint capacity )
+{
+	K_ASSERT( type > 0 );
+
+	ScopedLock sl( m_lock );
+
+	if ( m_frozen )
+	{
+		LOG( FT_ERROR, 
+			 _T("MessageFactory::SetPool> Frozen. Type %d refused"), 
+			 type );
+
+		return;
 	}
 
-	m_messages.insert( MessageMap::value_type( prototype->type, prototype ) );
+	Entry& e = m_entries[type];
+
+	K_RETURN_IF( e.pool != 0 ); // blocks can point to it. kept once set.
+
+	e.pool = new MessagePool( capacity );
+}
+
+void 
+MessageFactory::Freeze()
+{
+	ScopedLock sl( m_lock );
+
+	m_frozen = true;
 }
 
 MessagePtr
 MessageFactory::Create( int type )
 {
-	ScopedLock sl( m_lock );
+	K_RETURN_V_IF( type <= 0 || type >= TYPE_COUNT, MessagePtr() );
 
-	MessageMap::iterator itr( m_messages.find( type ) );
+	const Entry& e = m_entries[type];
 
-	if( itr == m_messages.end() )
-	{
-		return MessagePtr();
-	}
+	Message* prototype = e.prototype; // volatile read is acquire on msvc
+
+	K_RETURN_V_IF( prototype == 0, MessagePtr() );
 
-	Message* m = itr->second;
-	K_ASSERT( m != NULL );
+	MessagePool::SetHint( e.pool );
 
-	return MessagePtr( m->Create() );
+	Message* m = prototype->Create();
+
+	MessagePool::SetHint( 0 );
+
+	return MessagePtr( m );
 }
 
 void
 MessageFactory::cleanup()
 {
-	MessageMap::iterator itr( m_messages.begin() );
-	
-	for( ; itr != m_messages.end(); ++itr)
+	for ( int i = 0; i < TYPE_COUNT; ++i )
+	{
+		Entry& e = m_entries[i];
+
+		delete e.prototype;
+
+		e.prototype = 0;
+
+		// pools are not deleted. messages released later still point to them.
+
+		if ( e.pool != 0 )
+		{
+			e.pool->Clear();
+		}
+	}
+
+	for ( uint i = 0; i < m_retired.size(); ++i )
 	{
-		delete itr->second;
+		delete m_retired[i];
 	}
 
-	m_messages.clear();
+	m_retired.clear();
 }
 
 } // gk
@@ -2,8 +2,9 @@
 
 #include <kcore/sys/ScopedLock.h>
 #include <knet/message/Message.h>
+#include <knet/message/MessagePool.h>
 
-#include <hash_map>
+#include <vector>
 
 namespace gk 
 {
@@ -12,9 +13,25 @@ namespace gk
  * @class MessageFactory
  *
  * A factory for messages
+ *
+ * Prototypes are kept in a flat table indexed by message type. 
+ * Create reads the table without lock. Register and SetPool lock 
+ * each other only and are refused after Freeze.
+ *
+ * A replaced prototype is kept until the factory is destroyed 
+ * since Create can be using it on another thread.
+ *
+ * Types with a pool recycle message blocks. See MessagePool.
  */
 class MessageFactory
 {
+public:
+	enum 
+	{
+		  TYPE_COUNT 			= 0x10000 	// ushort message types
+		, DEFAULT_POOL_CAPACITY = 1024 		// free blocks kept per type
+	};
+
 public:
 	/**
 	 * Access a singleton
@@ -34,25 +51,74 @@ public:
 	void Register( Message* prototype );
 
 	/**
-	 * Create a message of type
+	 * Recycle messages of a type. Call before Freeze.
+	 *
+	 * @param type The message type. Registered before or after.
+	 * @param capacity Max free blocks kept
+	 */
+	void SetPool( ushort type, uint capacity = DEFAULT_POOL_CAPACITY );
+
+	/**
+	 * Stop registration. Call after startup registered all types, 
+	 * after NetServer::Init or NetClient::Init and before traffic. 
+	 * Until then Register can race Create. Node::Init calls it.
+	 */
+	void Freeze();
+
+	/**
+	 * Check whether frozen
+	 */
+	bool IsFrozen() const;
+
+	/**
+	 * Create a message of type. No lock.
 	 *
 	 * @param type The message type to create 
 	 * @return The message created
 	 */
 	MessagePtr Create( int type );
 
+	/**
+	 * Get the pool of a type
+	 *
+	 * @return The pool. 0 if not pooled.
+	 */
+	const MessagePool* GetPool( ushort type ) const;
+
 private:
-	typedef stdext::hash_map<int, Message*> MessageMap;
+	struct Entry
+	{
+		Message* volatile 		prototype;
+		MessagePool* volatile 	pool;
+	};
+
+	typedef std::vector<Message*> MessageList;
 
 	MessageFactory();
 
 	void cleanup();
 
 private:
-	MessageMap 	m_messages;
-	Mutex		m_lock;
+	Entry 			m_entries[TYPE_COUNT];
+	MessageList 	m_retired; 		// replaced prototypes
+	Atomic<bool> 	m_frozen;
+	Mutex			m_lock;
 };
 
+inline
+bool 
+MessageFactory::IsFrozen() const
+{
+	return m_frozen;
+}
+
+inline
+const MessagePool* 
+MessageFactory::GetPool( ushort type ) const
+{
+	return m_entries[type].pool;
+}
+
 } // knet 
 
 #define REGISTER_MESSAGE( m ) \
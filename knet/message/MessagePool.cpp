@@ -0,0 +1,152 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <knet/message/MessagePool.h>
+
+#include <kcore/mem/Allocator.h>
+
+namespace gk {
+
+/**
+ * Placed before each message. entry is used only while free.
+ */
+struct MessagePool::Header
+{
+	SLIST_ENTRY 	entry;
+	MessagePool* 	pool; 		// 0 when not pooled
+};
+
+// keeps the message aligned as the allocator returns blocks
+const uint MessagePool::HEADER_LEN = 
+	( sizeof( Header ) + MEMORY_ALLOCATION_ALIGNMENT - 1 ) & ~( MEMORY_ALLOCATION_ALIGNMENT - 1 );
+
+namespace
+{
+
+__declspec(thread) MessagePool* t_hint;
+
+} // anonymous
+
+MessagePool::MessagePool( uint capacity )
+: m_capacity( capacity )
+, m_size( 0 )
+, m_allocCount( 0 )
+{
+	::InitializeSListHead( &m_free );
+}
+
+MessagePool::~MessagePool()
+{
+	Clear();
+}
+
+void 
+MessagePool::Clear()
+{
+	PSLIST_ENTRY e = ::InterlockedFlushSList( &m_free );
+
+	while ( e != 0 )
+	{
+		PSLIST_ENTRY next = e->Next;
+
+		g_allocator.Free( e ); // entry is the first member of Header
+
+		m_allocCount.Dec();
+
+		e = next;
+	}
+}
+
+uint 
+MessagePool::GetFreeCount() const
+{
+	return ::QueryDepthSList( const_cast<PSLIST_HEADER>( &m_free ) );
+}
+
+uint 
+MessagePool::GetAllocCount() const
+{
+	return m_allocCount;
+}
+
+void 
+MessagePool::SetHint( MessagePool* pool )
+{
+	t_hint = pool;
+}
+
+void* 
+MessagePool::Allocate( size_t size )
+{
+	// the hint is for one allocation. 
+	// messages created by a constructor get plain blocks.
+
+	MessagePool* pool = t_hint;
+
+	t_hint = 0;
+
+	Header* h = ( pool != 0 ) ? pool->pop( size ) : 0;
+
+	if ( h == 0 )
+	{
+		h = (Header*)g_allocator.Alloc( HEADER_LEN + size );
+
+		K_RETURN_V_IF( h == 0, 0 );
+
+		h->pool = 0;
+
+		if ( pool != 0 && pool->m_size == (uint)size )
+		{
+			h->pool = pool;
+
+			pool->m_allocCount.Inc();
+		}
+	}
+
+	return (byte*)h + HEADER_LEN;
+}
+
+void 
+MessagePool::Deallocate( void* p )
+{
+	K_RETURN_IF( p == 0 );
+
+	Header* h = (Header*)( (byte*)p - HEADER_LEN );
+
+	if ( h->pool != 0 )
+	{
+		K_RETURN_IF( h->pool->push( h ) );
+
+		h->pool->m_allocCount.Dec();
+	}
+
+	g_allocator.Free( h );
+}
+
+MessagePool::Header* 
+MessagePool::pop( size_t size )
+{
+	if ( m_size != (uint)size )
+	{
+		// the first allocation decides. a type has one size.
+
+		uint expected = 0;
+
+		K_RETURN_V_IF( !m_size.CompareExchange( expected, (uint)size ) && 
+					   expected != (uint)size, 0 );
+	}
+
+	return (Header*)::InterlockedPopEntrySList( &m_free );
+}
+
+bool 
+MessagePool::push( Header* h )
+{
+	K_RETURN_V_IF( ::QueryDepthSList( &m_free ) >= m_capacity, false );
+
+	::InterlockedPushEntrySList( &m_free, &h->entry );
+
+	return true;
+}
+
+} // gk
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <kcore/base/Noncopyable.h>
+#include <kcore/sys/Atomic.h>
+
+namespace gk 
+{
+
+/**
+ * @class MessagePool
+ *
+ * @brief Recycles memory blocks of one message type.
+ *
+ * Every Message is allocated with a small header by Message::operator new. 
+ * MessageFactory::Create sets the pool of the type as a hint for the 
+ * calling thread. The next message allocation on the thread takes a block 
+ * from the pool and records the pool in the header. Message::operator 
+ * delete returns the block to its pool instead of the allocator.
+ *
+ * Free blocks are kept in an interlocked SList. Alloc and Free take no 
+ * lock and can be called from any thread.
+ */
+class MessagePool : private Noncopyable
+{
+public:
+	/**
+	 * @param capacity Max free blocks kept. More are freed to the allocator.
+	 */
+	explicit MessagePool( uint capacity );
+	~MessagePool();
+
+	/**
+	 * Free all blocks kept
+	 */
+	void Clear();
+
+	/**
+	 * Get the number of free blocks kept
+	 */
+	uint GetFreeCount() const;
+
+	/**
+	 * Get the number of blocks allocated from the allocator for this pool
+	 */
+	uint GetAllocCount() const;
+
+	/**
+	 * Set the pool for the next message allocation of this thread
+	 *
+	 * @param pool The pool. 0 to clear.
+	 */
+	static void SetHint( MessagePool* pool );
+
+	/**
+	 * Allocate a message block. Used by Message::operator new.
+	 */
+	static void* Allocate( size_t size );
+
+	/**
+	 * Free a message block. Used by Message::operator delete.
+	 */
+	static void Deallocate( void* p );
+
+private:
+	struct Header;
+
+	static const uint HEADER_LEN;
+
+	Header* pop( size_t size );
+	bool push( Header* h );
+
+private:
+	SLIST_HEADER 	m_free;
+	uint 			m_capacity;
+	Atomic<uint> 	m_size; 		// block size. set by the first allocation
+	Atomic<uint> 	m_allocCount;
+};
+
+} // gk
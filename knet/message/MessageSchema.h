@@ -0,0 +1,1022 @@
+#pragma once
+
+#include <knet/message/BitStream.h>
+
+#include <vector>
+
+namespace gk
+{
+
+/**
+ * @file MessageSchema.h
+ *
+ * Declarative field lists for messages.
+ *
+ * A message lists its fields once with a field type for each.
+ * Pack / Unpack are generated from the list:
+ *
+ * 	struct NmGroupLeave : public Message
+ * 	{
+ * 		uint groupId;
+ * 		uint connectionId;
+ *
+ * 		K_SCHEMA_BEGIN( Message )
+ * 			K_FIELD( groupId, 		SchemaUInt<32> )
+ * 			K_FIELD( connectionId, 	SchemaUInt<32> )
+ * 		K_SCHEMA_END()
+ * 		...
+ * 	};
+ *
+ * Field types have compile time bit widths. Pack measures the message
+ * first and reserves the stream once. When every field has a fixed
+ * width the fields are packed into a local buffer without stream checks
+ * and written with one WriteBits. Unpack reads the bits with one ReadBits
+ * in the same way. Range checks are still done on each field.
+ *
+ * The bits on wire are same as the BitStream calls the field types
+ * stand for. So hand written Pack / Unpack can be converted one by one.
+ *
+ * Field types with a comma like SchemaRange<-10, 10> need a typedef
+ * since macro arguments can not have a comma.
+ *
+ * K_FIELDS_BEGIN lists fields without Pack / Unpack. It is used for 
+ * states replicated with DeltaPacker / DeltaUnpacker.
+ */
+
+/**
+ * Bits to hold values up to N
+ */
+template <uint N>
+struct SchemaBits
+{
+	enum { VALUE = 1 + SchemaBits<( N >> 1 )>::VALUE };
+};
+
+template <>
+struct SchemaBits<1>
+{
+	enum { VALUE = 1 };
+};
+
+template <>
+struct SchemaBits<0>
+{
+	enum { VALUE = 1 };
+};
+
+/**
+ * @class SchemaWriter
+ *
+ * Unchecked LSB first bit writer on a zeroed local buffer.
+ * Same bit order as BitStream.
+ */
+class SchemaWriter
+{
+public:
+	SchemaWriter( byte* buf )
+	: m_buf( buf )
+	, m_pos( 0 )
+	, m_valid( true )
+	{
+	}
+
+	void Put( uint value, uint bits )
+	{
+		K_ASSERT( bits > 0 && bits <= 32 );
+
+		uint8 v = (uint8)value & ( ( (uint8)1 << bits ) - 1 );
+
+		v <<= ( m_pos & 0x7 );
+
+		byte* dst = m_buf + ( m_pos >> 3 );
+		uint len = ( ( m_pos & 0x7 ) + bits + 7 ) >> 3;
+
+		for ( uint i = 0; i < len; ++i )
+		{
+			dst[i] |= (byte)( v >> ( i << 3 ) );
+		}
+
+		m_pos += bits;
+	}
+
+	template <class T, class F>
+	void Visit( const T& value, const F& )
+	{
+		m_valid = F::Put( *this, value ) && m_valid;
+	}
+
+	uint GetBits() const 	{ return m_pos; }
+	bool IsValid() const 	{ return m_valid; }
+
+private:
+	byte* 	m_buf;
+	uint 	m_pos;
+	bool 	m_valid;
+};
+
+/**
+ * @class SchemaReader
+ *
+ * Unchecked LSB first bit reader on a local buffer
+ */
+class SchemaReader
+{
+public:
+	SchemaReader( const byte* buf )
+	: m_buf( buf )
+	, m_pos( 0 )
+	, m_valid( true )
+	{
+	}
+
+	uint Get( uint bits )
+	{
+		K_ASSERT( bits > 0 && bits <= 32 );
+
+		const byte* src = m_buf + ( m_pos >> 3 );
+		uint len = ( ( m_pos & 0x7 ) + bits + 7 ) >> 3;
+
+		uint8 v = 0;
+
+		for ( uint i = 0; i < len; ++i )
+		{
+			v |= (uint8)src[i] << ( i << 3 );
+		}
+
+		v >>= ( m_pos & 0x7 );
+
+		m_pos += bits;
+
+		return (uint)( v & ( ( (uint8)1 << bits ) - 1 ) );
+	}
+
+	template <class T, class F>
+	void Visit( T& value, const F& )
+	{
+		m_valid = F::Get( *this, value ) && m_valid;
+	}
+
+	bool IsValid() const 	{ return m_valid; }
+
+private:
+	const byte* m_buf;
+	uint 		m_pos;
+	bool 		m_valid;
+};
+
+/**
+ * @class SchemaMeasure
+ *
+ * Bits of a message and whether all fields are fixed width.
+ * The sums of constants are folded by the compiler for fixed messages.
+ */
+class SchemaMeasure
+{
+public:
+	SchemaMeasure()
+	: m_bits( 0 )
+	, m_fixed( true )
+	{
+	}
+
+	template <class T, class F>
+	void Visit( const T& value, const F& )
+	{
+		m_bits 	+= F::Measure( value );
+		m_fixed  = m_fixed && F::FIXED;
+	}
+
+	uint GetBits() const 	{ return m_bits; }
+	bool IsFixed() const 	{ return m_fixed; }
+
+private:
+	uint m_bits;
+	bool m_fixed;
+};
+
+/**
+ * @class SchemaPacker
+ *
+ * Packs fields with BitStream calls. Used for variable length messages.
+ */
+class SchemaPacker
+{
+public:
+	SchemaPacker( BitStream& bs )
+	: m_bs( bs )
+	, m_valid( true )
+	{
+	}
+
+	template <class T, class F>
+	void Visit( const T& value, const F& )
+	{
+		m_valid = m_valid && F::Pack( m_bs, value );
+	}
+
+	bool IsValid() const 	{ return m_valid && m_bs.IsValid(); }
+
+private:
+	BitStream& 	m_bs;
+	bool 		m_valid;
+};
+
+/**
+ * @class SchemaUnpacker
+ *
+ * Unpacks fields with BitStream calls. Stops at the first invalid field.
+ */
+class SchemaUnpacker
+{
+public:
+	SchemaUnpacker( BitStream& bs )
+	: m_bs( bs )
+	, m_valid( true )
+	{
+	}
+
+	template <class T, class F>
+	void Visit( T& value, const F& )
+	{
+		m_valid = m_valid && F::Unpack( m_bs, value ) && m_bs.IsValid();
+	}
+
+	bool IsValid() const 	{ return m_valid && m_bs.IsValid(); }
+
+private:
+	BitStream& 	m_bs;
+	bool 		m_valid;
+};
+
+/**
+ * @struct SchemaUInt
+ *
+ * Unsigned integer in BITS bits. Same as WriteInt( v, BITS ).
+ */
+template <uint BITS>
+struct SchemaUInt
+{
+	enum { MAX_BITS = BITS, FIXED = 1 };
+
+	template <class T>
+	static uint Measure( const T& )
+	{
+		return BITS;
+	}
+
+	template <class T>
+	static bool Pack( BitStream& bs, const T& v )
+	{
+		bs.WriteInt( (uint)v, BITS );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Unpack( BitStream& bs, T& v )
+	{
+		uint x = 0;
+
+		bs.ReadInt( x, BITS );
+
+		v = (T)x;
+
+		return true;
+	}
+
+	template <class T>
+	static bool Put( SchemaWriter& w, const T& v )
+	{
+		w.Put( (uint)v, BITS );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Get( SchemaReader& r, T& v )
+	{
+		v = (T)r.Get( BITS );
+
+		return true;
+	}
+};
+
+/**
+ * @struct SchemaInt
+ *
+ * Signed integer in BITS bits. Same as WriteSignedInt( v, BITS ).
+ */
+template <uint BITS>
+struct SchemaInt
+{
+	enum { MAX_BITS = BITS, FIXED = 1 };
+
+	template <class T>
+	static uint Measure( const T& )
+	{
+		return BITS;
+	}
+
+	template <class T>
+	static bool Pack( BitStream& bs, const T& v )
+	{
+		bs.WriteSignedInt( (int)v, BITS );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Unpack( BitStream& bs, T& v )
+	{
+		int x = 0;
+
+		bs.ReadSignedInt( x, BITS );
+
+		v = (T)x;
+
+		return true;
+	}
+
+	template <class T>
+	static bool Put( SchemaWriter& w, const T& v )
+	{
+		int x = (int)v;
+
+		w.Put( x < 0 ? 1 : 0, 1 );
+		w.Put( (uint)( x < 0 ? -x : x ), BITS - 1 );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Get( SchemaReader& r, T& v )
+	{
+		bool negative = r.Get( 1 ) != 0;
+		int x = (int)r.Get( BITS - 1 );
+
+		v = (T)( negative ? -x : x );
+
+		return true;
+	}
+};
+
+/**
+ * @struct SchemaRange
+ *
+ * Integer in [LO, HI] sent as v - LO in just enough bits.
+ * Pack fails on a value out of range. Unpack rejects one.
+ */
+template <int LO, int HI>
+struct SchemaRange
+{
+	enum
+	{
+		  BITS 		= SchemaBits<(uint)( HI - LO )>::VALUE
+		, MAX_BITS 	= BITS
+		, FIXED 	= 1
+	};
+
+	template <class T>
+	static uint Measure( const T& )
+	{
+		return BITS;
+	}
+
+	template <class T>
+	static bool Pack( BitStream& bs, const T& v )
+	{
+		K_RETURN_V_IF( !IsIn( (int)v ), false );
+
+		bs.WriteInt( (uint)( (int)v - LO ), BITS );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Unpack( BitStream& bs, T& v )
+	{
+		uint x = 0;
+
+		bs.ReadInt( x, BITS );
+
+		return set( x, v );
+	}
+
+	template <class T>
+	static bool Put( SchemaWriter& w, const T& v )
+	{
+		K_RETURN_V_IF( !IsIn( (int)v ), false );
+
+		w.Put( (uint)( (int)v - LO ), BITS );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Get( SchemaReader& r, T& v )
+	{
+		return set( r.Get( BITS ), v );
+	}
+
+	static bool IsIn( int v )
+	{
+		K_ASSERT( v >= LO && v <= HI );
+
+		return v >= LO && v <= HI;
+	}
+
+private:
+	template <class T>
+	static bool set( uint x, T& v )
+	{
+		K_RETURN_V_IF( x > (uint)( HI - LO ), false );
+
+		v = (T)( (int)x + LO );
+
+		return true;
+	}
+};
+
+/**
+ * @struct SchemaVarUInt
+ *
+ * Unsigned integer in groups of GROUP bits. Same as WriteVarInt( v, GROUP ).
+ */
+template <uint GROUP>
+struct SchemaVarUInt
+{
+	enum 
+	{ 
+		  MAX_BITS 	= ( ( 32 + GROUP - 1 ) / GROUP ) * ( GROUP + 1 )
+		, FIXED 	= 0 
+	};
+
+	template <class T>
+	static uint Measure( const T& v )
+	{
+		return BitStream::GetVarIntBits( (uint)v, GROUP );
+	}
+
+	template <class T>
+	static bool Pack( BitStream& bs, const T& v )
+	{
+		bs.WriteVarInt( (uint)v, GROUP );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Unpack( BitStream& bs, T& v )
+	{
+		uint x = 0;
+
+		bs.ReadVarInt( x, GROUP );
+
+		v = (T)x;
+
+		return bs.IsValid();
+	}
+
+	template <class T>
+	static bool Put( SchemaWriter&, const T& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+
+	template <class T>
+	static bool Get( SchemaReader&, T& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+};
+
+/**
+ * @struct SchemaVarInt
+ *
+ * Signed integer zigzag mapped. Same as WriteVarSignedInt( v, GROUP ).
+ */
+template <uint GROUP>
+struct SchemaVarInt
+{
+	enum 
+	{ 
+		  MAX_BITS 	= SchemaVarUInt<GROUP>::MAX_BITS
+		, FIXED 	= 0 
+	};
+
+	template <class T>
+	static uint Measure( const T& v )
+	{
+		return BitStream::GetVarIntBits( BitStream::ZigZag( (int)v ), GROUP );
+	}
+
+	template <class T>
+	static bool Pack( BitStream& bs, const T& v )
+	{
+		bs.WriteVarSignedInt( (int)v, GROUP );
+
+		return true;
+	}
+
+	template <class T>
+	static bool Unpack( BitStream& bs, T& v )
+	{
+		int x = 0;
+
+		bs.ReadVarSignedInt( x, GROUP );
+
+		v = (T)x;
+
+		return bs.IsValid();
+	}
+
+	template <class T>
+	static bool Put( SchemaWriter&, const T& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+
+	template <class T>
+	static bool Get( SchemaReader&, T& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+};
+
+/**
+ * @struct SchemaBool
+ *
+ * One bit flag. Same as Write( bool ).
+ */
+struct SchemaBool
+{
+	enum { MAX_BITS = 1, FIXED = 1 };
+
+	static uint Measure( bool )
+	{
+		return 1;
+	}
+
+	static bool Pack( BitStream& bs, bool v )
+	{
+		bs.WriteFlag( v );
+
+		return true;
+	}
+
+	static bool Unpack( BitStream& bs, bool& v )
+	{
+		v = bs.ReadFlag();
+
+		return true;
+	}
+
+	static bool Put( SchemaWriter& w, bool v )
+	{
+		w.Put( v ? 1 : 0, 1 );
+
+		return true;
+	}
+
+	static bool Get( SchemaReader& r, bool& v )
+	{
+		v = r.Get( 1 ) != 0;
+
+		return true;
+	}
+};
+
+/**
+ * @struct SchemaBytes
+ *
+ * Byte array of LEN. Same as Write( LEN, v ).
+ */
+template <uint LEN>
+struct SchemaBytes
+{
+	enum { MAX_BITS = LEN << 3, FIXED = 1 };
+
+	static uint Measure( const byte* )
+	{
+		return LEN << 3;
+	}
+
+	static bool Pack( BitStream& bs, const byte* v )
+	{
+		return bs.Write( LEN, v );
+	}
+
+	static bool Unpack( BitStream& bs, byte* v )
+	{
+		return bs.Read( LEN, v );
+	}
+
+	static bool Put( SchemaWriter& w, const byte* v )
+	{
+		for ( uint i = 0; i < LEN; ++i )
+		{
+			w.Put( v[i], 8 );
+		}
+
+		return true;
+	}
+
+	static bool Get( SchemaReader& r, byte* v )
+	{
+		for ( uint i = 0; i < LEN; ++i )
+		{
+			v[i] = (byte)r.Get( 8 );
+		}
+
+		return true;
+	}
+};
+
+/**
+ * @struct SchemaString
+ *
+ * String up to MAX_LEN characters. Same as Write( tstring ).
+ * The length field of BitStream is 10 bits of bit count.
+ */
+template <uint MAX_LEN>
+struct SchemaString
+{
+	enum
+	{
+		  MAX_BITS 	= 10 + ( ( MAX_LEN * sizeof( TCHAR ) ) << 3 )
+		, FIXED 	= 0
+	};
+
+	static uint Measure( const tstring& v )
+	{
+		return 10 + ( ( v.length() * sizeof( TCHAR ) ) << 3 );
+	}
+
+	static bool Pack( BitStream& bs, const tstring& v )
+	{
+		K_RETURN_V_IF( !IsIn( v ), false );
+
+		bs.Write( v );
+
+		return true;
+	}
+
+	static bool Unpack( BitStream& bs, tstring& v )
+	{
+		bs.Read( v );
+
+		return v.length() <= MAX_LEN;
+	}
+
+	static bool Put( SchemaWriter&, const tstring& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+
+	static bool Get( SchemaReader&, tstring& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+
+	static bool IsIn( const tstring& v )
+	{
+		bool in = v.length() <= MAX_LEN &&
+				  ( ( v.length() * sizeof( TCHAR ) ) << 3 ) < 1024;
+
+		K_ASSERT( in );
+
+		return in;
+	}
+};
+
+/**
+ * @struct SchemaVector
+ *
+ * Up to MAX_COUNT elements of field type F.
+ * The count is sent in SchemaBits<MAX_COUNT> bits.
+ */
+template <class F, uint MAX_COUNT>
+struct SchemaVector
+{
+	enum
+	{
+		  COUNT_BITS 	= SchemaBits<MAX_COUNT>::VALUE
+		, MAX_BITS 		= COUNT_BITS + F::MAX_BITS * MAX_COUNT
+		, FIXED 		= 0
+	};
+
+	template <class T>
+	static uint Measure( const std::vector<T>& v )
+	{
+		uint bits = COUNT_BITS;
+
+		for ( uint i = 0; i < v.size(); ++i )
+		{
+			bits += F::Measure( v[i] );
+		}
+
+		return bits;
+	}
+
+	template <class T>
+	static bool Pack( BitStream& bs, const std::vector<T>& v )
+	{
+		K_ASSERT( v.size() <= MAX_COUNT );
+		K_RETURN_V_IF( v.size() > MAX_COUNT, false );
+
+		bs.WriteInt( (uint)v.size(), COUNT_BITS );
+
+		for ( uint i = 0; i < v.size(); ++i )
+		{
+			K_RETURN_V_IF( !F::Pack( bs, v[i] ), false );
+		}
+
+		return true;
+	}
+
+	template <class T>
+	static bool Unpack( BitStream& bs, std::vector<T>& v )
+	{
+		uint count = 0;
+
+		bs.ReadInt( count, COUNT_BITS );
+
+		K_RETURN_V_IF( count > MAX_COUNT || !bs.IsValid(), false );
+
+		v.resize( count );
+
+		for ( uint i = 0; i < count; ++i )
+		{
+			K_RETURN_V_IF( !F::Unpack( bs, v[i] ), false );
+		}
+
+		return bs.IsValid();
+	}
+
+	template <class T>
+	static bool Put( SchemaWriter&, const std::vector<T>& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+
+	template <class T>
+	static bool Get( SchemaReader&, std::vector<T>& )
+	{
+		K_ASSERT( !_T("Variable length field") );
+
+		return false;
+	}
+};
+
+/**
+ * Compare field values. Arrays are compared by elements.
+ */
+template <class T>
+bool
+SchemaEqual( const T& a, const T& b )
+{
+	return a == b;
+}
+
+template <class T, size_t N>
+bool
+SchemaEqual( const T (&a)[N], const T (&b)[N] )
+{
+	for ( size_t i = 0; i < N; ++i )
+	{
+		if ( !( a[i] == b[i] ) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @class DeltaPacker
+ *
+ * Packs a state against a base state of the same type.
+ * Each field has a changed flag and the value when changed.
+ * The base field is found at the same offset in the base object.
+ */
+template <class S>
+class DeltaPacker
+{
+public:
+	DeltaPacker( const S& state, const S& base, BitStream& bs )
+	: m_state( reinterpret_cast<const byte*>( &state ) )
+	, m_base( reinterpret_cast<const byte*>( &base ) )
+	, m_bs( bs )
+	, m_valid( true )
+	{
+	}
+
+	template <class T, class F>
+	void Visit( const T& value, const F& )
+	{
+		const byte* p = reinterpret_cast<const byte*>( &value );
+		const T& base = *reinterpret_cast<const T*>( m_base + ( p - m_state ) );
+
+		bool changed = !SchemaEqual( value, base );
+
+		m_bs.WriteFlag( changed );
+
+		if ( changed )
+		{
+			m_valid = m_valid && F::Pack( m_bs, value );
+		}
+	}
+
+	bool IsValid() const 	{ return m_valid && m_bs.IsValid(); }
+
+private:
+	const byte* m_state;
+	const byte* m_base;
+	BitStream& 	m_bs;
+	bool 		m_valid;
+};
+
+/**
+ * @class DeltaUnpacker
+ *
+ * Unpacks changed fields onto a state which is a copy of the base
+ */
+class DeltaUnpacker
+{
+public:
+	DeltaUnpacker( BitStream& bs )
+	: m_bs( bs )
+	, m_valid( true )
+	{
+	}
+
+	template <class T, class F>
+	void Visit( T& value, const F& )
+	{
+		K_RETURN_IF( !m_valid );
+
+		if ( m_bs.ReadFlag() )
+		{
+			m_valid = F::Unpack( m_bs, value );
+		}
+
+		m_valid = m_valid && m_bs.IsValid();
+	}
+
+	bool IsValid() const 	{ return m_valid && m_bs.IsValid(); }
+
+private:
+	BitStream& 	m_bs;
+	bool 		m_valid;
+};
+
+enum
+{
+	SCHEMA_FAST_BITS = 1024 	///< max bits of fixed messages on the local buffer path
+};
+
+/**
+ * Pack fields of a message listed with K_FIELD
+ *
+ * @param m The message
+ * @param bs The stream to write
+ * @return true if all fields are packed
+ */
+template <class M>
+bool
+SchemaPack( M& m, BitStream& bs )
+{
+	SchemaMeasure measure;
+
+	m.VisitFields( measure );
+
+	uint bits = measure.GetBits();
+
+	if ( measure.IsFixed() && bits <= SCHEMA_FAST_BITS )
+	{
+		byte buf[SCHEMA_FAST_BITS / 8 + 8];
+
+		::memset( buf, 0, ( bits + 7 ) >> 3 );
+
+		SchemaWriter w( buf );
+
+		m.VisitFields( w );
+
+		K_RETURN_V_IF( !w.IsValid(), false );
+
+		return bs.WriteBits( bits, buf );
+	}
+
+	if ( ( bs.GetBitPosition() & 0x7 ) == 0 )
+	{
+		K_RETURN_V_IF( !bs.ReserveWrite( ( bits + 7 ) >> 3 ), false );
+	}
+
+	SchemaPacker p( bs );
+
+	m.VisitFields( p );
+
+	return p.IsValid();
+}
+
+/**
+ * Unpack fields of a message listed with K_FIELD
+ *
+ * @param m The message
+ * @param bs The stream to read
+ * @return true if all fields are read and in their ranges
+ */
+template <class M>
+bool
+SchemaUnpack( M& m, BitStream& bs )
+{
+	SchemaMeasure measure;
+
+	m.VisitFields( measure );
+
+	uint bits = measure.GetBits();
+
+	if ( measure.IsFixed() && bits <= SCHEMA_FAST_BITS )
+	{
+		byte buf[SCHEMA_FAST_BITS / 8 + 8];
+
+		::memset( buf, 0, ( bits + 7 ) >> 3 );
+
+		K_RETURN_V_IF( !bs.ReadBits( bits, buf ), false );
+
+		SchemaReader r( buf );
+
+		m.VisitFields( r );
+
+		return r.IsValid();
+	}
+
+	SchemaUnpacker u( bs );
+
+	m.VisitFields( u );
+
+	return u.IsValid();
+}
+
+/**
+ * Get packed bits of the fields of a message
+ */
+template <class M>
+uint
+SchemaGetBits( M& m )
+{
+	SchemaMeasure measure;
+
+	m.VisitFields( measure );
+
+	return measure.GetBits();
+}
+
+} // gk
+
+/**
+ * Generates Pack / Unpack of a message from its field list.
+ * base is the message class to pack first.
+ */
+#define K_SCHEMA_BEGIN( base ) \
+	bool Pack( gk::BitStream& bs ) \
+	{ \
+		return base::Pack( bs ) && gk::SchemaPack( *this, bs ); \
+	} \
+	bool Unpack( gk::BitStream& bs ) \
+	{ \
+		return base::Unpack( bs ) && gk::SchemaUnpack( *this, bs ); \
+	} \
+	K_FIELDS_BEGIN()
+
+/**
+ * Lists fields without Pack / Unpack
+ */
+#define K_FIELDS_BEGIN() \
+	template <class V> \
+	void VisitFields( V& schemaVisitor ) \
+	{
+
+#define K_FIELD( name, field ) \
+		schemaVisitor.Visit( name, field() );
+
+#define K_SCHEMA_END() \
+	}
+
+#define K_FIELDS_END() \
+	}
@@ -24,6 +24,7 @@ struct NetControlMessage : public Message
 		, TCP_LISTEN
 		, TCP_CONNECT
 		, TCP_CLOSE
+		, TCP_LOW_LATENCY 	// param 1 to set, 0 to clear
 	};
 
 	uint 		control; 		// control
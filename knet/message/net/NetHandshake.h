@@ -10,14 +10,27 @@ namespace gk {
  * @struct NetHandshake 
  *
  * Handshake on TCP security setup
+ *
+ * The server offers a compression mode. A client accepting it replies 
+ * with a NetHandshake of the mode to use. Compression fields are read 
+ * only when present. So a peer without them gets no compression.
  */
 struct NetHandshake : public Message
 {
 	SecurityLevel sl;
 	byte 		  challenge[Cipher::LEN_CHALLENGE];
+	uint 		  compression; 	// Compressor::Mode offered or accepted
+	uint 		  dictId; 		// Compressor::GetDictionaryId() of the sender
+
+	enum 
+	{
+		COMPRESSION_BITS = 8 + 32
+	};
 
 	NetHandshake()
 		: sl( SECURITY0 )
+		, compression( 0 )
+		, dictId( 0 )
 	{
 		type = NET_HANDSHAKE;
 
@@ -30,6 +43,8 @@ struct NetHandshake : public Message
 
 		bs.WriteInt( sl, 16 );
 		bs.Write( Cipher::LEN_CHALLENGE, challenge );
+		bs.WriteInt( compression, 8 );
+		bs.WriteInt( dictId, 32 );
 
 		return bs.IsValid();
 	}
@@ -45,6 +60,12 @@ struct NetHandshake : public Message
 
 		bs.Read( Cipher::LEN_CHALLENGE, challenge );
 
+		if ( bs.GetMaxReadBitPosition() >= bs.GetBitPosition() + COMPRESSION_BITS )
+		{
+			bs.ReadInt( compression, 8 );
+			bs.ReadInt( dictId, 32 );
+		}
+
 		return bs.IsValid();
 	}
 
@@ -26,6 +26,11 @@ struct NetStateMessage : public Message
 
 		, TCP_OPEN 				// A connetion is ready for communication
 		, TCP_CLOSED
+
+		, TCP_SEND_HIGH_WATER 	// Send queue went over the high water mark
+		, TCP_SEND_LOW_WATER 	// Send queue drained to the low water mark
+
+		, UDP_SENT 				// A reliable udp send with a cookie. see NetClient::SendUdp
 	};
 
 	uint 		state; 			// state mesage
@@ -34,6 +39,10 @@ struct NetStateMessage : public Message
 	IpAddress 	addr; 			// Remote or peer ip address 
 	Socket*   	socket;			// When tcp accepted or connected
 	SecurityLevel sl;
+	uint 		queued; 		// Queued send bytes on send water mark states
+	uint 		cookie; 		// Cookie of the send on UDP_SENT
+	uint 		seq; 			// Reliable sequence of the send on UDP_SENT
+	uint 		cumAck; 		// Cumulative ack from the remote on UDP_SENT
 
 	NetStateMessage()
 		: state( 0 )
@@ -41,6 +50,10 @@ struct NetStateMessage : public Message
 		, groupId( 0 )
 		, addr()
 		, socket( 0 )
+		, queued( 0 )
+		, cookie( 0 )
+		, seq( 0 )
+		, cumAck( 0 )
 	{
 		type = NET_STATE_MESSAGE;
 	}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <kcore/base/Noncopyable.h>
+#include <knet/message/MessageSchema.h>
+
+namespace gk
+{
+
+/**
+ * @class ReplicaReceiver
+ *
+ * @brief Reads updates written by Replicator.
+ *
+ * Keeps the last HISTORY states received so that a delta can be
+ * applied on the base state it refers to. HISTORY must be same as
+ * the Replicator.
+ *
+ * Updates can arrive out of order. Older ones are kept as bases
+ * but do not change the current state.
+ *
+ * Not thread safe.
+ */
+template <class S, uint HISTORY = 32>
+class ReplicaReceiver : private Noncopyable
+{
+public:
+	enum
+	{
+		  SEQ_BITS 		= 16
+		, DISTANCE_BITS = SchemaBits<HISTORY - 1>::VALUE
+	};
+
+public:
+	ReplicaReceiver();
+	~ReplicaReceiver();
+
+	/**
+	 * Read an update
+	 *
+	 * @param bs The stream to read
+	 * @param state Set to the update when it is newer than the last one
+	 * @return true if state is set
+	 */
+	bool Read( BitStream& bs, S& state );
+
+	/**
+	 * Get the sequence of the newest update.
+	 * Report it to the sender for Replicator::OnAck.
+	 */
+	uint GetLast() const;
+
+	/**
+	 * Forget all received states. 
+	 * Used when the sender added this client again.
+	 */
+	void Reset();
+
+private:
+	uint expand( uint low ) const;
+
+private:
+	uint 	m_last;
+	uint 	m_seqs[HISTORY];
+	S 		m_states[HISTORY];
+};
+
+template <class S, uint HISTORY>
+inline
+ReplicaReceiver<S, HISTORY>::ReplicaReceiver()
+: m_last( 0 )
+{
+	::memset( m_seqs, 0, sizeof( m_seqs ) );
+}
+
+template <class S, uint HISTORY>
+inline
+ReplicaReceiver<S, HISTORY>::~ReplicaReceiver()
+{
+}
+
+template <class S, uint HISTORY>
+inline
+bool
+ReplicaReceiver<S, HISTORY>::Read( BitStream& bs, S& state )
+{
+	uint low = 0;
+
+	bs.ReadInt( low, SEQ_BITS );
+
+	bool full = bs.ReadFlag();
+
+	K_RETURN_V_IF( !bs.IsValid(), false );
+
+	uint seq = expand( low );
+
+	// its slot is used by a newer one already
+
+	K_RETURN_V_IF( seq == 0 || seq + HISTORY <= m_last, false );
+
+	S s;
+
+	if ( full )
+	{
+		K_RETURN_V_IF( !SchemaUnpack( s, bs ), false );
+	}
+	else
+	{
+		uint distance = 0;
+
+		bs.ReadInt( distance, DISTANCE_BITS );
+
+		K_RETURN_V_IF( !bs.IsValid() || distance == 0 || distance >= seq, false );
+
+		uint base = seq - distance;
+
+		K_RETURN_V_IF( m_seqs[base % HISTORY] != base, false );
+
+		s = m_states[base % HISTORY];
+
+		DeltaUnpacker u( bs );
+
+		s.VisitFields( u );
+
+		K_RETURN_V_IF( !u.IsValid(), false );
+	}
+
+	uint slot = seq % HISTORY;
+
+	m_seqs[slot] 	= seq;
+	m_states[slot] 	= s;
+
+	K_RETURN_V_IF( seq <= m_last, false );
+
+	m_last 	= seq;
+	state 	= s;
+
+	return true;
+}
+
+template <class S, uint HISTORY>
+inline
+uint
+ReplicaReceiver<S, HISTORY>::GetLast() const
+{
+	return m_last;
+}
+
+template <class S, uint HISTORY>
+inline
+void
+ReplicaReceiver<S, HISTORY>::Reset()
+{
+	m_last = 0;
+
+	::memset( m_seqs, 0, sizeof( m_seqs ) );
+}
+
+template <class S, uint HISTORY>
+inline
+uint
+ReplicaReceiver<S, HISTORY>::expand( uint low ) const
+{
+	// closest to the last one within half of 16 bit range
+
+	uint seq = ( m_last & ~0xFFFFu ) | low;
+
+	if ( seq + 0x8000 < m_last )
+	{
+		seq += 0x10000;
+	}
+	else if ( seq > m_last + 0x8000 && seq >= 0x10000 )
+	{
+		seq -= 0x10000;
+	}
+
+	return seq;
+}
+
+} // gk
@@ -0,0 +1,360 @@
+#pragma once
+
+#include <kcore/base/Noncopyable.h>
+#include <knet/message/MessageSchema.h>
+
+#include <hash_map>
+
+namespace gk
+{
+
+/**
+ * @class Replicator
+ *
+ * @brief Sends a state to clients as deltas against acknowledged states.
+ *
+ * S lists its fields with K_FIELDS_BEGIN / K_FIELD / K_FIELDS_END and
+ * is copyable. Each client keeps the last HISTORY states sent to it.
+ * An update is packed against the newest one the client acknowledged.
+ * Only changed fields are sent. When nothing is acknowledged yet or the
+ * acknowledged one is out of the history, the full state is sent.
+ *
+ * Update:
+ *   SEQ{16} FULL{1}=1 fields
+ *   SEQ{16} FULL{1}=0 DISTANCE{DISTANCE_BITS} ( CHANGED{1} [field] )*
+ *
+ * ReplicaReceiver reads updates on the other side.
+ *
+ * Acks come in two ways:
+ *  - OnAck with ReplicaReceiver::GetLast() reported by the client.
+ *    Used when updates are sent with Message::LOSSY.
+ *  - Updates sent with NetClient::SendUdp and the update sequence as 
+ *    the cookie. The NetStateMessage UDP_SENT of the send gives the 
+ *    reliable sequence for OnSent and the cumulative ack for 
+ *    OnTransportAck. No ack message needed. NetServer has no UDP, 
+ *    so its clients report acks with OnAck.
+ *    Reset the client when its connection is opened again.
+ *
+ * Not thread safe. Used from the thread owning the state.
+ */
+template <class S, uint HISTORY = 32>
+class Replicator : private Noncopyable
+{
+public:
+	enum
+	{
+		  SEQ_BITS 		= 16
+		, DISTANCE_BITS = SchemaBits<HISTORY - 1>::VALUE
+	};
+
+public:
+	Replicator();
+	~Replicator();
+
+	/**
+	 * Add a client. The first update to it is a full state.
+	 *
+	 * @param clientId The id of the client
+	 */
+	void AddClient( uint clientId );
+
+	/**
+	 * Remove a client
+	 *
+	 * @param clientId The id of the client
+	 */
+	void RemoveClient( uint clientId );
+
+	/**
+	 * Forget acknowledged states. The next update is a full state.
+	 *
+	 * @param clientId The id of the client
+	 */
+	void Reset( uint clientId );
+
+	/**
+	 * Write an update of state for a client
+	 *
+	 * On failure the client is not changed and bs is set back to the 
+	 * bit position before the call. The error state of bs is kept.
+	 *
+	 * @param clientId The id of the client
+	 * @param state The current state
+	 * @param bs The stream to write
+	 * @return The update sequence. 0 if failed.
+	 */
+	uint Write( uint clientId, const S& state, BitStream& bs );
+
+	/**
+	 * An update is received by the client
+	 *
+	 * @param clientId The id of the client
+	 * @param seq The update sequence received
+	 */
+	void OnAck( uint clientId, uint seq );
+
+	/**
+	 * Bind an update to the transport sequence carrying it
+	 *
+	 * @param clientId The id of the client
+	 * @param seq The update sequence from Write
+	 * @param transportSeq The reliable sequence of the send. UDP_SENT seq.
+	 */
+	void OnSent( uint clientId, uint seq, uint transportSeq );
+
+	/**
+	 * Transport segments up to cumAck are received by the client
+	 *
+	 * @param clientId The id of the client
+	 * @param cumAck The cumulative ack of the transport
+	 */
+	void OnTransportAck( uint clientId, uint cumAck );
+
+	/**
+	 * Get the newest acknowledged update sequence
+	 *
+	 * @param clientId The id of the client
+	 * @return The sequence. 0 if none.
+	 */
+	uint GetAcked( uint clientId ) const;
+
+	/**
+	 * Get the number of clients
+	 */
+	uint GetClientCount() const;
+
+private:
+	struct Client
+	{
+		uint 	seq; 					// last update sequence
+		uint 	acked; 					// newest acknowledged. 0 for none.
+		uint 	seqs[HISTORY];
+		uint 	transportSeqs[HISTORY];
+		S 		states[HISTORY];
+
+		Client()
+		: seq( 0 )
+		, acked( 0 )
+		{
+			::memset( seqs, 0, sizeof( seqs ) );
+			::memset( transportSeqs, 0, sizeof( transportSeqs ) );
+		}
+	};
+
+	typedef stdext::hash_map<uint, Client*> ClientMap;
+
+	Client* find( uint clientId ) const;
+
+private:
+	ClientMap m_clients;
+};
+
+template <class S, uint HISTORY>
+inline
+Replicator<S, HISTORY>::Replicator()
+: m_clients()
+{
+	K_ASSERT( HISTORY > 1 && HISTORY < 0x8000 );
+}
+
+template <class S, uint HISTORY>
+inline
+Replicator<S, HISTORY>::~Replicator()
+{
+	typename ClientMap::iterator i( m_clients.begin() );
+	typename ClientMap::iterator iEnd( m_clients.end() );
+
+	for ( ; i != iEnd; ++i )
+	{
+		delete i->second;
+	}
+
+	m_clients.clear();
+}
+
+template <class S, uint HISTORY>
+inline
+void
+Replicator<S, HISTORY>::AddClient( uint clientId )
+{
+	K_RETURN_IF( find( clientId ) != 0 );
+
+	m_clients[clientId] = new Client;
+}
+
+template <class S, uint HISTORY>
+inline
+void
+Replicator<S, HISTORY>::RemoveClient( uint clientId )
+{
+	typename ClientMap::iterator i( m_clients.find( clientId ) );
+
+	K_RETURN_IF( i == m_clients.end() );
+
+	delete i->second;
+
+	m_clients.erase( i );
+}
+
+template <class S, uint HISTORY>
+inline
+void
+Replicator<S, HISTORY>::Reset( uint clientId )
+{
+	Client* c = find( clientId );
+
+	K_RETURN_IF( c == 0 );
+
+	c->acked = 0;
+
+	::memset( c->transportSeqs, 0, sizeof( c->transportSeqs ) );
+}
+
+template <class S, uint HISTORY>
+inline
+uint
+Replicator<S, HISTORY>::Write( uint clientId, const S& state, BitStream& bs )
+{
+	Client* c = find( clientId );
+
+	K_RETURN_V_IF( c == 0, 0 );
+
+	uint seq 		= c->seq + 1; // used only when packed
+	uint distance 	= seq - c->acked;
+	uint base 		= c->acked % HISTORY;
+	uint bitPos 	= bs.GetBitPosition();
+
+	bool full = c->acked == 0 ||
+				distance >= HISTORY ||
+				c->seqs[base] != c->acked;
+
+	bs.WriteInt( seq & 0xFFFF, SEQ_BITS );
+	bs.WriteFlag( full );
+
+	S& s = const_cast<S&>( state );
+
+	bool rc = false;
+
+	if ( full )
+	{
+		rc = SchemaPack( s, bs );
+	}
+	else
+	{
+		bs.WriteInt( distance, DISTANCE_BITS );
+
+		DeltaPacker<S> p( state, c->states[base], bs );
+
+		s.VisitFields( p );
+
+		rc = p.IsValid();
+	}
+
+	if ( !rc || !bs.IsValid() )
+	{
+		bs.SetBitPosition( bitPos ); // no partial update
+
+		return 0;
+	}
+
+	c->seq = seq;
+
+	uint slot = seq % HISTORY;
+
+	c->seqs[slot] 			= seq;
+	c->transportSeqs[slot] 	= 0;
+	c->states[slot] 		= state;
+
+	return seq;
+}
+
+template <class S, uint HISTORY>
+inline
+void
+Replicator<S, HISTORY>::OnAck( uint clientId, uint seq )
+{
+	Client* c = find( clientId );
+
+	K_RETURN_IF( c == 0 );
+	K_RETURN_IF( seq <= c->acked || seq > c->seq );
+
+	// too old ones are out of the history already
+
+	K_RETURN_IF( c->seqs[seq % HISTORY] != seq );
+
+	c->acked = seq;
+}
+
+template <class S, uint HISTORY>
+inline
+void
+Replicator<S, HISTORY>::OnSent( uint clientId, uint seq, uint transportSeq )
+{
+	Client* c = find( clientId );
+
+	K_RETURN_IF( c == 0 );
+
+	uint slot = seq % HISTORY;
+
+	K_RETURN_IF( c->seqs[slot] != seq );
+
+	c->transportSeqs[slot] = transportSeq;
+}
+
+template <class S, uint HISTORY>
+inline
+void
+Replicator<S, HISTORY>::OnTransportAck( uint clientId, uint cumAck )
+{
+	Client* c = find( clientId );
+
+	K_RETURN_IF( c == 0 );
+
+	uint newest = c->acked;
+
+	for ( uint i = 0; i < HISTORY; ++i )
+	{
+		if ( c->transportSeqs[i] != 0 &&
+			 c->transportSeqs[i] <= cumAck &&
+			 c->seqs[i] > newest )
+		{
+			newest = c->seqs[i];
+		}
+	}
+
+	c->acked = newest;
+}
+
+template <class S, uint HISTORY>
+inline
+uint
+Replicator<S, HISTORY>::GetAcked( uint clientId ) const
+{
+	Client* c = find( clientId );
+
+	K_RETURN_V_IF( c == 0, 0 );
+
+	return c->acked;
+}
+
+template <class S, uint HISTORY>
+inline
+uint
+Replicator<S, HISTORY>::GetClientCount() const
+{
+	return (uint)m_clients.size();
+}
+
+template <class S, uint HISTORY>
+inline
+typename Replicator<S, HISTORY>::Client*
+Replicator<S, HISTORY>::find( uint clientId ) const
+{
+	typename ClientMap::const_iterator i( m_clients.find( clientId ) );
+
+	K_RETURN_V_IF( i == m_clients.end(), 0 );
+
+	return i->second;
+}
+
+} // gk
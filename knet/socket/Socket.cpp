@@ -141,7 +141,7 @@ Socket::Listen()
 }
 
 Socket* 
-Socket::Accept()
+Socket::Accept( int* errorCode )
 {
     K_ASSERT( socket_ != INVALID_SOCKET );
     K_ASSERT( protocol_ == PT_TCP );
@@ -155,11 +155,21 @@ Socket::Accept()
                                 (SOCKADDR *)&clientAddr, 
                                 &clientAddrLen );
 
-    if ( acceptedSocket == 0 )
+    if ( acceptedSocket == 0 || acceptedSocket == INVALID_SOCKET )
 	{
+		if ( errorCode != 0 )
+		{
+			*errorCode = GetLastError(); // WSAEWOULDBLOCK on nonblocking socket
+		}
+
 		return (Socket*)0;
 	}
 
+	if ( errorCode != 0 )
+	{
+		*errorCode = 0;
+	}
+
     IpAddress addr;
     (void)addr.Init( (SOCKADDR*)&clientAddr );
 
@@ -187,19 +197,62 @@ Socket::Connect( const IpAddress& remote )
 
     if ( rc != SOCKET_ERROR )
     {
-        sockaddr_in addrin;
+        onConnected();
+    }
+
+    return ( rc == 0 );
+}
+
+int 
+Socket::StartConnect( const IpAddress& remote )
+{
+    K_ASSERT( socket_ != INVALID_SOCKET );
+    K_ASSERT( protocol_ == PT_TCP );
+
+    int rc = ::connect(
+                    socket_, 
+                    (SOCKADDR *)remote.GetInetAddr(), 
+                    sizeof(sockaddr_in) );
 
-        int len = sizeof( sockaddr_in );
+    if ( rc != SOCKET_ERROR )
+    {
+        onConnected();
 
-        ::getsockname( socket_, (SOCKADDR*)&addrin, &len );
+        return 0;
+    }
 
-        (void)addr_.Init( (SOCKADDR*)&addrin );
+    int errorCode = GetLastError();
 
-        // Init peer address here.
-        (void)this->GetPeerAddress();
+    if ( errorCode == WSAEWOULDBLOCK || errorCode == WSAEINPROGRESS )
+    {
+        return WSAEWOULDBLOCK;
     }
 
-    return ( rc == 0 );
+    return errorCode;
+}
+
+int 
+Socket::FinishConnect()
+{
+    K_ASSERT( socket_ != INVALID_SOCKET );
+    K_ASSERT( protocol_ == PT_TCP );
+
+    int errorCode = 0;
+    int len = sizeof( errorCode );
+
+    int rc = ::getsockopt( socket_, SOL_SOCKET, SO_ERROR, (char*)&errorCode, &len );
+
+    if ( rc == SOCKET_ERROR )
+    {
+        return GetLastError();
+    }
+
+    if ( errorCode == 0 )
+    {
+        onConnected();
+    }
+
+    return errorCode;
 }
 
 int 
@@ -237,6 +290,10 @@ Socket::AsyncRecv( IoBlock* buf )
     K_ASSERT( buf->buf.len >= 0 ); // we use 0 buffer recv
     K_ASSERT( buf->op == IoBlock::OP_READ );
 
+#if defined( GK_IO_EPOLL )
+    return IoPort::Submit( (int)socket_, buf, false );
+#else
+
     DWORD bytes = 0;
     DWORD flag = 0;
 
@@ -268,7 +325,8 @@ Socket::AsyncRecv( IoBlock* buf )
 
     // let owner handles error
 
-    return errorCode; 
+    return errorCode;
+#endif
 }
 
 int 
@@ -278,13 +336,22 @@ Socket::AsyncSend( IoBlock* buf )
     K_ASSERT( protocol_ == PT_TCP );
 
     K_ASSERT( buf != 0 );
-    K_ASSERT( buf->buf.buf != 0  );
-    K_ASSERT( buf->buf.len > 0 ); // send must have data
+    K_ASSERT( buf->bufs != 0 || buf->buf.buf != 0  );
+    K_ASSERT( buf->bufs != 0 || buf->buf.len > 0 ); // send must have data
     K_ASSERT( buf->op == IoBlock::OP_WRITE );
 
+#if defined( GK_IO_EPOLL )
+    return IoPort::Submit( (int)socket_, buf, false );
+#else
+
     DWORD bytes = buf->buf.len;
     DWORD flag = 0;
 
+    // gather send when bufs are given
+
+    LPWSABUF bufs   = buf->bufs != 0 ? buf->bufs : (LPWSABUF)&buf->buf;
+    DWORD bufCount  = buf->bufs != 0 ? buf->bufCount : 1;
+
     ::memset( (void*)buf, 0, sizeof(OVERLAPPED) ); // clear!!!
 
     // if we don't clear, then ERROR_INVALID_HANDLE returns. 
@@ -292,8 +359,8 @@ Socket::AsyncSend( IoBlock* buf )
     
     int rc = ::WSASend( 
                     socket_, 
-                    (LPWSABUF)&buf->buf, 
-                    1, 
+                    bufs, 
+                    bufCount, 
                     &bytes, 
                     flag,                       // same as ::send flag
                     (LPOVERLAPPED)buf, 
@@ -313,7 +380,8 @@ Socket::AsyncSend( IoBlock* buf )
 
     // let owner handle error
 
-    return errorCode;    
+    return errorCode;
+#endif
 }
 
 int 
@@ -372,6 +440,10 @@ Socket::AsyncRecvFrom( IoBlock* buf )
     K_ASSERT( buf->buf.len >= 0 ); // we can use 0 buffer recv
     K_ASSERT( buf->op == IoBlock::OP_READ );
 
+#if defined( GK_IO_EPOLL )
+    return IoPort::Submit( (int)socket_, buf, true );
+#else
+
     DWORD bytes = 0;
     DWORD flag = 0;
 
@@ -405,7 +477,8 @@ Socket::AsyncRecvFrom( IoBlock* buf )
 
     // let owner handles error
 
-    return errorCode; 
+    return errorCode;
+#endif
 }
 
 int 
@@ -419,6 +492,10 @@ Socket::AsyncSendTo( IoBlock* buf )
     K_ASSERT( buf->buf.len > 0 ); // send must have data
     K_ASSERT( buf->op == IoBlock::OP_WRITE );
 
+#if defined( GK_IO_EPOLL )
+    return IoPort::Submit( (int)socket_, buf, true );
+#else
+
     DWORD bytes = buf->buf.len;
     DWORD flag = 0;
 
@@ -452,7 +529,8 @@ Socket::AsyncSendTo( IoBlock* buf )
 
     // let owner handles error
 
-    return errorCode; 
+    return errorCode;
+#endif
 }
 
 bool 
@@ -516,6 +594,10 @@ Socket::Close()
 {
     if ( socket_ )
     {
+#if defined( GK_IO_EPOLL )
+        IoPort::Cancel( (int)socket_ ); // before the handle number is reused
+#endif
+
         ::shutdown( socket_, SD_BOTH );
 
         ::closesocket( socket_ );
@@ -594,4 +676,19 @@ Socket::GetLastError()
     return ::WSAGetLastError();
 }
 
+void 
+Socket::onConnected()
+{
+    sockaddr_in addrin;
+
+    int len = sizeof( sockaddr_in );
+
+    ::getsockname( socket_, (SOCKADDR*)&addrin, &len );
+
+    (void)addr_.Init( (SOCKADDR*)&addrin );
+
+    // Init peer address here.
+    (void)this->GetPeerAddress();
+}
+
 } // gk
@@ -63,14 +63,33 @@ public:
 
     /**
      * Accepts a new socket
+     *
+     * @param errorCode Set to 0 if accepted, WSAEWOULDBLOCK if none 
+     *                  is pending, error code otherwise
+     * @return The accepted socket. 0 if failed.
      */
-    Socket* Accept();
+    Socket* Accept( int* errorCode = 0 );
 
     /**
      * Connect to address
      */
     bool Connect( const IpAddress& remote );
 
+    /**
+     * Start to connect on a nonblocking socket. 
+     * Writable or exception on select when done. Then call FinishConnect.
+     *
+     * @return 0 if connected, WSAEWOULDBLOCK if in progress, error code otherwise
+     */
+    int StartConnect( const IpAddress& remote );
+
+    /**
+     * Get result of StartConnect
+     *
+     * @return 0 if connected, error code otherwise
+     */
+    int FinishConnect();
+
     /**
      * Recv from socket 
      */
@@ -173,6 +192,8 @@ private:
     IpAddress peerAddr_;
 
     tstring errorDesc_;
+
+    void onConnected();
 };
 
 } // gk 
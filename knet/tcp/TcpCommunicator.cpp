@@ -3,11 +3,14 @@
 #include <kcore/corebase.h>
 #include <knet/tcp/TcpCommunicator.h>
 
+#include <kcore/sys/Clock.h>
 #include <kcore/sys/Logger.h>
 #include <knet/group/NmGroupRelay.h>
 #include <knet/message/net/NetMessageTypes.h>
 #include <knet/message/net/NetStateMessage.h>
 
+#include <algorithm>
+
 namespace gk {
 
 TcpCommunicator::TcpCommunicator()
@@ -16,7 +19,19 @@ TcpCommunicator::TcpCommunicator()
 , m_acceptors()
 , m_connector()
 , m_messages()
-, m_nextConnectionId( 1 )
+, m_wakeup( 0 )
+, m_recvMode( TcpConnection::RECV_DIRECT )
+, m_compression( Compressor::MODE_NONE )
+, m_highWater( 0 )
+, m_lowWater( 0 )
+, m_sendPolicy( TcpConnection::SEND_QUEUE )
+, m_corked( false )
+, m_corkedIds()
+, m_corkedBytes( 0 )
+, m_corkSince( 0 )
+, m_maxCorkBytes( DEFAULT_CORK_BYTES )
+, m_maxCorkMs( DEFAULT_CORK_MS )
+, m_flushStats()
 {
 }
 
@@ -34,8 +49,6 @@ TcpCommunicator::Init( MessageListener* listener, IoService* ios )
     m_listener 	= listener;
 	m_ios 		= ios;
 
-	m_nextConnectionId = 1;
-
 	m_connector.Init( this );
 
 	LOG( FT_INFO, _T("TcpCommunicator::Init> Inited") );
@@ -136,17 +149,129 @@ TcpCommunicator::Close( uint connectionId )
 	}
 }
 
+void 
+TcpCommunicator::SetConnectRetry( uint timeout, uint attempts )
+{
+	m_connector.SetRetry( timeout, attempts );
+}
+
+void 
+TcpCommunicator::SetRecvMode( TcpConnection::RecvMode mode )
+{
+	m_recvMode = mode;
+}
+
+void 
+TcpCommunicator::SetCompression( uint mode )
+{
+	m_compression = mode;
+}
+
+void 
+TcpCommunicator::SetSendLimits( uint highWater, uint lowWater, uint policy )
+{
+	K_ASSERT( lowWater <= highWater );
+
+	m_highWater  = highWater;
+	m_lowWater 	 = lowWater;
+	m_sendPolicy = policy;
+}
+
+void 
+TcpCommunicator::SetSendLimits( uint connectionId, uint highWater, uint lowWater, uint policy )
+{
+	ConnectionTable::Reader reader( m_connections );
+
+	TcpConnection* c = FindById( connectionId );
+
+	if ( c == 0 )
+	{
+		LOG( FT_WARN, 
+			 _T("TcpCommunicator::SetSendLimits> %d not found"), 
+			 connectionId );
+
+		return;
+	}
+
+	c->SetSendLimits( highWater, lowWater, policy );
+}
+
+bool 
+TcpCommunicator::GetSendQueue( uint connectionId, uint& bytes, uint& frames )
+{
+	ConnectionTable::Reader reader( m_connections );
+
+	TcpConnection* c = FindById( connectionId );
+
+	K_RETURN_V_IF( c == 0, false );
+
+	bytes 	= c->GetQueuedBytes();
+	frames 	= c->GetQueuedFrames();
+
+	return true;
+}
+
+void 
+TcpCommunicator::Cork()
+{
+	m_corked = true;
+}
+
+void 
+TcpCommunicator::Flush()
+{
+	flushCorked();
+
+	m_corked = false;
+}
+
+void 
+TcpCommunicator::SetCorkLimits( uint bytes, uint ms )
+{
+	K_ASSERT( bytes > 0 );
+
+	m_maxCorkBytes 	= bytes;
+	m_maxCorkMs 	= ms;
+}
+
+void 
+TcpCommunicator::SetLowLatency( uint connectionId, bool lowLatency )
+{
+	TcpConnection* c = FindById( connectionId );
+
+	if ( c == 0 )
+	{
+		LOG( FT_WARN, 
+			 _T("TcpCommunicator::SetLowLatency> %d not found"), 
+			 connectionId );
+
+		return;
+	}
+
+	c->SetLowLatency( lowLatency );
+}
+
 void
 TcpCommunicator::Send( uint connectionId, MessagePtr m )
 {
-	ConnectionMap::iterator i( m_connections.find( connectionId ) );
+	K_ASSERT( m.Get() != 0 );
+
+	TcpConnection* c = m_connections.Find( connectionId );
 
-	if ( i != m_connections.end() )
+	if ( c != 0 )
 	{
-		TcpConnection* c = i->second;
-		K_ASSERT( c != 0 );
+		TcpFramePtr frame( new TcpFrame );
 
-		c->Send( m );
+		if ( !frame->Pack( *m, c->GetCipher(), c->GetCompression() ) )
+		{
+			LOG( FT_ERROR, 
+				 _T("TcpCommunicator::Send> Failed to pack %d"), 
+				 m->type );
+
+			return;
+		}
+
+		send( c, frame );
 	}
 	else
 	{
@@ -157,22 +282,27 @@ TcpCommunicator::Send( uint connectionId, MessagePtr m )
 }
 
 void 
-TcpCommunicator::Send( const std::vector<uint> connections, MessagePtr m )
+TcpCommunicator::Send( const std::vector<uint>& connections, MessagePtr m )
 {
-	std::vector<uint>::const_iterator i( connections.begin() );
-	std::vector<uint>::const_iterator iEnd( connections.end() );
+	K_ASSERT( m.Get() != 0 );
 
-	for ( ; i != iEnd; ++i )
-	{
-		Send( *i, m );
-	}
+	multicast( connections, m.Get(), 0, 0 );
 }
 
 void
 TcpCommunicator::Run()
 {
+	if ( m_corkedBytes > 0 && Clock::Now() - m_corkSince >= m_maxCorkMs )
+	{
+		++m_flushStats.ageFlushes;
+
+		flushCorked();
+	}
+
 	processConnections();
 	processMessages();
+
+	m_connections.Reclaim();
 }
 
 void 
@@ -189,28 +319,56 @@ TcpCommunicator::Notify( MessagePtr m )
 	case NET_GROUP_RELAY:
 	// add more message if required
 		m_messages.Put( m );
+
+		if ( m_wakeup != 0 )
+		{
+			m_wakeup->Signal();
+		}
 		return;
 	}
 
 	m_listener->Notify( m );
 }
 
+void
+TcpCommunicator::SetWakeup( Event* wakeup )
+{
+	m_wakeup = wakeup;
+}
+
+uint
+TcpCommunicator::GetWaitMs( uint maxMs ) const
+{
+	K_RETURN_V_IF( m_corkedBytes == 0, maxMs );
+
+	uint8 age = Clock::Now() - m_corkSince;
+
+	K_RETURN_V_IF( age >= m_maxCorkMs, 0 );
+
+	return std::min<uint>( maxMs, m_maxCorkMs - (uint)age );
+}
+
 void
 TcpCommunicator::Fini()
 {
 	LOG( FT_DEBUG, _T("TcpCommunicator::Fini> start to finish") );
 
+	cleanupAcceptors(); // acceptors create connections
+
+	LOG( FT_DEBUG, _T("TcpCommunicator::Fini> acceptors") );
+
 	cleanupMessages();
 
 	LOG( FT_DEBUG, _T("TcpCommunicator::Fini> messages") );
 
-	cleanupConnections();
+	m_corkedIds.clear();
 
-	LOG( FT_DEBUG, _T("TcpCommunicator::Fini> connections") );
+	m_corked 		= false;
+	m_corkedBytes 	= 0;
 
-	cleanupAcceptors();
+	cleanupConnections();
 
-	LOG( FT_DEBUG, _T("TcpCommunicator::Fini> acceptors") );
+	LOG( FT_DEBUG, _T("TcpCommunicator::Fini> connections") );
 
 	m_connector.Fini();
 
@@ -220,25 +378,17 @@ TcpCommunicator::Fini()
 TcpConnection* 
 TcpCommunicator::FindById( uint id )
 {
-	ConnectionMap::iterator i( m_connections.find( id ) );
-
-	if ( i == m_connections.end() )
-	{
-		return (TcpConnection*)0;
-	}
-
-	return i->second;
+	return m_connections.Find( id );
 }
 
 void 
 TcpCommunicator::processConnections()
 {
-    ConnectionMap::iterator i(m_connections.begin());
+	uint count = m_connections.GetSlotCount();
 
-    for ( ; i != m_connections.end(); )
+    for ( uint i = 0; i < count; ++i )
     {
-        TcpConnection* c = i->second;
-        K_ASSERT( c != 0 );
+        TcpConnection* c = m_connections.GetAt( i );
 
         if ( c )
         {
@@ -252,11 +402,7 @@ TcpCommunicator::processConnections()
 						 _T("TcpCommunicator::processConnections> Cleaning %d"), 
 						 c->GetId() );
 
-                    delete c;
-
-                    i = m_connections.erase( i );
-
-                    continue;
+					m_connections.Retire( c ); // deleted when no reader can see it
                 }
             }
             else
@@ -264,8 +410,6 @@ TcpCommunicator::processConnections()
                 c->Run();
             }
         }
-
-        ++i;
     }
 }
 
@@ -323,6 +467,17 @@ TcpCommunicator::onStateMessage( MessagePtr m )
 			m_listener->Notify( m );
 		}
 		break;
+	case NetStateMessage::TCP_SEND_HIGH_WATER:
+	case NetStateMessage::TCP_SEND_LOW_WATER:
+		{
+			LOG( FT_DEBUG, 
+				 _T("TcpCommunicator::onStateMessage> Conn %d send water %d bytes"), 
+				 nsm->connectionId, 
+				 nsm->queued );
+
+			m_listener->Notify( m );
+		}
+		break;
 	}
 }
 
@@ -335,56 +490,155 @@ TcpCommunicator::onRelayMessage( MessagePtr m )
 		 _T("TcpCommunicator::onRelayMessage> len %d"), 
 		 relay->len );
 
-	std::vector<uint>::iterator i 	 = relay->relays.begin();
-	std::vector<uint>::iterator iEnd = relay->relays.end();
+	// send only data part
+
+	multicast( relay->relays, 0, relay->data, relay->len );
+}
+
+void 
+TcpCommunicator::multicast( const std::vector<uint>& connections, 
+							Message* m, const void* data, uint len )
+{
+	K_ASSERT( m != 0 || data != 0 );
+
+	// ECB encryption gives same bytes for same key. 
+	// So a frame is packed once per compression and key and shared.
+
+	FrameMap frames;
+
+	std::vector<uint>::const_iterator i( connections.begin() );
+	std::vector<uint>::const_iterator iEnd( connections.end() );
 
 	for ( ; i != iEnd; ++i )
 	{
-		// send only data part
-
 		TcpConnection* c = FindById( *i );
 
-		if ( c != 0 )
+		if ( c == 0 )
+		{
+			LOG( FT_WARN, 
+				 _T("TcpCommunicator::multicast> %d not found"), 
+				 *i );
+
+			continue;
+		}
+
+		Cipher* cipher 	 = c->GetCipher();
+		uint compression = c->GetCompression();
+
+		std::string key( 1, (char)compression );
+
+		if ( cipher != 0 )
+		{
+			key.push_back( (char)cipher->GetAlgorithm() );
+			key.append( (const char*)cipher->GetEncryptionKey(), 
+						cipher->GetEncryptionKeyLength() );
+		}
+
+		FrameMap::iterator fi( frames.find( key ) );
+
+		if ( fi == frames.end() )
 		{
-			c->Send( relay->data, relay->len );
+			TcpFramePtr frame( new TcpFrame );
+
+			bool rc = ( m != 0 ) ? frame->Pack( *m, cipher, compression ) 
+								 : frame->Pack( data, len, cipher, compression );
+
+			if ( !rc )
+			{
+				LOG( FT_ERROR, 
+					 _T("TcpCommunicator::multicast> Failed to pack for %d"), 
+					 *i );
+
+				continue;
+			}
+
+			fi = frames.insert( FrameMap::value_type( key, frame ) ).first;
 		}
+
+		send( c, fi->second );
 	}
 }
 
 void 
-TcpCommunicator::onNewConnection( Socket* s, SecurityLevel sl, bool accepted )
+TcpCommunicator::send( TcpConnection* c, TcpFramePtr frame )
 {
-	K_ASSERT( s != 0 );
+	K_ASSERT( c != 0 );
+	K_ASSERT( frame.Get() != 0 );
 
-	TcpConnection* c = new TcpConnection;
+	if ( m_corked && !c->IsCorked() && c->Cork() )
+	{
+		m_corkedIds.push_back( c->GetId() );
+	}
 
-	bool rc = c->Init( this, ++m_nextConnectionId, s, sl, accepted );
+	uint len = frame->GetLength();
 
-	if ( !rc )
+	c->Send( frame );
+
+	K_RETURN_IF( !c->IsCorked() );
+
+	if ( m_corkedBytes == 0 )
 	{
-		LOG( FT_ERROR, 
-			 _T("TcpCommunicator::onNewConnection> Connection init failed on Socket %d"), 
-			 s->GetSystemSocket() );
-		
-		c->Fini();
+		m_corkSince = Clock::Now();
+	}
 
-		delete c;
+	m_corkedBytes += len;
 
-		return;
+	++m_flushStats.frames;
+
+	if ( m_corkedBytes >= m_maxCorkBytes )
+	{
+		++m_flushStats.sizeFlushes;
+
+		flushCorked(); // still corked for later sends
 	}
+}
 
-	rc = m_ios->BindIo( c );
+void 
+TcpCommunicator::flushCorked()
+{
+	K_RETURN_IF( m_corkedIds.empty() );
 
-	if ( !rc )
+	std::vector<uint>::const_iterator i( m_corkedIds.begin() );
+	std::vector<uint>::const_iterator iEnd( m_corkedIds.end() );
+
+	for ( ; i != iEnd; ++i )
 	{
-		LOG( FT_ERROR, 
-			 _T("TcpCommunicator::onNewConnection> Bind io failed on Socket %d"), 
-			 s->GetSystemSocket() );
+		TcpConnection* c = FindById( *i );
 
-		 c->Fini();
+		if ( c != 0 )
+		{
+			c->Flush();
+		}
+	}
 
-		delete c;
+	m_corkedIds.clear();
+
+	if ( m_corkedBytes > 0 )
+	{
+		uint delay = (uint)( Clock::Now() - m_corkSince );
+
+		++m_flushStats.flushes;
+
+		m_flushStats.totalDelay += delay;
+
+		if ( delay > m_flushStats.maxDelay )
+		{
+			m_flushStats.maxDelay = delay;
+		}
+	}
+
+	m_corkedBytes = 0;
+}
+
+void 
+TcpCommunicator::onNewConnection( Socket* s, SecurityLevel sl, bool accepted )
+{
+	K_ASSERT( s != 0 );
+
+	TcpConnection* c = CreateConnection( s, sl, accepted );
 
+	if ( c == 0 )
+	{
 		return;
 	}
 
@@ -392,12 +646,14 @@ TcpCommunicator::onNewConnection( Socket* s, SecurityLevel sl, bool accepted )
 
 	if ( accepted )
 	{
-		rc = m_ios->BeginRecv( c );
+		bool rc = m_ios->BeginRecv( c );
 
 		if ( !rc )
 		{
 			LOG( FT_ERROR, _T("TcpCommunicator::onNewConnection> %d BeginRecv fail"), c->GetId() );
 
+			m_connections.Free( c->GetId() );
+
 			c->Fini();
 
 			delete c;
@@ -406,7 +662,7 @@ TcpCommunicator::onNewConnection( Socket* s, SecurityLevel sl, bool accepted )
 		}
 	}
 
-	m_connections.insert( ConnectionMap::value_type( c->GetId(), c ) );
+	m_connections.Set( c->GetId(), c );
 
 	if ( accepted )
 	{
@@ -423,6 +679,122 @@ TcpCommunicator::onNewConnection( Socket* s, SecurityLevel sl, bool accepted )
 		 s->GetSystemSocket() );
 }
 
+bool 
+TcpCommunicator::StartAccepted( TcpConnection* c )
+{
+	K_ASSERT( c != 0 );
+
+	// in the list before recv, so that Run sees every message from it. 
+	// from Set, Run can retire it on error. the reader keeps it alive here.
+
+	ConnectionTable::Reader reader( m_connections );
+
+	m_connections.Set( c->GetId(), c );
+
+	bool rc = m_ios->BeginRecv( c );
+
+	if ( !rc )
+	{
+		LOG( FT_ERROR, _T("TcpCommunicator::StartAccepted> %d BeginRecv fail"), c->GetId() );
+
+		return false; // error is set. cleaned up in Run.
+	}
+
+	c->StartHandshake();
+
+	LOG( FT_DEBUG, 
+		 _T("TcpCommunicator::StartAccepted> Connection %d open"), 
+		 c->GetId() );
+
+	return true;
+}
+
+TcpConnection* 
+TcpCommunicator::CreateConnection( Socket* s, SecurityLevel sl, bool accepted )
+{
+	K_ASSERT( s != 0 );
+
+	uint id = m_connections.Alloc();
+
+	if ( id == 0 )
+	{
+		LOG( FT_ERROR, 
+			 _T("TcpCommunicator::CreateConnection> No slot for Socket %d"), 
+			 s->GetSystemSocket() );
+
+		delete s;
+
+		return (TcpConnection*)0;
+	}
+
+	TcpConnection* c = new TcpConnection;
+
+	bool rc = c->Init( this, id, s, sl, accepted );
+
+	c->SetRecvMode( m_recvMode );
+	c->SetCompression( m_compression );
+	c->SetSendLimits( m_highWater, m_lowWater, m_sendPolicy );
+
+	if ( !rc )
+	{
+		LOG( FT_ERROR, 
+			 _T("TcpCommunicator::CreateConnection> Connection init failed on Socket %d"), 
+			 s->GetSystemSocket() );
+		
+		m_connections.Free( id );
+
+		c->Fini();
+
+		delete c;
+
+		return (TcpConnection*)0;
+	}
+
+	rc = m_ios->BindIo( c );
+
+	if ( !rc )
+	{
+		LOG( FT_ERROR, 
+			 _T("TcpCommunicator::CreateConnection> Bind io failed on Socket %d"), 
+			 s->GetSystemSocket() );
+
+		m_connections.Free( id );
+
+		c->Fini();
+
+		delete c;
+
+		return (TcpConnection*)0;
+	}
+
+	return c;
+}
+
+Acceptor::Stats 
+TcpCommunicator::GetAcceptStats() const
+{
+	Acceptor::Stats total;
+
+	AcceptorMap::const_iterator i( m_acceptors.begin() );
+	AcceptorMap::const_iterator iEnd( m_acceptors.end() );
+
+	for ( ; i != iEnd; ++i )
+	{
+		const Acceptor::Stats& stats = i->second->GetStats();
+
+		total.accepted 	+= stats.accepted;
+		total.failed 	+= stats.failed;
+		total.batches 	+= stats.batches;
+
+		if ( stats.maxBatch > total.maxBatch )
+		{
+			total.maxBatch = stats.maxBatch;
+		}
+	}
+
+	return total;
+}
+
 void 
 TcpCommunicator::cleanupMessages()
 {
@@ -458,20 +830,21 @@ TcpCommunicator::cleanupMessages()
 void 
 TcpCommunicator::cleanupConnections()
 {
-    ConnectionMap::iterator i( m_connections.begin());
-    ConnectionMap::iterator iEnd( m_connections.end());
+	uint count = m_connections.GetSlotCount();
 
-    for ( ; i != iEnd; ++i )
+    for ( uint i = 0; i < count; ++i )
     {
-        TcpConnection* c = i->second;
-        K_ASSERT( c != 0 );
+        TcpConnection* c = m_connections.GetAt( i );
 
-        c->Fini(); 
+		if ( c != 0 )
+		{
+			c->Fini(); 
 
-        delete c;
+			delete c;
+		}
     }
 
-    m_connections.clear();
+    m_connections.Clear();
 }
 
 void 
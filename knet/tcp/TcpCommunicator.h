@@ -1,15 +1,19 @@
 #pragma once 
 
+#include <kcore/sys/Event.h>
 #include <knet/aio/IoService.h>
 #include <knet/message/Message.h>
 #include <knet/message/MessageListener.h>
 #include <knet/tcp/impl/TcpConnection.h>
 #include <knet/tcp/impl/Acceptor.h>
+#include <knet/tcp/impl/ConnectionTable.h>
 #include <knet/tcp/impl/Connector.h>
 #include <knet/socket/Socket.h>
 #include <knet/NetSecurity.h>
 
 #include <map>
+#include <string>
+#include <vector>
 
 namespace gk
 {
@@ -18,9 +22,45 @@ namespace gk
  *
  * Maintains a list of connected connections
  * and communicates with those connections.
+ *
+ * Between Cork and Flush, connections sent to hold their frames and 
+ * send them together on Flush. Corked frames are flushed early when 
+ * the corked bytes reach a limit or the first corked frame gets old.
+ * Run checks the age. So the latency added is bounded by the age limit 
+ * and the tick interval.
  */
 class TcpCommunicator 
 {
+public:
+	enum 
+	{
+		  DEFAULT_CORK_BYTES = 32768 	// flush when corked bytes reach this
+		, DEFAULT_CORK_MS = 10 			// flush when the first corked frame is this old
+	};
+
+	/**
+	 * Counters for corked sends
+	 */
+	struct FlushStats
+	{
+		uint 	flushes; 		///< flushes with corked frames
+		uint 	sizeFlushes; 	///< flushes by the byte limit
+		uint 	ageFlushes; 	///< flushes by the age limit
+		uint 	frames; 		///< frames sent corked
+		uint 	maxDelay; 		///< max ms from the first corked frame to flush
+		uint8 	totalDelay; 	///< sum of ms from the first corked frame to flush
+
+		FlushStats()
+			: flushes( 0 )
+			, sizeFlushes( 0 )
+			, ageFlushes( 0 )
+			, frames( 0 )
+			, maxDelay( 0 )
+			, totalDelay( 0 )
+		{
+		}
+	};
+
 public:
     TcpCommunicator();
     virtual ~TcpCommunicator();
@@ -57,6 +97,89 @@ public:
 	 */
 	void Connect( const IpAddress& remote );
 
+	/**
+	 * Set connect timeout and attempts. Call before Init.
+	 *
+	 * @param timeout Milliseconds per attempt
+	 * @param attempts Attempts before TCP_CONNECT_FAIL
+	 */
+	void SetConnectRetry( uint timeout, uint attempts );
+
+	/**
+	 * Set recv mode of connections created later
+	 *
+	 * @param mode The recv mode. RECV_DIRECT by default.
+	 */
+	void SetRecvMode( TcpConnection::RecvMode mode );
+
+	/**
+	 * Set compression of connections created later. 
+	 * Offered by accepted connections and accepted by connected ones.
+	 *
+	 * @param mode Compressor::Mode. MODE_NONE by default.
+	 */
+	void SetCompression( uint mode );
+
+	/**
+	 * Set send queue limits of connections created later
+	 *
+	 * @param highWater Queued bytes to notify and apply policy over. 0 for no limit.
+	 * @param lowWater Queued bytes to notify at after going over high water
+	 * @param policy TcpConnection::SendPolicy bits
+	 */
+	void SetSendLimits( uint highWater, uint lowWater, uint policy );
+
+	/**
+	 * Set send queue limits of a connection. Thread safe.
+	 *
+	 * @param connectionId The connection id
+	 * @param highWater Queued bytes to notify and apply policy over. 0 for no limit.
+	 * @param lowWater Queued bytes to notify at after going over high water
+	 * @param policy TcpConnection::SendPolicy bits
+	 */
+	void SetSendLimits( uint connectionId, uint highWater, uint lowWater, uint policy );
+
+	/**
+	 * Get send queue depth of a connection. Thread safe.
+	 *
+	 * @param connectionId The connection id
+	 * @param bytes [out] Bytes queued and being sent
+	 * @param frames [out] Frames queued and being sent
+	 * @return false if not found
+	 */
+	bool GetSendQueue( uint connectionId, uint& bytes, uint& frames );
+
+	/**
+	 * Hold frames of connections sent to until Flush
+	 */
+	void Cork();
+
+	/**
+	 * Send held frames and stop corking
+	 */
+	void Flush();
+
+	/**
+	 * Set limits to flush corked frames early
+	 *
+	 * @param bytes Corked bytes to flush at
+	 * @param ms Age of the first corked frame to flush at
+	 */
+	void SetCorkLimits( uint bytes, uint ms );
+
+	/**
+	 * Set a connection low latency. A low latency connection is not corked.
+	 *
+	 * @param connectionId The connection id
+	 * @param lowLatency true to send right away always
+	 */
+	void SetLowLatency( uint connectionId, bool lowLatency );
+
+	/**
+	 * Get counters for corked sends
+	 */
+	const FlushStats& GetFlushStats() const;
+
 	/**
 	 * Close a connection 
 	 *
@@ -75,16 +198,35 @@ public:
 	/**
 	 * Send a message to several connections 
 	 *
+	 * The message is packed once for plain connections and once per 
+	 * session key for encrypted ones. Connections share the frames.
+	 *
 	 * @param connections The list of connection ids to send to 
 	 * @param m The message to send
 	 */
-    void Send( const std::vector<uint> connections, MessagePtr m );
+    void Send( const std::vector<uint>& connections, MessagePtr m );
 
     /**
      * Tick function. Not a thread function.
      */
     void Run();
 
+	/**
+	 * Set the event of the thread calling Run. 
+	 * Signalled when a message is queued for Run.
+	 *
+	 * @param wakeup The event. 0 to clear.
+	 */
+	void SetWakeup( Event* wakeup );
+
+	/**
+	 * Get how long the thread calling Run can wait when idle
+	 *
+	 * @param maxMs The longest wait of the caller
+	 * @return Time until the corked frames are due. maxMs if none.
+	 */
+	uint GetWaitMs( uint maxMs ) const;
+
 	/**
 	 * Called when to notify message. 
 	 *
@@ -100,17 +242,50 @@ public:
     void Fini();
 
 	/**
-	 * Find connection. Used only by NetClient or NetServer
+	 * Create a connection on a socket and bind it to IoService. 
+	 * Thread safe. Used by Acceptor to start handshake right after accept.
+	 *
+	 * @param s The socket accepted or connected
+	 * @param sl The security level
+	 * @param accepted The flag for accepted or connected
+	 * @return The connection. 0 if failed and the socket is deleted.
+	 */
+	TcpConnection* CreateConnection( Socket* s, SecurityLevel sl, bool accepted );
+
+	/**
+	 * Add an accepted connection to the list, then start recv and 
+	 * handshake on the calling thread. Thread safe. Used by Acceptor.
+	 *
+	 * @param c The connection from CreateConnection
+	 * @return false if recv failed. Run cleans it up.
+	 */
+	bool StartAccepted( TcpConnection* c );
+
+	/**
+	 * Get accept counters summed over acceptors. 
+	 * Rate is the difference of accepted over time.
+	 */
+	Acceptor::Stats GetAcceptStats() const;
+
+	/**
+	 * Find connection. On the thread calling Run, or inside a 
+	 * ConnectionTable::Reader on GetConnections() on other threads. 
+	 * Do not keep the connection past either.
 	 *
 	 * @param id The connection id to find
 	 * @return The TcpConnection found. 0 if not found.
 	 */
 	TcpConnection* FindById( uint id );
 
+	/**
+	 * Get the connection table for a ConnectionTable::Reader
+	 */
+	ConnectionTable& GetConnections();
+
 
 private:
-	typedef std::map<uint, TcpConnection*> ConnectionMap;
 	typedef std::map<uint, Acceptor*> AcceptorMap;
+	typedef std::map<std::string, TcpFramePtr> FrameMap;
 
 	void processConnections();
 	void processMessages();
@@ -118,6 +293,12 @@ private:
 	void onStateMessage( MessagePtr m );
 	void onRelayMessage( MessagePtr m );
 
+	void multicast( const std::vector<uint>& connections, 
+					Message* m, const void* data, uint len );
+
+	void send( TcpConnection* c, TcpFramePtr frame );
+	void flushCorked();
+
 	void onNewConnection( Socket* s, SecurityLevel sl, bool accepted );
 
 	void cleanupMessages();
@@ -128,13 +309,41 @@ private:
 	MessageListener* m_listener;
 	IoService* 		 m_ios;
 
-    ConnectionMap   m_connections;      // normal connections including udp
+    ConnectionTable m_connections;      // normal connections including udp
 	AcceptorMap 	m_acceptors;
 	Connector 		m_connector;		// A threaded connector
 
 	MessageQ 		m_messages;
-	uint 			m_nextConnectionId;
+	Event* 			m_wakeup; 			// of the thread calling Run
+
+	TcpConnection::RecvMode m_recvMode;
+	uint 				m_compression;
+	uint 				m_highWater;
+	uint 				m_lowWater;
+	uint 				m_sendPolicy;
+
+	bool 				m_corked;
+	std::vector<uint> 	m_corkedIds; 	// connections corked since the last flush
+	uint 				m_corkedBytes;
+	uint8 				m_corkSince; 	// time of the first corked frame
+	uint 				m_maxCorkBytes;
+	uint 				m_maxCorkMs;
+	FlushStats 			m_flushStats;
 };
 
+inline
+const TcpCommunicator::FlushStats& 
+TcpCommunicator::GetFlushStats() const
+{
+	return m_flushStats;
+}
+
+inline
+ConnectionTable& 
+TcpCommunicator::GetConnections()
+{
+	return m_connections;
+}
+
 } // gk
 
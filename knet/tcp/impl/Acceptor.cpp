@@ -4,14 +4,16 @@
 #include <knet/tcp/impl/Acceptor.h>
 
 #include <kcore/sys/Logger.h>
-#include <knet/message/net/NetStateMessage.h>
 #include <knet/tcp/TcpCommunicator.h>
+#include <knet/tcp/impl/TcpConnection.h>
 
 namespace gk {
 
 Acceptor::Acceptor()
 : m_communicator( 0 )
 , m_socket( 0 )
+, m_sl( SECURITY0 )
+, m_stats()
 {
 }
 
@@ -30,6 +32,8 @@ Acceptor::Init( TcpCommunicator* communicator, Socket* socket, SecurityLevel sl
 	m_socket 		= socket;
 	m_sl 			= sl;
 
+	m_socket->SetNonblocking();
+
     Start();
 
     return true;
@@ -40,27 +44,50 @@ Acceptor::Run()
 {
     while ( IsRunning() )
     {
-        Socket* socket = m_socket->Accept();
-        K_ASSERT( socket != 0 );
-
-		if ( !IsRunning() ) // check running state again
+		if ( !waitAccept() )
 		{
-			break;
+			continue;
 		}
 
-		NetStateMessage* m = new NetStateMessage;
+		uint batch = 0;
+
+		while ( batch < MAX_BATCH )
+		{
+			if ( !IsRunning() ) // check running state again
+			{
+				break;
+			}
+
+			int errorCode = 0;
+
+			Socket* socket = m_socket->Accept( &errorCode );
 
-		m->state  = NetStateMessage::TCP_ACCEPTED;
-        m->addr   = socket->GetPeerAddress();
-        m->socket = socket;
-		m->sl 	  = m_sl;
+			if ( socket == 0 )
+			{
+				if ( onAcceptError( errorCode ) )
+				{
+					continue;
+				}
 
-		m_communicator->Notify( MessagePtr( m ) );
+				break;
+			}
+
+			onAccepted( socket );
+
+			++batch;
+		}
+
+		if ( batch > 0 )
+		{
+			m_stats.accepted += batch;
 
-        LOG( FT_DEBUG,
-             _T("Accepted new connection %d from %s"),
-             socket->GetSystemSocket(),
-             m->addr.ToString().c_str() );
+			++m_stats.batches;
+
+			if ( batch > m_stats.maxBatch )
+			{
+				m_stats.maxBatch = batch;
+			}
+		}
     }
 
     return 0;
@@ -83,20 +110,81 @@ Acceptor::Fini()
 	LOG( FT_INFO, _T("Acceptor::Fini> Finished") );
 }
 
-void
-Acceptor::helpStop()
+bool 
+Acceptor::waitAccept()
 {
-    Socket client;
+	SOCKET fd = m_socket->GetSystemSocket();
 
-    if ( client.CreateTcpSocket() )
-    {
-		IpAddress addr;
+	fd_set readSet;
 
-		addr.Init( _T("127.0.0.1"), m_socket->GetAddress().GetPort() );
+	FD_ZERO( &readSet );
+	FD_SET( fd, &readSet );
 
-        (void)client.Connect( m_socket->GetAddress() );
-		(void)client.Connect( addr );
-    }
+	timeval tv;
+
+	tv.tv_sec  = 0;
+	tv.tv_usec = WAIT_MS * 1000;
+
+	int rc = ::select( (int)fd + 1, &readSet, 0, 0, &tv );
+
+	return rc > 0;
+}
+
+bool 
+Acceptor::onAcceptError( int errorCode )
+{
+	switch ( errorCode )
+	{
+	case WSAEWOULDBLOCK:
+		return false; 	// batch done
+
+	case WSAECONNRESET: 
+		return true; 	// reset by peer before accept. try the next one.
+
+	default:
+		break;
+	}
+
+	++m_stats.errors;
+
+	LOG( FT_ERROR, 
+		 _T("Acceptor::onAcceptError> Accept failed %d. Backoff %d ms"), 
+		 errorCode, 
+		 ERROR_BACKOFF_MS );
+
+	Thread::Sleep( ERROR_BACKOFF_MS );
+
+	return false;
+}
+
+void 
+Acceptor::onAccepted( Socket* socket )
+{
+	K_ASSERT( socket != 0 );
+
+	IpAddress addr = socket->GetPeerAddress();
+
+	TcpConnection* c = m_communicator->CreateConnection( socket, m_sl, true );
+
+	if ( c == 0 )
+	{
+		++m_stats.failed;
+
+		return; // socket is deleted
+	}
+
+	LOG( FT_DEBUG,
+		 _T("Accepted new connection %d from %s"),
+		 c->GetId(),
+		 addr.ToString().c_str() );
+
+	// added to the list, then recv and handshake start here. 
+	// c is owned by the communicator from here.
+
+	if ( !m_communicator->StartAccepted( c ) )
+	{
+		++m_stats.failed;
+	}
 }
 
 } // gk
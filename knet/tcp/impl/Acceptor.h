@@ -15,10 +15,48 @@ class TcpCommunicator;
  * Accepts client connections. 
  *
  * AcceptEx is not used. Thread approach is much simpler. 
- * 
+ *
+ * The listening socket is nonblocking. When select reports it readable, 
+ * accepts are repeated until it would block, up to MAX_BATCH. Each 
+ * connection is created, bound, added to the connection list, and 
+ * starts recv and handshake on this thread. The handshake does not 
+ * wait for the next TcpCommunicator::Run.
+ *
+ * When accept fails for lack of resources such as descriptors or 
+ * buffers, the pending connection stays and select keeps reporting it. 
+ * So the thread backs off ERROR_BACKOFF_MS instead of spinning.
  */
 class Acceptor : public Thread
 {
+public:
+	enum 
+	{
+		  MAX_BATCH 		= 256 		// accepts per wakeup
+		, WAIT_MS 			= 100 		// select wait to check stop
+		, ERROR_BACKOFF_MS 	= 100 		// wait after an accept error
+	};
+
+	/**
+	 * Accept counters. Read without lock.
+	 */
+	struct Stats
+	{
+		uint 	accepted; 		///< connections accepted
+		uint 	failed; 		///< connections failed to create
+		uint 	errors; 		///< accept errors other than would block
+		uint 	batches; 		///< wakeups with accepts
+		uint 	maxBatch; 		///< max accepts in a wakeup
+
+		Stats()
+			: accepted( 0 )
+			, failed( 0 )
+			, errors( 0 )
+			, batches( 0 )
+			, maxBatch( 0 )
+		{
+		}
+	};
+
 public:
     Acceptor();
     virtual ~Acceptor();
@@ -43,14 +81,29 @@ public:
 	 */
     void Fini();
 
+	/**
+	 * Get accept counters
+	 */
+	const Stats& GetStats() const;
+
 private:
-    void helpStop();
+	bool waitAccept();
+	bool onAcceptError( int errorCode );
+	void onAccepted( Socket* socket );
 
 private:
 	TcpCommunicator* m_communicator;
 	Socket*          m_socket;    
 	SecurityLevel    m_sl;
+	Stats 			 m_stats;
 };
 
+inline
+const Acceptor::Stats& 
+Acceptor::GetStats() const
+{
+	return m_stats;
+}
+
 } // gk
 
@@ -0,0 +1,227 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <knet/tcp/impl/ConnectionTable.h>
+
+#include <kcore/sys/ScopedLock.h>
+#include <knet/tcp/impl/TcpConnection.h>
+
+namespace gk {
+
+ConnectionTable::ConnectionTable()
+: m_slotCount( 0 )
+, m_count( 0 )
+, m_free()
+, m_lock()
+, m_epoch( 0 )
+, m_retired()
+, m_reclaim()
+{
+	m_readers[0] = 0;
+	m_readers[1] = 0;
+
+	for ( int i = 0; i < CHUNKS; ++i )
+	{
+		m_chunks[i] = 0;
+	}
+}
+
+ConnectionTable::~ConnectionTable()
+{
+	deleteAll( m_retired );
+	deleteAll( m_reclaim );
+
+	for ( int i = 0; i < CHUNKS; ++i )
+	{
+		delete [] m_chunks[i];
+
+		m_chunks[i] = 0;
+	}
+}
+
+uint 
+ConnectionTable::Alloc()
+{
+	ScopedLock sl( m_lock );
+
+	uint index = m_slotCount;
+
+	// reuse the oldest freed slot when enough are free or no new slot is left
+
+	if ( m_free.size() > QUARANTINE || ( !m_free.empty() && index >= MAX_SLOTS ) )
+	{
+		index = m_free.front();
+
+		m_free.pop_front();
+	}
+	else
+	{
+		K_RETURN_V_IF( index >= MAX_SLOTS, 0 );
+
+		uint chunk = index >> CHUNK_BITS;
+
+		if ( m_chunks[chunk] == 0 )
+		{
+			Slot* slots = new Slot[CHUNK_SIZE];
+
+			for ( int i = 0; i < CHUNK_SIZE; ++i )
+			{
+				slots[i].id 		= 0;
+				slots[i].connection = 0;
+				slots[i].gen 		= 1; // id is never 0
+			}
+
+			m_chunks[chunk] = slots;
+		}
+
+		m_slotCount = index + 1; // after the chunk is published
+	}
+
+	Slot* slot = getSlot( index );
+	K_ASSERT( slot != 0 );
+
+	return ( slot->gen << INDEX_BITS ) | index;
+}
+
+void 
+ConnectionTable::Set( uint id, TcpConnection* c )
+{
+	K_ASSERT( id != 0 );
+	K_ASSERT( c != 0 );
+
+	Slot* slot = getSlot( id & INDEX_MASK );
+	K_ASSERT( slot != 0 );
+	K_ASSERT( slot->id == 0 );
+	K_ASSERT( ( slot->gen << INDEX_BITS | ( id & INDEX_MASK ) ) == id );
+
+	slot->connection = c;
+	slot->id 		 = id; 	// connection is visible before the id
+
+	m_count.Inc();
+}
+
+void 
+ConnectionTable::Free( uint id )
+{
+	K_ASSERT( id != 0 );
+
+	ScopedLock sl( m_lock );
+
+	uint index = id & INDEX_MASK;
+
+	Slot* slot = getSlot( index );
+	K_ASSERT( slot != 0 );
+	K_RETURN_IF( slot == 0 );
+
+	K_ASSERT( ( slot->gen << INDEX_BITS | index ) == id );
+	K_RETURN_IF( ( slot->gen << INDEX_BITS | index ) != id );
+
+	if ( slot->id == id )
+	{
+		slot->id = 0;
+
+		m_count.Dec();
+	}
+
+	slot->connection = 0;
+
+	slot->gen = ( slot->gen + 1 ) & GEN_MASK;
+
+	if ( slot->gen == 0 )
+	{
+		slot->gen = 1;
+	}
+
+	m_free.push_back( index );
+}
+
+void 
+ConnectionTable::Retire( TcpConnection* c )
+{
+	K_ASSERT( c != 0 );
+
+	Free( c->GetId() );
+
+	m_retired.push_back( c );
+}
+
+void 
+ConnectionTable::Reclaim()
+{
+	K_RETURN_IF( m_retired.empty() && m_reclaim.empty() );
+
+	uint epoch = m_epoch;
+
+	// readers of the previous epoch can still see m_reclaim
+
+	K_RETURN_IF( m_readers[( epoch + 1 ) & 1] != 0 );
+
+	deleteAll( m_reclaim );
+
+	m_reclaim.swap( m_retired );
+
+	m_epoch = epoch + 1; // readers of this epoch can see m_reclaim now
+}
+
+void 
+ConnectionTable::Clear()
+{
+	deleteAll( m_retired );
+	deleteAll( m_reclaim );
+
+	ScopedLock sl( m_lock );
+
+	uint count = m_slotCount;
+
+	for ( uint i = 0; i < count; ++i )
+	{
+		Slot* slot = getSlot( i );
+
+		if ( slot->id != 0 )
+		{
+			Free( slot->id );
+		}
+	}
+}
+
+uint 
+ConnectionTable::enter()
+{
+	for ( ;; )
+	{
+		uint epoch = m_epoch;
+
+		m_readers[epoch & 1].Inc();
+
+		// counted before the flip. otherwise Reclaim may not see it.
+
+		if ( m_epoch == epoch )
+		{
+			return epoch;
+		}
+
+		m_readers[epoch & 1].Dec();
+	}
+}
+
+void 
+ConnectionTable::leave( uint epoch )
+{
+	m_readers[epoch & 1].Dec();
+}
+
+void 
+ConnectionTable::deleteAll( ConnectionList& l )
+{
+	ConnectionList::iterator i( l.begin() );
+	ConnectionList::iterator iEnd( l.end() );
+
+	for ( ; i != iEnd; ++i )
+	{
+		delete *i;
+	}
+
+	l.clear();
+}
+
+} // gk
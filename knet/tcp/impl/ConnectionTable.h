@@ -0,0 +1,265 @@
+#pragma once
+
+#include <kcore/base/Noncopyable.h>
+#include <kcore/sys/Atomic.h>
+#include <kcore/sys/Lock.h>
+
+#include <deque>
+#include <vector>
+
+namespace gk
+{
+
+class TcpConnection;
+
+/**
+ * @class ConnectionTable
+ *
+ * Slot table of TCP connections indexed by connection id.
+ *
+ * An id is a slot index in the low INDEX_BITS and the generation of 
+ * the slot above them. A slot gets a new generation when freed. So 
+ * a stale id does not find the connection reusing the slot.
+ *
+ * Freed slots are reused first in first out, and only when more than 
+ * QUARANTINE slots are free. A slot is then reused after at least 
+ * QUARANTINE other frees, so GEN_BITS generations wrap only after 
+ * millions of connections instead of 4095 reuses of a hot slot.
+ *
+ * Slots are in chunks allocated on demand and kept until destruction. 
+ * Alloc and Free take a lock. 
+ *
+ * Find reads a slot without lock. The owner thread, the one running the 
+ * communicator, removes connections with Retire and deletes them later 
+ * in Reclaim. Other threads Find inside a Reader. A retired connection 
+ * is deleted only when every Reader open at its Retire is closed, so a 
+ * connection found in a Reader stays valid until the Reader closes.
+ *
+ * Readers count themselves in one of two counters by the parity of 
+ * the epoch. Reclaim flips the epoch only when the readers of the 
+ * previous epoch are gone, and then deletes what was retired before 
+ * that previous flip. Readers never wait. Reclaim just tries again 
+ * on the next Run.
+ */
+class ConnectionTable : private Noncopyable
+{
+public:
+	enum
+	{
+		  INDEX_BITS 	= 20
+		, GEN_BITS 		= 32 - INDEX_BITS
+		, MAX_SLOTS 	= 1 << INDEX_BITS
+		, INDEX_MASK 	= MAX_SLOTS - 1
+		, GEN_MASK 		= ( 1 << GEN_BITS ) - 1
+		, CHUNK_BITS 	= 12
+		, CHUNK_SIZE 	= 1 << CHUNK_BITS
+		, CHUNKS 		= MAX_SLOTS / CHUNK_SIZE
+		, QUARANTINE 	= 1024 		// free slots kept before reuse
+	};
+
+	/**
+	 * @class Reader
+	 *
+	 * Scope in which connections found on a thread other than the 
+	 * owner are not deleted. Keep it short. Retired connections wait 
+	 * for it.
+	 */
+	class Reader : private Noncopyable
+	{
+	public:
+		explicit Reader( ConnectionTable& table );
+		~Reader();
+
+	private:
+		ConnectionTable& 	m_table;
+		uint 				m_epoch;
+	};
+
+public:
+	ConnectionTable();
+	~ConnectionTable();
+
+	/**
+	 * Reserve a slot. Thread safe.
+	 *
+	 * @return The connection id. 0 if the table is full.
+	 */
+	uint Alloc();
+
+	/**
+	 * Publish a connection in its reserved slot
+	 *
+	 * @param id The id from Alloc
+	 * @param c The connection with the id
+	 */
+	void Set( uint id, TcpConnection* c );
+
+	/**
+	 * Remove a connection and release the slot. Thread safe.
+	 *
+	 * @param id The id from Alloc
+	 */
+	void Free( uint id );
+
+	/**
+	 * Find a connection. Lock free. On the owner thread, or inside 
+	 * a Reader on other threads. Do not keep it past the Reader.
+	 *
+	 * @param id The connection id
+	 * @return The connection. 0 if not found or stale.
+	 */
+	TcpConnection* Find( uint id ) const;
+
+	/**
+	 * Free the slot of a connection and delete it in a later Reclaim. 
+	 * Owner thread only.
+	 *
+	 * @param c The connection set in the table
+	 */
+	void Retire( TcpConnection* c );
+
+	/**
+	 * Delete retired connections no Reader can see. Owner thread only.
+	 * Called every Run of the communicator.
+	 */
+	void Reclaim();
+
+	/**
+	 * Get a connection by slot index for iteration
+	 *
+	 * @param index Slot index less than GetSlotCount()
+	 * @return The connection. 0 if the slot is empty.
+	 */
+	TcpConnection* GetAt( uint index ) const;
+
+	/**
+	 * Get the number of slots ever used. Iteration bound.
+	 */
+	uint GetSlotCount() const;
+
+	/**
+	 * Get the number of connections set
+	 */
+	uint GetCount() const;
+
+	/**
+	 * Free all slots. Connections set are not deleted. 
+	 * Retired ones are. No Reader may be open.
+	 */
+	void Clear();
+
+private:
+	typedef std::vector<TcpConnection*> ConnectionList;
+
+	struct Slot
+	{
+		Atomic<uint> 			id; 		// full id when set. 0 otherwise.
+		TcpConnection* volatile connection;
+		uint 					gen;
+	};
+
+	Slot* getSlot( uint index ) const;
+
+	uint enter();
+	void leave( uint epoch );
+
+	static void deleteAll( ConnectionList& l );
+
+private:
+	Slot* volatile 		m_chunks[CHUNKS];
+	Atomic<uint> 		m_slotCount;
+	Atomic<uint> 		m_count;
+	std::deque<uint> 	m_free; 	// fifo
+	Mutex 				m_lock;
+	Atomic<uint> 		m_epoch;
+	Atomic<uint> 		m_readers[2]; 	// by epoch parity
+	ConnectionList 		m_retired; 		// in this epoch
+	ConnectionList 		m_reclaim; 		// before the last flip
+};
+
+inline
+ConnectionTable::Reader::Reader( ConnectionTable& table )
+: m_table( table )
+, m_epoch( table.enter() )
+{
+}
+
+inline
+ConnectionTable::Reader::~Reader()
+{
+	m_table.leave( m_epoch );
+}
+
+inline
+ConnectionTable::Slot* 
+ConnectionTable::getSlot( uint index ) const
+{
+	Slot* chunk = m_chunks[index >> CHUNK_BITS];
+
+	if ( chunk == 0 )
+	{
+		return (Slot*)0;
+	}
+
+	return &chunk[index & ( CHUNK_SIZE - 1 )];
+}
+
+inline
+TcpConnection* 
+ConnectionTable::Find( uint id ) const
+{
+	uint index = id & INDEX_MASK;
+
+	if ( id == 0 || index >= m_slotCount )
+	{
+		return (TcpConnection*)0;
+	}
+
+	Slot* slot = getSlot( index );
+
+	if ( slot == 0 || slot->id != id )
+	{
+		return (TcpConnection*)0;
+	}
+
+	TcpConnection* c = slot->connection;
+
+	// slot can be freed and reused while reading 
+
+	if ( slot->id != id )
+	{
+		return (TcpConnection*)0;
+	}
+
+	return c;
+}
+
+inline
+TcpConnection* 
+ConnectionTable::GetAt( uint index ) const
+{
+	Slot* slot = getSlot( index );
+
+	if ( slot == 0 || slot->id == 0 )
+	{
+		return (TcpConnection*)0;
+	}
+
+	return slot->connection;
+}
+
+inline
+uint 
+ConnectionTable::GetSlotCount() const
+{
+	return m_slotCount;
+}
+
+inline
+uint 
+ConnectionTable::GetCount() const
+{
+	return m_count;
+}
+
+} // gk
@@ -3,6 +3,7 @@
 #include <kcore/corebase.h>
 #include <knet/tcp/impl/Connector.h>
 
+#include <kcore/sys/Clock.h>
 #include <kcore/sys//Logger.h>
 #include <knet/socket/Socket.h>
 #include <knet/tcp/TcpCommunicator.h>
@@ -12,6 +13,11 @@ namespace gk {
 
 Connector::Connector()
 : m_communicator( 0 )
+, m_reqQ()
+, m_attempts()
+, m_timeout( DEFAULT_TIMEOUT )
+, m_maxAttempts( DEFAULT_ATTEMPTS )
+, m_wakeup()
 {
 }
 
@@ -32,10 +38,22 @@ Connector::Init( TcpCommunicator* communicator )
     return true;
 }
 
+void 
+Connector::SetRetry( uint timeout, uint attempts )
+{
+	K_ASSERT( timeout > 0 );
+	K_ASSERT( attempts > 0 );
+
+	m_timeout 	  = timeout;
+	m_maxAttempts = attempts > 0 ? attempts : 1;
+}
+
 void 
 Connector::Connect( const IpAddress& remote )
 {
 	m_reqQ.Put( remote );
+
+	m_wakeup.Signal();
 }
 
 int 
@@ -43,65 +61,328 @@ Connector::Run()
 {
     while ( IsRunning() )
     {
-		if ( m_reqQ.IsEmpty() )
+		Clock::Update();
+
+		IpAddress addr; 
+
+		while ( m_reqQ.Get( addr ) )
 		{
-			Sleep( 10 );
+			Attempt a;
+
+			a.addr 		= addr;
+			a.socket 	= 0;
+			a.tries 	= 0;
+			a.deadline 	= 0;
+			a.retryAt 	= 0;
+			a.done 		= false;
+
+			m_attempts.push_back( a );
+		}
+
+		if ( m_attempts.empty() )
+		{
+			m_wakeup.Wait( Event::INFINITE_WAIT );
 
 			continue;
 		}
 
-		IpAddress addr; 
+		uint8 now = Clock::Now();
+
+		for ( uint i = 0; i < m_attempts.size(); ++i )
+		{
+			Attempt& a = m_attempts[i];
 
-		bool rc = m_reqQ.Get( addr );
-		K_ASSERT( rc );
+			if ( !a.done && a.socket == 0 && a.retryAt <= now )
+			{
+				begin( a, now );
+			}
+		}
+
+		if ( !wait() )
+		{
+			// only retries are waiting. until the first one or a request
+
+			m_wakeup.Wait( untilRetry( now ) );
+		}
+
+		Clock::Update();
+
+		expire( Clock::Now() );
+
+		sweep();
+    }
+
+    return 0;
+}
+
+void 
+Connector::helpStop()
+{
+	m_wakeup.Signal();
+}
 
-		Socket* s = new Socket;
+void 
+Connector::Fini()
+{
+    Stop();
+
+	for ( uint i = 0; i < m_attempts.size(); ++i )
+	{
+		delete m_attempts[i].socket;
+	}
+
+	m_attempts.clear();
+}
+
+void 
+Connector::begin( Attempt& a, uint8 now )
+{
+	K_ASSERT( a.socket == 0 );
+
+	Socket* s = new Socket;
 		
-		s->CreateTcpSocket();
+	s->CreateTcpSocket();
+	s->SetNonblocking();
+
+	++a.tries;
+
+	a.socket = s;
+
+	int error = s->StartConnect( a.addr );
+
+	if ( error == 0 )
+	{
+		onConnected( a );
+	}
+	else if ( error == WSAEWOULDBLOCK )
+	{
+		a.deadline = now + m_timeout;
+	}
+	else
+	{
+		onFailed( a, error, now );
+	}
+}
 
-		if ( s->Connect( addr ) )
+bool 
+Connector::wait()
+{
+	// fd_set holds FD_SETSIZE sockets. 64 on Windows by default.
+	// waits only on the first set. the rest are polled.
+
+	uint count 	= 0;
+	uint i 		= 0;
+
+	while ( i < m_attempts.size() )
+	{
+		fd_set writeSet;
+		fd_set errorSet;
+
+		FD_ZERO( &writeSet );
+		FD_ZERO( &errorSet );
+
+		std::vector<uint> indices;
+
+		int maxFd = 0;
+
+		for ( ; i < m_attempts.size() && indices.size() < FD_SETSIZE; ++i )
 		{
-			NetStateMessage* m = new NetStateMessage;
+			Attempt& a = m_attempts[i];
 
-			m->state 		= NetStateMessage::TCP_CONNECTED;
-			m->connectionId = 0;
-			m->addr 		= addr;
-			m->socket 		= s;
+			if ( a.done || a.socket == 0 )
+			{
+				continue;
+			}
 
-			m_communicator->Notify( MessagePtr( m ) );
+			SOCKET fd = a.socket->GetSystemSocket();
 
-			LOG( FT_DEBUG, 
-					_T("Connector> Connected %d to %s"), 
-					s->GetSystemSocket(), 
-					addr.ToString().c_str() );
+			FD_SET( fd, &writeSet );
+			FD_SET( fd, &errorSet );
+
+			if ( (int)fd > maxFd )
+			{
+				maxFd = (int)fd;
+			}
+
+			indices.push_back( i );
 		}
-		else
+
+		if ( indices.empty() )
 		{
-			delete s;
+			break;
+		}
 
-			NetStateMessage* m = new NetStateMessage;
+		timeval tv;
 
-			m->state 		= NetStateMessage::TCP_CONNECT_FAIL;
-			m->connectionId = 0;
-			m->addr 		= addr;
-			m->socket 		= 0;
+		tv.tv_sec  = 0;
+		tv.tv_usec = ( count == 0 ) ? WAIT_MS * 1000 : 0;
 
-			m_communicator->Notify( MessagePtr( m ) );
+		count += (uint)indices.size();
 
-			LOG( FT_DEBUG, 
-					_T("Failed to connect to %s"), 
-					addr.ToString().c_str() );
+		int rc = ::select( maxFd + 1, 0, &writeSet, &errorSet, &tv );
+
+		if ( rc <= 0 )
+		{
+			continue; // timeouts are checked in expire
 		}
-    }
 
-    return 0;
+		uint8 now = Clock::Now();
+
+		for ( uint k = 0; k < indices.size(); ++k )
+		{
+			Attempt& a = m_attempts[indices[k]];
+
+			SOCKET fd = a.socket->GetSystemSocket();
+
+			if ( !FD_ISSET( fd, &writeSet ) && !FD_ISSET( fd, &errorSet ) )
+			{
+				continue;
+			}
+
+			int error = a.socket->FinishConnect();
+
+			if ( error == 0 )
+			{
+				onConnected( a );
+			}
+			else
+			{
+				onFailed( a, error, now );
+			}
+		}
+	}
+
+	return count > 0;
 }
 
 void 
-Connector::Fini()
+Connector::expire( uint8 now )
 {
-    Stop();
+	for ( uint i = 0; i < m_attempts.size(); ++i )
+	{
+		Attempt& a = m_attempts[i];
+
+		if ( !a.done && a.socket != 0 && a.deadline <= now )
+		{
+			onFailed( a, WSAETIMEDOUT, now );
+		}
+	}
+}
+
+void 
+Connector::sweep()
+{
+	uint i = 0;
+
+	while ( i < m_attempts.size() )
+	{
+		if ( m_attempts[i].done )
+		{
+			m_attempts[i] = m_attempts.back();
+			m_attempts.pop_back();
+
+			continue;
+		}
+
+		++i;
+	}
+}
+
+uint 
+Connector::untilRetry( uint8 now ) const
+{
+	uint wait = BACKOFF_MAX;
+
+	for ( uint i = 0; i < m_attempts.size(); ++i )
+	{
+		const Attempt& a = m_attempts[i];
+
+		if ( a.done || a.socket != 0 )
+		{
+			continue;
+		}
+
+		K_RETURN_V_IF( a.retryAt <= now, 0 );
+
+		if ( a.retryAt - now < wait )
+		{
+			wait = (uint)( a.retryAt - now );
+		}
+	}
+
+	return wait;
+}
+
+void 
+Connector::onConnected( Attempt& a )
+{
+	Socket* s = a.socket;
+
+	a.socket = 0;
+	a.done 	 = true;
+
+	LOG( FT_DEBUG, 
+		 _T("Connector> Connected %d to %s after %d tries"), 
+		 s->GetSystemSocket(), 
+		 a.addr.ToString().c_str(), 
+		 a.tries );
+
+	notify( NetStateMessage::TCP_CONNECTED, a.addr, s );
+}
+
+void 
+Connector::onFailed( Attempt& a, int error, uint8 now )
+{
+	delete a.socket;
+
+	a.socket = 0;
+
+	if ( a.tries < m_maxAttempts )
+	{
+		uint backoff = BACKOFF_MAX;
+
+		if ( a.tries < 16 )
+		{
+			backoff = BACKOFF_MIN << ( a.tries - 1 );
+
+			if ( backoff > BACKOFF_MAX )
+			{
+				backoff = BACKOFF_MAX;
+			}
+		}
+
+		a.retryAt = now + backoff;
+
+		LOG( FT_DEBUG, 
+			 _T("Connector> Retry %s in %d ms. error %d"), 
+			 a.addr.ToString().c_str(), 
+			 backoff, 
+			 error );
+
+		return;
+	}
+
+	a.done = true;
+
+	notify( NetStateMessage::TCP_CONNECT_FAIL, a.addr, 0 );
+
+	LOG( FT_DEBUG, 
+		 _T("Failed to connect to %s. error %d"), 
+		 a.addr.ToString().c_str(), 
+		 error );
+}
+
+void 
+Connector::notify( uint state, const IpAddress& addr, Socket* s )
+{
+	NetStateMessage* m = new NetStateMessage;
+
+	m->state 		= state;
+	m->connectionId = 0;
+	m->addr 		= addr;
+	m->socket 		= s;
 
+	m_communicator->Notify( MessagePtr( m ) );
 }
 
-} // gk 
\ No newline at end of file
+} // gk 
@@ -1,22 +1,39 @@
 #pragma once 
 
+#include <kcore/sys/Event.h>
 #include <kcore/sys/Thread.h>
 #include <kcore/sys/Queue.h>
 #include <knet/socket/IpAddress.h>
 
+#include <vector>
+
 namespace gk {
 
+class Socket;
 class TcpCommunicator;
 
 /** 
  * @class Connector
  *
- * Connector to connect to remote host. 
+ * Connector to connect to remote hosts. 
  * 
- * ConnectEx is not used. Thread approach is much simpler. 
+ * Connects are started on nonblocking sockets and waited together 
+ * with select. So an unreachable host does not delay others. 
+ * An attempt fails after the timeout and is retried with exponential 
+ * backoff. TCP_CONNECT_FAIL is notified after the last attempt.
  */
 class Connector : public Thread
 {
+public:
+	enum 
+	{
+		  DEFAULT_TIMEOUT 	= 3000 		// ms per attempt
+		, DEFAULT_ATTEMPTS 	= 3 		// attempts before failure
+		, BACKOFF_MIN 		= 100 		// ms before the first retry
+		, BACKOFF_MAX 		= 5000 		// max ms between retries
+		, WAIT_MS 			= 10 		// select wait when connecting
+	};
+
 public:
 	Connector();
 	virtual ~Connector();
@@ -29,6 +46,14 @@ public:
 	 */
 	bool Init( TcpCommunicator* communicator );
 
+	/**
+	 * Set timeout and attempts. Call before Init.
+	 *
+	 * @param timeout Milliseconds per attempt
+	 * @param attempts Attempts before TCP_CONNECT_FAIL. At least 1.
+	 */
+	void SetRetry( uint timeout, uint attempts );
+
 	/**
 	 * Thread::Run
 	 */
@@ -46,11 +71,48 @@ public:
 	 */
 	void Fini();
 
+protected:
+	/**
+	 * Wake Run to exit
+	 */
+	void helpStop();
+
 private:
 	typedef Queue<IpAddress, Mutex> ReqQ;
 
+	/**
+	 * A connect to a remote. socket is 0 while waiting for retry.
+	 */
+	struct Attempt
+	{
+		IpAddress 	addr;
+		Socket* 	socket;
+		uint 		tries;
+		uint8 		deadline; 	// fails at when connecting
+		uint8 		retryAt; 	// starts at when waiting
+		bool 		done;
+	};
+
+	typedef std::vector<Attempt> AttemptList;
+
+	void begin( Attempt& a, uint8 now );
+	bool wait();
+	void expire( uint8 now );
+	void sweep();
+	uint untilRetry( uint8 now ) const;
+
+	void onConnected( Attempt& a );
+	void onFailed( Attempt& a, int error, uint8 now );
+
+	void notify( uint state, const IpAddress& addr, Socket* s );
+
+private:
 	TcpCommunicator* m_communicator;
-	ReqQ 	m_reqQ;
+	ReqQ 			m_reqQ;
+	AttemptList 	m_attempts;
+	uint 			m_timeout;
+	uint 			m_maxAttempts;
+	Event 			m_wakeup; 		// signalled on request
 };
 
 } // gk
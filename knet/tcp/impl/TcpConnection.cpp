@@ -20,16 +20,30 @@ TcpConnection::TcpConnection()
 , m_error( 0 )
 , m_accepted( true )
 , m_handshaking( false )
+, m_corked( false )
+, m_lowLatency( false )
+, m_compressOffer( Compressor::MODE_NONE )
+, m_compression( Compressor::MODE_NONE )
+, m_replyCompression( Compressor::MODE_NONE )
 , m_lockRecv()
 , m_lockSend()
 , m_sendRequestCount( 0 )
 , m_recvRequestCount( 0 )
-, m_sendBuffer1()
-, m_sendBuffer2()
+, m_sendQ()
+, m_sending()
 , m_recvBuffer() 
-, m_accBuffer( 0 )
+, m_recvPos( 0 )
+, m_recvMode( RECV_DIRECT )
+, m_recvLen( RECV_MIN_LEN )
 , m_sendBlock() 
 , m_recvBlock()
+, m_highWater( 0 )
+, m_lowWater( 0 )
+, m_sendPolicy( SEND_QUEUE )
+, m_overHighWater( false )
+, m_queuedBytes( 0 )
+, m_queuedFrames( 0 )
+, m_droppedFrames( 0 )
 , m_groupId( 0 )
 {
 }
@@ -54,14 +68,27 @@ TcpConnection::Init( TcpCommunicator* communicator, uint id, Socket* socket,
 	m_sl 			= sl;
 	m_accepted 		= accepted;
 	m_handshaking   = true;
+	m_corked 		= false;
+	m_lowLatency 	= false;
+	m_compression 	= Compressor::MODE_NONE;
+	m_replyCompression = Compressor::MODE_NONE;
 
 	m_sendRequestCount = 0;
 	m_recvRequestCount = 0;
 
-    m_sendBuffer1.Clear();
-    m_sendBuffer2.Clear();
+	m_sendQ.clear();
+	m_sending.clear();
+	m_highWater 	= 0;
+	m_lowWater 		= 0;
+	m_sendPolicy 	= SEND_QUEUE;
+	m_overHighWater = false;
+	m_queuedBytes 	= 0;
+	m_queuedFrames 	= 0;
+	m_droppedFrames = 0;
 	m_recvBuffer.Clear();
-	m_accBuffer = &m_sendBuffer1;
+	m_recvBuffer.Reset();
+	m_recvPos = 0;
+	m_recvLen = RECV_MIN_LEN;
 
 	m_groupId = 0;
 
@@ -75,6 +102,24 @@ TcpConnection::Init( TcpCommunicator* communicator, uint id, Socket* socket,
     return true;
 }
 
+void 
+TcpConnection::SetRecvMode( RecvMode mode )
+{
+	K_ASSERT( m_recvRequestCount == (uint)0 );
+
+	m_recvMode = mode;
+	m_recvLen  = RECV_MIN_LEN;
+}
+
+void 
+TcpConnection::SetCompression( uint mode )
+{
+	K_ASSERT( m_handshaking );
+	K_ASSERT( mode <= Compressor::MODE_DICT );
+
+	m_compressOffer = mode;
+}
+
 void 
 TcpConnection::StartHandshake()
 {
@@ -91,6 +136,11 @@ TcpConnection::StartHandshake()
 
 	sendHandshake(); 		// security level is sent with challenge
 
+	// before TCP_OPEN. the communicator thread can send right after it.
+
+	m_handshaking = false; 	// finished quickly on server
+	m_cipher.SetEstablished();
+
 	NetStateMessage* nsm = new NetStateMessage;
 
 	nsm->state 			= NetStateMessage::TCP_OPEN;
@@ -99,9 +149,6 @@ TcpConnection::StartHandshake()
 	nsm->addr			= m_socket->GetPeerAddress();
 
 	m_communicator->Notify( MessagePtr( nsm ) );
-	
-	m_handshaking = false; 	// finished quickly on server
-	m_cipher.SetEstablished();
 }
 
 void 
@@ -125,64 +172,98 @@ TcpConnection::Run()
 void 
 TcpConnection::Send( MessagePtr m )
 {
-	K_ASSERT( m_accBuffer != 0 );
 	K_ASSERT( m.Get() != 0 );
 	K_ASSERT( m->type != NET_HANDSHAKE );
 	K_ASSERT( !m_handshaking );
 
-	BitStream bs;
-
-	m->Pack( bs );
-
-	if ( m_sl > SECURITY0 )
-	{
-		m_cipher.Encrypt( bs );
-	}
+	TcpFramePtr frame( new TcpFrame );
 
+	if ( !frame->Pack( *m, GetCipher(), m_compression ) )
 	{
-		ScopedLock sl( m_lockSend );
+		LOG( FT_ERROR, _T("TcpConnection::Send> Failed to pack %d"), m->type );
 
-		m_accBuffer->WriteInt( bs.GetBytePosition(), 16 );
-		m_accBuffer->WriteInt( 0, 8 );
-		m_accBuffer->Write( bs.GetBytePosition(), bs.GetBuffer() );
+		return;
 	}
 
-    RequestSend();
+	queueFrame( frame );
 }
 
 void 
 TcpConnection::Send( void* data, uint len )
 {
-	K_ASSERT( m_accBuffer != 0 );
 	K_ASSERT( data != 0 );
 	K_ASSERT( len > 0 );
 
-	if ( m_sl > SECURITY0 )
+	TcpFramePtr frame( new TcpFrame );
+
+	if ( !frame->Pack( data, len, GetCipher(), m_compression ) )
 	{
-		BitStream bs;
+		LOG( FT_ERROR, _T("TcpConnection::Send> Failed to pack %d bytes"), len );
 
-		bs.Write( len, data );
+		return;
+	}
 
-		m_cipher.Encrypt( bs );
+	queueFrame( frame );
+}
 
-		{
-			ScopedLock sl( m_lockSend );
+void 
+TcpConnection::Send( TcpFramePtr frame )
+{
+	K_ASSERT( frame.Get() != 0 );
+	K_ASSERT( !m_handshaking );
 
-			m_accBuffer->WriteInt( bs.GetBytePosition(), 16 );
-			m_accBuffer->WriteInt( 0, 8 );
-			m_accBuffer->Write( bs.GetBytePosition(), bs.GetBuffer() );
-		}
-	}
-	else
+	queueFrame( frame );
+}
+
+Cipher* 
+TcpConnection::GetCipher()
+{
+	return m_sl > SECURITY0 ? &m_cipher : 0;
+}
+
+bool 
+TcpConnection::Cork()
+{
+	ScopedLock sl( m_lockSend );
+
+	m_corked = !m_lowLatency;
+
+	return m_corked;
+}
+
+void 
+TcpConnection::Flush()
+{
 	{
 		ScopedLock sl( m_lockSend );
 
-		m_accBuffer->WriteInt( len, 16 );
-		m_accBuffer->WriteInt( 0, 8 );
-		m_accBuffer->Write( len, data );
+		m_corked = false;
+	}
+
+	RequestSend();
+}
+
+void 
+TcpConnection::SetLowLatency( bool lowLatency )
+{
+	m_lowLatency = lowLatency;
+
+	if ( m_lowLatency && m_corked )
+	{
+		Flush();
 	}
+}
+
+void 
+TcpConnection::SetSendLimits( uint highWater, uint lowWater, uint policy )
+{
+	K_ASSERT( lowWater <= highWater );
+
+	ScopedLock sl( m_lockSend );
 
-    RequestSend();
+	m_highWater  = highWater;
+	m_lowWater 	 = lowWater;
+	m_sendPolicy = policy;
 }
 
 // IoAgent { 
@@ -211,38 +292,45 @@ TcpConnection::RequestSend()
         return true; // we already have one. 1-send.
     }
 
+	if ( m_corked )
+	{
+		return true; // sent on Flush
+	}
 
-	K_ASSERT( m_accBuffer != 0 );
-
-	if ( m_accBuffer->GetBitPosition() == 0 )
+	if ( m_sendQ.empty() )
 	{
 		return true; // no data to send
 	}
 
-	BitStream* cacc = m_accBuffer;
-
 	K_ASSERT( m_sendRequestCount == (uint)0 );
+	K_ASSERT( m_sending.empty() );
 
-	if ( m_accBuffer == &m_sendBuffer1 )
-	{
-		m_accBuffer = &m_sendBuffer2;
-	}
-	else 
+	// gather queued frames. frames are held in m_sending until sent.
+
+	ulong count = 0;
+	ulong total = 0;
+
+	while ( !m_sendQ.empty() && count < MAX_SEND_BUFS )
 	{
-		K_ASSERT( m_accBuffer == &m_sendBuffer2 );
+		m_sending.push_back( TcpFramePtr() );
+		m_sending.back().Swap( m_sendQ.front() );
+		m_sendQ.pop_front();
 
-		m_accBuffer = &m_sendBuffer1;
-	}
+		const TcpFramePtr& frame = m_sending.back();
+
+		m_sendBufs[count].buf = (char*)frame->GetData();
+		m_sendBufs[count].len = (ulong)frame->GetLength();
 
-	m_accBuffer->Clear();
-	m_accBuffer->Reset();
+		total += m_sendBufs[count].len;
 
-	K_ASSERT( cacc != m_accBuffer );
+		++count;
+	}
 
 	m_sendBlock.op  		= IoBlock::OP_WRITE;
-    m_sendBlock.buf.buf    = (char*)cacc->GetBuffer();
-    m_sendBlock.buf.len    = (ulong)cacc->GetBytePosition();
-    m_sendBlock.totalLen   = m_sendBlock.buf.len;
+    m_sendBlock.buf        = m_sendBufs[0];
+    m_sendBlock.bufs       = m_sendBufs;
+    m_sendBlock.bufCount   = count;
+    m_sendBlock.totalLen   = total;
     m_sendBlock.extra      = this;
 
     int error = m_socket->AsyncSend( &m_sendBlock );
@@ -277,11 +365,26 @@ TcpConnection::RequestRecv()
     }
 
     m_recvBlock.op          = IoBlock::OP_READ;
-    m_recvBlock.buf.buf     = 0;   // no buffer needed
+    m_recvBlock.buf.buf     = 0;   // no buffer for zero byte recv
     m_recvBlock.buf.len     = 0; 
-    m_recvBlock.totalLen    = 0;   // not used for recv. we used 0 recv
+    m_recvBlock.totalLen    = 0;   // not used for recv
     m_recvBlock.extra       = this;
 
+	if ( m_recvMode == RECV_DIRECT )
+	{
+		// recv right after buffered data. buffer is not touched until completed.
+
+		if ( !m_recvBuffer.ReserveWrite( m_recvLen ) )
+		{
+			OnIoError( NET_ERROR_MESSAGE_UNPACK, &m_recvBlock );
+
+			return false;
+		}
+
+		m_recvBlock.buf.buf = (char*)m_recvBuffer.GetBytePtr();
+		m_recvBlock.buf.len = m_recvLen;
+	}
+
     int error = m_socket->AsyncRecv( &m_recvBlock );
 
     if ( error > 0 )
@@ -302,35 +405,74 @@ void
 TcpConnection::OnSendCompleted( IoBlock* io )
 {
 	K_ASSERT( io != 0 );
-	K_ASSERT( io->buf.buf != 0 );
+	K_ASSERT( io->bufs != 0 );
     K_ASSERT( io->op == IoBlock::OP_WRITE );
-	K_ASSERT( io->buf.buf != (char*)m_accBuffer->GetBuffer() );
 
-	ScopedLock sl( m_lockSend ); // Windows spin lock is reentrant
+	bool low = false;
 
-	m_sendRequestCount.Dec();
+	{
+		ScopedLock sl( m_lockSend ); // Windows spin lock is reentrant
 
-	RequestSend();
+		FrameList::const_iterator i( m_sending.begin() );
+		FrameList::const_iterator iEnd( m_sending.end() );
+
+		for ( ; i != iEnd; ++i )
+		{
+			m_queuedBytes -= (*i)->GetLength();
+		}
+
+		m_queuedFrames -= (uint)m_sending.size();
+
+		m_sending.clear();
+
+		if ( m_overHighWater && m_queuedBytes <= m_lowWater )
+		{
+			m_overHighWater = false;
+
+			low = true;
+		}
+
+		m_sendRequestCount.Dec();
+
+		RequestSend();
+	}
+
+	if ( low )
+	{
+		notifySendState( NetStateMessage::TCP_SEND_LOW_WATER );
+	}
 }
 
 void 
 TcpConnection::OnSendCompleted( IoBlock* io, uint bytesSent )
 {
     K_ASSERT( io != 0 );
-	K_ASSERT( io->buf.buf != 0 );
+	K_ASSERT( io->bufs != 0 );
     K_ASSERT( bytesSent > 0 );
     K_ASSERT( io->totalLen > bytesSent );
     K_ASSERT( io->op == IoBlock::OP_WRITE );
 
 	LOG( FT_DEBUG, _T("Incomplete send") );
 
-    // move byets forward. 
-    ::memmove_s( (void*)io->buf.buf,               io->buf.len, 
-                 (void*)(io->buf.buf + bytesSent), io->buf.len - bytesSent );
+	// advance the cursor over sent buffers. frames stay in m_sending.
+
+	ulong skip = bytesSent;
+
+	while ( skip >= io->bufs->len )
+	{
+		K_ASSERT( io->bufCount > 1 );
+
+		skip -= io->bufs->len;
 
-    // decrease total bytes
+		++io->bufs;
+		--io->bufCount;
+	}
+
+	io->bufs->buf += skip;
+	io->bufs->len -= skip;
+
+	io->buf 	  = *io->bufs;
     io->totalLen -= bytesSent;
-    io->buf.len  -= bytesSent;
 
     int error = m_socket->AsyncSend( io );
 
@@ -341,58 +483,89 @@ TcpConnection::OnSendCompleted( IoBlock* io, uint bytesSent )
 }
 
 void 
-TcpConnection::OnRecvCompleted( IoBlock* /* io */ )
+TcpConnection::OnRecvCompleted( IoBlock* io )
 {
-	ScopedLock sl( m_lockRecv );
+	uint reply = Compressor::MODE_NONE;
 
-	m_recvRequestCount.Dec();
+	{
+		ScopedLock sl( m_lockRecv );
+
+		recvCompleted( io );
 
-    byte b[2048]; 
+		reply = m_replyCompression;
 
-	// ::memset( b, 0, 1024 );
+		m_replyCompression = Compressor::MODE_NONE;
 
-	// TODO: Optimization can be done with direct copy to recv buffer
+		if ( reply != Compressor::MODE_NONE )
+		{
+			m_recvRequestCount.Inc(); // hold the connection until the reply is queued
+		}
+	}
 
-	int len = m_socket->Recv( b, 2048 );
+	// queueFrame takes m_lockSend. not under m_lockRecv.
 
-	if ( len == 0 )
+	if ( reply != Compressor::MODE_NONE )
 	{
-		OnIoError( SOCKET_ERROR, &m_recvBlock );
+		sendHandshakeReply( reply );
 
-		return;
+		m_recvRequestCount.Dec();
 	}
 
-	if ( len == SOCKET_ERROR )
+	RequestRecv(); // fails on error
+}
+
+void 
+TcpConnection::recvCompleted( IoBlock* io )
+{
+	m_recvRequestCount.Dec();
+
+	if ( m_recvMode == RECV_DIRECT )
 	{
-		int error = GetLastError();
+		uint len = io->transferred;
 
-		if ( error != WSAEWOULDBLOCK )
+		K_ASSERT( len > 0 && len <= m_recvLen );
+
+		LOG( FT_DEBUG_FLOW, _T("TcpConnection::OnRecvCompleted> %d added"), len );
+
+		m_recvBuffer.AdvanceBitPosition( len << 3 );
+
+		bool full = ( len == m_recvLen );
+
+		adaptRecvLen( len );
+		dispatchMessages();
+
+		if ( !full ) 
 		{
-			OnIoError( error, &m_recvBlock );
+			return;
 		}
-
-		return;
 	}
 
-	K_ASSERT( len > 0 && len <= 2048 );
+	// read until the socket would block. bounded not to hold the io thread.
 
-	LOG( FT_DEBUG_FLOW, _T("TcpConnection::OnRecvCompleted> %d added"), len );
+	for ( int round = 0; round < MAX_RECV_ROUNDS && !HasError(); ++round )
+	{
+		uint wanted = m_recvLen;
 
-	m_recvBuffer.Accumulate( b, len ); // a faster version of write. 
+		int len = recvNow();
 
-	LOG( FT_DEBUG_FLOW, _T("TcpConnection::OnRecvCompleted> Buff %d bytes"), m_recvBuffer.GetBytePosition() );
+		if ( len < 0 )
+		{
+			return; // error reported
+		}
 
-	MessagePtr m = buildMessage();
+		if ( len == 0 )
+		{
+			break; // would block
+		}
 
-	while ( m.Get() != 0 && !HasError() )
-	{
-		m->remote = m_id;				//	
-		m_communicator->Notify( m ); 	// NOTE: called by IOCP thread
+		adaptRecvLen( len );
+		dispatchMessages();
 
-		m = buildMessage();
+		if ( (uint)len < wanted )
+		{
+			break;
+		}
 	}
-
-	RequestRecv();
 }
 
 void 
@@ -482,6 +655,12 @@ TcpConnection::Fini()
 		ScopedLock slRecv( m_lockRecv ); // race with OnRecvCompleted -> IoError
 		ScopedLock slSend( m_lockSend );
 
+		m_sendQ.clear();
+		m_sending.clear();
+
+		m_queuedBytes 	= 0;
+		m_queuedFrames 	= 0;
+
         delete m_socket;
 
         m_socket = 0;
@@ -495,7 +674,7 @@ TcpConnection::buildMessage()
 
 	uint usedLen	= 0;
 	uint bitPos		= m_recvBuffer.GetBitPosition();
-	uint byteLen    = m_recvBuffer.GetBytePosition();
+	uint byteLen    = m_recvBuffer.GetBytePosition() - m_recvPos;
 
 	LOG( FT_DEBUG_FLOW, _T("buildMessage> byteLen %d"), byteLen );
 
@@ -515,7 +694,7 @@ TcpConnection::buildMessage()
 
 	uint messageLen = 0;
 
-	m_recvBuffer.SetBitPosition( 0 );			// read from front
+	m_recvBuffer.SetBytePosition( m_recvPos );	// read from the cursor
 	m_recvBuffer.ReadInt( messageLen, 16 );
 
 	LOG( FT_DEBUG_FLOW, _T("buildMessage> Message Len %d"), messageLen );
@@ -555,7 +734,7 @@ TcpConnection::buildMessage()
 
 		m_recvBuffer.Read( type );
 
-		if ( type != NET_HANDSHAKE )
+		if ( type != NET_HANDSHAKE || messageLen <= sizeof( type ) )
 		{
 			LOG( FT_ERROR, 
 		 		 _T("TcpConnection::buildMessage> Decryption error"), 
@@ -568,7 +747,11 @@ TcpConnection::buildMessage()
 
 		NetHandshake hs;
 
-		bool rc = hs.Unpack( m_recvBuffer );
+		// bounded by the frame. fields of newer peers are optional.
+
+		BitStream payload( m_recvBuffer.GetBytePtr(), messageLen - sizeof( type ) );
+
+		bool rc = hs.Unpack( payload );
 
 		if ( !rc )
 		{
@@ -600,24 +783,39 @@ TcpConnection::buildMessage()
 		m_handshaking = false;
 		m_cipher.SetEstablished();
 
+		// replied by OnRecvCompleted after m_lockRecv is released
+
+		m_replyCompression = negotiateCompression( hs.compression, hs.dictId );
+
 		usedLen = messageLen + HEADER_LEN;
 
-		K_ASSERT( usedLen <= (bitPos >> 3) );
+		K_ASSERT( usedLen <= byteLen );
 
-		m_recvBuffer.TruncateFront( usedLen );
-		m_recvBuffer.SetBitPosition( bitPos - (usedLen << 3) );
+		m_recvPos += usedLen;
+		m_recvBuffer.SetBitPosition( bitPos );
 
-		LOG( FT_DEBUG_FLOW, _T( "used %d pos %d buf len %d"), usedLen, bitPos >> 3, m_recvBuffer.GetBytePosition() );
+		LOG( FT_DEBUG_FLOW, _T( "used %d pos %d buf len %d"), usedLen, m_recvPos, bitPos >> 3 );
 
 		return MessagePtr();
 	}
 
 	K_ASSERT( !m_handshaking );
 
+	if ( !acceptsControl( control ) )
+	{
+		LOG( FT_ERROR, 
+			 _T("TcpConnection::buildMessage> Control %x not agreed. compression %d"), 
+			 control, m_compression );
+
+		OnIoError( NET_ERROR_MESSAGE_UNPACK, &m_recvBlock );
+
+		return MessagePtr();
+	}
+
 	// just message part is encrypted
 	if ( m_sl > SECURITY0 )
 	{
-		bool rc = m_cipher.Decrypt( m_recvBuffer, HEADER_LEN, messageLen );
+		bool rc = m_cipher.Decrypt( m_recvBuffer, m_recvPos + HEADER_LEN, messageLen );
 
 		if ( !rc )
 		{
@@ -630,14 +828,66 @@ TcpConnection::buildMessage()
 		}
 	}
 
-	// we have a message 
+	// we have a message. compressed payload is inflated to a local buffer.
+
+	byte 		raw[MAX_PACKET_LEN];
+	uint 		rawLen = 0;
+	BitStream 	rawStream( raw, MAX_PACKET_LEN );
+	BitStream* 	in = &m_recvBuffer;
+
+	if ( control & TcpFrame::CONTROL_COMPRESSED )
+	{
+		if ( !inflate( control, messageLen, raw, rawLen ) )
+		{
+			LOG( FT_ERROR, 
+				 _T("TcpConnection::buildMessage> Failed to decompress %d bytes"), 
+				 messageLen );
+
+			OnIoError( NET_ERROR_MESSAGE_UNPACK, &m_recvBlock );
+
+			return MessagePtr();
+		}
+
+		rawStream.SetMaxSizes( rawLen, rawLen );
+
+		in = &rawStream;
+	}
 
 	ushort type = 0;
 
-	m_recvBuffer.Read( type );
+	in->Read( type );
 
 	K_ASSERT( type > 0 );
 
+	if ( type == NET_HANDSHAKE && m_accepted )
+	{
+		// reply of the client with the compression accepted
+
+		NetHandshake hs;
+
+		if ( !hs.Unpack( *in ) || hs.compression > m_compressOffer )
+		{
+			LOG( FT_ERROR, 
+				 _T("TcpConnection::buildMessage> Invalid handshake reply %d"), 
+				 m_id );
+
+			OnIoError( NET_ERROR_SECURITY, &m_recvBlock );
+
+			return MessagePtr();
+		}
+
+		m_compression = negotiateCompression( hs.compression, hs.dictId );
+
+		LOG( FT_DEBUG, 
+			 _T("TcpConnection::buildMessage> Id %d compression %d"), 
+			 m_id, m_compression );
+
+		m_recvPos += messageLen + HEADER_LEN;
+		m_recvBuffer.SetBitPosition( bitPos );
+
+		return MessagePtr();
+	}
+
 	MessagePtr m = MessageFactory::Instance()->Create( type );
 
 	if ( m.Get() == 0 )
@@ -653,7 +903,7 @@ TcpConnection::buildMessage()
 		return MessagePtr();
 	}
 
-	bool rc = m->Unpack( m_recvBuffer );
+	bool rc = m->Unpack( *in );
 
 	if ( !rc )
 	{
@@ -668,20 +918,142 @@ TcpConnection::buildMessage()
 
 	usedLen = messageLen + HEADER_LEN;
 
-	K_ASSERT( usedLen <= (bitPos >> 3) );
+	K_ASSERT( usedLen <= byteLen );
 
-	m_recvBuffer.TruncateFront( usedLen );
-	m_recvBuffer.SetBitPosition( bitPos - (usedLen << 3) );
+	m_recvPos += usedLen;
+	m_recvBuffer.SetBitPosition( bitPos );
 
 	K_ASSERT( (bitPos & 0x7) == 0 ); // byte aligned
 
 	LOG( FT_DEBUG_FLOW, _T( "used %d buf len %d"), 
-		 (byteLen - m_recvBuffer.GetBytePosition()), 
-		 m_recvBuffer.GetBytePosition() );
+		 usedLen, 
+		 (bitPos >> 3) - m_recvPos );
 
 	return m;
 }
 
+int 
+TcpConnection::recvNow()
+{
+	if ( !m_recvBuffer.ReserveWrite( m_recvLen ) )
+	{
+		OnIoError( NET_ERROR_MESSAGE_UNPACK, &m_recvBlock );
+
+		return -1;
+	}
+
+	int len = m_socket->Recv( m_recvBuffer.GetBytePtr(), m_recvLen );
+
+	if ( len == 0 )
+	{
+		OnIoError( SOCKET_ERROR, &m_recvBlock );
+
+		return -1;
+	}
+
+	if ( len == SOCKET_ERROR )
+	{
+		int error = GetLastError();
+
+		if ( error != WSAEWOULDBLOCK )
+		{
+			OnIoError( error, &m_recvBlock );
+
+			return -1;
+		}
+
+		return 0;
+	}
+
+	K_ASSERT( len > 0 && (uint)len <= m_recvLen );
+
+	LOG( FT_DEBUG_FLOW, _T("TcpConnection::recvNow> %d added"), len );
+
+	m_recvBuffer.AdvanceBitPosition( len << 3 );
+
+	return len;
+}
+
+void 
+TcpConnection::adaptRecvLen( uint len )
+{
+	// zero byte mode keeps the buffer small 
+
+	K_RETURN_IF( m_recvMode != RECV_DIRECT );
+
+	if ( len == m_recvLen )
+	{
+		if ( m_recvLen < RECV_MAX_LEN )
+		{
+			m_recvLen <<= 1;
+		}
+	}
+	else if ( len < ( m_recvLen >> 2 ) )
+	{
+		if ( m_recvLen > RECV_MIN_LEN )
+		{
+			m_recvLen >>= 1;
+		}
+	}
+}
+
+void 
+TcpConnection::dispatchMessages()
+{
+	LOG( FT_DEBUG_FLOW, _T("TcpConnection::dispatchMessages> Buff %d bytes"), m_recvBuffer.GetBytePosition() );
+
+	while ( !HasError() )
+	{
+		uint pos = m_recvPos;
+
+		MessagePtr m = buildMessage();
+
+		if ( m.Get() == 0 )
+		{
+			// a handshake frame is used without a message. continue after it.
+
+			if ( m_recvPos == pos || HasError() )
+			{
+				break;
+			}
+
+			continue;
+		}
+
+		m->remote = m_id;				//	
+		m_communicator->Notify( m ); 	// NOTE: called by IOCP thread
+	}
+
+	compactRecvBuffer();
+}
+
+void 
+TcpConnection::compactRecvBuffer()
+{
+	// called once per recv after all complete frames are built
+
+	if ( m_recvPos == 0 )
+	{
+		return;
+	}
+
+	uint endPos = m_recvBuffer.GetBytePosition();
+
+	K_ASSERT( m_recvPos <= endPos );
+
+	uint remain = endPos - m_recvPos;
+
+	if ( remain > 0 )
+	{
+		byte* p = m_recvBuffer.GetBuffer();
+
+		::memmove( p, p + m_recvPos, remain ); // only a partial frame
+	}
+
+	m_recvPos = 0;
+	m_recvBuffer.SetBytePosition( remain );
+}
+
 void 
 TcpConnection::sendHandshake()
 {
@@ -690,21 +1062,214 @@ TcpConnection::sendHandshake()
 
 	NetHandshake hs;
 
-	hs.sl = m_sl;
+	hs.sl 			= m_sl;
+	hs.compression 	= m_compressOffer;
+	hs.dictId 		= Compressor::GetDictionaryId();
 
 	::memcpy( hs.challenge, m_cipher.GetChallenge(), Cipher::LEN_CHALLENGE );
 	
-	BitStream bs;
+	TcpFramePtr frame( new TcpFrame );
 
-	hs.Pack( bs );
+	frame->Pack( hs, 0 ); // handshake is not encrypted
 
-	ScopedLock sl( m_lockSend );
+	queueFrame( frame );
+}
+
+void 
+TcpConnection::sendHandshakeReply( uint mode )
+{
+	K_ASSERT( !m_accepted );
+	K_ASSERT( !m_handshaking );
+
+	NetHandshake hs;
+
+	hs.sl 			= m_sl;
+	hs.compression 	= mode;
+	hs.dictId 		= Compressor::GetDictionaryId();
+
+	TcpFramePtr frame( new TcpFrame );
+
+	frame->Pack( hs, GetCipher() ); // encrypted like messages. not compressed.
+
+	queueFrame( frame );
 
-	m_accBuffer->WriteInt( bs.GetBytePosition(), 16 );
-	m_accBuffer->WriteInt( 0, 8 );
-	m_accBuffer->Write( bs.GetBytePosition(), bs.GetBuffer() );
+	// compressed frames are queued after the reply. the server accepts them then.
 
-    RequestSend();
+	m_compression = mode;
+}
+
+uint 
+TcpConnection::negotiateCompression( uint offered, uint dictId ) const
+{
+	K_RETURN_V_IF( offered == Compressor::MODE_NONE, Compressor::MODE_NONE );
+	K_RETURN_V_IF( m_compressOffer == Compressor::MODE_NONE, Compressor::MODE_NONE );
+
+	if ( offered == Compressor::MODE_DICT && 
+		 m_compressOffer == Compressor::MODE_DICT && 
+		 dictId != 0 && 
+		 dictId == Compressor::GetDictionaryId() )
+	{
+		return Compressor::MODE_DICT;
+	}
+
+	return Compressor::MODE_FAST;
+}
+
+bool 
+TcpConnection::acceptsControl( uint control ) const
+{
+	// a frame is compressed only in the mode agreed in the handshake
+
+	K_RETURN_V_IF( control == 0, true );
+	K_RETURN_V_IF( control & ~( TcpFrame::CONTROL_COMPRESSED | TcpFrame::CONTROL_DICT ), false );
+	K_RETURN_V_IF( !( control & TcpFrame::CONTROL_COMPRESSED ), false );
+	K_RETURN_V_IF( m_compression == Compressor::MODE_NONE, false );
+
+	if ( control & TcpFrame::CONTROL_DICT )
+	{
+		return m_compression == Compressor::MODE_DICT && 
+			   Compressor::GetDictionaryId() != 0;
+	}
+
+	return true;
+}
+
+bool 
+TcpConnection::inflate( uint control, uint messageLen, byte* raw, uint& rawLen )
+{
+	// RAWLEN{16} and compressed bytes. padding of cipher can follow.
+
+	K_RETURN_V_IF( messageLen <= 2, false );
+
+	m_recvBuffer.ReadInt( rawLen, 16 );
+
+	K_RETURN_V_IF( rawLen == 0 || rawLen > MAX_PACKET_LEN, false );
+
+	Compressor::Mode mode = ( control & TcpFrame::CONTROL_DICT ) 
+							? Compressor::MODE_DICT 
+							: Compressor::MODE_FAST;
+
+	int len = Compressor::Decompress( m_recvBuffer.GetBytePtr(), messageLen - 2, 
+									  raw, rawLen, mode );
+
+	return len == (int)rawLen;
+}
+
+void 
+TcpConnection::queueFrame( TcpFramePtr frame )
+{
+	bool high 	= false;
+	bool queued = true;
+	bool close 	= false;
+
+	{
+		ScopedLock sl( m_lockSend );
+
+		uint len = frame->GetLength();
+
+		if ( m_highWater > 0 && m_queuedBytes + len > m_highWater )
+		{
+			high = !m_overHighWater;
+
+			m_overHighWater = true;
+
+			if ( ( m_sendPolicy & SEND_COLLAPSE ) && collapseFrame( frame ) )
+			{
+				queued = false;
+			}
+			else if ( ( m_sendPolicy & SEND_DROP ) && frame->IsDroppable() )
+			{
+				++m_droppedFrames;
+
+				queued = false;
+			}
+			else if ( m_sendPolicy & SEND_DISCONNECT )
+			{
+				queued = false;
+				close  = true;
+			}
+		}
+
+		if ( queued )
+		{
+			m_queuedBytes += len;
+
+			++m_queuedFrames;
+
+			m_sendQ.push_back( TcpFramePtr() );
+			m_sendQ.back().Swap( frame );
+		}
+	}
+
+	if ( high )
+	{
+		notifySendState( NetStateMessage::TCP_SEND_HIGH_WATER );
+	}
+
+	if ( close )
+	{
+		LOG( FT_WARN, 
+			 _T("TcpConnection::queueFrame> Conn[%d] closed with %d bytes queued"), 
+			 m_id, 
+			 m_queuedBytes );
+
+		Close();
+
+		return;
+	}
+
+	if ( queued )
+	{
+		RequestSend();
+	}
+}
+
+bool 
+TcpConnection::collapseFrame( TcpFramePtr& frame )
+{
+	// called with m_lockSend. frames in m_sending are not touched.
+
+	K_RETURN_V_IF( frame->GetCollapseKey() == 0, false );
+
+	FrameQ::reverse_iterator i( m_sendQ.rbegin() );
+	FrameQ::reverse_iterator iEnd( m_sendQ.rend() );
+
+	for ( ; i != iEnd; ++i )
+	{
+		TcpFramePtr& queued = *i;
+
+		if ( queued->GetType() == frame->GetType() && 
+			 queued->GetCollapseKey() == frame->GetCollapseKey() )
+		{
+			m_queuedBytes -= queued->GetLength();
+			m_queuedBytes += frame->GetLength();
+
+			queued.Swap( frame ); // the old one is released with frame
+
+			++m_droppedFrames;
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void 
+TcpConnection::notifySendState( uint state )
+{
+	K_ASSERT( m_socket != 0 );
+
+	NetStateMessage* m = new NetStateMessage;
+
+	m->state 		= state;
+	m->connectionId = m_id;
+	m->groupId		= m_groupId;
+	m->addr 		= m_socket->GetPeerAddress();
+	m->socket 		= 0;
+	m->queued 		= m_queuedBytes;
+
+	m_communicator->Notify( MessagePtr( m ) );
 }
 
 } // gk
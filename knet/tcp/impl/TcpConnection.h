@@ -6,8 +6,10 @@
 #include <knet/message/BitStream.h>
 #include <knet/message/Message.h>
 #include <knet/socket/Socket.h>
+#include <knet/tcp/impl/TcpFrame.h>
 #include <knet/NetSecurity.h>
 
+#include <deque>
 #include <vector>
 
 namespace gk
@@ -23,9 +25,50 @@ class TcpCommunicator;
  * Protocol 
  *   LEN{16} CONTROL{8} 
  *  
+ * Messages are packed into TcpFrames and queued. A send takes up to 
+ * MAX_SEND_BUFS frames and sends them with one gather WSASend. 
+ * A partial send advances the buffer cursor. Bytes are not moved.
+ *
+ * RECV_DIRECT posts a recv straight into the receive buffer. The size 
+ * starts from RECV_MIN_LEN and doubles when a recv fills it, up to 
+ * RECV_MAX_LEN. It halves when recvs stay small. A full recv is followed 
+ * by nonblocking recvs until the socket would block.
+ *
+ * RECV_ZERO_BYTE posts a zero byte recv and reads on completion. 
+ * No buffer is pinned while idle. For servers with many idle connections.
+ *
+ * A corked connection queues frames without sending. Flush sends them 
+ * together. A low latency connection ignores Cork.
+ *
+ * Compression is negotiated in the handshake. The server offers its mode 
+ * and the client replies with the mode both support. Each side compresses 
+ * only after the mode is agreed. A compressed frame before that, or a 
+ * dictionary frame when MODE_DICT is not agreed, closes the connection 
+ * with NET_ERROR_MESSAGE_UNPACK.
+ *
+ * Queued bytes are bounded by send limits. TCP_SEND_HIGH_WATER is 
+ * notified when a frame would go over the high water mark and 
+ * TCP_SEND_LOW_WATER when the queue drains to the low water mark. 
+ * Over the high water mark, SendPolicy bits decide what to do with 
+ * the frame in order of collapse, drop and disconnect.
  */
 class TcpConnection : private Noncopyable, public IoAgent
 {
+public:
+	enum RecvMode
+	{
+		  RECV_DIRECT 		// post buffers of adaptive size
+		, RECV_ZERO_BYTE 	// post zero byte recv and read on readiness
+	};
+
+	enum SendPolicy
+	{
+		  SEND_QUEUE 		= 0 	// queue anyway. notify only.
+		, SEND_COLLAPSE 	= 1 	// replace a queued frame of same type and collapse key
+		, SEND_DROP 		= 2 	// drop droppable frames
+		, SEND_DISCONNECT 	= 4 	// close the connection
+	};
+
 public:
     TcpConnection();
     ~TcpConnection();
@@ -41,6 +84,27 @@ public:
      */
     bool Init( TcpCommunicator* communicator, uint id, Socket* socket, SecurityLevel sl, bool accepted );
 
+	/**
+	 * Set recv mode. Call before the connection is bound to IoService.
+	 *
+	 * @param mode The recv mode
+	 */
+	void SetRecvMode( RecvMode mode );
+
+	/**
+	 * Set compression to offer or accept. Call before handshake.
+	 *
+	 * @param mode Compressor::Mode
+	 */
+	void SetCompression( uint mode );
+
+	/**
+	 * Get compression agreed with the peer
+	 *
+	 * @return Compressor::Mode to pack frames for this connection
+	 */
+	uint GetCompression() const;
+
 	/**
 	 * Start negotiating for security and other protocol parameters 
 	 */
@@ -68,6 +132,16 @@ public:
 	 */
 	void Send( void* data, uint len );
 
+	/**
+	 * Send a packed frame. 
+	 *
+	 * The frame must be packed with GetCipher() of this connection. 
+	 * Used to share one frame among connections.
+	 *
+	 * @param frame The frame to send
+	 */
+	void Send( TcpFramePtr frame );
+
     /**
      * Get tick for protocol processing
      */
@@ -127,15 +201,94 @@ public:
 	 */
 	uint GetGroup() const;
 
+	/**
+	 * Hold queued frames until Flush. Ignored for low latency connections.
+	 *
+	 * @return true if corked
+	 */
+	bool Cork();
+
+	/**
+	 * Send frames held by Cork
+	 */
+	void Flush();
+
+	/**
+	 * Check whether corked
+	 */
+	bool IsCorked() const;
+
+	/**
+	 * Set low latency. A low latency connection is not corked.
+	 *
+	 * @param lowLatency true to send frames right away always
+	 */
+	void SetLowLatency( bool lowLatency );
+
+	/**
+	 * Check low latency 
+	 */
+	bool IsLowLatency() const;
+
+	/**
+	 * Set send queue limits. 
+	 *
+	 * @param highWater Queued bytes to notify and apply policy over. 0 for no limit.
+	 * @param lowWater Queued bytes to notify at after going over high water
+	 * @param policy SendPolicy bits
+	 */
+	void SetSendLimits( uint highWater, uint lowWater, uint policy );
+
+	/**
+	 * Get bytes queued and being sent. Read without lock.
+	 */
+	uint GetQueuedBytes() const;
+
+	/**
+	 * Get frames queued and being sent. Read without lock.
+	 */
+	uint GetQueuedFrames() const;
+
+	/**
+	 * Get frames dropped or collapsed by send policy
+	 */
+	uint GetDroppedFrames() const;
+
+	/**
+	 * Get cipher to pack frames for this connection
+	 *
+	 * @return The cipher. 0 if not encrypted.
+	 */
+	Cipher* GetCipher();
+
 private:
 	enum 
 	{
-		  HEADER_LEN = 3 		 // 2 bytes len, 1 byte control
+		  HEADER_LEN = TcpFrame::HEADER_LEN
 		, MAX_PACKET_LEN = 8192
+		, RECV_MIN_LEN = 2048 	 // initial bytes to recv
+		, RECV_MAX_LEN = 65536 	 // max bytes to recv at once
+		, MAX_RECV_ROUNDS = 8 	 // nonblocking recvs per completion
+		, MAX_SEND_BUFS = 64 	 // frames per send
 	};
 
+	typedef std::deque<TcpFramePtr> FrameQ;
+	typedef std::vector<TcpFramePtr> FrameList;
+
+	void queueFrame( TcpFramePtr frame );
+	bool collapseFrame( TcpFramePtr& frame );
+	void notifySendState( uint state );
+	int recvNow();
+	void adaptRecvLen( uint len );
+	void recvCompleted( IoBlock* io );
+	void dispatchMessages();
 	MessagePtr buildMessage();
+	void compactRecvBuffer();
 	void sendHandshake();
+	void sendHandshakeReply( uint mode );
+	uint negotiateCompression( uint offered, uint dictId ) const;
+	bool acceptsControl( uint control ) const;
+	bool inflate( uint control, uint messageLen, byte* raw, uint& rawLen );
 
 private:
 	TcpCommunicator* 	m_communicator;
@@ -147,18 +300,34 @@ private:
 
 	Cipher				m_cipher;
 	bool 				m_handshaking;
+	bool 				m_corked;
+	bool 				m_lowLatency;
+	uint 				m_compressOffer; 		// mode to offer or accept
+	uint 				m_compression; 			// mode agreed to send
+	uint 				m_replyCompression; 	// mode to reply after recv
 
 	Mutex				m_lockRecv;
 	Mutex 				m_lockSend;
     Atomic<uint>		m_sendRequestCount;
     Atomic<uint>		m_recvRequestCount;
-    BitStream 			m_sendBuffer1;
-	BitStream 			m_sendBuffer2;
-    BitStream 			m_recvBuffer;
-	BitStream* 			m_accBuffer; 			// accumulation buffer
+	FrameQ 				m_sendQ; 				// frames waiting for send
+	FrameList 			m_sending; 				// frames in the outstanding send
+	IoBuf 				m_sendBufs[MAX_SEND_BUFS];
+    BitStream 			m_recvBuffer; 			// data is from m_recvPos to write position
+	uint 				m_recvPos; 				// read cursor of the next frame
+	RecvMode 			m_recvMode;
+	uint 				m_recvLen; 				// bytes to recv at once
 	IoBlock 			m_sendBlock;
 	IoBlock 			m_recvBlock;
 
+	uint 				m_highWater;
+	uint 				m_lowWater;
+	uint 				m_sendPolicy;
+	bool 				m_overHighWater;
+	uint 				m_queuedBytes; 			// bytes in m_sendQ and m_sending
+	uint 				m_queuedFrames;
+	uint 				m_droppedFrames;
+
 	uint 				m_groupId;
 };
 
@@ -204,5 +373,47 @@ TcpConnection::GetGroup() const
 	return m_groupId;
 }
 
+inline
+uint 
+TcpConnection::GetCompression() const
+{
+	return m_compression;
+}
+
+inline
+bool 
+TcpConnection::IsCorked() const
+{
+	return m_corked;
+}
+
+inline
+bool 
+TcpConnection::IsLowLatency() const
+{
+	return m_lowLatency;
+}
+
+inline
+uint 
+TcpConnection::GetQueuedBytes() const
+{
+	return m_queuedBytes;
+}
+
+inline
+uint 
+TcpConnection::GetQueuedFrames() const
+{
+	return m_queuedFrames;
+}
+
+inline
+uint 
+TcpConnection::GetDroppedFrames() const
+{
+	return m_droppedFrames;
+}
+
 } // gk
 
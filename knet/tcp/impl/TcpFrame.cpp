@@ -0,0 +1,120 @@
+#include "stdafx.h"
+
+#include <kcore/corebase.h>
+#include <knet/tcp/impl/TcpFrame.h>
+
+#include <knet/cipher/Cipher.h>
+
+namespace gk {
+
+TcpFrame::TcpFrame()
+: m_stream()
+, m_type( 0 )
+, m_sendFlags( 0 )
+, m_collapseKey( 0 )
+{
+}
+
+TcpFrame::~TcpFrame()
+{
+}
+
+bool
+TcpFrame::Pack( Message& m, Cipher* cipher, uint compression )
+{
+	begin();
+
+	m_type 			= m.type;
+	m_sendFlags 	= m.sendFlags;
+	m_collapseKey 	= m.collapseKey;
+
+	K_RETURN_V_IF( !m.Pack( m_stream ), false );
+
+	return end( cipher, compression );
+}
+
+bool
+TcpFrame::Pack( const void* data, uint len, Cipher* cipher, uint compression )
+{
+	K_ASSERT( data != 0 );
+	K_ASSERT( len > 0 );
+
+	begin();
+
+	m_type 			= 0;
+	m_sendFlags 	= 0;
+	m_collapseKey 	= 0;
+
+	K_RETURN_V_IF( !m_stream.Write( len, data ), false );
+
+	return end( cipher, compression );
+}
+
+void
+TcpFrame::begin()
+{
+	m_stream.Clear();
+	m_stream.Reset();
+
+	m_stream.WriteInt( 0, 16 ); 	// len. filled in end()
+	m_stream.WriteInt( 0, 8 ); 		// control
+}
+
+bool
+TcpFrame::end( Cipher* cipher, uint compression )
+{
+	if ( compression != Compressor::MODE_NONE )
+	{
+		compress( (Compressor::Mode)compression );
+	}
+
+	if ( cipher != 0 )
+	{
+		// just message part is encrypted
+
+		K_RETURN_V_IF( !cipher->Encrypt( m_stream, HEADER_LEN ), false );
+	}
+
+	uint len = m_stream.GetBytePosition() - HEADER_LEN;
+
+	m_stream.WriteIntAt( len, 16, 0 );
+
+	return true;
+}
+
+void
+TcpFrame::compress( Compressor::Mode mode )
+{
+	enum 
+	{
+		OUT_LEN = MAX_PAYLOAD_LEN + MAX_PAYLOAD_LEN / 255 + 16 	// Compressor::GetBound
+	};
+
+	uint len = m_stream.GetBytePosition() - HEADER_LEN;
+
+	K_RETURN_IF( len < COMPRESS_MIN_LEN || len > MAX_PAYLOAD_LEN );
+
+	byte out[OUT_LEN];
+
+	uint clen = Compressor::Compress( m_stream.GetBuffer() + HEADER_LEN, len, 
+									  out, OUT_LEN, mode );
+
+	// plain when it does not save bytes with the length field
+
+	K_RETURN_IF( clen == 0 || clen + 2 >= len );
+
+	m_stream.SetBytePosition( HEADER_LEN );
+	m_stream.WriteInt( len, 16 );
+	m_stream.Write( clen, out );
+
+	uint control = CONTROL_COMPRESSED;
+
+	if ( mode == Compressor::MODE_DICT )
+	{
+		control |= CONTROL_DICT;
+	}
+
+	m_stream.WriteIntAt( control, 8, 16 );
+}
+
+} // gk
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <kcore/mem/AllocatorAware.h>
+#include <kcore/sys/IntrusivePointer.h>
+#include <kcore/sys/RefCounted.h>
+#include <knet/compress/Compressor.h>
+#include <knet/message/BitStream.h>
+#include <knet/message/Message.h>
+
+namespace gk
+{
+
+class Cipher;
+
+/**
+ * @class TcpFrame
+ *
+ * A TCP frame with header and payload in one buffer.
+ *
+ * A message is packed right after the header space and encrypted in place.
+ * Then the header is filled. So payload bytes are written once and the
+ * frame is sent as it is from the send queue of TcpConnection.
+ *
+ * Frames are not changed after packing. So they can be shared.
+ *
+ * With compression the payload is RAWLEN{16} and the compressed bytes 
+ * and CONTROL_COMPRESSED is set. Compression is before encryption. 
+ * Payloads which do not get smaller are sent as they are.
+ */
+class TcpFrame : public AllocatorAware, public RefCounted
+{
+public:
+	enum
+	{
+		  HEADER_LEN 		= 3 		// 2 bytes len, 1 byte control
+		, MAX_PAYLOAD_LEN 	= 8192 		// max payload accepted by receivers
+		, COMPRESS_MIN_LEN 	= 64 		// smaller payloads are not compressed
+	};
+
+	/**
+	 * Bits of the control byte
+	 */
+	enum Control
+	{
+		  CONTROL_COMPRESSED 	= 0x01
+		, CONTROL_DICT 			= 0x02 	// compressed with the shared dictionary
+	};
+
+public:
+	TcpFrame();
+	~TcpFrame();
+
+	/**
+	 * Pack a message
+	 *
+	 * @param m The message to pack
+	 * @param cipher Cipher to encrypt payload. 0 for plain.
+	 * @param compression Compressor::Mode to compress payload
+	 * @return true if successful
+	 */
+	bool Pack( Message& m, Cipher* cipher, uint compression = Compressor::MODE_NONE );
+
+	/**
+	 * Pack already packed bytes
+	 *
+	 * @param data The raw bytes
+	 * @param len The length of data
+	 * @param cipher Cipher to encrypt payload. 0 for plain.
+	 * @param compression Compressor::Mode to compress payload
+	 * @return true if successful
+	 */
+	bool Pack( const void* data, uint len, Cipher* cipher, 
+			   uint compression = Compressor::MODE_NONE );
+
+	/**
+	 * Get frame bytes including header
+	 */
+	const byte* GetData() const;
+
+	/**
+	 * Get frame length including header
+	 */
+	uint GetLength() const;
+
+	/**
+	 * Get message type. 0 for raw bytes.
+	 */
+	ushort GetType() const;
+
+	/**
+	 * Check Message::DROPPABLE of the packed message
+	 */
+	bool IsDroppable() const;
+
+	/**
+	 * Get Message::collapseKey of the packed message
+	 */
+	uint GetCollapseKey() const;
+
+private:
+	void begin();
+	bool end( Cipher* cipher, uint compression );
+	void compress( Compressor::Mode mode );
+
+private:
+	BitStream 	m_stream;
+	ushort 		m_type;
+	ushort 		m_sendFlags;
+	uint 		m_collapseKey;
+};
+
+typedef IntrusivePointer<TcpFrame> TcpFramePtr;
+
+inline
+const byte*
+TcpFrame::GetData() const
+{
+	return m_stream.GetBuffer();
+}
+
+inline
+uint
+TcpFrame::GetLength() const
+{
+	return m_stream.GetBytePosition();
+}
+
+inline
+ushort 
+TcpFrame::GetType() const
+{
+	return m_type;
+}
+
+inline
+bool 
+TcpFrame::IsDroppable() const
+{
+	return ( m_sendFlags & Message::DROPPABLE ) != 0;
+}
+
+inline
+uint 
+TcpFrame::GetCollapseKey() const
+{
+	return m_collapseKey;
+}
+
+} // gk
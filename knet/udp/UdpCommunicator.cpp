@@ -179,7 +179,7 @@ UdpCommunicator::Run()
 }
 
 void
-UdpCommunicator::Send( uint tag, MessagePtr m, int qos )
+UdpCommunicator::Send( uint tag, MessagePtr m, int qos, uint* seq )
 {
 	K_ASSERT( m_ios != 0 );
 	K_ASSERT( m_listener != 0 );
@@ -187,11 +187,11 @@ UdpCommunicator::Send( uint tag, MessagePtr m, int qos )
 
 	UdpConnection* c = FindByTag( tag );
 
-	send( c, m, qos );
+	send( c, m, qos, seq );
 }
 
 void
-UdpCommunicator::SendByTag( MessagePtr m, int qos )
+UdpCommunicator::SendByTag( MessagePtr m, int qos, uint* seq )
 {
 	K_ASSERT( m_ios != 0 );
 	K_ASSERT( m_listener != 0 );
@@ -199,13 +199,18 @@ UdpCommunicator::SendByTag( MessagePtr m, int qos )
 
 	if ( m->remote == 0 )
 	{
+		if ( seq != 0 )
+		{
+			*seq = 0;
+		}
+
 		multicast( m->remotes, m, qos );
 	}
 	else
 	{
 		UdpConnection* c = FindByTag( m->remote );
 
-		send( c, m, qos );
+		send( c, m, qos, seq );
 	}
 }
 
@@ -570,6 +575,20 @@ UdpCommunicator::SetLossy( uint tag, uint rate )
 	c->SetLossy( rate );
 }
 
+bool 
+UdpCommunicator::GetAckState( uint tag, uint& cumAck )
+{
+	ScopedLock sl( m_connLock );
+
+	ConnectionMap::iterator i( m_connections.find( tag ) );
+
+	K_RETURN_V_IF( i == m_connections.end(), false );
+
+	cumAck = i->second->GetRecvCumAck();
+
+	return true;
+}
+
 UdpConnection* 
 UdpCommunicator::FindByAddress( ulong addrKey )
 {
@@ -680,8 +699,13 @@ UdpCommunicator::processTickConnections()
 }
 
 void
-UdpCommunicator::send( UdpConnection* c, MessagePtr m, int qos )
+UdpCommunicator::send( UdpConnection* c, MessagePtr m, int qos, uint* seq )
 {
+	if ( seq != 0 )
+	{
+		*seq = 0; // set by reliable sends only
+	}
+
 	if ( c == 0 )
 	{
 		LOG( FT_WARN, _T("UdpCommunicator::send> UDP connection is null") );
@@ -735,12 +759,12 @@ UdpCommunicator::send( UdpConnection* c, MessagePtr m, int qos )
 	{
 	case Message::RELIABLE:
 		{
-			c->SendReliable( bs.GetBuffer(), bs.GetBytePosition() );
+			c->SendReliable( bs.GetBuffer(), bs.GetBytePosition(), seq );
 		}
 		break;
 	case Message::ORDERED:
 		{
-			c->SendOrdered( bs.GetBuffer(), bs.GetBytePosition() );
+			c->SendOrdered( bs.GetBuffer(), bs.GetBytePosition(), seq );
 		}
 		break;
 	default:
@@ -85,9 +85,11 @@ public:
 	 *
 	 * @param localId : connection to send
 	 * @param m       : message to send
+	 * @param seq     : [out] reliable sequence of the send if not 0. 
+	 *                  0 when lossy, relayed, multicast or failed.
 	 */
-	void Send( uint tag, MessagePtr m, int qos = Message::RELIABLE );
-	void SendByTag( MessagePtr m, int qos = Message::RELIABLE );
+	void Send( uint tag, MessagePtr m, int qos = Message::RELIABLE, uint* seq = 0 );
+	void SendByTag( MessagePtr m, int qos = Message::RELIABLE, uint* seq = 0 );
 
 	/**
 	 * Broadcast message to all connected ones 
@@ -144,6 +146,15 @@ public:
 	 */
 	void SetLossy( uint tag, uint rate );
 
+	/**
+	 * Get the cumulative ack of a connection. On the thread calling Run.
+	 *
+	 * @param tag The tag of the connection
+	 * @param cumAck The cumulative ack received from the remote
+	 * @return false if the connection is not found
+	 */
+	bool GetAckState( uint tag, uint& cumAck );
+
 	/**
 	 * Find by key
 	 *
@@ -172,7 +183,7 @@ private:
 	void processErrorConnections();
 	void processTickConnections();
 
-	void send( UdpConnection* c, MessagePtr m, int qos );
+	void send( UdpConnection* c, MessagePtr m, int qos, uint* seq = 0 );
 	void multicast( const Message::RemoteList& tags, MessagePtr m, int qos );	
 
 private:
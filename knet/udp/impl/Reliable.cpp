@@ -242,7 +242,7 @@ Reliable::OnRecv( const UdpHeader& header, void* data, uint len )
 }
 
 bool 
-Reliable::Send( void* data, uint len, bool ordered )
+Reliable::Send( void* data, uint len, bool ordered, uint* seq )
 {
 	K_ASSERT( data != 0 );
 	K_ASSERT( len > 0 );
@@ -289,6 +289,11 @@ Reliable::Send( void* data, uint len, bool ordered )
 
 	m_sendList.push_back( sb );
 
+	if ( seq != 0 )
+	{
+		*seq = sb->header.seq;
+	}
+
 	return true;
 }
 
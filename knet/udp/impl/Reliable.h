@@ -73,9 +73,10 @@ public:
 	 * @param data The bytes to send
 	 * @param len The length of bytes to send
 	 * @param ordered The tag to direct ordered delivery
+	 * @param seq [out] The sequence of the segment if not 0
 	 * @return true if successful
 	 */
-	bool Send( void* data, uint len, bool ordered = false );
+	bool Send( void* data, uint len, bool ordered = false, uint* seq = 0 );
 
 	/**
 	 * Cleans up 
@@ -87,6 +88,12 @@ public:
 	 */
 	uint GetSendCumAck() const;
 
+	/**
+	 * Get last cumulative ack received from the remote.
+	 * Segments up to it are received by the remote.
+	 */
+	uint GetRecvCumAck() const;
+
 private:
 	typedef std::list<UdpSendBlock*> SendBlockList;
 	typedef std::list<UdpRecvBlock*> RecvBlockList;
@@ -157,4 +164,11 @@ Reliable::GetSendCumAck() const
 	return m_sendCumAck;
 }
 
+inline
+uint 
+Reliable::GetRecvCumAck() const
+{
+	return m_recvCumAck;
+}
+
 } // gk 
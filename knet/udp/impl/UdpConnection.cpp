@@ -133,7 +133,7 @@ UdpConnection::OnRecv( void* data, uint len )
 }
 
 bool
-UdpConnection::SendReliable( void* data, uint len )
+UdpConnection::SendReliable( void* data, uint len, uint* seq )
 {
 	// NOTE: data is owned by Communicator
 	
@@ -148,11 +148,11 @@ UdpConnection::SendReliable( void* data, uint len )
 	K_ASSERT( len > 0 );
 	K_ASSERT( len < MAX_SEGMENT_SIZE );
 
-	return m_reliable->Send( data, len, false );
+	return m_reliable->Send( data, len, false, seq );
 }
 
 bool
-UdpConnection::SendOrdered( void* data, uint len )
+UdpConnection::SendOrdered( void* data, uint len, uint* seq )
 {
 	// NOTE: data is owned by Communicator
 	
@@ -167,7 +167,7 @@ UdpConnection::SendOrdered( void* data, uint len )
 	K_ASSERT( len > 0 );
 	K_ASSERT( len < MAX_SEGMENT_SIZE );
 
-	return m_reliable->Send( data, len, true );
+	return m_reliable->Send( data, len, true, seq );
 }
 
 bool
@@ -244,6 +244,14 @@ UdpConnection::SendRaw( void* data, uint len )
 	return slen > 0;
 }
 
+uint 
+UdpConnection::GetRecvCumAck() const
+{
+	K_ASSERT( m_reliable != 0 );
+
+	return m_reliable->GetRecvCumAck();
+}
+
 void 
 UdpConnection::Run()
 {
@@ -62,18 +62,20 @@ public:
 	 *
 	 * @param data The bytes to send
 	 * @param len The length of bytes to send
+	 * @param seq [out] The reliable sequence of the segment if not 0
 	 * @return true if successful
 	 */
-	bool SendReliable( void* data, uint len ); 
+	bool SendReliable( void* data, uint len, uint* seq = 0 ); 
 
 	/**
 	 * Send data to network reliable and ordered
 	 *
 	 * @param data The bytes to send
 	 * @param len The length of bytes to send
+	 * @param seq [out] The reliable sequence of the segment if not 0
 	 * @return true if successful
 	 */
-	bool SendOrdered( void* data, uint len ); 
+	bool SendOrdered( void* data, uint len, uint* seq = 0 ); 
 
 	/**
 	 * Send bytes to network which can be lost
@@ -116,6 +118,11 @@ public:
 	 */
 	uint GetRemoteTag() const;
 
+	/**
+	 * Get cumulative ack of reliable segments from the remote
+	 */
+	uint GetRecvCumAck() const;
+
 	/**
 	 * Returns error
 	 */
@@ -13,6 +13,7 @@
 #include <knet/message/net/NetStateMessage.h>
 #include <kcore/xml/tinyxml.h>
 #include <kcore/util/StringUtil.h>
+#include <kcore/sys/Clock.h>
 
 namespace gk {
 
@@ -53,6 +54,10 @@ Node::Init( TiXmlElement* xe, bool luaMode )
 	REGISTER_MESSAGE( new CmNodeState );
 	REGISTER_MESSAGE( new CmCellState );
 
+	// all types are registered by the net, cells and above. Create is lock free after.
+
+	MessageFactory::Instance()->Freeze();
+
 	m_net.Listen( m_self.addr, SECURITY1 );
 
 	m_recvCount = 0;
@@ -70,6 +75,8 @@ Node::Run()
 
 	while ( IsRunning() )
 	{
+		Clock::Update(); // cells and dispatchers share this time
+
 		m_processCount = 0;
 
 		processCells();
@@ -81,7 +88,9 @@ Node::Run()
 
 		if ( m_processCount == (uint)0 )
 		{
-			::Sleep( 1 );
+			// woken by queues and passive cells. timers are due at slot bounds.
+
+			m_wakeup.Wait( TimerWheel::RESOLUTION );
 		}
 
 		if ( m_tickStatus.Elapsed() > 1000 )
@@ -111,6 +120,8 @@ Node::Send( MessagePtr m )
 	else
 	{
 		m_sendQ.Put( m );
+
+		m_wakeup.Signal();
 	}
 }
 
@@ -118,6 +129,8 @@ void
 Node::Notify( MessagePtr m )
 {
 	m_recvQ.Put( m );
+
+	m_wakeup.Signal();
 }
 
 void 
@@ -133,6 +146,20 @@ void
 Node::Completed( Transaction* trans )
 {
 	m_transQ.Put( trans );
+
+	m_wakeup.Signal();
+}
+
+void 
+Node::Wakeup()
+{
+	m_wakeup.Signal();
+}
+
+void 
+Node::helpStop()
+{
+	m_wakeup.Signal();
 }
 
 uint 
@@ -274,10 +301,20 @@ Node::processCluster()
 void 
 Node::processRecvQ()
 {
-	MessagePtr m;
+	LockFreeMessageQ::List ms;
+
+	if ( !m_recvQ.GetAll( ms ) )
+	{
+		return;
+	}
+
+	LockFreeMessageQ::List::iterator i( ms.begin() );
+	LockFreeMessageQ::List::iterator iEnd( ms.end() );
 
-	while ( m_recvQ.Get( m ) )
+	for ( ; i != iEnd; ++i )
 	{
+		MessagePtr& m = *i;
+
 		m_processCount.Inc();
 
 		switch ( m->type )
@@ -326,6 +363,8 @@ Node::processSendQ()
 		{
 			// local message 
 			m_recvQ.Put( m );
+
+			m_wakeup.Signal();
 		}
 		else
 		{
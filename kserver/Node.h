@@ -1,5 +1,6 @@
 #pragma once 
 
+#include <kcore/sys/Event.h>
 #include <kcore/sys/Tick.h>
 #include <knet/NetServer.h>
 #include <knet/message/MessageListener.h>
@@ -120,6 +121,15 @@ public:
 	/// Get async pool
 	AsyncPool* GetAsyncPool();
 
+	/**
+	 * Wake the node thread. Used by passive cells on new work.
+	 */
+	void Wakeup();
+
+protected:
+	/// Thread::helpStop. Wakes Run to exit
+	void helpStop();
+
 private:
 	typedef Queue<Transaction*, Mutex> TransQ;
 
@@ -157,7 +167,7 @@ private:
 	CellTree  		m_celltree;
 	CellList  		m_cells;		// level 0 cells
 
-	MessageQ 		m_recvQ;
+	LockFreeMessageQ m_recvQ;
 	MessageQ 		m_sendQ;
 
 	uint			m_recvCount;
@@ -166,6 +176,7 @@ private:
 	Tick 			m_tickState;
 	Tick			m_tickStatus;
 	Atomic<uint> 	m_processCount;
+	Event 			m_wakeup; 		// signalled on queue put
 
 	TransactionServer m_transServer;
 	TransQ 			  m_transQ;
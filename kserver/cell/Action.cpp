@@ -6,13 +6,46 @@
 
 namespace gk {
 
+Action::ActionTimer::ActionTimer()
+: m_action( 0 )
+, m_tick( false )
+{
+}
+
+void 
+Action::ActionTimer::Set( Action* action, bool tick )
+{
+	m_action 	= action;
+	m_tick 		= tick;
+}
+
+void 
+Action::ActionTimer::onExpire( uint8 now )
+{
+	K_ASSERT( m_action != 0 );
+
+	if ( m_tick )
+	{
+		m_action->onTick( now );
+	}
+	else
+	{
+		m_action->onTimeout();
+	}
+}
+
 Action::Action()
 : m_cell( 0 )
 , m_finished( true )
 , m_timeout( 0 )
 , m_age( 0 )
 , m_hsm( 0 )
+, m_tickInterval( 0 )
+, m_start( 0 )
+, m_lastTick( 0 )
 {
+	m_timeoutTimer.Set( this, false );
+	m_tickTimer.Set( this, true );
 }
 
 Action::~Action()
@@ -28,6 +61,10 @@ Action::Init( Cell* cell )
 	m_timeout 	= 0;
 	m_age 		= 0;
 	m_hsm		= 0;
+
+	m_tickInterval 	= DEFAULT_TICK_INTERVAL;
+	m_start 		= cell->GetTimers().GetNow();
+	m_lastTick 		= m_start;
 	
 	m_finished = !init();
 
@@ -39,6 +76,9 @@ Action::Init( Cell* cell )
 		{
 			m_hsm->Init( this );
 		}
+
+		scheduleTimeout();
+		scheduleTick();
 	}
 
 	return !m_finished;
@@ -49,14 +89,9 @@ Action::Run( uint age )
 {
 	K_ASSERT( m_cell != 0 );
 
-	m_age += age;
-
-	if ( m_timeout > 0 && m_age > m_timeout )
-	{
-		timeout();
+	// timeout is on the wheel. see onTimeout.
 
-		return false;
-	}
+	m_age += age;
 
 	if ( m_hsm != 0 )
 	{
@@ -90,6 +125,9 @@ Action::Completed( Transaction* trans )
 void 
 Action::Fini()
 {
+	m_timeoutTimer.Cancel();
+	m_tickTimer.Cancel();
+
 	if ( m_hsm != 0 )
 	{
 		m_hsm->Fini();
@@ -106,6 +144,30 @@ Action::Fini()
 	LOG( FT_DEBUG, _T("Action::Fini> %s"), m_name.c_str() );
 }
 
+void 
+Action::SetTimeout( uint ms )
+{
+	m_timeout = ms;
+
+	// during init(), scheduled when init() is done
+
+	if ( m_cell != 0 && !m_finished )
+	{
+		scheduleTimeout();
+	}
+}
+
+void 
+Action::SetTickInterval( uint ms )
+{
+	m_tickInterval = ms;
+
+	if ( m_cell != 0 && !m_finished )
+	{
+		scheduleTick();
+	}
+}
+
 bool 
 Action::init()
 {
@@ -148,4 +210,62 @@ Action::setFinished()
 	m_finished = true;
 }
 
+void 
+Action::scheduleTimeout()
+{
+	if ( m_timeout == 0 )
+	{
+		m_timeoutTimer.Cancel();
+
+		return;
+	}
+
+	m_cell->GetTimers().Schedule( &m_timeoutTimer, m_start + m_timeout );
+}
+
+void 
+Action::scheduleTick()
+{
+	if ( m_tickInterval == 0 )
+	{
+		m_tickTimer.Cancel();
+
+		return;
+	}
+
+	m_cell->GetTimers().Schedule( &m_tickTimer, m_lastTick + m_tickInterval );
+}
+
+void 
+Action::onTimeout()
+{
+	K_RETURN_IF( m_finished );
+
+	timeout();
+
+	Fini();
+}
+
+void 
+Action::onTick( uint8 now )
+{
+	K_RETURN_IF( m_finished );
+
+	uint age = (uint)( now - m_lastTick );
+
+	m_lastTick = now;
+
+	if ( !Run( age ) )
+	{
+		Fini();
+
+		return;
+	}
+
+	if ( !m_finished )
+	{
+		scheduleTick();
+	}
+}
+
 } // gk
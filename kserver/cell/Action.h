@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <kcore/sys/SharedPointer.h>
+#include <kcore/sys/TimerWheel.h>
 #include <knet/message/Message.h>
 #include <kserver/cell/action/ActionHsm.h>
 
@@ -13,9 +14,19 @@ class Cell;
  * @class Action 
  *
  * An instance based action handler 
+ *
+ * Timeout and periodic ticks are scheduled on the timer wheel of the cell.
+ * So idle actions are not visited every Cell::Run.
  */
 class Action 
 {
+public:
+	enum
+	{
+		DEFAULT_TICK_INTERVAL 	= 0, 						// not ticked
+		TICK_INTERVAL 			= TimerWheel::RESOLUTION 	// ms. each Cell::Run at most, as before the wheel
+	};
+
 public:
 	Action();
 	virtual ~Action();
@@ -28,7 +39,8 @@ public:
 	bool Init( Cell* cell );
 
 	/**
-	 * Tick with elapsed time of Cell::Run 
+	 * Tick with elapsed time from last tick. 
+	 * Called from the cell timer wheel every tick interval.
 	 *
 	 * @param tick Elapsed time from last call
 	 */
@@ -58,7 +70,7 @@ public:
 
 	/**
 	 * Set timeout 
-	 * @param ms Miliseconds to timeout 
+	 * @param ms Miliseconds to timeout from Init. 0 to disable.
 	 */
 	void SetTimeout( uint ms );
 
@@ -67,6 +79,20 @@ public:
 	 */
 	uint GetTimeout() const;
 
+	/**
+	 * Set tick interval. 0 by default, so an action is not visited 
+	 * until a message or timeout. Actions with run( uint ) or hsm 
+	 * OnTick logic call this in init(), usually with TICK_INTERVAL.
+	 *
+	 * @param ms Miliseconds between ticks. 0 for no tick.
+	 */
+	void SetTickInterval( uint ms );
+
+	/**
+	 * Get tick interval
+	 */
+	uint GetTickInterval() const;
+
 protected:
 	virtual bool init();
 	virtual bool run( uint tick );
@@ -77,13 +103,46 @@ protected:
 
 	void setFinished();
 
+private:
+	/**
+	 * @class ActionTimer
+	 *
+	 * Calls back the action from the timer wheel
+	 */
+	class ActionTimer : public Timer
+	{
+	public:
+		ActionTimer();
+
+		void Set( Action* action, bool tick );
+
+	protected:
+		void onExpire( uint8 now );
+
+	private:
+		Action*		m_action;
+		bool		m_tick;
+	};
+
+	void scheduleTimeout();
+	void scheduleTick();
+	void onTimeout();
+	void onTick( uint8 now );
+
 protected:
 	Cell*		m_cell;
 	bool		m_finished;
 	uint		m_timeout; 		// set this to > 0 to check timeout
-	uint		m_age;
+	uint		m_age;			// sum of ticks from Init
 	tstring		m_name;			// for debugging
-	ActionHsm*	m_hsm;			// To use hsm, set this during init
+	ActionHsm*	m_hsm;			// To use hsm, set this during init. SetTickInterval for OnTick
+
+private:
+	uint			m_tickInterval;
+	uint8			m_start;		// wheel time of Init
+	uint8			m_lastTick;
+	ActionTimer		m_timeoutTimer;
+	ActionTimer		m_tickTimer;
 };
 
 typedef SharedPointer<Action> ActionPtr;
@@ -96,17 +155,17 @@ Action::IsFinished() const
 }
 
 inline
-void 
-Action::SetTimeout( uint ms )
+uint 
+Action::GetTimeout() const
 {
-	m_timeout = ms;
+	return m_timeout;
 }
 
 inline
 uint 
-Action::GetTimeout() const
+Action::GetTickInterval() const
 {
-	return m_timeout;
+	return m_tickInterval;
 }
 
 } // gk
@@ -11,6 +11,7 @@
 
 #include <kserver/Node.h>
 
+#include <kcore/sys/Clock.h>
 #include <kcore/util/StringUtil.h>
 #include <kcore/xml/tinyxml.h>
 
@@ -118,6 +119,8 @@ Cell::Notify( MessagePtr m )
 
 	// since a cell can be activated, we need to use a queue 
 	m_mailbox.Put( m );
+
+	Wakeup();
 }
 
 void 
@@ -130,6 +133,8 @@ Cell::Run()
 
 	run();
 
+	m_timers.Advance( Clock::Now() ); // action timeouts and ticks
+
 	m_typeDispatcher.Run();
 	m_ctxDispatcher.Run();
 	m_transDispatcher.Run();
@@ -141,12 +146,16 @@ void
 Cell::MakeActive()
 {
 	m_activeFlag = 1;
+
+	Wakeup();
 }
 
 void 
 Cell::MakePassive()
 {
 	m_activeFlag = 2;
+
+	Wakeup();
 }
 
 void 
@@ -155,6 +164,25 @@ Cell::Completed( Transaction* trans )
 	K_ASSERT( trans != 0 );
 
 	m_transQ.Put( trans );
+
+	Wakeup();
+}
+
+void 
+Cell::Wakeup()
+{
+	if ( IsActive() )
+	{
+		m_runner.Wakeup();
+	}
+	else if ( m_parent != 0 )
+	{
+		m_parent->Wakeup();
+	}
+	else if ( m_node != 0 )
+	{
+		m_node->Wakeup();
+	}
 }
 
 uint 
@@ -230,10 +258,20 @@ Cell::processActivation()
 void 
 Cell::processMailbox()
 {
-	MessagePtr m;
+	LockFreeMessageQ::List ms;
+
+	if ( !m_mailbox.GetAll( ms ) )
+	{
+		return;
+	}
 
-	while ( m_mailbox.Get( m ) )
+	LockFreeMessageQ::List::iterator mi( ms.begin() );
+	LockFreeMessageQ::List::iterator miEnd( ms.end() );
+
+	for ( ; mi != miEnd; ++mi )
 	{
+		MessagePtr& m = *mi;
+
 		if ( m->type == NET_STATE_MESSAGE )
 		{
 			onNetState( m );
@@ -283,7 +321,7 @@ Cell::processMailbox()
 
 				cell->Notify( m );
 
-				return;
+				continue; // rest of the batch is ours
 			}
 
 			// search for broadcast or intermediate cell
@@ -2,6 +2,7 @@
 
 #include <kcore/sys/Atomic.h>
 #include <kcore/sys/Tick.h>
+#include <kcore/sys/TimerWheel.h>
 #include <knet/NetSecurity.h>
 #include <kserver/cell/CellRunner.h>
 #include <kserver/cell/CellTree.h>
@@ -87,6 +88,12 @@ public:
 	 */
 	void Completed( Transaction* trans );
 
+	/**
+	 * Wake the thread running this cell. 
+	 * CellRunner when active. Otherwise the parent or the node.
+	 */
+	void Wakeup();
+
 	/// udp {
 	uint CreateUdpGroup( SecurityLevel sl = SECURITY0 );
 	void JoinUdpGroup( uint groupId, uint connectionId, const tstring& extra );
@@ -136,6 +143,11 @@ public:
 
 	Node* GetNode();
 
+	/**
+	 * Timer wheel advanced every Run. Used for action timeouts and ticks.
+	 */
+	TimerWheel& GetTimers();
+
 	/**
 	 * Factory prototype 
 	 */
@@ -164,7 +176,7 @@ protected:
 
 protected:
 	CellRunner 		m_runner;
-	MessageQ 		m_mailbox; 		// mailbox
+	LockFreeMessageQ m_mailbox; 	// mailbox
 	Atomic<uint> 	m_activeFlag; 	// 0 - none, 1 - make active, 2 - make passive
 	Node*			m_node;			// The node
 	Cell*			m_parent;		// local parent
@@ -179,6 +191,7 @@ protected:
 	Tick 			m_tickUpdate;
 	uint 			m_updateInterval;
 	TransQ 			m_transQ;
+	TimerWheel 		m_timers;
 
 	TypeDispatcher 		m_typeDispatcher;
 	ContextDispatcher 	m_ctxDispatcher;
@@ -238,5 +251,12 @@ Cell::GetNode()
 	return m_node;
 }
 
+inline
+TimerWheel& 
+Cell::GetTimers()
+{
+	return m_timers;
+}
+
 } // gk
 
@@ -58,13 +58,27 @@ CellRunner::Run()
 
 		if ( m_cell->GetProcessCount() == 0 )
 		{
-			::Sleep( 1 ); // XXX: active logic can be delayed 1 ms when there is no traffic
+			// woken by mailbox and transactions. timers are due at slot bounds.
+
+			m_wakeup.Wait( TimerWheel::RESOLUTION );
 		}
 	}
 
 	return 0;
 }
 
+void 
+CellRunner::Wakeup()
+{
+	m_wakeup.Signal();
+}
+
+void 
+CellRunner::helpStop()
+{
+	m_wakeup.Signal();
+}
+
 void 
 CellRunner::Fini()
 {
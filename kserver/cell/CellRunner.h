@@ -1,5 +1,6 @@
 #pragma once 
 
+#include <kcore/sys/Event.h>
 #include <kcore/sys/Thread.h>
 
 #include <vector>
@@ -46,13 +47,23 @@ public:
 	/// Thread::Run
 	int Run();
 
+	/**
+	 * @brief Wake the runner when the cell has work. Cheap when awake.
+	 */
+	void Wakeup();
+
 	/**
 	 * @brief Cleans up 
 	 */
 	void Fini();
 
+protected:
+	/// Thread::helpStop. Wakes Run to exit
+	void helpStop();
+
 private:
 	Cell*		 m_cell;
+	Event 		 m_wakeup;
 };
 
 } // gk
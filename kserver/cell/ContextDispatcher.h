@@ -1,7 +1,6 @@
 #pragma once 
 
 #include <kcore/sys/Tick.h>
-#include <kcore/sys/FineTick.h>
 #include <kserver/cell/Action.h>
 
 #include <hash_map>
@@ -52,13 +51,11 @@ private:
 	typedef std::vector<ActionPtr> ActionList;
 	typedef stdext::hash_map<tstring, ActionList> ActionMap;
 
-	void processTick();
 	void processCleanup();
 
 private:
 	ActionMap m_actions;
 	Tick 	  m_tickCleanup;
-	FineTick  m_tick;
 };
 
 } // gk
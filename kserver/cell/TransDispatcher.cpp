@@ -16,7 +16,6 @@ TransDispatcher::~TransDispatcher()
 bool 
 TransDispatcher::Init()
 {
-	m_tick.Reset();
 	m_tickCleanup.Reset();
 
 	return true;
@@ -26,8 +25,6 @@ void
 TransDispatcher::Run()
 {
 	processCleanup();
-
-	m_tick.Reset();
 }
 
 void 
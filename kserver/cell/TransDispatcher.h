@@ -1,7 +1,6 @@
 #pragma once 
 
 #include <kcore/sys/Tick.h>
-#include <kcore/sys/FineTick.h>
 #include <kserver/cell/Action.h>
 #include <kserver/db/Transaction.h>
 
@@ -60,13 +59,11 @@ private:
 	typedef std::vector<ActionPtr> ActionList;
 	typedef stdext::hash_map<uint, ActionList> ActionMap;
 
-	void processTick();
 	void processCleanup();
 
 private:
 	ActionMap	m_actions;
 	Tick 		m_tickCleanup;
-	Tick		m_tick;
 };
 
 } // gk
@@ -16,7 +16,6 @@ TypeDispatcher::~TypeDispatcher()
 bool 
 TypeDispatcher::Init()
 {
-	m_tick.Reset();
 	m_tickCleanup.Reset();
 
 	return true;
@@ -25,10 +24,7 @@ TypeDispatcher::Init()
 void 
 TypeDispatcher::Run()
 {
-	processTick();
 	processCleanup();
-
-	m_tick.Reset();
 }
 
 void 
@@ -104,34 +100,6 @@ TypeDispatcher::Fini()
 	m_actions.clear();
 }
 
-void 
-TypeDispatcher::processTick()
-{
-	uint ms = (uint)( m_tick.Elapsed() * 1000 );
-
-	ActionMap::iterator i( m_actions.begin() );
-
-	for ( ; i != m_actions.end(); ++i )
-	{
-		ActionList& lst = i->second;
-
-		ActionList::iterator ai( lst.begin() );
-
-		for ( ; ai != lst.end(); ++ai )
-		{
-			ActionPtr action = *ai;
-
-			if ( !action->IsFinished() )
-			{
-				if ( !action->Run( ms ) )
-				{
-					action->Fini();
-				}
-			}
-		}
-	}
-}
-
 void 
 TypeDispatcher::processCleanup()
 {
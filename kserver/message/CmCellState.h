@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <kserver/message/CellMessage.h>
+#include <knet/message/MessageSchema.h>
 
 namespace gk {
 
@@ -21,23 +22,9 @@ struct CmCellState : public CellMessage
 		type = CM_CELL_STATE;
 	}
 
-	bool Pack( BitStream& bs )
-	{
-		CellMessage::Pack( bs );
-
-		bs.Write( up );
-
-		return bs.IsValid();
-	}
-
-	bool Unpack( BitStream& bs )
-	{
-		CellMessage::Unpack( bs );
-
-		bs.Read( up );
-
-		return bs.IsValid();
-	}
+	K_SCHEMA_BEGIN( CellMessage )
+		K_FIELD( up, SchemaBool )
+	K_SCHEMA_END()
 
 	Message* Create() 
 	{
@@ -14,6 +14,10 @@ class DummyCell;
  *
  * To make a test, override load of this class to load configuration. 
  * Then override TestCreator to create this action.
+ *
+ * TestClient calls Run( uint ) every loop, so run( uint ) and hsm 
+ * OnTick work here without SetTickInterval. The dummy cell wheel 
+ * is not advanced.
  */
 class TestAction : public Action
 {
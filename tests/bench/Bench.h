@@ -0,0 +1,146 @@
+#pragma once 
+
+#include <kcore/sys/Atomic.h>
+#include <kcore/sys/Clock.h>
+
+#include <stdio.h>
+
+namespace gk 
+{
+
+/**
+ * @class BenchTimer
+ *
+ * Wall time of a benchmark section in nanoseconds
+ */
+class BenchTimer
+{
+public:
+	BenchTimer()
+		: m_start( Clock::NowNs() )
+	{
+	}
+
+	/**
+	 * Restart timing
+	 */
+	void Reset()
+	{
+		m_start = Clock::NowNs();
+	}
+
+	/**
+	 * @return Nanoseconds since construction or Reset
+	 */
+	uint8 ElapsedNs() const
+	{
+		return Clock::NowNs() - m_start;
+	}
+
+	/**
+	 * Print ns/op and ops/s of the section
+	 *
+	 * @param name Name of the section
+	 * @param ops The number of operations done in the section
+	 */
+	void Report( const char* name, uint8 ops ) const
+	{
+		double ns = (double)ElapsedNs();
+
+		if ( ops == 0 || ns <= 0 )
+		{
+			::printf( "%-40s no ops\n", name );
+
+			return;
+		}
+
+		::printf( "%-40s %12I64u ops %10.1f ns/op %14.0f ops/s\n", 
+				  name, ops, ns / ops, ops * 1e9 / ns );
+	}
+
+private:
+	uint8 m_start;
+};
+
+/**
+ * @class BenchAllocs
+ *
+ * Allocations of all threads in a benchmark section. Counts the 
+ * global new of the bench and g_allocator with its hook. Both are 
+ * installed by bench.cpp.
+ */
+class BenchAllocs
+{
+public:
+	BenchAllocs()
+		: m_start( Count() )
+	{
+	}
+
+	/**
+	 * Restart counting
+	 */
+	void Reset()
+	{
+		m_start = Count();
+	}
+
+	/**
+	 * @return Allocations since construction or Reset
+	 */
+	uint Get() const
+	{
+		return Count() - m_start;
+	}
+
+	/**
+	 * Print allocations per op of the section
+	 *
+	 * @param name Name of the section
+	 * @param ops The number of operations done in the section
+	 */
+	void Report( const char* name, uint8 ops ) const
+	{
+		uint allocs = Get();
+
+		if ( ops == 0 )
+		{
+			::printf( "%-40s no ops\n", name );
+
+			return;
+		}
+
+		::printf( "%-40s %12u allocs %10.2f allocs/op\n", 
+				  name, allocs, (double)allocs / ops );
+	}
+
+	/**
+	 * Count an allocation. Any thread.
+	 */
+	static void Add( size_t /* size */ )
+	{
+		counter().Inc();
+	}
+
+	/**
+	 * @return Allocations since start
+	 */
+	static uint Count()
+	{
+		return counter().Load();
+	}
+
+private:
+	static Atomic<uint>& counter()
+	{
+		// constructed by the first new of the process
+		static Atomic<uint> count( 0 );
+
+		return count;
+	}
+
+private:
+	uint m_start;
+};
+
+} // gk
@@ -0,0 +1,125 @@
+// bench.cpp : Runs benchmarks. Give names to run some of them.
+//
+
+#include "stdafx.h"
+
+#include "Bench.h"
+#include "benches/BenchAlloc.h"
+#include "benches/BenchBitStream.h"
+#include "benches/BenchBuffer.h"
+#include "benches/BenchCompress.h"
+#include "benches/BenchConnect.h"
+#include "benches/BenchDecode.h"
+#include "benches/BenchEcho.h"
+#include "benches/BenchMessagePtr.h"
+#include "benches/BenchMulticast.h"
+#include "benches/BenchQueue.h"
+#include "benches/BenchReconnect.h"
+#include "benches/BenchWakeup.h"
+
+#include <kcore/mem/Allocator.h>
+
+#include <malloc.h>
+#include <new>
+
+// global new of the bench and the libraries. counted for BenchAllocs.
+
+void* 
+operator new( size_t size )
+{
+	gk::BenchAllocs::Add( size );
+
+	void* p = ::malloc( size );
+
+	if ( p == 0 )
+	{
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+void* 
+operator new[]( size_t size )
+{
+	return operator new( size );
+}
+
+void 
+operator delete( void* p )
+{
+	::free( p );
+}
+
+void 
+operator delete[]( void* p )
+{
+	::free( p );
+}
+
+namespace
+{
+
+struct BenchEntry
+{
+	const _TCHAR* 	name;
+	void 			(*run)();
+};
+
+const BenchEntry s_benches[] = 
+{
+	  { _T("alloc"), 			gk::BenchAlloc }
+	, { _T("bitstream"), 		gk::BenchBitStream }
+	, { _T("buffer"), 		gk::BenchBuffer }
+	, { _T("compress"), 		gk::BenchCompress }
+	, { _T("connect"), 		gk::BenchConnect }
+	, { _T("decode"), 		gk::BenchDecode }
+	, { _T("echo"), 			gk::BenchEcho }
+	, { _T("msgptr"), 		gk::BenchMessagePtr }
+	, { _T("multicast"), 		gk::BenchMulticast }
+	, { _T("queue"), 			gk::BenchQueue }
+	, { _T("reconnect"), 		gk::BenchReconnect }
+	, { _T("wakeup"), 		gk::BenchWakeup }
+};
+
+const int BENCH_COUNT = sizeof( s_benches ) / sizeof( s_benches[0] );
+
+bool 
+selected( int argc, _TCHAR* argv[], const _TCHAR* name )
+{
+	if ( argc < 2 )
+	{
+		return true;
+	}
+
+	for ( int i = 1; i < argc; ++i )
+	{
+		if ( ::_tcscmp( argv[i], name ) == 0 )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+} // 
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	(void)gk::Clock::Calibrate();
+
+	gk::DefaultAllocator::SetAllocHook( gk::BenchAllocs::Add );
+
+	for ( int i = 0; i < BENCH_COUNT; ++i )
+	{
+		if ( selected( argc, argv, s_benches[i].name ) )
+		{
+			::_tprintf( _T("[%s]\n"), s_benches[i].name );
+
+			s_benches[i].run();
+		}
+	}
+
+	return 0;
+}
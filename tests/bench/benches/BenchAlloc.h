@@ -0,0 +1,182 @@
+#pragma once
+
+#include "../Bench.h"
+
+#include <kcore/mem/impl/LowFragHeap/LowFragHeap.h>
+#include <kcore/mem/impl/MSVCRT_malloc/MSVCRT_malloc.h>
+#include <kcore/mem/impl/SlabAllocator/SlabAllocator.h>
+#include <kcore/mem/impl/nedmalloc/nedmallocWrapper.h>
+#include <kcore/sys/Atomic.h>
+#include <kcore/sys/Thread.h>
+
+namespace gk
+{
+
+/**
+ * @class AllocWorker
+ *
+ * Allocates count blocks into its own slots after go is set.
+ * When all workers are done allocating, frees the blocks in
+ * the peer slots. The peer is itself for local frees and the
+ * next worker for cross thread frees, like IO thread alloc and
+ * Node thread free of messages.
+ */
+template <class A>
+class AllocWorker : public Thread
+{
+public:
+	AllocWorker()
+		: m_alloc( 0 )
+		, m_go( 0 )
+		, m_allocated( 0 )
+		, m_workers( 0 )
+		, m_mine( 0 )
+		, m_peer( 0 )
+		, m_count( 0 )
+	{
+	}
+
+	~AllocWorker()
+	{
+		Stop();
+	}
+
+	void Init( A* alloc, Atomic<bool>* go, Atomic<uint>* allocated, uint workers,
+			   void** mine, void** peer, uint count )
+	{
+		m_alloc 	= alloc;
+		m_go 		= go;
+		m_allocated = allocated;
+		m_workers 	= workers;
+		m_mine 		= mine;
+		m_peer 		= peer;
+		m_count 	= count;
+	}
+
+	int Run()
+	{
+		static const size_t SIZES[] = { 16, 24, 32, 48, 64, 96, 128, 256, 512 };
+		static const uint SIZE_COUNT = sizeof( SIZES ) / sizeof( SIZES[0] );
+
+		while ( !m_go->Load() )
+		{
+			Thread::Sleep( 0 );
+		}
+
+		for ( uint i = 0; i < m_count; ++i )
+		{
+			m_mine[i] = m_alloc->Alloc( SIZES[i % SIZE_COUNT] );
+		}
+
+		m_allocated->Inc();
+
+		while ( m_allocated->Load() < m_workers )
+		{
+			Thread::Sleep( 0 );
+		}
+
+		for ( uint i = 0; i < m_count; ++i )
+		{
+			m_alloc->Free( m_peer[i] );
+		}
+
+		return 0;
+	}
+
+private:
+	A* 				m_alloc;
+	Atomic<bool>* 	m_go;
+	Atomic<uint>* 	m_allocated;
+	uint 			m_workers;
+	void** 			m_mine;
+	void** 			m_peer;
+	uint 			m_count;
+};
+
+/**
+ * Each worker allocates count blocks of mixed small sizes and
+ * then frees its own blocks or those of the next worker.
+ * Reports an alloc and free pair as one op.
+ */
+template <class A>
+inline
+void
+benchAlloc( const char* name, uint workers, uint count, bool cross )
+{
+	enum { MAX_WORKERS = 8 };
+
+	K_ASSERT( workers <= MAX_WORKERS );
+
+	A alloc;
+	Atomic<bool> go( false );
+	Atomic<uint> allocated( 0 );
+
+	void** slots = new void*[workers * count];
+
+	AllocWorker<A> threads[MAX_WORKERS];
+
+	for ( uint i = 0; i < workers; ++i )
+	{
+		uint peer = cross ? ( i + 1 ) % workers : i;
+
+		threads[i].Init( &alloc, &go, &allocated, workers,
+						 slots + i * count, slots + peer * count, count );
+		threads[i].Start();
+	}
+
+	BenchTimer t;
+
+	go.Store( true );
+
+	for ( uint i = 0; i < workers; ++i )
+	{
+		threads[i].Stop();
+	}
+
+	char label[64];
+
+	::sprintf_s( label, sizeof( label ), "%s %u threads %s",
+				 name, workers, cross ? "cross" : "local" );
+
+	t.Report( label, (uint8)workers * count );
+
+	delete [] slots;
+}
+
+template <class A>
+inline
+void
+benchAllocator( const char* name, uint workers, uint count )
+{
+	benchAlloc<A>( name, workers, count, false );
+
+	if ( workers > 1 )
+	{
+		benchAlloc<A>( name, workers, count, true );
+	}
+}
+
+/**
+ * Multi-threaded alloc and free of message sized blocks.
+ * SlabAllocator against nedmalloc, Low-fragmentation Heap and
+ * CRT malloc with 1 to 8 threads, freeing on the allocating
+ * thread and on another thread.
+ *
+ * Extends the single-shot numbers in kcore/mem/impl/Benchmark.txt.
+ */
+inline
+void
+BenchAlloc()
+{
+	enum { COUNT = 50000 };
+
+	for ( uint workers = 1; workers <= 8; workers *= 2 )
+	{
+		benchAllocator<SlabAllocator>( "alloc slab", workers, COUNT );
+		benchAllocator<nedmallocWrapper>( "alloc nedmalloc", workers, COUNT );
+		benchAllocator<LowFragHeap>( "alloc lfh", workers, COUNT );
+		benchAllocator<MSVCRT_malloc>( "alloc crt", workers, COUNT );
+	}
+}
+
+} // gk
@@ -0,0 +1,279 @@
+#pragma once 
+
+#include "../Bench.h"
+
+#include <knet/message/BitStream.h>
+
+namespace gk 
+{
+
+/**
+ * @class ByteLoopStream
+ *
+ * The byte at a time WriteBits and ReadBits BitStream had before 
+ * it moved words. Fixed buffer without resize. Baseline only.
+ */
+class ByteLoopStream
+{
+public:
+	ByteLoopStream( byte* data, uint size )
+		: m_data( data )
+		, m_maxBits( size << 3 )
+		, m_posBit( 0 )
+	{
+	}
+
+	void Reset()
+	{
+		m_posBit = 0;
+	}
+
+	void WriteInt( uint value, byte bitCount )
+	{
+		WriteBits( bitCount, &value );
+	}
+
+	void ReadInt( uint& value, byte bitCount )
+	{
+		ReadBits( bitCount, &value );
+
+		if ( bitCount != 32 )
+		{
+			value &= ( 1u << bitCount ) - 1;
+		}
+	}
+
+	bool WriteBits( uint bitCount, const void* bitPtr )
+	{
+		K_RETURN_V_IF( bitCount == 0, true );
+		K_RETURN_V_IF( bitCount + m_posBit > m_maxBits, false );
+
+		uint upShift 	= m_posBit & 0x7;
+		uint downShift 	= 8 - upShift;
+
+		const byte* sourcePtr = (const byte*)bitPtr;
+		byte* destPtr = m_data + ( m_posBit >> 3 );
+
+		if ( downShift >= bitCount )
+		{
+			byte mask = (byte)( ( ( ( 1 << bitCount ) - 1 ) << upShift ) & 0xFF );
+			*destPtr = (byte)( ( *destPtr & ~mask ) | ( ( *sourcePtr << upShift ) & mask ) );
+			m_posBit += bitCount;
+
+			return true;
+		}
+
+		if ( !upShift )
+		{
+			m_posBit += bitCount;
+
+			for ( ; bitCount >= 8; bitCount -= 8 )
+			{
+				*destPtr++ = *sourcePtr++;
+			}
+
+			if ( bitCount )
+			{
+				byte mask = (byte)( ( 1 << bitCount ) - 1 );
+				*destPtr = (byte)( ( *sourcePtr & mask ) | ( *destPtr & ~mask ) );
+			}
+
+			return true;
+		}
+
+		byte sourceByte;
+		byte destByte = (byte)( *destPtr & ( 0xFF >> downShift ) );
+		byte lastMask = (byte)( 0xFF >> ( 7 - ( ( m_posBit + bitCount - 1 ) & 0x7 ) ) );
+
+		m_posBit += bitCount;
+
+		for ( ; bitCount >= 8; bitCount -= 8 )
+		{
+			sourceByte = *sourcePtr++;
+			*destPtr++ = (byte)( destByte | ( sourceByte << upShift ) );
+			destByte = (byte)( sourceByte >> downShift );
+		}
+
+		if ( bitCount == 0 )
+		{
+			*destPtr = (byte)( ( *destPtr & ~lastMask ) | ( destByte & lastMask ) );
+
+			return true;
+		}
+
+		if ( bitCount <= downShift )
+		{
+			*destPtr = (byte)( ( *destPtr & ~lastMask ) | 
+							   ( ( destByte | ( *sourcePtr << upShift ) ) & lastMask ) );
+
+			return true;
+		}
+
+		sourceByte = *sourcePtr;
+		*destPtr++ = (byte)( destByte | ( sourceByte << upShift ) );
+		*destPtr   = (byte)( ( *destPtr & ~lastMask ) | ( ( sourceByte >> downShift ) & lastMask ) );
+
+		return true;
+	}
+
+	bool ReadBits( uint bitCount, void* bitPtr )
+	{
+		K_RETURN_V_IF( bitCount == 0, true );
+		K_RETURN_V_IF( bitCount + m_posBit > m_maxBits, false );
+
+		byte* sourcePtr = m_data + ( m_posBit >> 3 );
+		uint byteCount 	= ( bitCount + 7 ) >> 3;
+
+		byte* destPtr 	= (byte*)bitPtr;
+		uint downShift 	= m_posBit & 0x7;
+		uint upShift 	= 8 - downShift;
+
+		if ( !downShift )
+		{
+			while ( byteCount-- )
+			{
+				*destPtr++ = *sourcePtr++;
+			}
+
+			m_posBit += bitCount;
+
+			return true;
+		}
+
+		byte sourceByte = (byte)( *sourcePtr >> downShift );
+		m_posBit += bitCount;
+
+		for ( ; bitCount >= 8; bitCount -= 8 )
+		{
+			byte nextByte = *++sourcePtr;
+			*destPtr++ = (byte)( sourceByte | ( nextByte << upShift ) );
+			sourceByte = (byte)( nextByte >> downShift );
+		}
+
+		if ( bitCount )
+		{
+			if ( bitCount <= upShift )
+			{
+				*destPtr = sourceByte;
+
+				return true;
+			}
+
+			*destPtr = (byte)( sourceByte | ( ( *++sourcePtr ) << upShift ) );
+		}
+
+		return true;
+	}
+
+private:
+	byte* 	m_data;
+	uint 	m_maxBits;
+	uint 	m_posBit;
+};
+
+/**
+ * Mixed width ints then unaligned 64 byte runs. Written and read 
+ * back in passes over a fixed buffer.
+ */
+template <class S>
+inline
+void 
+benchBitStream( const char* name, uint passes )
+{
+	enum 
+	{
+		  BUFFER_LEN = 4096
+		, FIELDS 	 = 512 		// 8 widths. 768 bytes.
+		, RUNS 		 = 48 		// 64 byte runs after a 3 bit offset
+		, RUN_LEN 	 = 64
+	};
+
+	static const byte widths[] = { 1, 3, 7, 12, 16, 20, 32, 5 };
+
+	byte data[BUFFER_LEN];
+	byte run[RUN_LEN];
+
+	::memset( data, 0, sizeof( data ) );
+
+	for ( uint i = 0; i < RUN_LEN; ++i )
+	{
+		run[i] = (byte)( i * 37 );
+	}
+
+	S s( data, BUFFER_LEN );
+
+	uint sum = 0;
+	char label[64];
+
+	BenchTimer t;
+
+	for ( uint p = 0; p < passes; ++p )
+	{
+		s.Reset();
+
+		for ( uint i = 0; i < FIELDS; ++i )
+		{
+			s.WriteInt( i * 2654435761u + p, widths[i & 7] );
+		}
+
+		s.Reset();
+
+		for ( uint i = 0; i < FIELDS; ++i )
+		{
+			uint v = 0;
+
+			s.ReadInt( v, widths[i & 7] );
+
+			sum += v;
+		}
+	}
+
+	::sprintf_s( label, sizeof( label ), "%s ints", name );
+
+	t.Report( label, (uint8)passes * FIELDS * 2 );
+
+	t.Reset();
+
+	for ( uint p = 0; p < passes; ++p )
+	{
+		s.Reset();
+		s.WriteInt( p, 3 );
+
+		for ( uint i = 0; i < RUNS; ++i )
+		{
+			s.WriteBits( RUN_LEN << 3, run );
+		}
+
+		s.Reset();
+		s.ReadInt( sum, 3 );
+
+		for ( uint i = 0; i < RUNS; ++i )
+		{
+			s.ReadBits( RUN_LEN << 3, run );
+		}
+	}
+
+	::sprintf_s( label, sizeof( label ), "%s runs", name );
+
+	t.Report( label, (uint8)passes * RUNS * 2 );
+
+	if ( sum == 0xFFFFFFFF )
+	{
+		::printf( "%u\n", sum ); // keeps the reads
+	}
+}
+
+/**
+ * BitStream moving words against the byte loop it replaced
+ */
+inline
+void 
+BenchBitStream()
+{
+	enum { PASSES = 20000 };
+
+	benchBitStream<ByteLoopStream>( "bitstream byte loop", PASSES );
+	benchBitStream<BitStream>( "bitstream word", PASSES );
+}
+
+} // gk
@@ -0,0 +1,128 @@
+#pragma once 
+
+#include "../Bench.h"
+#include "BenchMessages.h"
+
+#include <kcore/sys/Buffer.h>
+#include <knet/message/BitStream.h>
+#include <knet/tcp/impl/TcpFrame.h>
+
+namespace gk 
+{
+
+/**
+ * A new TcpFrame packed with m like TcpConnection::Send.
+ * Reports ns and allocations per packed message.
+ */
+inline
+void 
+benchPackFrame( const char* name, Message& m, uint count )
+{
+	TcpFrame probe;
+
+	K_RETURN_IF( !probe.Pack( m, 0 ) );
+
+	char label[64];
+
+	::sprintf_s( label, sizeof( label ), "buffer pack %s %u bytes", name, probe.GetLength() );
+
+	BenchAllocs a;
+	BenchTimer t;
+
+	for ( uint i = 0; i < count; ++i )
+	{
+		TcpFramePtr f( new TcpFrame );
+
+		(void)f->Pack( m, 0 );
+	}
+
+	t.Report( label, count );
+	a.Report( label, count );
+}
+
+/**
+ * Allocation cost of small BitStream temporaries and of appends,
+ * and allocations per packed message below and above the inline size.
+ * Build all projects with BUFFER_INLINE_SIZE=0 to compare without inline storage.
+ */
+inline
+void 
+BenchBuffer()
+{
+	enum 
+	{ 
+		  COUNT 		= 1000000
+		, APPENDS 		= 4096
+		, APPEND_LEN 	= 16 
+	};
+
+	::printf( "buffer inline size %u, sizeof(Buffer) %u\n", 
+			  (uint)Buffer::INLINE_BUFFER_SIZE, (uint)sizeof( Buffer ) );
+
+	// a send path temporary. 100 bytes into a default BitStream.
+	{
+		BenchAllocs a;
+		BenchTimer t;
+
+		for ( uint i = 0; i < COUNT; ++i )
+		{
+			BitStream bs;
+
+			for ( uint k = 0; k < 25; ++k )
+			{
+				bs.Write( i + k );
+			}
+		}
+
+		t.Report( "buffer bitstream temporary", COUNT );
+		a.Report( "buffer bitstream temporary", COUNT );
+	}
+
+	// accumulation. appends to one buffer.
+	{
+		byte chunk[APPEND_LEN] = { 0, };
+
+		BenchAllocs a;
+		BenchTimer t;
+
+		for ( uint i = 0; i < COUNT / APPENDS; ++i )
+		{
+			Buffer b( 1 );
+
+			for ( uint k = 0; k < APPENDS; ++k )
+			{
+				b.AppendBuffer( chunk, APPEND_LEN );
+			}
+		}
+
+		t.Report( "buffer append", ( COUNT / APPENDS ) * APPENDS );
+		a.Report( "buffer append", ( COUNT / APPENDS ) * APPENDS );
+	}
+
+	// copy of a small buffer
+	{
+		Buffer src( 64 );
+
+		BenchAllocs a;
+		BenchTimer t;
+
+		for ( uint i = 0; i < COUNT; ++i )
+		{
+			Buffer b( src );
+		}
+
+		t.Report( "buffer copy 64", COUNT );
+		a.Report( "buffer copy 64", COUNT );
+	}
+
+	// packed messages. inline sized and heap sized.
+	{
+		BmEcho echo;
+		BmBulk bulk;
+
+		benchPackFrame( "echo", echo, COUNT );
+		benchPackFrame( "bulk", bulk, COUNT / 4 );
+	}
+}
+
+} // gk
@@ -0,0 +1,266 @@
+#pragma once
+
+#include "../Bench.h"
+#include "BenchMessages.h"
+
+#include <knet/compress/Compressor.h>
+#include <knet/tcp/impl/TcpFrame.h>
+#include <kserver/message/CmCellState.h>
+
+#include <vector>
+
+namespace gk
+{
+
+typedef std::vector<MessagePtr> BenchMix;
+
+/**
+ * Messages of a mix. seed gives other values of the same shapes,
+ * so a dictionary built from one seed is tested on another.
+ */
+inline
+void
+buildCompressMix( BenchMix& mix, uint seed, bool echoes, bool cells )
+{
+	static const TCHAR* NAMES[] =
+	{
+		  _T("Warrior")
+		, _T("Ranger")
+		, _T("Cleric")
+		, _T("Shadow Mage")
+	};
+
+	enum { COUNT = 64 };
+
+	for ( uint i = 0; i < COUNT; ++i )
+	{
+		uint v = seed * COUNT + i;
+
+		if ( echoes )
+		{
+			BmEcho* e = new BmEcho;
+
+			e->seq = v;
+
+			for ( uint k = 0; k < BmEcho::PAYLOAD_LEN; k += 8 )
+			{
+				e->payload[k] = (byte)( v + k ); // sparse like most game payloads
+			}
+
+			mix.push_back( MessagePtr( e ) );
+		}
+
+		if ( cells )
+		{
+			BmCellUpdate* u = new BmCellUpdate;
+
+			u->src 		= CellId( 1, (ushort)( v % 16 ) );
+			u->dst 		= CellId( 2, (ushort)( v % 16 ) );
+			u->entity 	= 100000 + v;
+			u->x 		= 5000 + (int)( v * 7 % 300 );
+			u->y 		= -2000 + (int)( v * 13 % 300 );
+			u->z 		= 40;
+			u->hp 		= 1000 - v % 100;
+			u->name 	= NAMES[v % 4];
+
+			for ( uint k = 0; k < 8 + v % 16; ++k )
+			{
+				u->items.push_back( 2000 + ( v + k * 3 ) % 64 );
+			}
+
+			mix.push_back( MessagePtr( u ) );
+
+			CmCellState* s = new CmCellState; // too small to compress
+
+			s->src 	= u->src;
+			s->dst 	= u->dst;
+			s->up 	= true;
+
+			mix.push_back( MessagePtr( s ) );
+		}
+	}
+}
+
+/**
+ * Set the shared dictionary from plain payloads of a mix
+ */
+inline
+void
+setCompressDictionary( const BenchMix& mix )
+{
+	std::vector<byte> dict;
+
+	for ( uint i = 0; i < mix.size(); ++i )
+	{
+		TcpFrame f;
+
+		K_RETURN_IF( !f.Pack( *mix[i], 0, Compressor::MODE_NONE ) );
+
+		const byte* p = f.GetData() + TcpFrame::HEADER_LEN;
+
+		dict.insert( dict.end(), p, p + f.GetLength() - TcpFrame::HEADER_LEN );
+	}
+
+	Compressor::SetDictionary( &dict[0], (uint)dict.size() );
+}
+
+/**
+ * Pack the mix into frames with mode, then decompress the frames
+ * as TcpConnection::buildMessage does. Reports bytes out against
+ * the plain payloads, and ns per frame of both.
+ */
+inline
+void
+benchCompress( const char* name, const BenchMix& mix, Compressor::Mode mode )
+{
+	enum { ROUNDS = 500 };
+
+	static const char* MODES[] = { "none", "fast", "dict" };
+
+	std::vector<TcpFramePtr> frames( mix.size() );
+	std::vector<uint> rawLens( mix.size() );
+
+	uint8 rawBytes = 0;
+	uint8 outBytes = 0;
+	uint compressed = 0;
+
+	for ( uint i = 0; i < mix.size(); ++i )
+	{
+		TcpFrame plain;
+
+		K_RETURN_IF( !plain.Pack( *mix[i], 0, Compressor::MODE_NONE ) );
+
+		rawLens[i] = plain.GetLength() - TcpFrame::HEADER_LEN;
+		rawBytes  += plain.GetLength();
+	}
+
+	char label[64];
+
+	// [1] pack
+
+	BenchTimer t;
+
+	for ( uint r = 0; r < ROUNDS; ++r )
+	{
+		for ( uint i = 0; i < mix.size(); ++i )
+		{
+			TcpFramePtr f( new TcpFrame );
+
+			(void)f->Pack( *mix[i], 0, mode );
+
+			if ( r == 0 )
+			{
+				frames[i] = f;
+			}
+		}
+	}
+
+	::sprintf_s( label, sizeof( label ), "compress %s %s pack", name, MODES[mode] );
+
+	t.Report( label, (uint8)ROUNDS * mix.size() );
+
+	// [2] decompress. header read as TcpConnection::buildMessage does.
+	// plain frames are used in place.
+
+	std::vector<uint> controls( frames.size() );
+
+	for ( uint i = 0; i < frames.size(); ++i )
+	{
+		BitStream in( (byte*)frames[i]->GetData(), frames[i]->GetLength() );
+
+		uint len = 0;
+
+		in.ReadInt( len, 16 );
+		in.ReadInt( controls[i], 8 );
+
+		outBytes += frames[i]->GetLength();
+
+		if ( controls[i] & TcpFrame::CONTROL_COMPRESSED )
+		{
+			++compressed;
+		}
+	}
+
+	byte out[TcpFrame::MAX_PAYLOAD_LEN];
+
+	uint failed = 0;
+
+	t.Reset();
+
+	for ( uint r = 0; r < ROUNDS; ++r )
+	{
+		for ( uint i = 0; i < frames.size(); ++i )
+		{
+			if ( ( controls[i] & TcpFrame::CONTROL_COMPRESSED ) == 0 )
+			{
+				continue;
+			}
+
+			Compressor::Mode m = ( controls[i] & TcpFrame::CONTROL_DICT ) ?
+									Compressor::MODE_DICT : Compressor::MODE_FAST;
+
+			// payload is RAWLEN{16} and the compressed bytes
+
+			int n = Compressor::Decompress( frames[i]->GetData() + TcpFrame::HEADER_LEN + 2,
+											frames[i]->GetLength() - TcpFrame::HEADER_LEN - 2,
+											out, rawLens[i], m );
+
+			if ( n != (int)rawLens[i] )
+			{
+				++failed;
+			}
+		}
+	}
+
+	::sprintf_s( label, sizeof( label ), "compress %s %s unpack", name, MODES[mode] );
+
+	t.Report( label, (uint8)ROUNDS * frames.size() );
+
+	::printf( "compress %s %s %u frames %I64u bytes plain %I64u out %.1f%% %u compressed%s\n",
+			  name, MODES[mode], (uint)frames.size(), rawBytes, outBytes,
+			  100.0 * outBytes / rawBytes, compressed,
+			  failed > 0 ? " DECOMPRESS FAILED" : "" );
+}
+
+/**
+ * Compression of TCP frames. Echo messages, cell updates with cell
+ * states, and both mixed, with MODE_NONE, MODE_FAST and MODE_DICT.
+ * The dictionary is built from another seed of the same mix.
+ */
+inline
+void
+BenchCompress()
+{
+	struct MixSpec
+	{
+		const char* name;
+		bool 		echoes;
+		bool 		cells;
+	};
+
+	static const MixSpec MIXES[] =
+	{
+		  { "echo", true, false }
+		, { "cell", false, true }
+		, { "mixed", true, true }
+	};
+
+	for ( uint i = 0; i < sizeof( MIXES ) / sizeof( MIXES[0] ); ++i )
+	{
+		BenchMix sample;
+		BenchMix mix;
+
+		buildCompressMix( sample, 1, MIXES[i].echoes, MIXES[i].cells );
+		buildCompressMix( mix, 2, MIXES[i].echoes, MIXES[i].cells );
+
+		setCompressDictionary( sample );
+
+		benchCompress( MIXES[i].name, mix, Compressor::MODE_NONE );
+		benchCompress( MIXES[i].name, mix, Compressor::MODE_FAST );
+		benchCompress( MIXES[i].name, mix, Compressor::MODE_DICT );
+	}
+
+	Compressor::SetDictionary( 0, 0 );
+}
+
+} // gk
@@ -0,0 +1,157 @@
+#pragma once 
+
+#include "../Bench.h"
+#include "BenchEcho.h"
+
+#include <kcore/sys/Event.h>
+#include <knet/NetServer.h>
+#include <knet/message/net/NetStateMessage.h>
+
+namespace gk 
+{
+
+/**
+ * @class ConnectListener
+ *
+ * Counts connects opened and failed. Called from the NetServer thread.
+ */
+class ConnectListener : public MessageListener
+{
+public:
+	ConnectListener()
+		: m_expected( 0 )
+		, m_opened( 0 )
+		, m_failed( 0 )
+		, m_lastNs( 0 )
+		, m_done()
+	{
+	}
+
+	void Init( uint expected )
+	{
+		m_expected = expected;
+	}
+
+	void Notify( MessagePtr m )
+	{
+		K_RETURN_IF( m->type != NET_STATE_MESSAGE );
+
+		NetStateMessage* nsm = static_cast<NetStateMessage*>( m.Get() );
+
+		switch ( nsm->state )
+		{
+		case NetStateMessage::TCP_OPEN:
+			++m_opened;
+			break;
+		case NetStateMessage::TCP_CONNECT_FAIL:
+			++m_failed;
+			break;
+		default:
+			return;
+		}
+
+		m_lastNs = Clock::NowNs();
+
+		if ( m_opened + m_failed == m_expected )
+		{
+			m_done.Signal();
+		}
+	}
+
+	bool Wait( uint ms )
+	{
+		return m_done.Wait( ms );
+	}
+
+	uint GetOpened() const 		{ return m_opened; }
+	uint GetFailed() const 		{ return m_failed; }
+	uint8 GetLastNs() const 	{ return m_lastNs; }
+
+private:
+	uint 	m_expected;
+	uint 	m_opened;
+	uint 	m_failed;
+	uint8 	m_lastNs;
+	Event 	m_done;
+};
+
+/**
+ * Connects CONNECTIONS at once to a server that starts listening 
+ * delayMs later. Reports the time until every connect is opened or 
+ * failed, which is how fast the retries converge after the server is up.
+ */
+inline
+void 
+benchConnect( uint port, uint delayMs )
+{
+	enum
+	{
+		  CONNECTIONS 	= 200
+		, TIMEOUT_MS 	= 60000
+	};
+
+	EchoServerListener sl;
+	ConnectListener cl;
+
+	NetServer server;
+	NetServer client;
+
+	sl.Init( &server );
+	cl.Init( CONNECTIONS );
+
+	K_RETURN_IF( !server.Init( &sl ) );
+	K_RETURN_IF( !client.Init( &cl ) );
+
+	IpAddress addr;
+
+	addr.Init( _T("127.0.0.1"), (ushort)port );
+
+	uint8 start = Clock::NowNs();
+
+	for ( uint i = 0; i < CONNECTIONS; ++i )
+	{
+		client.Connect( addr );
+	}
+
+	if ( delayMs > 0 )
+	{
+		Thread::Sleep( delayMs );
+	}
+
+	uint8 up = Clock::NowNs();
+
+	server.Listen( addr );
+
+	bool done = cl.Wait( TIMEOUT_MS );
+
+	uint8 last = cl.GetLastNs();
+
+	::printf( "connect %u after %4u ms: opened %u failed %u, "
+			  "%I64u ms from start, %I64u ms from listen%s\n", 
+			  CONNECTIONS, delayMs, cl.GetOpened(), cl.GetFailed(), 
+			  last > start ? ( last - start ) / 1000000 : 0, 
+			  last > up ? ( last - up ) / 1000000 : 0, 
+			  done ? "" : " (timed out)" );
+
+	client.Fini();
+	server.Fini();
+}
+
+/**
+ * Convergence of parallel connects with retry and backoff
+ */
+inline
+void 
+BenchConnect()
+{
+	enum { PORT = 17002 };
+
+	const uint delays[] = { 0, 50, 150, 400 };
+
+	for ( uint i = 0; i < sizeof( delays ) / sizeof( delays[0] ); ++i )
+	{
+		benchConnect( PORT + i, delays[i] );
+	}
+}
+
+} // gk
@@ -0,0 +1,165 @@
+#pragma once 
+
+#include "../Bench.h"
+#include "BenchMessages.h"
+
+#include <knet/message/BitStream.h>
+#include <knet/message/MessageFactory.h>
+#include <kcore/sys/Thread.h>
+
+namespace gk 
+{
+
+/**
+ * @class DecodeThread
+ *
+ * Decodes a packed message count times after go is set. 
+ * Reads the type, creates with MessageFactory and unpacks 
+ * like TcpConnection::buildMessage.
+ */
+class DecodeThread : public Thread
+{
+public:
+	DecodeThread()
+		: m_data( 0 )
+		, m_len( 0 )
+		, m_go( 0 )
+		, m_count( 0 )
+		, m_failed( 0 )
+	{
+	}
+
+	~DecodeThread()
+	{
+		Stop();
+	}
+
+	void Init( byte* data, uint len, Atomic<bool>* go, uint count )
+	{
+		m_data 	 = data;
+		m_len 	 = len;
+		m_go 	 = go;
+		m_count  = count;
+		m_failed = 0;
+	}
+
+	uint GetFailed() const
+	{
+		return m_failed;
+	}
+
+	int Run()
+	{
+		while ( !m_go->Load() )
+		{
+			Thread::Sleep( 0 );
+		}
+
+		for ( uint i = 0; i < m_count; ++i )
+		{
+			BitStream in( m_data, m_len );
+
+			ushort type = 0;
+
+			in.Read( type );
+
+			MessagePtr m = MessageFactory::Instance()->Create( type );
+
+			if ( m.Get() == 0 || !m->Unpack( in ) )
+			{
+				++m_failed;
+			}
+		}
+
+		return 0;
+	}
+
+private:
+	byte* 			m_data;
+	uint 			m_len;
+	Atomic<bool>* 	m_go;
+	uint 			m_count;
+	uint 			m_failed;
+};
+
+/**
+ * Threads decode the same message type at once
+ */
+inline
+void 
+benchDecode( const char* name, Message& m, uint threads, uint count )
+{
+	enum { MAX_THREADS = 8 };
+
+	K_ASSERT( threads <= MAX_THREADS );
+
+	byte data[256];
+
+	BitStream out( data, sizeof( data ) );
+
+	bool rc = m.Pack( out );
+
+	K_ASSERT( rc );
+
+	Atomic<bool> go( false );
+
+	DecodeThread decoders[MAX_THREADS];
+
+	for ( uint i = 0; i < threads; ++i )
+	{
+		decoders[i].Init( data, out.GetBytePosition(), &go, count );
+		decoders[i].Start();
+	}
+
+	BenchTimer t;
+
+	go.Store( true );
+
+	uint failed = 0;
+
+	for ( uint i = 0; i < threads; ++i )
+	{
+		decoders[i].Stop(); // joins after Run returns
+
+		failed += decoders[i].GetFailed();
+	}
+
+	char label[64];
+
+	::sprintf_s( label, sizeof( label ), "%s %u threads", name, threads );
+
+	t.Report( label, (uint8)threads * count );
+
+	if ( failed > 0 )
+	{
+		::printf( "%-40s %u failed\n", label, failed );
+	}
+}
+
+/**
+ * Multi threaded decode through MessageFactory. A plain type 
+ * against a type with a MessagePool with 1 to 8 threads.
+ */
+inline
+void 
+BenchDecode()
+{
+	enum { COUNT = 200000 };
+
+	MessageFactory* f = MessageFactory::Instance();
+
+	f->Register( new BmEcho );
+	f->Register( new BmPooled );
+	f->SetPool( BENCH_POOLED );
+
+	BmEcho plain;
+	BmPooled pooled;
+
+	for ( uint threads = 1; threads <= 8; threads *= 2 )
+	{
+		benchDecode( "decode new", plain, threads, COUNT );
+		benchDecode( "decode pooled", pooled, threads, COUNT );
+	}
+}
+
+} // gk
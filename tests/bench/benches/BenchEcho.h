@@ -0,0 +1,541 @@
+#pragma once 
+
+#include "../Bench.h"
+#include "BenchMessages.h"
+
+#include <kcore/sys/Event.h>
+#include <kcore/sys/Lock.h>
+#include <kcore/sys/ScopedLock.h>
+#include <knet/NetServer.h>
+#include <knet/message/MessageFactory.h>
+#include <knet/message/net/NetStateMessage.h>
+#include <knet/socket/Socket.h>
+
+#include <map>
+#include <vector>
+
+namespace gk 
+{
+
+/**
+ * @class EchoServerListener
+ *
+ * Sends every BmEcho back to the connection it came from
+ */
+class EchoServerListener : public MessageListener
+{
+public:
+	EchoServerListener()
+		: m_server( 0 )
+	{
+	}
+
+	void Init( NetServer* server )
+	{
+		m_server = server;
+	}
+
+	void Notify( MessagePtr m )
+	{
+		K_RETURN_IF( m->type != BENCH_ECHO );
+
+		BmEcho* e = static_cast<BmEcho*>( m.Get() );
+
+		BmEcho* r = new BmEcho;
+
+		r->remote 	= e->remote;
+		r->seq 		= e->seq;
+
+		::memcpy( r->payload, e->payload, sizeof( r->payload ) );
+
+		m_server->Send( MessagePtr( r ) );
+	}
+
+private:
+	NetServer* m_server;
+};
+
+/**
+ * @class EchoClientListener
+ *
+ * Keeps one echo in flight per connection and records round trips.
+ * Called from the client NetServer thread only.
+ */
+class EchoClientListener : public MessageListener
+{
+public:
+	EchoClientListener()
+		: m_client( 0 )
+		, m_rounds( 0 )
+		, m_connections( 0 )
+		, m_finished( 0 )
+		, m_echoes( 0 )
+		, m_totalNs( 0 )
+		, m_maxNs( 0 )
+		, m_states()
+		, m_done()
+	{
+	}
+
+	void Init( NetServer* client, uint connections, uint rounds )
+	{
+		m_client 		= client;
+		m_connections 	= connections;
+		m_rounds 		= rounds;
+	}
+
+	void Notify( MessagePtr m )
+	{
+		if ( m->type == NET_STATE_MESSAGE )
+		{
+			NetStateMessage* nsm = static_cast<NetStateMessage*>( m.Get() );
+
+			if ( nsm->state == NetStateMessage::TCP_OPEN )
+			{
+				send( nsm->connectionId, 1 );
+			}
+
+			return;
+		}
+
+		K_RETURN_IF( m->type != BENCH_ECHO );
+
+		BmEcho* e = static_cast<BmEcho*>( m.Get() );
+
+		State& s = m_states[e->remote];
+
+		uint8 ns = Clock::NowNs() - s.sentNs;
+
+		++m_echoes;
+
+		m_totalNs += ns;
+		m_maxNs = ns > m_maxNs ? ns : m_maxNs;
+
+		if ( e->seq < m_rounds )
+		{
+			send( e->remote, e->seq + 1 );
+		}
+		else if ( ++m_finished == m_connections )
+		{
+			m_done.Signal();
+		}
+	}
+
+	bool Wait( uint ms )
+	{
+		return m_done.Wait( ms );
+	}
+
+	uint8 GetEchoes() const 	{ return m_echoes; }
+	uint8 GetTotalNs() const 	{ return m_totalNs; }
+	uint8 GetMaxNs() const 		{ return m_maxNs; }
+
+private:
+	struct State
+	{
+		uint8 sentNs;
+
+		State() : sentNs( 0 ) {}
+	};
+
+	void send( uint connectionId, uint seq )
+	{
+		BmEcho* e = new BmEcho;
+
+		e->remote 	= connectionId;
+		e->seq 		= seq;
+
+		m_states[connectionId].sentNs = Clock::NowNs();
+
+		m_client->Send( MessagePtr( e ) );
+	}
+
+private:
+	NetServer* 				m_client;
+	uint 					m_rounds;
+	uint 					m_connections;
+	uint 					m_finished;
+	uint8 					m_echoes;
+	uint8 					m_totalNs;
+	uint8 					m_maxNs;
+	std::map<uint, State> 	m_states;
+	Event 					m_done;
+};
+
+/**
+ * @class BlockingEcho
+ *
+ * Thread per connection echo over blocking sockets. 
+ * The baseline of the completion driven echo.
+ * Threads reserve a small stack so that 10k connections fit.
+ */
+class BlockingEcho
+{
+public:
+	enum
+	{
+		  FRAME = 72 				// about a packed BmEcho
+		, STACK = 64 * 1024
+	};
+
+	BlockingEcho()
+		: m_listen( INVALID_SOCKET )
+		, m_connections( 0 )
+		, m_rounds( 0 )
+		, m_echoes( 0 )
+		, m_totalNs( 0 )
+		, m_maxNs( 0 )
+		, m_lock()
+		, m_servers()
+	{
+		::memset( (void*)&m_addr, 0, sizeof( m_addr ) );
+	}
+
+	/**
+	 * Echo rounds on each connection and report like BenchEcho
+	 */
+	void Run( ushort port, uint connections, uint rounds )
+	{
+		m_connections 	= connections;
+		m_rounds 		= rounds;
+
+		m_addr.sin_family 		= AF_INET;
+		m_addr.sin_port 		= ::htons( port );
+		m_addr.sin_addr.s_addr 	= ::inet_addr( "127.0.0.1" );
+
+		m_listen = ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+		K_RETURN_IF( m_listen == INVALID_SOCKET );
+
+		if ( ::bind( m_listen, (sockaddr*)&m_addr, sizeof( m_addr ) ) != 0 || 
+			 ::listen( m_listen, SOMAXCONN ) != 0 )
+		{
+			::closesocket( m_listen );
+
+			return;
+		}
+
+		HANDLE acceptor = start( acceptMain, this );
+
+		std::vector<HANDLE> clients;
+
+		BenchTimer t;
+
+		for ( uint i = 0; i < connections; ++i )
+		{
+			HANDLE h = start( clientMain, this );
+
+			if ( h == 0 )
+			{
+				break;
+			}
+
+			clients.push_back( h );
+		}
+
+		join( clients );
+
+		char label[64];
+
+		::sprintf_s( label, sizeof( label ), "echo blocking %u connections", connections );
+
+		t.Report( label, m_echoes );
+
+		if ( clients.size() < connections )
+		{
+			::printf( "echo blocking started %u of %u client threads\n", 
+					  (uint)clients.size(), connections );
+		}
+
+		if ( m_echoes > 0 )
+		{
+			::printf( "echo blocking rtt avg %I64u ns max %I64u ns\n", 
+					  m_totalNs / m_echoes, m_maxNs );
+		}
+
+		// unblocks accept when some clients failed to connect
+
+		::closesocket( m_listen );
+
+		if ( acceptor != 0 )
+		{
+			::WaitForSingleObject( acceptor, INFINITE );
+			::CloseHandle( acceptor );
+		}
+
+		join( m_servers );
+	}
+
+private:
+	static HANDLE start( LPTHREAD_START_ROUTINE f, void* arg )
+	{
+		return ::CreateThread( 0, STACK, f, arg, STACK_SIZE_PARAM_IS_A_RESERVATION, 0 );
+	}
+
+	static void join( std::vector<HANDLE>& threads )
+	{
+		for ( uint i = 0; i < threads.size(); ++i )
+		{
+			::WaitForSingleObject( threads[i], INFINITE );
+			::CloseHandle( threads[i] );
+		}
+
+		threads.clear();
+	}
+
+	static bool sendAll( SOCKET s, char* p, int len )
+	{
+		while ( len > 0 )
+		{
+			int n = ::send( s, p, len, 0 );
+
+			if ( n <= 0 )
+			{
+				return false;
+			}
+
+			p 	+= n;
+			len -= n;
+		}
+
+		return true;
+	}
+
+	static bool recvAll( SOCKET s, char* p, int len )
+	{
+		while ( len > 0 )
+		{
+			int n = ::recv( s, p, len, 0 );
+
+			if ( n <= 0 )
+			{
+				return false;
+			}
+
+			p 	+= n;
+			len -= n;
+		}
+
+		return true;
+	}
+
+	static void noDelay( SOCKET s )
+	{
+		int on = 1;
+
+		::setsockopt( s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof( on ) );
+	}
+
+	static DWORD WINAPI acceptMain( void* arg )
+	{
+		BlockingEcho* self = (BlockingEcho*)arg;
+
+		for ( uint i = 0; i < self->m_connections; ++i )
+		{
+			SOCKET s = ::accept( self->m_listen, 0, 0 );
+
+			if ( s == INVALID_SOCKET )
+			{
+				break;
+			}
+
+			noDelay( s );
+
+			HANDLE h = start( serveMain, (void*)s );
+
+			if ( h == 0 )
+			{
+				::closesocket( s );
+
+				continue;
+			}
+
+			self->m_servers.push_back( h );
+		}
+
+		return 0;
+	}
+
+	static DWORD WINAPI serveMain( void* arg )
+	{
+		SOCKET s = (SOCKET)arg;
+
+		char frame[FRAME];
+
+		while ( recvAll( s, frame, FRAME ) && sendAll( s, frame, FRAME ) )
+		{
+		}
+
+		::closesocket( s );
+
+		return 0;
+	}
+
+	static DWORD WINAPI clientMain( void* arg )
+	{
+		BlockingEcho* self = (BlockingEcho*)arg;
+
+		SOCKET s = ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+		K_RETURN_V_IF( s == INVALID_SOCKET, 1 );
+
+		if ( ::connect( s, (sockaddr*)&self->m_addr, sizeof( self->m_addr ) ) != 0 )
+		{
+			::closesocket( s );
+
+			return 1;
+		}
+
+		noDelay( s );
+
+		char frame[FRAME];
+
+		::memset( frame, 0, sizeof( frame ) );
+
+		uint8 echoes 	= 0;
+		uint8 totalNs 	= 0;
+		uint8 maxNs 	= 0;
+
+		for ( uint r = 0; r < self->m_rounds; ++r )
+		{
+			uint8 sentNs = Clock::NowNs();
+
+			if ( !sendAll( s, frame, FRAME ) || !recvAll( s, frame, FRAME ) )
+			{
+				break;
+			}
+
+			uint8 ns = Clock::NowNs() - sentNs;
+
+			++echoes;
+
+			totalNs += ns;
+			maxNs = ns > maxNs ? ns : maxNs;
+		}
+
+		::closesocket( s );
+
+		ScopedLock sl( self->m_lock );
+
+		self->m_echoes 	+= echoes;
+		self->m_totalNs += totalNs;
+		self->m_maxNs 	= maxNs > self->m_maxNs ? maxNs : self->m_maxNs;
+
+		return 0;
+	}
+
+private:
+	SOCKET 					m_listen;
+	sockaddr_in 			m_addr;
+	uint 					m_connections;
+	uint 					m_rounds;
+	uint8 					m_echoes;
+	uint8 					m_totalNs;
+	uint8 					m_maxNs;
+	Mutex 					m_lock;
+	std::vector<HANDLE> 	m_servers; 		// touched by the acceptor only until it is joined
+};
+
+/**
+ * Echo rounds on connections through two NetServers
+ */
+inline
+void 
+benchEcho( ushort port, uint connections, uint rounds )
+{
+	enum { TIMEOUT_MS = 120000 };
+
+	EchoServerListener sl;
+	EchoClientListener cl;
+
+	NetServer server;
+	NetServer client;
+
+	sl.Init( &server );
+	cl.Init( &client, connections, rounds );
+
+	K_RETURN_IF( !server.Init( &sl ) );
+	K_RETURN_IF( !client.Init( &cl ) );
+
+	IpAddress addr;
+
+	addr.Init( _T("127.0.0.1"), port );
+
+	server.Listen( addr );
+
+	Thread::Sleep( 100 );
+
+	BenchTimer t;
+
+	for ( uint i = 0; i < connections; ++i )
+	{
+		client.Connect( addr );
+	}
+
+	bool done = cl.Wait( TIMEOUT_MS );
+
+	char label[64];
+
+	::sprintf_s( label, sizeof( label ), "echo io %u connections", connections );
+
+	t.Report( label, cl.GetEchoes() );
+
+	if ( !done )
+	{
+		::printf( "echo timed out\n" );
+	}
+
+	if ( cl.GetEchoes() > 0 )
+	{
+		::printf( "echo io rtt avg %I64u ns max %I64u ns\n", 
+				  cl.GetTotalNs() / cl.GetEchoes(), cl.GetMaxNs() );
+	}
+
+	client.Fini();
+	server.Fini();
+}
+
+/**
+ * TCP echo round trips over loopback through IoService against 
+ * a blocking thread per connection baseline, with 16, 1k and 10k 
+ * connections. Each run does about the same number of echoes.
+ *
+ * Measures the completion path of the IoPort in use. IOCP on Windows, 
+ * epoll on Linux.
+ */
+inline
+void 
+BenchEcho()
+{
+	enum
+	{
+		  PORT 		= 17001
+		, ECHOES 	= 32000
+	};
+
+	static const uint CONNECTIONS[] = { 16, 1000, 10000 };
+
+	MessageFactory::Instance()->Register( new BmEcho );
+
+	K_RETURN_IF( !Socket::Startup() );
+
+	// a new port each run. the previous one can be in TIME_WAIT.
+
+	ushort port = PORT;
+
+	for ( uint i = 0; i < sizeof( CONNECTIONS ) / sizeof( CONNECTIONS[0] ); ++i )
+	{
+		uint connections = CONNECTIONS[i];
+		uint rounds 	 = ECHOES / connections;
+
+		benchEcho( port++, connections, rounds );
+
+		BlockingEcho blocking;
+
+		blocking.Run( port++, connections, rounds );
+	}
+
+	Socket::Cleanup();
+}
+
+} // gk
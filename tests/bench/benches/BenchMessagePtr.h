@@ -0,0 +1,375 @@
+#pragma once 
+
+#include "../Bench.h"
+#include "BenchMessages.h"
+
+#include <kcore/sys/Event.h>
+#include <kcore/sys/SharedPointer.h>
+#include <kcore/sys/Thread.h>
+#include <knet/NetServer.h>
+#include <knet/message/Message.h>
+#include <knet/message/MessageFactory.h>
+#include <knet/message/net/NetStateMessage.h>
+#include <knet/socket/Socket.h>
+#include <knet/tcp/impl/TcpFrame.h>
+
+#include <vector>
+
+namespace gk 
+{
+
+/**
+ * Create and release, copy and queue pass of MessagePtr.
+ * SharedPointer with its separate counter is the baseline.
+ */
+template <class P>
+inline
+void 
+benchMessagePtr( const char* name, uint count )
+{
+	char label[64];
+
+	// create and release. one allocation for intrusive, two for shared.
+	{
+		BenchAllocs a;
+		BenchTimer t;
+
+		for ( uint i = 0; i < count; ++i )
+		{
+			P m( new Message );
+		}
+
+		::sprintf_s( label, sizeof( label ), "%s create", name );
+
+		t.Report( label, count );
+		a.Report( label, count );
+	}
+
+	// copy
+	{
+		P m( new Message );
+
+		BenchAllocs a;
+		BenchTimer t;
+
+		for ( uint i = 0; i < count; ++i )
+		{
+			P c( m );
+		}
+
+		::sprintf_s( label, sizeof( label ), "%s copy", name );
+
+		t.Report( label, count );
+		a.Report( label, count );
+	}
+
+	// put and get through a locked queue
+	{
+		Queue<P, Mutex> q;
+
+		BenchAllocs a;
+		BenchTimer t;
+
+		for ( uint i = 0; i < count; ++i )
+		{
+			q.Put( P( new Message ) );
+
+			P m;
+
+			q.Get( m );
+		}
+
+		::sprintf_s( label, sizeof( label ), "%s queue", name );
+
+		t.Report( label, count );
+		a.Report( label, count );
+	}
+}
+
+/**
+ * @class RecvQListener
+ *
+ * Queues messages like Node::Notify and drains them on its own 
+ * thread like Node::processRecvQ. Signals when the expected number 
+ * of messages are processed.
+ */
+class RecvQListener : public MessageListener, public Thread
+{
+public:
+	RecvQListener()
+		: m_recvQ()
+		, m_wakeup()
+		, m_opened()
+		, m_done()
+		, m_received( 0 )
+		, m_target( 0 )
+	{
+	}
+
+	~RecvQListener()
+	{
+		Stop();
+	}
+
+	/**
+	 * Expect count more messages. Call when none is in flight.
+	 */
+	void Expect( uint count )
+	{
+		m_target.Store( m_received.Load() + count );
+	}
+
+	bool WaitOpen( uint ms )
+	{
+		return m_opened.Wait( ms );
+	}
+
+	bool WaitDone( uint ms )
+	{
+		return m_done.Wait( ms );
+	}
+
+	/**
+	 * From IO threads through TcpCommunicator and NetServer
+	 */
+	void Notify( MessagePtr m )
+	{
+		m_recvQ.Put( m );
+
+		m_wakeup.Signal();
+	}
+
+	int Run()
+	{
+		while ( IsRunning() )
+		{
+			processRecvQ();
+
+			m_wakeup.Wait( 10 );
+		}
+
+		return 0;
+	}
+
+protected:
+	void helpStop()
+	{
+		m_wakeup.Signal();
+	}
+
+private:
+	void processRecvQ()
+	{
+		LockFreeMessageQ::List ms;
+
+		K_RETURN_IF( !m_recvQ.GetAll( ms ) );
+
+		LockFreeMessageQ::List::iterator i( ms.begin() );
+		LockFreeMessageQ::List::iterator iEnd( ms.end() );
+
+		for ( ; i != iEnd; ++i )
+		{
+			MessagePtr& m = *i;
+
+			if ( m->type == NET_STATE_MESSAGE )
+			{
+				NetStateMessage* nsm = static_cast<NetStateMessage*>( m.Get() );
+
+				if ( nsm->state == NetStateMessage::TCP_OPEN )
+				{
+					m_opened.Signal();
+				}
+
+				continue;
+			}
+
+			m_received.Inc();
+
+			if ( m_received.Load() == m_target.Load() )
+			{
+				m_done.Signal();
+			}
+		}
+	}
+
+private:
+	LockFreeMessageQ 	m_recvQ;
+	Event 				m_wakeup;
+	Event 				m_opened;
+	Event 				m_done;
+	Atomic<uint> 		m_received;
+	Atomic<uint> 		m_target;
+};
+
+/**
+ * Send a batch of frames count times on a blocking socket
+ */
+inline
+bool 
+sendBatches( SOCKET s, std::vector<char>& batch, uint count )
+{
+	for ( uint i = 0; i < count; ++i )
+	{
+		int len = (int)batch.size();
+		char* p = &batch[0];
+
+		while ( len > 0 )
+		{
+			int n = ::send( s, p, len, 0 );
+
+			if ( n <= 0 )
+			{
+				return false;
+			}
+
+			p 	+= n;
+			len -= n;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * Frames of m sent by a plain blocking socket to a NetServer. 
+ * The sender does not allocate, so allocations counted are those 
+ * of the receive path: TcpConnection::buildMessage, Notify through 
+ * TcpCommunicator and NetServer, and the queue and processRecvQ of 
+ * the listener. Reports ns and allocations per message.
+ */
+inline
+void 
+benchRecvPath( const char* name, ushort port, Message& m, uint rounds )
+{
+	enum 
+	{ 
+		  BATCH 		= 1000
+		, TIMEOUT_MS 	= 60000 
+	};
+
+	// frames of a batch in one buffer. the server handshake is not read.
+
+	std::vector<char> batch;
+
+	for ( uint i = 0; i < BATCH; ++i )
+	{
+		TcpFrame f;
+
+		K_RETURN_IF( !f.Pack( m, 0 ) );
+
+		batch.insert( batch.end(), f.GetData(), f.GetData() + f.GetLength() );
+	}
+
+	RecvQListener listener;
+	NetServer server;
+
+	K_RETURN_IF( !server.Init( &listener ) );
+	K_RETURN_IF( !listener.Start() );
+
+	IpAddress addr;
+
+	addr.Init( _T("127.0.0.1"), port );
+
+	server.Listen( addr ); // SECURITY0. frames are sent without a cipher.
+
+	Thread::Sleep( 100 );
+
+	sockaddr_in sa;
+
+	::memset( (void*)&sa, 0, sizeof( sa ) );
+
+	sa.sin_family 		= AF_INET;
+	sa.sin_port 		= ::htons( port );
+	sa.sin_addr.s_addr 	= ::inet_addr( "127.0.0.1" );
+
+	SOCKET s = ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+
+	if ( s == INVALID_SOCKET || 
+		 ::connect( s, (sockaddr*)&sa, sizeof( sa ) ) != 0 || 
+		 !listener.WaitOpen( TIMEOUT_MS ) )
+	{
+		::printf( "%s failed to connect\n", name );
+
+		if ( s != INVALID_SOCKET )
+		{
+			::closesocket( s );
+		}
+
+		server.Fini();
+
+		return;
+	}
+
+	// a warm up batch fills pools and queue blocks
+
+	listener.Expect( BATCH );
+
+	bool ok = sendBatches( s, batch, 1 ) && listener.WaitDone( TIMEOUT_MS );
+
+	if ( ok )
+	{
+		uint8 count = (uint8)rounds * BATCH;
+
+		listener.Expect( rounds * BATCH );
+
+		BenchAllocs a;
+		BenchTimer t;
+
+		ok = sendBatches( s, batch, rounds ) && listener.WaitDone( TIMEOUT_MS );
+
+		char label[64];
+
+		::sprintf_s( label, sizeof( label ), "%s recv", name );
+
+		t.Report( label, count );
+		a.Report( label, count );
+	}
+
+	if ( !ok )
+	{
+		::printf( "%s recv failed or timed out\n", name );
+	}
+
+	::closesocket( s );
+
+	server.Fini();
+	listener.Stop();
+}
+
+/**
+ * MessagePtr against SharedPointer, then messages through the 
+ * receive path of a NetServer with and without a MessagePool.
+ * Reports allocations per message with the times.
+ */
+inline
+void 
+BenchMessagePtr()
+{
+	enum 
+	{ 
+		  COUNT 	= 1000000
+		, PORT 		= 17020
+		, ROUNDS 	= 200
+	};
+
+	benchMessagePtr< SharedPointer<Message> >( "msgptr shared", COUNT );
+	benchMessagePtr< MessagePtr >( "msgptr intrusive", COUNT );
+
+	MessageFactory* f = MessageFactory::Instance();
+
+	f->Register( new BmEcho );
+	f->Register( new BmPooled );
+	f->SetPool( BENCH_POOLED );
+
+	K_RETURN_IF( !Socket::Startup() );
+
+	BmEcho plain;
+	BmPooled pooled;
+
+	benchRecvPath( "msgptr new", PORT, plain, ROUNDS );
+	benchRecvPath( "msgptr pooled", PORT + 1, pooled, ROUNDS );
+
+	Socket::Cleanup();
+}
+
+} // gk
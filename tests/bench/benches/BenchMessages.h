@@ -0,0 +1,142 @@
+#pragma once 
+
+#include <knet/message/Message.h>
+#include <knet/message/MessageSchema.h>
+#include <kserver/message/CellMessage.h>
+
+#include <vector>
+
+namespace gk 
+{
+
+enum
+{
+	  BENCH_ECHO = Message::MESSAGE_TYPE_SYSTEM_END + 1
+	, BENCH_POOLED
+	, BENCH_CELL_UPDATE
+	, BENCH_BULK
+};
+
+/**
+ * @struct BmEcho
+ *
+ * Sent back as it is by the echo server
+ */
+struct BmEcho : public Message
+{
+	enum { PAYLOAD_LEN = 64 };
+
+	uint seq;
+	byte payload[PAYLOAD_LEN];
+
+	K_SCHEMA_BEGIN( Message )
+		K_FIELD( seq, 		SchemaUInt<32> )
+		K_FIELD( payload, 	SchemaBytes<PAYLOAD_LEN> )
+	K_SCHEMA_END()
+
+	Message* Create()
+	{
+		return new BmEcho;
+	}
+
+	BmEcho()
+	: seq( 0 )
+	{
+		type = BENCH_ECHO;
+
+		::memset( payload, 0, sizeof( payload ) );
+	}
+};
+
+/**
+ * @struct BmPooled
+ *
+ * BmEcho of a type with a MessagePool
+ */
+struct BmPooled : public BmEcho
+{
+	Message* Create()
+	{
+		return new BmPooled;
+	}
+
+	BmPooled()
+	{
+		type = BENCH_POOLED;
+	}
+};
+
+/**
+ * @struct BmBulk
+ *
+ * Packs past the inline storage of a Buffer
+ */
+struct BmBulk : public Message
+{
+	enum { PAYLOAD_LEN = 1024 };
+
+	byte payload[PAYLOAD_LEN];
+
+	K_SCHEMA_BEGIN( Message )
+		K_FIELD( payload, 	SchemaBytes<PAYLOAD_LEN> )
+	K_SCHEMA_END()
+
+	Message* Create()
+	{
+		return new BmBulk;
+	}
+
+	BmBulk()
+	{
+		type = BENCH_BULK;
+
+		::memset( payload, 0, sizeof( payload ) );
+	}
+};
+
+/**
+ * @struct BmCellUpdate
+ *
+ * An entity update sent by a cell. Fields of typical game state.
+ */
+struct BmCellUpdate : public CellMessage
+{
+	enum { MAX_ITEMS = 32 };
+
+	uint 				entity;
+	int 				x;
+	int 				y;
+	int 				z;
+	uint 				hp;
+	tstring 			name;
+	std::vector<uint> 	items;
+
+	K_SCHEMA_BEGIN( CellMessage )
+		K_FIELD( entity, 	SchemaUInt<32> )
+		K_FIELD( x, 		SchemaInt<32> )
+		K_FIELD( y, 		SchemaInt<32> )
+		K_FIELD( z, 		SchemaInt<32> )
+		K_FIELD( hp, 		SchemaUInt<16> )
+		K_FIELD( name, 		SchemaString<32> )
+		K_FIELD( items, 	SchemaVector< SchemaUInt<16>, MAX_ITEMS > )
+	K_SCHEMA_END()
+
+	Message* Create()
+	{
+		return new BmCellUpdate;
+	}
+
+	BmCellUpdate()
+	: entity( 0 )
+	, x( 0 )
+	, y( 0 )
+	, z( 0 )
+	, hp( 0 )
+	, name()
+	, items()
+	{
+		type = BENCH_CELL_UPDATE;
+	}
+};
+
+} // gk
@@ -0,0 +1,348 @@
+#pragma once 
+
+#include "../Bench.h"
+#include "BenchMessages.h"
+
+#include <kcore/sys/Event.h>
+#include <kcore/sys/Lock.h>
+#include <kcore/sys/ScopedLock.h>
+#include <knet/NetServer.h>
+#include <knet/cipher/Cipher.h>
+#include <knet/message/MessageFactory.h>
+#include <knet/message/net/NetStateMessage.h>
+#include <knet/socket/Socket.h>
+#include <knet/tcp/impl/TcpFrame.h>
+
+#include <vector>
+
+namespace gk 
+{
+
+/**
+ * Frame cost of a multicast to receivers sharing a key.
+ * Packed per receiver as before against packed once and shared.
+ */
+inline
+void 
+benchMulticastFrames( const char* name, Cipher* cipher, uint receivers, uint count )
+{
+	BmEcho m;
+
+	char label[64];
+
+	{
+		BenchTimer t;
+
+		for ( uint i = 0; i < count; ++i )
+		{
+			for ( uint r = 0; r < receivers; ++r )
+			{
+				TcpFramePtr frame( new TcpFrame );
+
+				frame->Pack( m, cipher );
+			}
+		}
+
+		::sprintf_s( label, sizeof( label ), "%s %u per receiver", name, receivers );
+
+		t.Report( label, (uint8)count * receivers );
+	}
+
+	{
+		BenchTimer t;
+
+		for ( uint i = 0; i < count; ++i )
+		{
+			TcpFramePtr frame( new TcpFrame );
+
+			frame->Pack( m, cipher );
+
+			for ( uint r = 0; r < receivers; ++r )
+			{
+				TcpFramePtr shared( frame ); // queued by reference
+			}
+		}
+
+		::sprintf_s( label, sizeof( label ), "%s %u shared", name, receivers );
+
+		t.Report( label, (uint8)count * receivers );
+	}
+}
+
+/**
+ * @class MulticastServerListener
+ *
+ * Collects ids of accepted connections. Called from the NetServer thread.
+ */
+class MulticastServerListener : public MessageListener
+{
+public:
+	MulticastServerListener()
+		: m_lock()
+		, m_ids()
+	{
+	}
+
+	void Notify( MessagePtr m )
+	{
+		K_RETURN_IF( m->type != NET_STATE_MESSAGE );
+
+		NetStateMessage* nsm = static_cast<NetStateMessage*>( m.Get() );
+
+		K_RETURN_IF( nsm->state != NetStateMessage::TCP_OPEN );
+
+		ScopedLock sl( m_lock );
+
+		m_ids.push_back( nsm->connectionId );
+	}
+
+	/**
+	 * Get ids when count connections are open
+	 */
+	bool GetIds( std::vector<uint>& ids, uint count, uint ms )
+	{
+		for ( uint waited = 0; waited < ms; waited += 10 )
+		{
+			{
+				ScopedLock sl( m_lock );
+
+				if ( m_ids.size() >= count )
+				{
+					ids = m_ids;
+
+					return true;
+				}
+			}
+
+			Thread::Sleep( 10 );
+		}
+
+		return false;
+	}
+
+private:
+	Mutex 				m_lock;
+	std::vector<uint> 	m_ids;
+};
+
+/**
+ * @class MulticastClientListener
+ *
+ * Counts opened connections and BmEcho received on all of them.
+ * Called from IO threads and the NetServer thread.
+ */
+class MulticastClientListener : public MessageListener
+{
+public:
+	MulticastClientListener()
+		: m_opened( 0 )
+		, m_received( 0 )
+		, m_target( 0 )
+		, m_done()
+	{
+	}
+
+	/**
+	 * Expect count more messages. Call when none is in flight.
+	 */
+	void Expect( uint count )
+	{
+		m_target.Store( m_received.Load() + count );
+	}
+
+	bool WaitReceived( uint ms )
+	{
+		return m_done.Wait( ms );
+	}
+
+	bool WaitOpened( uint count, uint ms )
+	{
+		for ( uint waited = 0; m_opened.Load() < count; waited += 10 )
+		{
+			K_RETURN_V_IF( waited >= ms, false );
+
+			Thread::Sleep( 10 );
+		}
+
+		return true;
+	}
+
+	void Notify( MessagePtr m )
+	{
+		if ( m->type == NET_STATE_MESSAGE )
+		{
+			NetStateMessage* nsm = static_cast<NetStateMessage*>( m.Get() );
+
+			if ( nsm->state == NetStateMessage::TCP_OPEN )
+			{
+				m_opened.Inc();
+			}
+
+			return;
+		}
+
+		K_RETURN_IF( m->type != BENCH_ECHO );
+
+		if ( m_received.FetchAdd( 1 ) + 1 == m_target.Load() )
+		{
+			m_done.Signal();
+		}
+	}
+
+private:
+	Atomic<uint> 	m_opened;
+	Atomic<uint> 	m_received;
+	Atomic<uint> 	m_target;
+	Event 			m_done;
+};
+
+/**
+ * Multicasts from a NetServer to receivers connections of another. 
+ * NetServer::Send with remotes goes to TcpCommunicator::Send, which 
+ * groups receivers by compression and key, packs a frame per group 
+ * and queues it on each connection. Plain connections share one 
+ * frame. With SECURITY1 every connection has its own key. 
+ *
+ * Multicasts are sent in windows of about WINDOW deliveries and 
+ * each window is waited for at the receivers. Reports multicasts 
+ * and deliveries per second.
+ */
+inline
+void 
+benchMulticastPath( const char* name, ushort port, SecurityLevel sl, uint receivers, uint count )
+{
+	enum 
+	{ 
+		  WINDOW 		= 4096
+		, TIMEOUT_MS 	= 60000 
+	};
+
+	MulticastServerListener sls;
+	MulticastClientListener cl;
+
+	NetServer server;
+	NetServer client;
+
+	K_RETURN_IF( !server.Init( &sls ) );
+	K_RETURN_IF( !client.Init( &cl ) );
+
+	IpAddress addr;
+
+	addr.Init( _T("127.0.0.1"), port );
+
+	server.Listen( addr, sl );
+
+	Thread::Sleep( 100 );
+
+	for ( uint i = 0; i < receivers; ++i )
+	{
+		client.Connect( addr );
+	}
+
+	std::vector<uint> ids;
+
+	bool ok = sls.GetIds( ids, receivers, TIMEOUT_MS ) && 
+			  cl.WaitOpened( receivers, TIMEOUT_MS );
+
+	if ( !ok )
+	{
+		::printf( "%s %u receivers failed to connect\n", name, receivers );
+	}
+
+	uint window = WINDOW / receivers > 0 ? WINDOW / receivers : 1;
+
+	BenchTimer t;
+
+	for ( uint i = 0; i < count && ok; i += window )
+	{
+		uint n = count - i < window ? count - i : window;
+
+		cl.Expect( n * receivers );
+
+		for ( uint k = 0; k < n; ++k )
+		{
+			BmEcho* e = new BmEcho;
+
+			e->seq 		= i + k;
+			e->remotes 	= ids;
+
+			server.Send( MessagePtr( e ) );
+		}
+
+		ok = cl.WaitReceived( TIMEOUT_MS );
+	}
+
+	if ( ok )
+	{
+		char label[64];
+
+		::sprintf_s( label, sizeof( label ), "%s %u receivers", name, receivers );
+
+		t.Report( label, count );
+
+		::sprintf_s( label, sizeof( label ), "%s %u deliveries", name, receivers );
+
+		t.Report( label, (uint8)count * receivers );
+	}
+	else
+	{
+		::printf( "%s %u receivers timed out\n", name, receivers );
+	}
+
+	client.Fini();
+	server.Fini();
+}
+
+/**
+ * Multicast with 1, 10, 100 and 500 receivers, plain and encrypted.
+ * Frame packing alone, then the send path of TcpCommunicator to 
+ * connections over loopback.
+ */
+inline
+void 
+BenchMulticast()
+{
+	enum 
+	{ 
+		  PORT 			= 17030
+		, FRAMES 		= 200000 	// frames packed or shared per run
+		, DELIVERIES 	= 200000 	// messages received per run
+	};
+
+	static const uint RECEIVERS[] = { 1, 10, 100, 500 };
+	static const uint RUNS = sizeof( RECEIVERS ) / sizeof( RECEIVERS[0] );
+
+	Cipher cipher;
+
+	bool encrypted = cipher.Init();
+
+	for ( uint i = 0; i < RUNS; ++i )
+	{
+		uint count = FRAMES / RECEIVERS[i];
+
+		benchMulticastFrames( "multicast frames plain", 0, RECEIVERS[i], count );
+
+		if ( encrypted )
+		{
+			benchMulticastFrames( "multicast frames encrypted", &cipher, RECEIVERS[i], count );
+		}
+	}
+
+	MessageFactory::Instance()->Register( new BmEcho );
+
+	K_RETURN_IF( !Socket::Startup() );
+
+	ushort port = PORT; // a new port each run
+
+	for ( uint i = 0; i < RUNS; ++i )
+	{
+		uint count = DELIVERIES / RECEIVERS[i];
+
+		benchMulticastPath( "multicast plain", port++, SECURITY0, RECEIVERS[i], count );
+		benchMulticastPath( "multicast encrypted", port++, SECURITY1, RECEIVERS[i], count );
+	}
+
+	Socket::Cleanup();
+}
+
+} // gk
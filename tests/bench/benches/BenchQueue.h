@@ -0,0 +1,131 @@
+#pragma once 
+
+#include "../Bench.h"
+
+#include <kcore/sys/Queue.h>
+#include <kcore/sys/Thread.h>
+
+namespace gk 
+{
+
+/**
+ * @class QueueProducer
+ *
+ * Puts count values into a queue after go is set
+ */
+template <class Q>
+class QueueProducer : public Thread
+{
+public:
+	QueueProducer()
+		: m_q( 0 )
+		, m_go( 0 )
+		, m_count( 0 )
+	{
+	}
+
+	~QueueProducer()
+	{
+		Stop();
+	}
+
+	void Init( Q* q, Atomic<bool>* go, uint count )
+	{
+		m_q 	= q;
+		m_go 	= go;
+		m_count = count;
+	}
+
+	int Run()
+	{
+		while ( !m_go->Load() )
+		{
+			Thread::Sleep( 0 );
+		}
+
+		for ( uint i = 0; i < m_count; ++i )
+		{
+			m_q->Put( i );
+		}
+
+		return 0;
+	}
+
+private:
+	Q* 				m_q;
+	Atomic<bool>* 	m_go;
+	uint 			m_count;
+};
+
+/**
+ * Producers put into one queue and the caller drains it with GetAll. 
+ */
+template <class Q>
+inline
+void 
+benchQueue( const char* name, uint producers, uint count )
+{
+	enum { MAX_PRODUCERS = 16 };
+
+	K_ASSERT( producers <= MAX_PRODUCERS );
+
+	Q q;
+	Atomic<bool> go( false );
+
+	QueueProducer<Q> threads[MAX_PRODUCERS];
+
+	for ( uint i = 0; i < producers; ++i )
+	{
+		threads[i].Init( &q, &go, count );
+		threads[i].Start();
+	}
+
+	uint8 total = (uint8)producers * count;
+	uint8 taken = 0;
+
+	typename Q::List l;
+
+	BenchTimer t;
+
+	go.Store( true );
+
+	while ( taken < total )
+	{
+		if ( q.GetAll( l ) )
+		{
+			taken += l.size();
+
+			l.clear();
+		}
+	}
+
+	char label[64];
+
+	::sprintf_s( label, sizeof( label ), "%s %u producers", name, producers );
+
+	t.Report( label, total );
+
+	for ( uint i = 0; i < producers; ++i )
+	{
+		threads[i].Stop();
+	}
+}
+
+/**
+ * MPSC contention. Mutex queue against the lock free queue 
+ * with 1 to 16 producers and a single consumer.
+ */
+inline
+void 
+BenchQueue()
+{
+	enum { COUNT = 200000 };
+
+	for ( uint producers = 1; producers <= 16; producers *= 2 )
+	{
+		benchQueue< Queue<uint, Mutex> >( "queue mutex", producers, COUNT );
+		benchQueue< Queue<uint, LockFree> >( "queue lockfree", producers, COUNT );
+	}
+}
+
+} // gk
@@ -0,0 +1,166 @@
+#pragma once 
+
+#include "../Bench.h"
+#include "BenchEcho.h"
+
+#include <kcore/sys/Event.h>
+#include <knet/NetServer.h>
+#include <knet/message/net/NetStateMessage.h>
+
+namespace gk 
+{
+
+/**
+ * @class ReconnectListener
+ *
+ * Closes each connection as soon as it is open and connects again 
+ * until total connects are done. Called from the client NetServer thread.
+ */
+class ReconnectListener : public MessageListener
+{
+public:
+	ReconnectListener()
+		: m_client( 0 )
+		, m_addr()
+		, m_total( 0 )
+		, m_started( 0 )
+		, m_opened( 0 )
+		, m_failed( 0 )
+		, m_done()
+	{
+	}
+
+	void Init( NetServer* client, const IpAddress& addr, uint total )
+	{
+		m_client 	= client;
+		m_addr 		= addr;
+		m_total 	= total;
+	}
+
+	/**
+	 * Start count connects at once
+	 */
+	void Start( uint count )
+	{
+		K_ASSERT( count <= m_total );
+
+		// set before the first connect. notifications change it after.
+
+		m_started = count;
+
+		for ( uint i = 0; i < count; ++i )
+		{
+			m_client->Connect( m_addr );
+		}
+	}
+
+	void Notify( MessagePtr m )
+	{
+		K_RETURN_IF( m->type != NET_STATE_MESSAGE );
+
+		NetStateMessage* nsm = static_cast<NetStateMessage*>( m.Get() );
+
+		switch ( nsm->state )
+		{
+		case NetStateMessage::TCP_OPEN:
+			++m_opened;
+
+			m_client->Close( nsm->connectionId );
+			break;
+		case NetStateMessage::TCP_CONNECT_FAIL:
+			++m_failed;
+			break;
+		default:
+			return;
+		}
+
+		if ( m_opened + m_failed == m_total )
+		{
+			m_done.Signal();
+
+			return;
+		}
+
+		connect();
+	}
+
+	bool Wait( uint ms )
+	{
+		return m_done.Wait( ms );
+	}
+
+	uint GetOpened() const 	{ return m_opened; }
+	uint GetFailed() const 	{ return m_failed; }
+
+private:
+	void connect()
+	{
+		K_RETURN_IF( m_started >= m_total );
+
+		++m_started;
+
+		m_client->Connect( m_addr );
+	}
+
+private:
+	NetServer* 	m_client;
+	IpAddress 	m_addr;
+	uint 		m_total;
+	uint 		m_started;
+	uint 		m_opened;
+	uint 		m_failed;
+	Event 		m_done;
+};
+
+/**
+ * Reconnect storm. CONCURRENT clients connect, open and close in a loop. 
+ * Reports accepted connections per second through the Acceptor batch.
+ */
+inline
+void 
+BenchReconnect()
+{
+	enum
+	{
+		  PORT 			= 17010
+		, CONCURRENT 	= 256
+		, TOTAL 		= 20000
+		, TIMEOUT_MS 	= 120000
+	};
+
+	EchoServerListener sl;
+	ReconnectListener cl;
+
+	NetServer server;
+	NetServer client;
+
+	IpAddress addr;
+
+	addr.Init( _T("127.0.0.1"), PORT );
+
+	sl.Init( &server );
+	cl.Init( &client, addr, TOTAL );
+
+	K_RETURN_IF( !server.Init( &sl ) );
+	K_RETURN_IF( !client.Init( &cl ) );
+
+	server.Listen( addr );
+
+	Thread::Sleep( 100 );
+
+	BenchTimer t;
+
+	cl.Start( CONCURRENT );
+
+	bool done = cl.Wait( TIMEOUT_MS );
+
+	t.Report( "reconnect open and close", cl.GetOpened() );
+
+	::printf( "reconnect opened %u failed %u%s\n", 
+			  cl.GetOpened(), cl.GetFailed(), done ? "" : " (timed out)" );
+
+	client.Fini();
+	server.Fini();
+}
+
+} // gk
@@ -0,0 +1,176 @@
+#pragma once 
+
+#include "../Bench.h"
+
+#include <kcore/sys/Event.h>
+#include <kcore/sys/Queue.h>
+#include <kcore/sys/Thread.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace gk 
+{
+
+/**
+ * @class WakeupLoop
+ *
+ * An idle loop like Node::Run. Moves values from in to out and 
+ * either sleeps 1 ms or waits on its event when in is empty.
+ */
+class WakeupLoop : public Thread
+{
+public:
+	typedef Queue<uint, Mutex> Q;
+
+public:
+	WakeupLoop()
+		: m_in( 0 )
+		, m_out( 0 )
+		, m_reply( 0 )
+		, m_event( false )
+		, m_wakeup()
+	{
+	}
+
+	~WakeupLoop()
+	{
+		Stop();
+	}
+
+	void Init( Q* in, Q* out, Event* reply, bool event )
+	{
+		m_in 	= in;
+		m_out 	= out;
+		m_reply = reply;
+		m_event = event;
+	}
+
+	/**
+	 * Called by the producer after Put to in
+	 */
+	void Wakeup()
+	{
+		if ( m_event )
+		{
+			m_wakeup.Signal();
+		}
+	}
+
+	int Run()
+	{
+		Q::List l;
+
+		while ( IsRunning() )
+		{
+			if ( m_in->GetAll( l ) )
+			{
+				Q::List::iterator i( l.begin() );
+				Q::List::iterator iEnd( l.end() );
+
+				for ( ; i != iEnd; ++i )
+				{
+					m_out->Put( *i );
+				}
+
+				l.clear();
+
+				m_reply->Signal();
+			}
+			else if ( m_event )
+			{
+				m_wakeup.Wait( 100 );
+			}
+			else
+			{
+				Thread::Sleep( 1 );
+			}
+		}
+
+		return 0;
+	}
+
+protected:
+	void helpStop()
+	{
+		m_wakeup.Signal();
+	}
+
+private:
+	Q* 		m_in;
+	Q* 		m_out;
+	Event* 	m_reply;
+	bool 	m_event;
+	Event 	m_wakeup;
+};
+
+/**
+ * Single message round trips through an idle loop. The caller waits 
+ * on an event for the reply, so only the loop's idle wait is measured.
+ */
+inline
+void 
+benchWakeup( const char* name, bool event, uint count )
+{
+	WakeupLoop::Q in;
+	WakeupLoop::Q out;
+	Event reply;
+
+	WakeupLoop loop;
+
+	loop.Init( &in, &out, &reply, event );
+	loop.Start();
+
+	std::vector<uint8> rtts;
+	rtts.reserve( count );
+
+	WakeupLoop::Q::List l;
+
+	BenchTimer t;
+
+	for ( uint i = 0; i < count; ++i )
+	{
+		Thread::Sleep( 2 ); // let the loop go idle
+
+		uint8 start = Clock::NowNs();
+
+		in.Put( i );
+		loop.Wakeup();
+
+		while ( !out.GetAll( l ) )
+		{
+			reply.Wait( 100 );
+		}
+
+		rtts.push_back( Clock::NowNs() - start );
+
+		l.clear();
+	}
+
+	loop.Stop();
+
+	std::sort( rtts.begin(), rtts.end() );
+
+	::printf( "%-40s %12u rtts p50 %10.1f us p99 %10.1f us max %10.1f us\n", 
+			  name, 
+			  count, 
+			  rtts[count / 2] / 1e3, 
+			  rtts[count * 99 / 100] / 1e3, 
+			  rtts[count - 1] / 1e3 );
+}
+
+/**
+ * Round trip latency of one message through an idle loop. 
+ * Sleep(1) polling against waiting on an Event.
+ */
+inline
+void 
+BenchWakeup()
+{
+	enum { COUNT = 1000 };
+
+	benchWakeup( "wakeup sleep(1)", false, COUNT );
+	benchWakeup( "wakeup event", true, COUNT );
+}
+
+} // gk
@@ -0,0 +1,574 @@
+#pragma once 
+
+#include <knet/message/BitStream.h>
+#include <gtest/gtest.h>
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
+namespace {
+
+using namespace gk;
+
+/**
+ * WriteBits and ReadBits as BitStream had them before it moved 
+ * 64 bit words. One byte per loop. The reference output.
+ */
+class ByteLoopBits
+{
+public:
+	ByteLoopBits( byte* data, uint size )
+		: m_data( data )
+		, m_maxBits( size << 3 )
+		, m_posBit( 0 )
+	{
+	}
+
+	void SetBitPosition( uint bitPos )
+	{
+		m_posBit = bitPos;
+	}
+
+	bool WriteBits( uint bitCount, const void* bitPtr )
+	{
+		K_RETURN_V_IF( bitCount == 0, true );
+		K_RETURN_V_IF( bitCount + m_posBit > m_maxBits, false );
+
+		uint upShift 	= m_posBit & 0x7;
+		uint downShift 	= 8 - upShift;
+
+		const byte* sourcePtr = (const byte*)bitPtr;
+		byte* destPtr = m_data + ( m_posBit >> 3 );
+
+		if ( downShift >= bitCount )
+		{
+			byte mask = (byte)( ( ( ( 1 << bitCount ) - 1 ) << upShift ) & 0xFF );
+			*destPtr = (byte)( ( *destPtr & ~mask ) | ( ( *sourcePtr << upShift ) & mask ) );
+			m_posBit += bitCount;
+
+			return true;
+		}
+
+		if ( !upShift )
+		{
+			m_posBit += bitCount;
+
+			for ( ; bitCount >= 8; bitCount -= 8 )
+			{
+				*destPtr++ = *sourcePtr++;
+			}
+
+			if ( bitCount )
+			{
+				byte mask = (byte)( ( 1 << bitCount ) - 1 );
+				*destPtr = (byte)( ( *sourcePtr & mask ) | ( *destPtr & ~mask ) );
+			}
+
+			return true;
+		}
+
+		byte sourceByte;
+		byte destByte = (byte)( *destPtr & ( 0xFF >> downShift ) );
+		byte lastMask = (byte)( 0xFF >> ( 7 - ( ( m_posBit + bitCount - 1 ) & 0x7 ) ) );
+
+		m_posBit += bitCount;
+
+		for ( ; bitCount >= 8; bitCount -= 8 )
+		{
+			sourceByte = *sourcePtr++;
+			*destPtr++ = (byte)( destByte | ( sourceByte << upShift ) );
+			destByte = (byte)( sourceByte >> downShift );
+		}
+
+		if ( bitCount == 0 )
+		{
+			*destPtr = (byte)( ( *destPtr & ~lastMask ) | ( destByte & lastMask ) );
+
+			return true;
+		}
+
+		if ( bitCount <= downShift )
+		{
+			*destPtr = (byte)( ( *destPtr & ~lastMask ) | 
+							   ( ( destByte | ( *sourcePtr << upShift ) ) & lastMask ) );
+
+			return true;
+		}
+
+		sourceByte = *sourcePtr;
+		*destPtr++ = (byte)( destByte | ( sourceByte << upShift ) );
+		*destPtr   = (byte)( ( *destPtr & ~lastMask ) | ( ( sourceByte >> downShift ) & lastMask ) );
+
+		return true;
+	}
+
+	bool ReadBits( uint bitCount, void* bitPtr )
+	{
+		K_RETURN_V_IF( bitCount == 0, true );
+		K_RETURN_V_IF( bitCount + m_posBit > m_maxBits, false );
+
+		byte* sourcePtr = m_data + ( m_posBit >> 3 );
+		uint byteCount 	= ( bitCount + 7 ) >> 3;
+
+		byte* destPtr 	= (byte*)bitPtr;
+		uint downShift 	= m_posBit & 0x7;
+		uint upShift 	= 8 - downShift;
+
+		if ( !downShift )
+		{
+			while ( byteCount-- )
+			{
+				*destPtr++ = *sourcePtr++;
+			}
+
+			m_posBit += bitCount;
+
+			return true;
+		}
+
+		byte sourceByte = (byte)( *sourcePtr >> downShift );
+		m_posBit += bitCount;
+
+		for ( ; bitCount >= 8; bitCount -= 8 )
+		{
+			byte nextByte = *++sourcePtr;
+			*destPtr++ = (byte)( sourceByte | ( nextByte << upShift ) );
+			sourceByte = (byte)( nextByte >> downShift );
+		}
+
+		if ( bitCount )
+		{
+			if ( bitCount <= upShift )
+			{
+				*destPtr = sourceByte;
+
+				return true;
+			}
+
+			*destPtr = (byte)( sourceByte | ( ( *++sourcePtr ) << upShift ) );
+		}
+
+		return true;
+	}
+
+private:
+	byte* 	m_data;
+	uint 	m_maxBits;
+	uint 	m_posBit;
+};
+
+// crosses the 56 bit step of the word loop twice
+const uint MAX_RUN_BITS = 136;
+const uint RUN_LEN 		= MAX_RUN_BITS / 8 + 1;
+
+void 
+fillBytes( byte* p, uint len, uint seed )
+{
+	for ( uint i = 0; i < len; ++i )
+	{
+		seed = seed * 1103515245 + 12345;
+
+		p[i] = (byte)( seed >> 16 );
+	}
+}
+
+// the low bitCount bits of a and b are the same
+bool 
+sameBits( const byte* a, const byte* b, uint bitCount )
+{
+	uint bytes = bitCount >> 3;
+
+	if ( ::memcmp( a, b, bytes ) != 0 )
+	{
+		return false;
+	}
+
+	uint rest = bitCount & 0x7;
+	byte mask = (byte)( ( 1 << rest ) - 1 );
+
+	return rest == 0 || ( ( a[bytes] ^ b[bytes] ) & mask ) == 0;
+}
+
+/**
+ * Writes bitCount bits at bitPos with both, over the same garbage, 
+ * and reads them back. Buffers are exactly size bytes on the heap 
+ * so a debug heap catches access past the end.
+ */
+void 
+compareRun( uint size, uint bitPos, uint bitCount, uint seed )
+{
+	byte* expected 	= new byte[size];
+	byte* actual 	= new byte[size];
+
+	fillBytes( expected, size, seed );
+	::memcpy( actual, expected, size );
+
+	byte run[RUN_LEN];
+
+	fillBytes( run, RUN_LEN, seed + 1 );
+
+	ByteLoopBits ref( expected, size );
+	BitStream bs( actual, size );
+
+	ref.SetBitPosition( bitPos );
+	bs.SetBitPosition( bitPos );
+
+	ASSERT_TRUE( ref.WriteBits( bitCount, run ) );
+	ASSERT_TRUE( bs.WriteBits( bitCount, run ) );
+	ASSERT_EQ( bitPos + bitCount, bs.GetBitPosition() );
+	ASSERT_EQ( 0, ::memcmp( expected, actual, size ) );
+
+	byte refOut[RUN_LEN];
+	byte out[RUN_LEN + 1];
+
+	::memset( out, 0xCD, sizeof( out ) );
+
+	ref.SetBitPosition( bitPos );
+	bs.SetBitPosition( bitPos );
+
+	ASSERT_TRUE( ref.ReadBits( bitCount, refOut ) );
+	ASSERT_TRUE( bs.ReadBits( bitCount, out ) );
+	ASSERT_EQ( bitPos + bitCount, bs.GetBitPosition() );
+	ASSERT_TRUE( bs.IsValid() );
+
+	ASSERT_TRUE( sameBits( refOut, out, bitCount ) );
+	ASSERT_TRUE( sameBits( run, out, bitCount ) );
+
+	// nothing written past the bytes of bitCount
+	ASSERT_EQ( 0xCD, out[( bitCount + 7 ) >> 3] );
+
+	delete [] expected;
+	delete [] actual;
+}
+
+} // 
+
+TEST( TestBitStream, testBitsAtEveryOffset ) {
+	const uint SIZE = 64;
+
+	for ( uint offset = 0; offset < 8; ++offset )
+	{
+		for ( uint bits = 1; bits <= MAX_RUN_BITS; ++bits )
+		{
+			compareRun( SIZE, offset, bits, offset * 1000 + bits );
+
+			// from the middle of a word 
+			compareRun( SIZE, 40 + offset, bits, offset * 3000 + bits );
+		}
+	}
+}
+
+TEST( TestBitStream, testBitsAtBufferEnd ) {
+	// the run ends on the last bit or up to 7 bits before it, 
+	// so the word loads and stores near the end take the short path
+
+	for ( uint tail = 0; tail < 8; ++tail )
+	{
+		for ( uint bits = 1; bits <= MAX_RUN_BITS; ++bits )
+		{
+			uint size = RUN_LEN + 2;
+			uint end  = ( size << 3 ) - tail;
+
+			compareRun( size, end - bits, bits, tail * 1000 + bits );
+		}
+	}
+
+	// a buffer shorter than a word
+
+	for ( uint size = 1; size < 8; ++size )
+	{
+		for ( uint bitPos = 0; bitPos < ( size << 3 ); ++bitPos )
+		{
+			compareRun( size, bitPos, ( size << 3 ) - bitPos, size * 100 + bitPos );
+		}
+	}
+}
+
+TEST( TestBitStream, testBitsPastBufferEnd ) {
+	const uint SIZE = 16;
+
+	for ( uint offset = 0; offset < 8; ++offset )
+	{
+		byte data[SIZE];
+		byte before[SIZE];
+		byte run[SIZE + 1];
+
+		fillBytes( data, SIZE, offset );
+		fillBytes( run, SIZE + 1, offset + 1 );
+		::memcpy( before, data, SIZE );
+
+		BitStream bs( data, SIZE );
+
+		bs.SetBitPosition( offset );
+
+		uint bits = ( SIZE << 3 ) - offset + 1;
+
+		ASSERT_TRUE( !bs.WriteBits( bits, run ) );
+		ASSERT_EQ( 0, ::memcmp( before, data, SIZE ) );
+
+		bs.Reset();
+		bs.SetBitPosition( offset );
+
+		ASSERT_TRUE( !bs.ReadBits( bits, run ) );
+		ASSERT_TRUE( !bs.IsValid() );
+	}
+}
+
+TEST( TestBitStream, testVarIntBytes ) {
+	// LEB128 of 300 when byte aligned
+
+	BitStream bs( 16 );
+
+	bs.WriteVarInt( 300 );
+
+	ASSERT_EQ( 16u, bs.GetBitPosition() );
+	ASSERT_EQ( 0xAC, bs.GetBuffer()[0] );
+	ASSERT_EQ( 0x02, bs.GetBuffer()[1] );
+	ASSERT_EQ( 16u, BitStream::GetVarIntBits( 300 ) );
+
+	bs.SetBitPosition( 0 );
+
+	uint v = 0;
+
+	bs.ReadVarInt( v );
+
+	ASSERT_TRUE( bs.IsValid() );
+	ASSERT_EQ( 300u, v );
+}
+
+TEST( TestBitStream, testVarIntRoundTrip ) {
+	const uint values[] = { 0, 1, 127, 128, 300, 16383, 16384, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF };
+	const byte groups[] = { 1, 3, 4, 7, 8, 31 };
+
+	for ( uint g = 0; g < sizeof( groups ) / sizeof( groups[0] ); ++g )
+	{
+		for ( uint i = 0; i < sizeof( values ) / sizeof( values[0] ); ++i )
+		{
+			BitStream bs( 64 );
+
+			bs.WriteInt( 5, 3 );
+			bs.WriteVarInt( values[i], groups[g] );
+
+			ASSERT_EQ( 3 + BitStream::GetVarIntBits( values[i], groups[g] ), bs.GetBitPosition() );
+
+			bs.SetBitPosition( 3 );
+
+			uint v = 0;
+
+			bs.ReadVarInt( v, groups[g] );
+
+			ASSERT_TRUE( bs.IsValid() );
+			ASSERT_EQ( values[i], v );
+		}
+	}
+}
+
+TEST( TestBitStream, testVarIntCorrupt ) {
+	// 7 bit groups. the fifth group is at bit 28 and has room for 4 bits.
+
+	byte last[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x0F };
+
+	BitStream ok( last, sizeof( last ) );
+
+	uint v = 0;
+
+	ok.ReadVarInt( v );
+
+	ASSERT_TRUE( ok.IsValid() );
+	ASSERT_EQ( 0xFFFFFFFF, v );
+
+	// a bit past 32 in the last group
+
+	byte over[] = { 0xFF, 0xFF, 0xFF, 0xFF, 0x1F };
+
+	BitStream bad( over, sizeof( over ) );
+
+	v = 7;
+
+	bad.ReadVarInt( v );
+
+	ASSERT_TRUE( !bad.IsValid() );
+	ASSERT_EQ( 7u, v );
+
+	// a sixth group
+
+	byte more[] = { 0x80, 0x80, 0x80, 0x80, 0x80, 0x00 };
+
+	BitStream longer( more, sizeof( more ) );
+
+	longer.ReadVarInt( v );
+
+	ASSERT_TRUE( !longer.IsValid() );
+	ASSERT_EQ( 7u, v );
+
+	// the stream ends in the middle
+
+	byte cut[] = { 0xFF, 0xFF };
+
+	BitStream shorter( cut, sizeof( cut ) );
+
+	shorter.ReadVarInt( v );
+
+	ASSERT_TRUE( !shorter.IsValid() );
+	ASSERT_EQ( 7u, v );
+}
+
+TEST( TestBitStream, testZigZag ) {
+	ASSERT_EQ( 0u, BitStream::ZigZag( 0 ) );
+	ASSERT_EQ( 1u, BitStream::ZigZag( -1 ) );
+	ASSERT_EQ( 2u, BitStream::ZigZag( 1 ) );
+	ASSERT_EQ( 0xFFFFFFFE, BitStream::ZigZag( INT_MAX ) );
+	ASSERT_EQ( 0xFFFFFFFF, BitStream::ZigZag( INT_MIN ) );
+
+	const int values[] = { 0, -1, 1, -64, 63, -65, 64, INT_MAX, INT_MIN, INT_MIN + 1 };
+
+	for ( uint i = 0; i < sizeof( values ) / sizeof( values[0] ); ++i )
+	{
+		ASSERT_EQ( values[i], BitStream::UnZigZag( BitStream::ZigZag( values[i] ) ) );
+
+		BitStream bs( 16 );
+
+		bs.WriteVarSignedInt( values[i] );
+
+		bs.SetBitPosition( 0 );
+
+		int v = 0;
+
+		bs.ReadVarSignedInt( v );
+
+		ASSERT_TRUE( bs.IsValid() );
+		ASSERT_EQ( values[i], v );
+	}
+
+	// small values of both signs fit a group
+
+	ASSERT_EQ( 8u, BitStream::GetVarIntBits( BitStream::ZigZag( -64 ) ) );
+	ASSERT_EQ( 8u, BitStream::GetVarIntBits( BitStream::ZigZag( 63 ) ) );
+	ASSERT_EQ( 16u, BitStream::GetVarIntBits( BitStream::ZigZag( 64 ) ) );
+}
+
+TEST( TestBitStream, testRangedFloat ) {
+	const byte bitCounts[] = { 1, 8, 16, 32 };
+
+	for ( uint b = 0; b < sizeof( bitCounts ) / sizeof( bitCounts[0] ); ++b )
+	{
+		byte bits = bitCounts[b];
+
+		const float values[] = { -100.0f, -5.01f, -5.0f, 5.0f, 0.0f, 2.5f, 5.01f, 1e9f };
+		const float expects[] = { -5.0f, -5.0f, -5.0f, 5.0f, 0.0f, 2.5f, 5.0f, 5.0f };
+
+		for ( uint i = 0; i < sizeof( values ) / sizeof( values[0] ); ++i )
+		{
+			BitStream bs( 16 );
+
+			bs.WriteRangedFloat( values[i], -5.0f, 5.0f, bits );
+
+			ASSERT_EQ( (uint)bits, bs.GetBitPosition() );
+
+			bs.SetBitPosition( 0 );
+
+			float f = 0.0f;
+
+			bs.ReadRangedFloat( f, -5.0f, 5.0f, bits );
+
+			// half a step of error at most
+			double step = 10.0 / ( (double)( ( (uint8)1 << bits ) - 1 ) );
+
+			ASSERT_TRUE( f >= -5.0f && f <= 5.0f );
+			ASSERT_TRUE( ::fabs( f - expects[i] ) <= step / 2 + 1e-6 );
+		}
+	}
+}
+
+TEST( TestBitStream, testNormal ) {
+	const double PI = 3.14159265358979323846;
+	const byte BITS = 10;
+
+	double maxError = 0.0;
+
+	for ( uint i = 0; i < 64; ++i )
+	{
+		for ( uint k = 0; k <= 16; ++k )
+		{
+			double phi 	 = ( i / 32.0 - 1.0 ) * PI;
+			double theta = ( k / 8.0 - 1.0 ) * ( PI / 2 );
+
+			float n[3];
+
+			n[0] = (float)( ::sin( phi ) * ::cos( theta ) );
+			n[1] = (float)( ::cos( phi ) * ::cos( theta ) );
+			n[2] = (float)::sin( theta );
+
+			BitStream bs( 16 );
+
+			bs.WriteNormal( n, BITS );
+
+			ASSERT_EQ( (uint)BITS * 2 + 1, bs.GetBitPosition() );
+
+			bs.SetBitPosition( 0 );
+
+			float r[3];
+
+			bs.ReadNormal( r, BITS );
+
+			ASSERT_TRUE( bs.IsValid() );
+
+			for ( uint c = 0; c < 3; ++c )
+			{
+				double e = ::fabs( (double)r[c] - n[c] );
+
+				maxError = e > maxError ? e : maxError;
+			}
+
+			ASSERT_TRUE( ::fabs( r[0] * r[0] + r[1] * r[1] + r[2] * r[2] - 1.0 ) < 1e-4 );
+		}
+	}
+
+	// a step of each angle is about PI / 1023
+	ASSERT_TRUE( maxError < 0.005 );
+}
+
+TEST( TestBitStream, testQuaternionSign ) {
+	const byte BITS = 12;
+
+	// the largest component at each index, of both signs
+	const float base[4] = { 0.8f, 0.4f, -0.3f, 0.3316625f };
+
+	for ( uint largest = 0; largest < 4; ++largest )
+	{
+		for ( uint s = 0; s < 2; ++s )
+		{
+			float sign = s ? -1.0f : 1.0f;
+			float q[4];
+
+			for ( uint i = 0; i < 4; ++i )
+			{
+				q[( largest + i ) % 4] = base[i] * sign;
+			}
+
+			BitStream bs( 16 );
+
+			bs.WriteQuaternion( q, BITS );
+
+			ASSERT_EQ( 2u + BITS * 3, bs.GetBitPosition() );
+
+			bs.SetBitPosition( 0 );
+
+			float r[4];
+
+			bs.ReadQuaternion( r, BITS );
+
+			ASSERT_TRUE( bs.IsValid() );
+
+			// read back with the largest positive. q or -q.
+
+			ASSERT_TRUE( r[largest] > 0.0f );
+
+			for ( uint i = 0; i < 4; ++i )
+			{
+				ASSERT_TRUE( ::fabs( r[i] - q[i] * sign ) < 0.002 );
+			}
+		}
+	}
+}
@@ -0,0 +1,171 @@
+#pragma once 
+
+#include <knet/group/NmGroupDestroy.h>
+#include <knet/group/NmGroupLeave.h>
+#include <kserver/message/CmCellState.h>
+#include <gtest/gtest.h>
+
+#include <string.h>
+
+namespace {
+
+using namespace gk;
+
+// an odd offset so the fast path of the schema writes unaligned
+const uint PREFIX_BITS = 3;
+
+void 
+beginStream( BitStream& bs )
+{
+	bs.WriteInt( 5, PREFIX_BITS );
+}
+
+void 
+expectSameBits( BitStream& expected, BitStream& actual )
+{
+	ASSERT_TRUE( expected.IsValid() );
+	ASSERT_TRUE( actual.IsValid() );
+	ASSERT_EQ( expected.GetBitPosition(), actual.GetBitPosition() );
+
+	uint bytes = ( expected.GetBitPosition() + 7 ) >> 3;
+
+	ASSERT_EQ( 0, ::memcmp( expected.GetBuffer(), actual.GetBuffer(), bytes ) );
+}
+
+// reads the prefix and the type like TcpConnection::buildMessage
+void 
+unpackStream( BitStream& bs, Message& m )
+{
+	uint bitPos = bs.GetBitPosition();
+
+	bs.SetBitPosition( 0 );
+
+	uint prefix = 0;
+
+	bs.ReadInt( prefix, PREFIX_BITS );
+
+	ushort type = 0;
+
+	bs.Read( type );
+
+	ASSERT_EQ( 5u, prefix );
+	ASSERT_EQ( m.type, type );
+	ASSERT_TRUE( m.Unpack( bs ) );
+	ASSERT_EQ( bitPos, bs.GetBitPosition() );
+}
+
+} // 
+
+TEST( TestMessageSchema, testGroupLeave ) {
+	NmGroupLeave m;
+
+	m.contextKey 	= _T("leave");
+	m.groupId 		= 0x89ABCDEF;
+	m.connectionId 	= 0x01234567;
+
+	BitStream schema( 256 );
+	BitStream old( 256 );
+
+	beginStream( schema );
+	beginStream( old );
+
+	ASSERT_TRUE( m.Pack( schema ) );
+
+	// hand written Pack before K_SCHEMA. 32 bits for each uint.
+
+	m.Message::Pack( old );
+
+	uint headerBits = old.GetBitPosition();
+
+	old.Write( m.groupId );
+	old.Write( m.connectionId );
+
+	ASSERT_EQ( headerBits + 64, old.GetBitPosition() );
+
+	expectSameBits( old, schema );
+
+	NmGroupLeave r;
+
+	unpackStream( schema, r );
+
+	ASSERT_TRUE( r.contextKey == m.contextKey );
+	ASSERT_EQ( m.groupId, r.groupId );
+	ASSERT_EQ( m.connectionId, r.connectionId );
+}
+
+TEST( TestMessageSchema, testGroupDestroy ) {
+	NmGroupDestroy m;
+
+	m.contextKey 	= _T("destroy");
+	m.groupId 		= 0xFEDCBA98;
+
+	BitStream schema( 256 );
+	BitStream old( 256 );
+
+	beginStream( schema );
+	beginStream( old );
+
+	ASSERT_TRUE( m.Pack( schema ) );
+
+	m.Message::Pack( old );
+
+	uint headerBits = old.GetBitPosition();
+
+	old.Write( m.groupId );
+
+	ASSERT_EQ( headerBits + 32, old.GetBitPosition() );
+
+	expectSameBits( old, schema );
+
+	NmGroupDestroy r;
+
+	unpackStream( schema, r );
+
+	ASSERT_TRUE( r.contextKey == m.contextKey );
+	ASSERT_EQ( m.groupId, r.groupId );
+}
+
+TEST( TestMessageSchema, testCellState ) {
+	bool ups[] = { true, false };
+
+	for ( int i = 0; i < 2; ++i )
+	{
+		CmCellState m;
+
+		m.contextKey 	= _T("cell");
+		m.src 			= CellId( 1, 2, 3, 4 );
+		m.dst 			= CellId( 4095, 7, 0, 1 );
+		m.up 			= ups[i];
+
+		BitStream schema( 256 );
+		BitStream old( 256 );
+
+		beginStream( schema );
+		beginStream( old );
+
+		ASSERT_TRUE( m.Pack( schema ) );
+
+		// bool was a single flag bit
+
+		m.CellMessage::Pack( old );
+
+		uint headerBits = old.GetBitPosition();
+
+		old.WriteFlag( m.up );
+
+		ASSERT_EQ( headerBits + 1, old.GetBitPosition() );
+
+		expectSameBits( old, schema );
+
+		CmCellState r;
+
+		r.up = !m.up;
+
+		unpackStream( schema, r );
+
+		ASSERT_TRUE( r.contextKey == m.contextKey );
+		ASSERT_TRUE( r.src == m.src );
+		ASSERT_TRUE( r.dst == m.dst );
+		ASSERT_EQ( m.up, r.up );
+	}
+}
@@ -0,0 +1,509 @@
+#pragma once 
+
+#include <knet/replica/ReplicaReceiver.h>
+#include <knet/replica/Replicator.h>
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+using namespace gk;
+
+struct TestEntity
+{
+	typedef SchemaRange<-1000, 1000> Pos;
+
+	uint 	id;
+	int 	x;
+	int 	y;
+	bool 	alive;
+	byte 	tag[4];
+
+	TestEntity()
+		: id( 0 )
+		, x( 0 )
+		, y( 0 )
+		, alive( false )
+	{
+		::memset( tag, 0, sizeof( tag ) );
+	}
+
+	bool operator==( const TestEntity& rhs ) const
+	{
+		return id == rhs.id && 
+			   x == rhs.x && 
+			   y == rhs.y && 
+			   alive == rhs.alive && 
+			   ::memcmp( tag, rhs.tag, sizeof( tag ) ) == 0;
+	}
+
+	K_FIELDS_BEGIN()
+		K_FIELD( id, SchemaUInt<20> )
+		K_FIELD( x, Pos )
+		K_FIELD( y, Pos )
+		K_FIELD( alive, SchemaBool )
+		K_FIELD( tag, SchemaBytes<4> )
+	K_FIELDS_END()
+};
+
+const uint HISTORY 	 = 16;
+const uint CLIENT 	 = 7;
+const uint SEQ_FLAG  = 16; 	// SEQ{16} then FULL{1}
+const uint FIELDS 	 = 5;
+
+typedef Replicator<TestEntity, HISTORY> TestReplicator;
+typedef ReplicaReceiver<TestEntity, HISTORY> TestReceiver;
+
+// FULL flag of the update written at bitPos
+bool 
+isFull( BitStream& bs, uint bitPos )
+{
+	uint end = bs.GetBitPosition();
+
+	bs.SetBitPosition( bitPos + SEQ_FLAG );
+
+	bool full = bs.ReadFlag();
+
+	bs.SetBitPosition( end );
+
+	return full;
+}
+
+// write an update and deliver it. returns the sequence.
+uint 
+sendUpdate( TestReplicator& rep, TestReceiver& rcv, const TestEntity& e, bool& full, bool& updated )
+{
+	BitStream bs( 64 );
+
+	uint seq = rep.Write( CLIENT, e, bs );
+
+	K_RETURN_V_IF( seq == 0, 0 );
+
+	full = isFull( bs, 0 );
+
+	bs.SetBitPosition( 0 );
+
+	TestEntity r;
+
+	updated = rcv.Read( bs, r );
+
+	if ( updated && !( r == e ) )
+	{
+		return 0;
+	}
+
+	return seq;
+}
+
+} // 
+
+TEST( TestReplicator, testFullThenDelta ) {
+	TestReplicator rep;
+	TestReceiver rcv;
+
+	rep.AddClient( CLIENT );
+
+	TestEntity e;
+
+	e.id 	= 42;
+	e.x 	= -300;
+	e.alive = true;
+
+	bool full 	 = false;
+	bool updated = false;
+
+	// nothing acked. full state.
+
+	ASSERT_EQ( 1u, sendUpdate( rep, rcv, e, full, updated ) );
+	ASSERT_TRUE( full );
+	ASSERT_TRUE( updated );
+	ASSERT_EQ( 1u, rcv.GetLast() );
+
+	rep.OnAck( CLIENT, rcv.GetLast() );
+
+	ASSERT_EQ( 1u, rep.GetAcked( CLIENT ) );
+
+	// delta against 1 with x and tag changed
+
+	e.x 		= 999;
+	e.tag[2] 	= 0x5A;
+
+	ASSERT_EQ( 2u, sendUpdate( rep, rcv, e, full, updated ) );
+	ASSERT_TRUE( !full );
+	ASSERT_TRUE( updated );
+
+	// not acked. the base is still 1.
+
+	BitStream bs( 64 );
+
+	ASSERT_EQ( 3u, rep.Write( CLIENT, e, bs ) );
+	ASSERT_TRUE( !isFull( bs, 0 ) );
+
+	// no field changed since 3
+
+	BitStream same( 64 );
+
+	rep.OnAck( CLIENT, 3 );
+
+	ASSERT_EQ( 4u, rep.Write( CLIENT, e, same ) );
+	ASSERT_EQ( SEQ_FLAG + 1 + (uint)TestReplicator::DISTANCE_BITS + FIELDS, same.GetBitPosition() );
+}
+
+TEST( TestReplicator, testLossy ) {
+	TestReplicator rep;
+	TestReceiver rcv;
+
+	rep.AddClient( CLIENT );
+
+	::srand( 5 );
+
+	TestEntity e;
+
+	e.id = 1234;
+
+	uint fulls 	 = 0;
+	uint deltas  = 0;
+	uint lost 	 = 0;
+
+	for ( uint i = 0; i < 20000; ++i )
+	{
+		// connection opened again. both sides forget.
+
+		if ( i == 10000 )
+		{
+			rep.Reset( CLIENT );
+			rcv.Reset();
+
+			ASSERT_EQ( 0u, rep.GetAcked( CLIENT ) );
+		}
+
+		if ( ::rand() % 4 == 0 )
+		{
+			e.x = ::rand() % 2001 - 1000;
+		}
+
+		if ( ::rand() % 10 == 0 )
+		{
+			e.alive = !e.alive;
+		}
+
+		if ( ::rand() % 50 == 0 )
+		{
+			e.tag[::rand() % 4] = (byte)::rand();
+		}
+
+		BitStream bs( 64 );
+
+		uint seq = rep.Write( CLIENT, e, bs );
+
+		ASSERT_TRUE( seq != 0 );
+
+		isFull( bs, 0 ) ? ++fulls : ++deltas;
+
+		// 20% loss. acks come late or are lost.
+
+		if ( ::rand() % 5 == 0 )
+		{
+			++lost;
+
+			continue;
+		}
+
+		bs.SetBitPosition( 0 );
+
+		TestEntity r;
+
+		ASSERT_TRUE( rcv.Read( bs, r ) );
+		ASSERT_TRUE( r == e );
+		ASSERT_EQ( seq, rcv.GetLast() );
+
+		if ( ::rand() % 3 == 0 )
+		{
+			rep.OnAck( CLIENT, rcv.GetLast() );
+		}
+	}
+
+	ASSERT_TRUE( fulls > 0 );
+	ASSERT_TRUE( deltas > fulls );
+	ASSERT_TRUE( lost > 0 );
+}
+
+TEST( TestReplicator, testBaseOutOfHistory ) {
+	TestReplicator rep;
+	TestReceiver rcv;
+
+	rep.AddClient( CLIENT );
+
+	TestEntity e;
+
+	bool full 	 = false;
+	bool updated = false;
+
+	ASSERT_EQ( 1u, sendUpdate( rep, rcv, e, full, updated ) );
+
+	rep.OnAck( CLIENT, 1 );
+
+	// deltas until 1 is HISTORY behind
+
+	for ( uint seq = 2; seq < HISTORY + 1; ++seq )
+	{
+		e.x = seq;
+
+		ASSERT_EQ( seq, sendUpdate( rep, rcv, e, full, updated ) );
+		ASSERT_TRUE( !full );
+		ASSERT_TRUE( updated );
+	}
+
+	e.x = 500;
+
+	ASSERT_EQ( HISTORY + 1, sendUpdate( rep, rcv, e, full, updated ) );
+	ASSERT_TRUE( full );
+	ASSERT_TRUE( updated );
+
+	// 1 has left the history. an ack of it is ignored.
+
+	TestReplicator late;
+
+	late.AddClient( CLIENT );
+
+	BitStream bs( 64 * HISTORY );
+
+	for ( uint i = 0; i < HISTORY + 1; ++i )
+	{
+		late.Write( CLIENT, e, bs );
+	}
+
+	late.OnAck( CLIENT, 1 );
+
+	ASSERT_EQ( 0u, late.GetAcked( CLIENT ) );
+
+	late.OnAck( CLIENT, 2 );
+
+	ASSERT_EQ( 2u, late.GetAcked( CLIENT ) );
+
+	// the receiver lost its states. a delta is not applied. 
+
+	rep.OnAck( CLIENT, HISTORY + 1 );
+	rcv.Reset();
+
+	e.x = 501;
+
+	ASSERT_EQ( HISTORY + 2, sendUpdate( rep, rcv, e, full, updated ) );
+	ASSERT_TRUE( !full );
+	ASSERT_TRUE( !updated );
+	ASSERT_EQ( 0u, rcv.GetLast() );
+
+	// until the sender resets too
+
+	rep.Reset( CLIENT );
+
+	ASSERT_EQ( HISTORY + 3, sendUpdate( rep, rcv, e, full, updated ) );
+	ASSERT_TRUE( full );
+	ASSERT_TRUE( updated );
+}
+
+TEST( TestReplicator, testSeqWrap ) {
+	TestReplicator rep;
+	TestReceiver rcv;
+
+	rep.AddClient( CLIENT );
+
+	TestEntity e;
+
+	bool full 	 = false;
+	bool updated = false;
+
+	// past 0xFFFF twice with every update acked
+
+	for ( uint seq = 1; seq < 0x20010; ++seq )
+	{
+		e.y = seq % 1000;
+
+		ASSERT_EQ( seq, sendUpdate( rep, rcv, e, full, updated ) );
+		ASSERT_TRUE( updated );
+		ASSERT_EQ( seq, rcv.GetLast() );
+		ASSERT_EQ( seq == 1, full );
+
+		rep.OnAck( CLIENT, seq );
+	}
+
+	// out of order around the wrap
+
+	TestReplicator wrap;
+	TestReceiver out;
+
+	wrap.AddClient( CLIENT );
+
+	BitStream old( 64 );
+
+	uint seq = 0;
+
+	for ( uint i = 0; i < 0xFFFE; ++i )
+	{
+		old.Reset();
+
+		seq = wrap.Write( CLIENT, e, old );
+	}
+
+	ASSERT_EQ( 0xFFFEu, seq );
+
+	BitStream next( 64 );
+
+	e.y = 77;
+
+	ASSERT_EQ( 0xFFFFu, wrap.Write( CLIENT, e, next ) );
+
+	next.Reset();
+
+	e.y = 78;
+
+	ASSERT_EQ( 0x10000u, wrap.Write( CLIENT, e, next ) );
+
+	// 0x10000 is sent as 0
+
+	next.SetBitPosition( 0 );
+
+	uint low = 1;
+
+	next.ReadInt( low, SEQ_FLAG );
+
+	ASSERT_EQ( 0u, low );
+
+	TestEntity r;
+
+	old.SetBitPosition( 0 );
+	next.SetBitPosition( 0 );
+
+	ASSERT_TRUE( out.Read( old, r ) );
+	ASSERT_EQ( 0xFFFEu, out.GetLast() );
+	ASSERT_TRUE( out.Read( next, r ) );
+	ASSERT_EQ( 0x10000u, out.GetLast() );
+	ASSERT_EQ( 78, r.y );
+
+	// 0xFFFE again is older than 0x10000 after the wrap
+
+	old.SetBitPosition( 0 );
+
+	ASSERT_TRUE( !out.Read( old, r ) );
+	ASSERT_EQ( 0x10000u, out.GetLast() );
+	ASSERT_EQ( 78, r.y );
+}
+
+TEST( TestReplicator, testTransportAck ) {
+	TestReplicator rep;
+
+	rep.AddClient( CLIENT );
+
+	TestEntity e;
+
+	for ( uint i = 1; i <= 3; ++i )
+	{
+		BitStream bs( 64 );
+
+		e.x = i;
+
+		ASSERT_EQ( i, rep.Write( CLIENT, e, bs ) );
+
+		rep.OnSent( CLIENT, i, 10 + i );
+	}
+
+	// not bound to a sent sequence
+	rep.OnSent( CLIENT, 9, 100 );
+
+	rep.OnTransportAck( CLIENT, 10 );
+
+	ASSERT_EQ( 0u, rep.GetAcked( CLIENT ) );
+
+	rep.OnTransportAck( CLIENT, 12 );
+
+	ASSERT_EQ( 2u, rep.GetAcked( CLIENT ) );
+
+	// an older cumulative ack does not go back
+
+	rep.OnTransportAck( CLIENT, 11 );
+
+	ASSERT_EQ( 2u, rep.GetAcked( CLIENT ) );
+
+	// the next update is a delta against 2
+
+	BitStream bs( 64 );
+
+	ASSERT_EQ( 4u, rep.Write( CLIENT, e, bs ) );
+	ASSERT_TRUE( !isFull( bs, 0 ) );
+
+	bs.SetBitPosition( SEQ_FLAG + 1 );
+
+	uint distance = 0;
+
+	bs.ReadInt( distance, TestReplicator::DISTANCE_BITS );
+
+	ASSERT_EQ( 2u, distance );
+
+	rep.OnTransportAck( CLIENT, 1000 );
+
+	ASSERT_EQ( 3u, rep.GetAcked( CLIENT ) );
+
+	// Reset drops the bound sequences
+
+	rep.Reset( CLIENT );
+	rep.OnTransportAck( CLIENT, 1000 );
+
+	ASSERT_EQ( 0u, rep.GetAcked( CLIENT ) );
+}
+
+TEST( TestReplicator, testWriteFailure ) {
+	TestReplicator rep;
+
+	rep.AddClient( CLIENT );
+
+	TestEntity e;
+
+	e.id = 99;
+
+	// room for the sequence but not the state
+
+	byte small[4];
+
+	BitStream bs( small, sizeof( small ) );
+
+	bs.WriteInt( 5, 3 );
+
+	ASSERT_EQ( 0u, rep.Write( CLIENT, e, bs ) );
+	ASSERT_EQ( 3u, bs.GetBitPosition() );
+	ASSERT_TRUE( !bs.IsValid() );
+
+	// the client is not changed. the next one is still 1 and full.
+
+	BitStream ok( 64 );
+
+	ASSERT_EQ( 1u, rep.Write( CLIENT, e, ok ) );
+	ASSERT_TRUE( isFull( ok, 0 ) );
+
+	rep.OnAck( CLIENT, 1 );
+
+	// a delta failing
+
+	e.tag[0] = 1;
+	e.tag[3] = 2;
+
+	byte tiny[3];
+
+	BitStream delta( tiny, sizeof( tiny ) );
+
+	ASSERT_EQ( 0u, rep.Write( CLIENT, e, delta ) );
+	ASSERT_EQ( 0u, delta.GetBitPosition() );
+
+	BitStream next( 64 );
+
+	ASSERT_EQ( 2u, rep.Write( CLIENT, e, next ) );
+	ASSERT_TRUE( !isFull( next, 0 ) );
+
+	// unknown client
+
+	BitStream none( 64 );
+
+	ASSERT_EQ( 0u, rep.Write( CLIENT + 1, e, none ) );
+	ASSERT_EQ( 0u, none.GetBitPosition() );
+}
@@ -0,0 +1,17 @@
+// unit.cpp : Defines the entry point for the console application.
+//
+
+#include "stdafx.h"
+
+#include "tests/TestBitStream.h"
+#include "tests/TestMessageSchema.h"
+#include "tests/TestReplicator.h"
+#include <gtest/gtest.h>
+
+int _tmain(int argc, _TCHAR* argv[])
+{
+	::testing::InitGoogleTest(&argc, argv);
+
+	return RUN_ALL_TESTS();
+}
+